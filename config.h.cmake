@@ -9,6 +9,7 @@
 #cmakedefine HAVE_LIBEXECINFO
 #cmakedefine HAVE_CXXABI_H
 #cmakedefine HAVE_NICE
+#cmakedefine HAVE_EPOLL
 #cmakedefine HAVE_EDITLINE
 
 #cmakedefine ICINGA2_UNITY_BUILD
@@ -115,6 +115,8 @@ void Application::Exit(int rc)
 	std::cout.flush();
 	std::cerr.flush();
 
+	Logger::DisableAsyncLog();
+
 	BOOST_FOREACH(const Logger::Ptr& logger, Logger::GetLoggers()) {
 		logger->Flush();
 	}
@@ -1440,6 +1442,27 @@ ThreadPool& Application::GetTP(void)
 	return tp;
 }
 
+/**
+ * Applies the ThreadPoolSize and ThreadPoolMaxPending constants to the
+ * global thread pool. ThreadPoolMaxPending only throttles callers which
+ * opt in with ThrottledScheduler (e.g. the checker); timers, socket events
+ * and work queues are never blocked because workers may wait for them.
+ */
+void Application::UpdateThreadPoolLimits(void)
+{
+	Value defaultMaxPending = 0;
+
+	Value size = ScriptGlobal::Get("ThreadPoolSize", &Empty);
+	int maxPending = ScriptGlobal::Get("ThreadPoolMaxPending", &defaultMaxPending);
+
+	if (size.IsEmpty())
+		GetTP().SetMaxThreads(UINT_MAX);
+	else
+		GetTP().SetMaxThreads(std::max(static_cast<int>(size), 1));
+
+	GetTP().SetMaxPending(std::max(maxPending, 0));
+}
+
 double Application::GetStartTime(void)
 {
 	return m_StartTime;
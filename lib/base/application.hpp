@@ -128,6 +128,7 @@ public:
 	static void DeclareConcurrency(int ncpus);
 
 	static ThreadPool& GetTP(void);
+	static void UpdateThreadPoolLimits(void);
 
 	static String GetAppVersion(void);
 
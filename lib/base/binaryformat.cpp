@@ -0,0 +1,291 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/binaryformat.hpp"
+#include "base/dictionary.hpp"
+#include "base/array.hpp"
+#include "base/objectlock.hpp"
+#include "base/convert.hpp"
+#include <boost/foreach.hpp>
+#include <boost/cstdint.hpp>
+#include <cstring>
+#include <iterator>
+#include <cmath>
+
+using namespace icinga;
+
+/*
+ * Values are encoded as a tag byte followed by the tag-specific payload.
+ * Lengths and counts are stored as LEB128 variable-length integers, numbers
+ * as their IEEE 754 bit pattern in network byte order. Integral numbers are
+ * stored as zigzag-encoded variable-length integers instead.
+ */
+enum BinaryTag
+{
+	BinaryEmpty = 0,
+	BinaryFalse = 1,
+	BinaryTrue = 2,
+	BinaryNumber = 3,
+	BinaryInteger = 4,
+	BinaryString = 5,
+	BinaryArray = 6,
+	BinaryDictionary = 7
+};
+
+static void EncodeVarint(std::string& buf, boost::uint64_t value)
+{
+	while (value >= 0x80) {
+		buf += static_cast<char>((value & 0x7f) | 0x80);
+		value >>= 7;
+	}
+
+	buf += static_cast<char>(value);
+}
+
+static void EncodeString(std::string& buf, const String& str)
+{
+	EncodeVarint(buf, str.GetLength());
+	buf.append(str.GetData());
+}
+
+static void EncodeValue(std::string& buf, const Value& value)
+{
+	switch (value.GetType()) {
+		case ValueEmpty:
+			buf += static_cast<char>(BinaryEmpty);
+			break;
+
+		case ValueBoolean:
+			buf += static_cast<char>(static_cast<bool>(value) ? BinaryTrue : BinaryFalse);
+			break;
+
+		case ValueNumber: {
+			double number = value;
+
+			if (number >= -4503599627370496.0 && number <= 4503599627370496.0 && static_cast<double>(static_cast<boost::int64_t>(number)) == number &&
+			    !(number == 0 && std::signbit(number))) {
+				boost::int64_t integer = static_cast<boost::int64_t>(number);
+				buf += static_cast<char>(BinaryInteger);
+				EncodeVarint(buf, (static_cast<boost::uint64_t>(integer) << 1) ^ static_cast<boost::uint64_t>(integer >> 63));
+				break;
+			}
+
+			boost::uint64_t bits;
+			memcpy(&bits, &number, sizeof(bits));
+
+			buf += static_cast<char>(BinaryNumber);
+
+			for (int i = 7; i >= 0; i--)
+				buf += static_cast<char>((bits >> (i * 8)) & 0xff);
+
+			break;
+		}
+
+		case ValueString:
+			buf += static_cast<char>(BinaryString);
+			EncodeString(buf, static_cast<String>(value));
+			break;
+
+		case ValueObject: {
+			Object::Ptr obj = value;
+
+			Dictionary::Ptr dict = dynamic_pointer_cast<Dictionary>(obj);
+
+			if (dict) {
+				buf += static_cast<char>(BinaryDictionary);
+
+				ObjectLock olock(dict);
+				EncodeVarint(buf, std::distance(dict->Begin(), dict->End()));
+
+				BOOST_FOREACH(const Dictionary::Pair& kv, dict) {
+					EncodeString(buf, kv.first);
+					EncodeValue(buf, kv.second);
+				}
+
+				break;
+			}
+
+			Array::Ptr arr = dynamic_pointer_cast<Array>(obj);
+
+			if (arr) {
+				buf += static_cast<char>(BinaryArray);
+
+				ObjectLock olock(arr);
+				EncodeVarint(buf, arr->End() - arr->Begin());
+
+				BOOST_FOREACH(const Value& item, arr) {
+					EncodeValue(buf, item);
+				}
+
+				break;
+			}
+
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot encode object of type '" + obj->GetReflectionType()->GetName() + "'."));
+		}
+
+		default:
+			VERIFY(!"Invalid variant type.");
+	}
+}
+
+/**
+ * Encodes a value (consisting of dictionaries, arrays and scalar values) in
+ * a compact binary format.
+ *
+ * @param value The value.
+ * @returns The encoded value.
+ */
+String icinga::BinaryEncode(const Value& value)
+{
+	std::string buf;
+	EncodeValue(buf, value);
+	return buf;
+}
+
+namespace
+{
+
+struct BinaryReader
+{
+	const unsigned char *Data;
+	const unsigned char *End;
+
+	void Require(size_t count) const
+	{
+		if (static_cast<size_t>(End - Data) < count)
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Unexpected end of binary data."));
+	}
+
+	boost::uint64_t ReadVarint(void)
+	{
+		boost::uint64_t value = 0;
+
+		for (int shift = 0; shift < 64; shift += 7) {
+			Require(1);
+
+			unsigned char byte = *Data++;
+			value |= static_cast<boost::uint64_t>(byte & 0x7f) << shift;
+
+			if (!(byte & 0x80))
+				return value;
+		}
+
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid variable-length integer in binary data."));
+	}
+
+	String ReadString(void)
+	{
+		boost::uint64_t length = ReadVarint();
+		Require(length);
+
+		String str(reinterpret_cast<const char *>(Data), reinterpret_cast<const char *>(Data) + length);
+		Data += length;
+		return str;
+	}
+
+	Value ReadValue(int depth)
+	{
+		if (depth > 256)
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Binary data is nested too deeply."));
+
+		Require(1);
+
+		switch (*Data++) {
+			case BinaryEmpty:
+				return Empty;
+
+			case BinaryFalse:
+				return false;
+
+			case BinaryTrue:
+				return true;
+
+			case BinaryNumber: {
+				Require(8);
+
+				boost::uint64_t bits = 0;
+
+				for (int i = 0; i < 8; i++)
+					bits = (bits << 8) | *Data++;
+
+				double number;
+				memcpy(&number, &bits, sizeof(number));
+				return number;
+			}
+
+			case BinaryInteger: {
+				boost::uint64_t zigzag = ReadVarint();
+				boost::int64_t integer = static_cast<boost::int64_t>(zigzag >> 1) ^ -static_cast<boost::int64_t>(zigzag & 1);
+				return static_cast<double>(integer);
+			}
+
+			case BinaryString:
+				return ReadString();
+
+			case BinaryArray: {
+				boost::uint64_t count = ReadVarint();
+
+				Array::Ptr arr = new Array();
+
+				for (boost::uint64_t i = 0; i < count; i++)
+					arr->Add(ReadValue(depth + 1));
+
+				return arr;
+			}
+
+			case BinaryDictionary: {
+				boost::uint64_t count = ReadVarint();
+
+				Dictionary::Ptr dict = new Dictionary();
+
+				for (boost::uint64_t i = 0; i < count; i++) {
+					String key = ReadString();
+					dict->Set(key, ReadValue(depth + 1));
+				}
+
+				return dict;
+			}
+
+			default:
+				BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid tag in binary data."));
+		}
+	}
+};
+
+}
+
+/**
+ * Decodes a value which was encoded with BinaryEncode().
+ *
+ * @param data The encoded value.
+ * @returns The value.
+ */
+Value icinga::BinaryDecode(const String& data)
+{
+	BinaryReader reader;
+	reader.Data = reinterpret_cast<const unsigned char *>(data.GetData().c_str());
+	reader.End = reader.Data + data.GetLength();
+
+	Value value = reader.ReadValue(0);
+
+	if (reader.Data != reader.End)
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Unexpected trailing data after binary value."));
+
+	return value;
+}
@@ -23,6 +23,7 @@
 #include "base/serializer.hpp"
 #include "base/netstring.hpp"
 #include "base/json.hpp"
+#include "base/binaryformat.hpp"
 #include "base/stdiostream.hpp"
 #include "base/debug.hpp"
 #include "base/objectlock.hpp"
@@ -35,7 +36,10 @@
 #include "base/application.hpp"
 #include "config/configitem.hpp"
 #include <fstream>
+#include <cstring>
 #include <boost/foreach.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/exception/errinfo_api_function.hpp>
@@ -49,6 +53,7 @@ REGISTER_TYPE_WITH_PROTOTYPE(ConfigObject, ConfigObject::GetPrototype());
 boost::signals2::signal<void (const ConfigObject::Ptr&)> ConfigObject::OnStateChanged;
 
 ConfigObject::ConfigObject(void)
+	: m_StateHash(0)
 { }
 
 ConfigType::Ptr ConfigObject::GetType(void) const
@@ -483,55 +488,180 @@ void ConfigObject::SetAuthority(bool authority)
 	}
 }
 
+/*
+ * The program state file starts with a magic string followed by records
+ * which consist of a key ("<type>\0<name>") and the binary-encoded state of
+ * the object, each prefixed with its length. Dumps only append records for
+ * objects whose state has changed since it was last written; when a record
+ * for an object appears more than once the last one wins. Once the file
+ * contains twice as many records as there are objects it is compacted by
+ * writing a new file.
+ */
+static const char l_StateMagic[] = "ICINGA2STATE1\n";
+static const size_t l_StateMagicLength = sizeof(l_StateMagic) - 1;
+
+static boost::mutex l_StateMutex;
+static String l_StateFile;
+static unsigned long l_StateRecords;
+static unsigned long l_StateObjects;
+
+static void EncodeStateLength(char *buf, size_t length)
+{
+	for (int i = 3; i >= 0; i--) {
+		buf[i] = length & 0xff;
+		length >>= 8;
+	}
+}
+
+static size_t DecodeStateLength(const char *buf)
+{
+	size_t length = 0;
+
+	for (int i = 0; i < 4; i++)
+		length = (length << 8) | static_cast<unsigned char>(buf[i]);
+
+	return length;
+}
+
+static size_t HashStateRecord(const String& key, const String& data)
+{
+	size_t seed = 0;
+	boost::hash_combine(seed, key.GetData());
+	boost::hash_combine(seed, data.GetData());
+	return seed;
+}
+
+void ConfigObject::SerializeStateChunk(const std::vector<ConfigObject::Ptr>& objects, size_t begin, size_t end,
+    int attributeTypes, bool all, std::vector<ConfigObjectStateRecord>& records)
+{
+	for (size_t i = begin; i < end; i++) {
+		const ConfigObject::Ptr& object = objects[i];
+
+		Dictionary::Ptr update = Serialize(object, attributeTypes);
+
+		if (!update)
+			continue;
+
+		ConfigObjectStateRecord record;
+		record.Key = object->GetReflectionType()->GetName();
+		record.Key += '\0';
+		record.Key += object->GetName();
+		record.Data = BinaryEncode(update);
+		record.Hash = HashStateRecord(record.Key, record.Data);
+
+		if (!all && record.Hash == object->m_StateHash)
+			continue;
+
+		record.Object = object;
+		records.push_back(record);
+	}
+}
+
 void ConfigObject::DumpObjects(const String& filename, int attributeTypes)
 {
+	boost::mutex::scoped_lock lock(l_StateMutex);
+
+	bool compact = (l_StateFile != filename || l_StateRecords > 2 * l_StateObjects || !Utility::PathExists(filename));
+
 	Log(LogInformation, "ConfigObject")
-	    << "Dumping program state to file '" << filename << "'";
+	    << "Dumping program state to file '" << filename << "'" << (compact ? "" : " (changed objects only)");
 
-	String tempFilename = filename + ".tmp";
+	String outFilename = compact ? filename + ".tmp" : filename;
 
-	std::fstream fp;
-	fp.open(tempFilename.CStr(), std::ios_base::out);
+	std::ofstream fp;
+	fp.open(outFilename.CStr(), std::ios_base::out | std::ios_base::binary | (compact ? std::ios_base::trunc : std::ios_base::app));
 
 	if (!fp)
-		BOOST_THROW_EXCEPTION(std::runtime_error("Could not open '" + tempFilename + "' file"));
+		BOOST_THROW_EXCEPTION(std::runtime_error("Could not open '" + outFilename + "' file"));
+
+	/* a failed dump leaves a partially written file behind */
+	l_StateFile = String();
+
+	if (compact)
+		fp.write(l_StateMagic, l_StateMagicLength);
 
-	StdioStream::Ptr sfp = new StdioStream(&fp, false);
+	std::vector<ConfigObject::Ptr> objects;
 
 	BOOST_FOREACH(const ConfigType::Ptr& type, ConfigType::GetTypes()) {
 		BOOST_FOREACH(const ConfigObject::Ptr& object, type->GetObjects()) {
-			Dictionary::Ptr persistentObject = new Dictionary();
+			objects.push_back(object);
+		}
+	}
 
-			persistentObject->Set("type", type->GetName());
-			persistentObject->Set("name", object->GetName());
+	/* Objects are serialized in parallel, a batch of chunks at a time so
+	 * that only the records for the current batch are kept in memory. */
+	int concurrency = Application::GetConcurrency();
+	const size_t chunkSize = 256;
+	const size_t batchSize = chunkSize * 4 * concurrency;
 
-			Dictionary::Ptr update = Serialize(object, attributeTypes);
+	WorkQueue upq(25000, concurrency);
 
-			if (!update)
-				continue;
+	unsigned long written = 0;
+
+	for (size_t offset = 0; offset < objects.size(); offset += batchSize) {
+		size_t batchEnd = std::min(offset + batchSize, objects.size());
 
-			persistentObject->Set("update", update);
+		std::vector<std::vector<ConfigObjectStateRecord> > chunks((batchEnd - offset + chunkSize - 1) / chunkSize);
 
-			String json = JsonEncode(persistentObject);
+		for (size_t i = 0; i < chunks.size(); i++) {
+			size_t begin = offset + i * chunkSize;
+			size_t end = std::min(begin + chunkSize, batchEnd);
 
-			NetString::WriteStringToStream(sfp, json);
+			upq.Enqueue(boost::bind(&ConfigObject::SerializeStateChunk, boost::cref(objects), begin, end,
+			    attributeTypes, compact, boost::ref(chunks[i])));
 		}
-	}
 
-	sfp->Close();
+		upq.Join();
+
+		if (upq.HasExceptions()) {
+			upq.ReportExceptions("ConfigObject");
+			BOOST_THROW_EXCEPTION(std::runtime_error("Could not serialize program state."));
+		}
+
+		BOOST_FOREACH(const std::vector<ConfigObjectStateRecord>& chunk, chunks) {
+			BOOST_FOREACH(const ConfigObjectStateRecord& record, chunk) {
+				char header[4];
+
+				EncodeStateLength(header, record.Key.GetLength());
+				fp.write(header, sizeof(header));
+				fp.write(record.Key.CStr(), record.Key.GetLength());
+
+				EncodeStateLength(header, record.Data.GetLength());
+				fp.write(header, sizeof(header));
+				fp.write(record.Data.CStr(), record.Data.GetLength());
+
+				record.Object->m_StateHash = record.Hash;
+				written++;
+			}
+		}
+	}
 
 	fp.close();
 
+	if (fp.fail())
+		BOOST_THROW_EXCEPTION(std::runtime_error("Could not write '" + outFilename + "' file"));
+
+	if (compact) {
 #ifdef _WIN32
-	_unlink(filename.CStr());
+		_unlink(filename.CStr());
 #endif /* _WIN32 */
 
-	if (rename(tempFilename.CStr(), filename.CStr()) < 0) {
-		BOOST_THROW_EXCEPTION(posix_error()
-		    << boost::errinfo_api_function("rename")
-		    << boost::errinfo_errno(errno)
-		    << boost::errinfo_file_name(tempFilename));
-	}
+		if (rename(outFilename.CStr(), filename.CStr()) < 0) {
+			BOOST_THROW_EXCEPTION(posix_error()
+			    << boost::errinfo_api_function("rename")
+			    << boost::errinfo_errno(errno)
+			    << boost::errinfo_file_name(outFilename));
+		}
+
+		l_StateRecords = written;
+	} else
+		l_StateRecords += written;
+
+	l_StateFile = filename;
+	l_StateObjects = objects.size();
+
+	Log(LogInformation, "ConfigObject")
+	    << "Dumped the state of " << written << " out of " << objects.size() << " objects.";
 }
 
 void ConfigObject::RestoreObject(const String& message, int attributeTypes)
@@ -563,6 +693,64 @@ void ConfigObject::RestoreObject(const String& message, int attributeTypes)
 	object->SetStateLoaded(true);
 }
 
+void ConfigObject::RestoreBinaryObject(const String& key, const String& data, int attributeTypes)
+{
+	String::SizeType pos = key.FindFirstOf('\0');
+
+	if (pos == String::NPos)
+		return;
+
+	String type = key.SubStr(0, pos);
+	String name = key.SubStr(pos + 1);
+
+	ConfigType::Ptr dt = ConfigType::GetByName(type);
+
+	if (!dt)
+		return;
+
+	ConfigObject::Ptr object = dt->GetObject(name);
+
+	if (!object)
+		return;
+
+	ASSERT(!object->IsActive());
+#ifdef I2_DEBUG
+	Log(LogDebug, "ConfigObject")
+	    << "Restoring object '" << name << "' of type '" << type << "'.";
+#endif /* I2_DEBUG */
+	Dictionary::Ptr update = BinaryDecode(data);
+	Deserialize(object, update, false, attributeTypes);
+	object->m_StateHash = HashStateRecord(key, data);
+	object->OnStateLoaded();
+	object->SetStateLoaded(true);
+}
+
+static bool ReadStateField(std::istream& fp, String *field, std::streamoff *remaining)
+{
+	char header[4];
+
+	if (*remaining < static_cast<std::streamoff>(sizeof(header)) || !fp.read(header, sizeof(header)))
+		return false;
+
+	*remaining -= sizeof(header);
+
+	size_t length = DecodeStateLength(header);
+
+	/* a length beyond the end of the file belongs to a torn record */
+	if (static_cast<std::streamoff>(length) > *remaining)
+		return false;
+
+	std::vector<char> buf(length);
+
+	if (length > 0 && !fp.read(&buf[0], length))
+		return false;
+
+	*remaining -= length;
+
+	*field = String(buf.begin(), buf.end());
+	return true;
+}
+
 void ConfigObject::RestoreObjects(const String& filename, int attributeTypes)
 {
 	if (!Utility::PathExists(filename))
@@ -571,31 +759,83 @@ void ConfigObject::RestoreObjects(const String& filename, int attributeTypes)
 	Log(LogInformation, "ConfigObject")
 	    << "Restoring program state from file '" << filename << "'";
 
+	boost::mutex::scoped_lock lock(l_StateMutex);
+
 	std::fstream fp;
-	fp.open(filename.CStr(), std::ios_base::in);
+	fp.open(filename.CStr(), std::ios_base::in | std::ios_base::binary);
 
-	StdioStream::Ptr sfp = new StdioStream (&fp, false);
+	char magic[l_StateMagicLength];
+	bool binary = fp.read(magic, l_StateMagicLength) && memcmp(magic, l_StateMagic, l_StateMagicLength) == 0;
 
 	unsigned long restored = 0;
 
 	WorkQueue upq(25000, Application::GetConcurrency());
 
-	String message;
-	StreamReadContext src;
-	for (;;) {
-		StreamReadStatus srs = NetString::ReadStringFromStream(sfp, &message, src);
+	std::map<String, String> states;
 
-		if (srs == StatusEof)
-			break;
+	if (binary) {
+		unsigned long records = 0;
 
-		if (srs != StatusNewItem)
-			continue;
+		fp.seekg(0, std::ios_base::end);
+		std::streamoff remaining = fp.tellg() - static_cast<std::streamoff>(l_StateMagicLength);
+		fp.seekg(l_StateMagicLength);
 
-		upq.Enqueue(boost::bind(&ConfigObject::RestoreObject, message, attributeTypes));
-		restored++;
-	}
+		/* Appending further records after a torn one would make them unreadable,
+		 * the next dump has to write a new file instead. */
+		bool torn = false;
 
-	sfp->Close();
+		while (remaining > 0) {
+			String key, data;
+
+			if (!ReadStateField(fp, &key, &remaining) || !ReadStateField(fp, &data, &remaining)) {
+				torn = true;
+				break;
+			}
+
+			states[key] = data;
+			records++;
+		}
+
+		fp.close();
+
+		if (torn) {
+			Log(LogWarning, "ConfigObject")
+			    << "Ignoring incomplete record at the end of the state file '" << filename << "'.";
+		}
+
+		typedef std::map<String, String>::value_type kv_pair;
+		BOOST_FOREACH(const kv_pair& kv, states) {
+			upq.Enqueue(boost::bind(&ConfigObject::RestoreBinaryObject, boost::cref(kv.first), boost::cref(kv.second), attributeTypes));
+			restored++;
+		}
+
+		/* further dumps append to this file */
+		l_StateFile = torn ? String() : filename;
+		l_StateRecords = records;
+		l_StateObjects = states.size();
+	} else {
+		fp.clear();
+		fp.seekg(0);
+
+		StdioStream::Ptr sfp = new StdioStream (&fp, false);
+
+		String message;
+		StreamReadContext src;
+		for (;;) {
+			StreamReadStatus srs = NetString::ReadStringFromStream(sfp, &message, src);
+
+			if (srs == StatusEof)
+				break;
+
+			if (srs != StatusNewItem)
+				continue;
+
+			upq.Enqueue(boost::bind(&ConfigObject::RestoreObject, message, attributeTypes));
+			restored++;
+		}
+
+		sfp->Close();
+	}
 
 	upq.Join();
 
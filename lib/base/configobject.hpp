@@ -31,6 +31,20 @@ namespace icinga
 {
 
 class ConfigType;
+class ConfigObject;
+
+/**
+ * A serialized object in the program state file.
+ *
+ * @ingroup base
+ */
+struct ConfigObjectStateRecord
+{
+	intrusive_ptr<ConfigObject> Object;
+	String Key;
+	String Data;
+	size_t Hash;
+};
 
 /**
  * A dynamic object that can be instantiated from the configuration file.
@@ -97,7 +111,12 @@ protected:
 	explicit ConfigObject(void);
 
 private:
+	size_t m_StateHash;
+
 	static void RestoreObject(const String& message, int attributeTypes);
+	static void RestoreBinaryObject(const String& key, const String& data, int attributeTypes);
+	static void SerializeStateChunk(const std::vector<ConfigObject::Ptr>& objects, size_t begin, size_t end,
+	    int attributeTypes, bool all, std::vector<ConfigObjectStateRecord>& records);
 };
 
 #define DECLARE_OBJECTNAME(klass)						\
@@ -22,11 +22,59 @@
 #include "base/debug.hpp"
 #include "base/primitivetype.hpp"
 #include <boost/foreach.hpp>
+#include <algorithm>
 
 using namespace icinga;
 
 REGISTER_PRIMITIVE_TYPE(Dictionary, Object, Dictionary::GetPrototype());
 
+/* Dictionaries with at least this many items are moved to a tree when
+ * a key is inserted out of order. */
+#define DICTIONARY_TREE_THRESHOLD 32
+
+struct DictionaryKeyLess
+{
+	inline bool operator()(const Dictionary::Pair& item, const String& key) const
+	{
+		return item.first < key;
+	}
+};
+
+/**
+ * Finds the item for the specified key.
+ *
+ * @param key The key.
+ * @returns The item or NULL if the key was not found.
+ */
+const Dictionary::Pair *Dictionary::FindKey(const String& key) const
+{
+	if (m_Tree) {
+		std::set<Pair, PairLess>::const_iterator it = m_TreeData.find(std::make_pair(key, Empty));
+
+		if (it == m_TreeData.end())
+			return NULL;
+
+		return &*it;
+	}
+
+	std::vector<Pair>::const_iterator it = std::lower_bound(m_Data.begin(), m_Data.end(), key, DictionaryKeyLess());
+
+	if (it != m_Data.end() && it->first == key)
+		return &*it;
+
+	return NULL;
+}
+
+/**
+ * Moves the items from the vector to the tree.
+ */
+void Dictionary::MoveToTree(void)
+{
+	m_TreeData.insert(m_Data.begin(), m_Data.end());
+	std::vector<Pair>().swap(m_Data);
+	m_Tree = true;
+}
+
 /**
  * Retrieves a value from a dictionary.
  *
@@ -38,12 +86,12 @@ Value Dictionary::Get(const String& key) const
 	ASSERT(!OwnsLock());
 	ObjectLock olock(this);
 
-	std::map<String, Value>::const_iterator it = m_Data.find(key);
+	const Pair *item = FindKey(key);
 
-	if (it == m_Data.end())
+	if (!item)
 		return Empty;
 
-	return it->second;
+	return item->second;
 }
 
 /**
@@ -58,12 +106,12 @@ bool Dictionary::Get(const String& key, Value *result) const
 	ASSERT(!OwnsLock());
 	ObjectLock olock(this);
 
-	std::map<String, Value>::const_iterator it = m_Data.find(key);
+	const Pair *item = FindKey(key);
 
-	if (it == m_Data.end())
+	if (!item)
 		return false;
 
-	*result = it->second;
+	*result = item->second;
 	return true;
 }
 
@@ -78,10 +126,34 @@ void Dictionary::Set(const String& key, const Value& value)
 	ASSERT(!OwnsLock());
 	ObjectLock olock(this);
 
-	std::pair<std::map<String, Value>::iterator, bool> ret;
-	ret = m_Data.insert(std::make_pair(key, value));
+	if (!m_Tree) {
+		/* Keys are usually added in order (e.g. when decoding JSON or copying
+		 * another dictionary), so check for the append case first. */
+		if (m_Data.empty() || m_Data.back().first < key) {
+			m_Data.push_back(std::make_pair(key, value));
+			return;
+		}
+
+		std::vector<Pair>::iterator it = std::lower_bound(m_Data.begin(), m_Data.end(), key, DictionaryKeyLess());
+
+		if (it != m_Data.end() && it->first == key) {
+			it->second = value;
+			return;
+		}
+
+		if (m_Data.size() < DICTIONARY_TREE_THRESHOLD) {
+			m_Data.insert(it, std::make_pair(key, value));
+			return;
+		}
+
+		MoveToTree();
+	}
+
+	std::pair<std::set<Pair, PairLess>::iterator, bool> ret = m_TreeData.insert(std::make_pair(key, value));
+
+	/* The set is ordered by key only, so the value can be updated in place. */
 	if (!ret.second)
-		ret.first->second = value;
+		const_cast<Pair&>(*ret.first).second = value;
 }
 
 
@@ -95,7 +167,10 @@ size_t Dictionary::GetLength(void) const
 	ASSERT(!OwnsLock());
 	ObjectLock olock(this);
 
-	return m_Data.size();
+	if (m_Tree)
+		return m_TreeData.size();
+	else
+		return m_Data.size();
 }
 
 /**
@@ -109,7 +184,7 @@ bool Dictionary::Contains(const String& key) const
 	ASSERT(!OwnsLock());
 	ObjectLock olock(this);
 
-	return (m_Data.find(key) != m_Data.end());
+	return (FindKey(key) != NULL);
 }
 
 /**
@@ -122,13 +197,15 @@ void Dictionary::Remove(const String& key)
 	ASSERT(!OwnsLock());
 	ObjectLock olock(this);
 
-	Dictionary::Iterator it;
-	it = m_Data.find(key);
-
-	if (it == m_Data.end())
+	if (m_Tree) {
+		m_TreeData.erase(std::make_pair(key, Empty));
 		return;
+	}
+
+	std::vector<Pair>::iterator it = std::lower_bound(m_Data.begin(), m_Data.end(), key, DictionaryKeyLess());
 
-	m_Data.erase(it);
+	if (it != m_Data.end() && it->first == key)
+		m_Data.erase(it);
 }
 
 /**
@@ -140,6 +217,8 @@ void Dictionary::Clear(void)
 	ObjectLock olock(this);
 
 	m_Data.clear();
+	m_TreeData.clear();
+	m_Tree = false;
 }
 
 void Dictionary::CopyTo(const Dictionary::Ptr& dest) const
@@ -150,6 +229,10 @@ void Dictionary::CopyTo(const Dictionary::Ptr& dest) const
 	BOOST_FOREACH(const Dictionary::Pair& kv, m_Data) {
 		dest->Set(kv.first, kv.second);
 	}
+
+	BOOST_FOREACH(const Dictionary::Pair& kv, m_TreeData) {
+		dest->Set(kv.first, kv.second);
+	}
 }
 
 /**
@@ -159,8 +242,13 @@ void Dictionary::CopyTo(const Dictionary::Ptr& dest) const
  */
 Dictionary::Ptr Dictionary::ShallowClone(void) const
 {
+	ASSERT(!OwnsLock());
+	ObjectLock olock(this);
+
 	Dictionary::Ptr clone = new Dictionary();
-	CopyTo(clone);
+	clone->m_Data = m_Data;
+	clone->m_TreeData = m_TreeData;
+	clone->m_Tree = m_Tree;
 	return clone;
 }
 
@@ -175,9 +263,18 @@ Object::Ptr Dictionary::Clone(void) const
 	Dictionary::Ptr dict = new Dictionary();
 	
 	ObjectLock olock(this);
+
+	dict->m_Data.reserve(m_Data.size());
+
 	BOOST_FOREACH(const Dictionary::Pair& kv, m_Data) {
-		dict->Set(kv.first, kv.second.Clone());
+		dict->m_Data.push_back(std::make_pair(kv.first, kv.second.Clone()));
 	}
+
+	BOOST_FOREACH(const Dictionary::Pair& kv, m_TreeData) {
+		dict->m_TreeData.insert(dict->m_TreeData.end(), std::make_pair(kv.first, kv.second.Clone()));
+	}
+
+	dict->m_Tree = m_Tree;
 	
 	return dict;
 }
@@ -194,10 +291,15 @@ std::vector<String> Dictionary::GetKeys(void) const
 	ObjectLock olock(this);
 
 	std::vector<String> keys;
+	keys.reserve(m_Data.size() + m_TreeData.size());
 
 	BOOST_FOREACH(const Dictionary::Pair& kv, m_Data) {
 		keys.push_back(kv.first);
 	}
 
+	BOOST_FOREACH(const Dictionary::Pair& kv, m_TreeData) {
+		keys.push_back(kv.first);
+	}
+
 	return keys;
 }
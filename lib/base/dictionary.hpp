@@ -24,14 +24,19 @@
 #include "base/object.hpp"
 #include "base/value.hpp"
 #include <boost/range/iterator.hpp>
-#include <map>
+#include <boost/iterator/iterator_facade.hpp>
 #include <vector>
+#include <set>
 
 namespace icinga
 {
 
 /**
- * A container that holds key-value pairs.
+ * A container that holds key-value pairs. The items are kept in a vector
+ * which is sorted by key, so iteration order is the same as for a std::map
+ * while lookups do not have to chase tree nodes. Large dictionaries whose
+ * keys are not added in order are moved to a tree so that inserting items
+ * does not have to shift the vector.
  *
  * @ingroup base
  */
@@ -40,16 +45,83 @@ class I2_BASE_API Dictionary : public Object
 public:
 	DECLARE_OBJECT(Dictionary);
 
+	typedef std::pair<String, Value> Pair;
+
 	/**
-	 * An iterator that can be used to iterate over dictionary elements.
+	 * Orders dictionary items by their key.
 	 */
-	typedef std::map<String, Value>::iterator Iterator;
-
-	typedef std::map<String, Value>::size_type SizeType;
+	struct PairLess
+	{
+		inline bool operator()(const Pair& a, const Pair& b) const
+		{
+			return a.first < b.first;
+		}
+	};
 
-	typedef std::pair<String, Value> Pair;
+	/**
+	 * An iterator that can be used to iterate over dictionary elements.
+	 */
+	class Iterator : public boost::iterator_facade<Iterator, Pair, boost::bidirectional_traversal_tag>
+	{
+	public:
+		inline Iterator(void)
+			: m_Tree(false)
+		{ }
+
+		inline Iterator(const std::vector<Pair>::iterator& it)
+			: m_Tree(false), m_VectorIterator(it)
+		{ }
+
+		inline Iterator(const std::set<Pair, PairLess>::iterator& it)
+			: m_Tree(true), m_TreeIterator(it)
+		{ }
+
+	private:
+		friend class boost::iterator_core_access;
+		friend class Dictionary;
+
+		bool m_Tree;
+		std::vector<Pair>::iterator m_VectorIterator;
+		std::set<Pair, PairLess>::iterator m_TreeIterator;
+
+		inline Pair& dereference(void) const
+		{
+			/* The set is ordered by key only, so callers may modify the value. */
+			if (m_Tree)
+				return const_cast<Pair&>(*m_TreeIterator);
+			else
+				return *m_VectorIterator;
+		}
+
+		inline bool equal(const Iterator& other) const
+		{
+			if (m_Tree)
+				return m_TreeIterator == other.m_TreeIterator;
+			else
+				return m_VectorIterator == other.m_VectorIterator;
+		}
+
+		inline void increment(void)
+		{
+			if (m_Tree)
+				++m_TreeIterator;
+			else
+				++m_VectorIterator;
+		}
+
+		inline void decrement(void)
+		{
+			if (m_Tree)
+				--m_TreeIterator;
+			else
+				--m_VectorIterator;
+		}
+	};
+
+	typedef std::vector<Pair>::size_type SizeType;
 
 	inline Dictionary(void)
+		: m_Tree(false)
 	{ }
 
 	inline ~Dictionary(void)
@@ -71,7 +143,10 @@ public:
 	{
 		ASSERT(OwnsLock());
 
-		return m_Data.begin();
+		if (m_Tree)
+			return m_TreeData.begin();
+		else
+			return m_Data.begin();
 	}
 
 	/**
@@ -85,7 +160,10 @@ public:
 	{
 		ASSERT(OwnsLock());
 
-		return m_Data.end();
+		if (m_Tree)
+			return m_TreeData.end();
+		else
+			return m_Data.end();
 	}
 
 	size_t GetLength(void) const;
@@ -101,7 +179,10 @@ public:
 	{
 		ASSERT(OwnsLock());
 
-		m_Data.erase(it);
+		if (m_Tree)
+			m_TreeData.erase(it.m_TreeIterator);
+		else
+			m_Data.erase(it.m_VectorIterator);
 	}
 
 	void Clear(void);
@@ -116,7 +197,12 @@ public:
 	virtual Object::Ptr Clone(void) const override;
 
 private:
-	std::map<String, Value> m_Data; /**< The data for the dictionary. */
+	std::vector<Pair> m_Data; /**< The data for the dictionary, sorted by key. */
+	std::set<Pair, PairLess> m_TreeData; /**< The data for large dictionaries. */
+	bool m_Tree; /**< Whether m_TreeData is used instead of m_Data. */
+
+	const Pair *FindKey(const String& key) const;
+	void MoveToTree(void);
 };
 
 inline Dictionary::Iterator range_begin(Dictionary::Ptr x)
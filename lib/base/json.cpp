@@ -23,16 +23,19 @@
 #include "base/array.hpp"
 #include "base/objectlock.hpp"
 #include "base/convert.hpp"
+#include "base/type.hpp"
 #include <boost/foreach.hpp>
 #include <boost/exception_ptr.hpp>
 #include <yajl/yajl_version.h>
 #include <yajl/yajl_gen.h>
 #include <yajl/yajl_parse.h>
-#include <stack>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
 
 using namespace icinga;
 
-static void Encode(yajl_gen handle, const Value& value);
+static void Encode(yajl_gen handle, const Value& value, int attributeTypes);
 
 #if YAJL_MAJOR < 2
 typedef unsigned int yajl_size;
@@ -40,35 +43,77 @@ typedef unsigned int yajl_size;
 typedef size_t yajl_size;
 #endif /* YAJL_MAJOR */
 
-static void EncodeDictionary(yajl_gen handle, const Dictionary::Ptr& dict)
+static inline void EncodeString(yajl_gen handle, const String& str)
+{
+	yajl_gen_string(handle, reinterpret_cast<const unsigned char *>(str.CStr()), str.GetLength());
+}
+
+static void EncodeDictionary(yajl_gen handle, const Dictionary::Ptr& dict, int attributeTypes)
 {
 	yajl_gen_map_open(handle);
 
 	ObjectLock olock(dict);
 	BOOST_FOREACH(const Dictionary::Pair& kv, dict) {
-		yajl_gen_string(handle, reinterpret_cast<const unsigned char *>(kv.first.CStr()), kv.first.GetLength());
-		Encode(handle, kv.second);
+		EncodeString(handle, kv.first);
+		Encode(handle, kv.second, attributeTypes);
 	}
 
 	yajl_gen_map_close(handle);
 }
 
-static void EncodeArray(yajl_gen handle, const Array::Ptr& arr)
+static void EncodeArray(yajl_gen handle, const Array::Ptr& arr, int attributeTypes)
 {
 	yajl_gen_array_open(handle);
 
 	ObjectLock olock(arr);
 	BOOST_FOREACH(const Value& value, arr) {
-		Encode(handle, value);
+		Encode(handle, value, attributeTypes);
 	}
 
 	yajl_gen_array_close(handle);
 }
 
-static void Encode(yajl_gen handle, const Value& value)
+/**
+ * Writes the fields of a reflected object directly into the generator. The
+ * output is equivalent to encoding the result of Serialize() for the object,
+ * but no intermediate dictionary is built.
+ */
+static void EncodeObject(yajl_gen handle, const Object::Ptr& object, int attributeTypes)
 {
-	String str;
+	Type::Ptr type;
+
+	if (attributeTypes != 0)
+		type = object->GetReflectionType();
+
+	if (!type) {
+		yajl_gen_null(handle);
+		return;
+	}
+
+	yajl_gen_map_open(handle);
+
+	for (int i = 0; i < type->GetFieldCount(); i++) {
+		Field field = type->GetFieldInfo(i);
 
+		if ((field.Attributes & attributeTypes) == 0)
+			continue;
+
+		/* Serialize() overwrites this attribute with the type name. */
+		if (strcmp(field.Name, "type") == 0)
+			continue;
+
+		yajl_gen_string(handle, reinterpret_cast<const unsigned char *>(field.Name), strlen(field.Name));
+		Encode(handle, object->GetField(i), attributeTypes);
+	}
+
+	yajl_gen_string(handle, reinterpret_cast<const unsigned char *>("type"), 4);
+	EncodeString(handle, type->GetName());
+
+	yajl_gen_map_close(handle);
+}
+
+static void Encode(yajl_gen handle, const Value& value, int attributeTypes)
+{
 	switch (value.GetType()) {
 		case ValueNumber:
 			if (yajl_gen_double(handle, static_cast<double>(value)) == yajl_gen_invalid_number)
@@ -80,17 +125,29 @@ static void Encode(yajl_gen handle, const Value& value)
 
 			break;
 		case ValueString:
-			str = value;
-			yajl_gen_string(handle, reinterpret_cast<const unsigned char *>(str.CStr()), str.GetLength());
+			EncodeString(handle, value);
 
 			break;
 		case ValueObject:
-			if (value.IsObjectType<Dictionary>())
-				EncodeDictionary(handle, value);
-			else if (value.IsObjectType<Array>())
-				EncodeArray(handle, value);
-			else
-				yajl_gen_null(handle);
+			{
+				Object::Ptr object = value;
+
+				Dictionary::Ptr dict = dynamic_pointer_cast<Dictionary>(object);
+
+				if (dict) {
+					EncodeDictionary(handle, dict, attributeTypes);
+					break;
+				}
+
+				Array::Ptr arr = dynamic_pointer_cast<Array>(object);
+
+				if (arr) {
+					EncodeArray(handle, arr, attributeTypes);
+					break;
+				}
+
+				EncodeObject(handle, object, attributeTypes);
+			}
 
 			break;
 		case ValueEmpty:
@@ -102,7 +159,7 @@ static void Encode(yajl_gen handle, const Value& value)
 	}
 }
 
-String icinga::JsonEncode(const Value& value, bool pretty_print)
+static String EncodeValue(const Value& value, bool pretty_print, int attributeTypes)
 {
 #if YAJL_MAJOR < 2
 	yajl_gen_config conf = { pretty_print, "" };
@@ -113,7 +170,7 @@ String icinga::JsonEncode(const Value& value, bool pretty_print)
 		yajl_gen_config(handle, yajl_gen_beautify, 1);
 #endif /* YAJL_MAJOR */
 
-	Encode(handle, value);
+	Encode(handle, value, attributeTypes);
 
 	const unsigned char *buf;
 	yajl_size len;
@@ -127,84 +184,62 @@ String icinga::JsonEncode(const Value& value, bool pretty_print)
 	return result;
 }
 
-struct JsonElement
+/**
+ * Encodes a value as JSON. Objects other than dictionaries and arrays
+ * are encoded as null.
+ */
+String icinga::JsonEncode(const Value& value, bool pretty_print)
 {
-	String Key;
-	bool KeySet;
-	Value EValue;
-
-	JsonElement(void)
-		: KeySet(false)
-	{ }
-};
+	return EncodeValue(value, pretty_print, 0);
+}
 
-struct JsonContext
+/**
+ * Encodes a value as JSON, writing the fields of reflected objects which
+ * match the specified attribute types. This is equivalent to
+ * JsonEncode(Serialize(value, attributeTypes)) except for the order of
+ * object keys.
+ */
+String icinga::JsonSerialize(const Value& value, int attributeTypes, bool pretty_print)
 {
-public:
-	void Push(const Value& value)
-	{
-		JsonElement element;
-		element.EValue = value;
+	ASSERT(attributeTypes != 0);
 
-		m_Stack.push(element);
-	}
+	return EncodeValue(value, pretty_print, attributeTypes);
+}
 
-	JsonElement Pop(void)
-	{
-		JsonElement value = m_Stack.top();
-		m_Stack.pop();
-		return value;
-	}
+JsonSaxHandler::~JsonSaxHandler(void)
+{ }
 
-	void AddValue(const Value& value)
-	{
-		if (m_Stack.empty()) {
-			JsonElement element;
-			element.EValue = value;
-			m_Stack.push(element);
-			return;
-		}
+void JsonSaxHandler::HandleNull(void)
+{ }
 
-		JsonElement& element = m_Stack.top();
+void JsonSaxHandler::HandleBoolean(bool)
+{ }
 
-		if (element.EValue.IsObjectType<Dictionary>()) {
-			if (!element.KeySet) {
-				element.Key = value;
-				element.KeySet = true;
-			} else {
-				Dictionary::Ptr dict = element.EValue;
-				dict->Set(element.Key, value);
-				element.KeySet = false;
-			}
-		} else if (element.EValue.IsObjectType<Array>()) {
-			Array::Ptr arr = element.EValue;
-			arr->Add(value);
-		} else {
-			BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot add value to JSON element."));
-		}
-	}
+void JsonSaxHandler::HandleNumber(double)
+{ }
 
-	Value GetValue(void) const
-	{
-		ASSERT(m_Stack.size() == 1);
-		return m_Stack.top().EValue;
-	}
+void JsonSaxHandler::HandleString(const char *, size_t)
+{ }
 
-	void SaveException(void)
-	{
-		m_Exception = boost::current_exception();
-	}
+void JsonSaxHandler::HandleKey(const char *, size_t)
+{ }
 
-	void ThrowException(void) const
-	{
-		if (m_Exception)
-			boost::rethrow_exception(m_Exception);
-	}
+void JsonSaxHandler::HandleStartMap(void)
+{ }
 
-private:
-	std::stack<JsonElement> m_Stack;
-	Value m_Key;
-	boost::exception_ptr m_Exception;
+void JsonSaxHandler::HandleEndMap(void)
+{ }
+
+void JsonSaxHandler::HandleStartArray(void)
+{ }
+
+void JsonSaxHandler::HandleEndArray(void)
+{ }
+
+struct JsonContext
+{
+	JsonSaxHandler *Handler;
+	boost::exception_ptr Exception;
 };
 
 static int DecodeNull(void *ctx)
@@ -212,9 +247,9 @@ static int DecodeNull(void *ctx)
 	JsonContext *context = static_cast<JsonContext *>(ctx);
 
 	try {
-		context->AddValue(Empty);
+		context->Handler->HandleNull();
 	} catch (...) {
-		context->SaveException();
+		context->Exception = boost::current_exception();
 		return 0;
 	}
 
@@ -226,9 +261,9 @@ static int DecodeBoolean(void *ctx, int value)
 	JsonContext *context = static_cast<JsonContext *>(ctx);
 
 	try {
-		context->AddValue(static_cast<bool>(value));
+		context->Handler->HandleBoolean(value != 0);
 	} catch (...) {
-		context->SaveException();
+		context->Exception = boost::current_exception();
 		return 0;
 	}
 
@@ -240,10 +275,20 @@ static int DecodeNumber(void *ctx, const char *str, yajl_size len)
 	JsonContext *context = static_cast<JsonContext *>(ctx);
 
 	try {
-		String jstr = String(str, str + len);
-		context->AddValue(Convert::ToDouble(jstr));
+		double value;
+		char buf[64];
+
+		/* yajl has already validated the number, avoid the String round-trip for the common case. */
+		if (len < sizeof(buf)) {
+			memcpy(buf, str, len);
+			buf[len] = '\0';
+			value = strtod(buf, NULL);
+		} else
+			value = Convert::ToDouble(String(str, str + len));
+
+		context->Handler->HandleNumber(value);
 	} catch (...) {
-		context->SaveException();
+		context->Exception = boost::current_exception();
 		return 0;
 	}
 
@@ -255,9 +300,23 @@ static int DecodeString(void *ctx, const unsigned char *str, yajl_size len)
 	JsonContext *context = static_cast<JsonContext *>(ctx);
 
 	try {
-		context->AddValue(String(str, str + len));
+		context->Handler->HandleString(reinterpret_cast<const char *>(str), len);
+	} catch (...) {
+		context->Exception = boost::current_exception();
+		return 0;
+	}
+
+	return 1;
+}
+
+static int DecodeMapKey(void *ctx, const unsigned char *str, yajl_size len)
+{
+	JsonContext *context = static_cast<JsonContext *>(ctx);
+
+	try {
+		context->Handler->HandleKey(reinterpret_cast<const char *>(str), len);
 	} catch (...) {
-		context->SaveException();
+		context->Exception = boost::current_exception();
 		return 0;
 	}
 
@@ -269,23 +328,23 @@ static int DecodeStartMap(void *ctx)
 	JsonContext *context = static_cast<JsonContext *>(ctx);
 
 	try {
-		context->Push(new Dictionary());
+		context->Handler->HandleStartMap();
 	} catch (...) {
-		context->SaveException();
+		context->Exception = boost::current_exception();
 		return 0;
 	}
 
 	return 1;
 }
 
-static int DecodeEndMapOrArray(void *ctx)
+static int DecodeEndMap(void *ctx)
 {
 	JsonContext *context = static_cast<JsonContext *>(ctx);
 
 	try {
-		context->AddValue(context->Pop().EValue);
+		context->Handler->HandleEndMap();
 	} catch (...) {
-		context->SaveException();
+		context->Exception = boost::current_exception();
 		return 0;
 	}
 
@@ -295,18 +354,36 @@ static int DecodeEndMapOrArray(void *ctx)
 static int DecodeStartArray(void *ctx)
 {
 	JsonContext *context = static_cast<JsonContext *>(ctx);
-	
+
 	try {
-		context->Push(new Array());
+		context->Handler->HandleStartArray();
 	} catch (...) {
-		context->SaveException();
+		context->Exception = boost::current_exception();
 		return 0;
 	}
 
 	return 1;
 }
 
-Value icinga::JsonDecode(const String& data)
+static int DecodeEndArray(void *ctx)
+{
+	JsonContext *context = static_cast<JsonContext *>(ctx);
+
+	try {
+		context->Handler->HandleEndArray();
+	} catch (...) {
+		context->Exception = boost::current_exception();
+		return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * Parses a JSON document and reports its contents to the specified handler
+ * without building an intermediate object tree.
+ */
+void icinga::JsonParse(const String& data, JsonSaxHandler& handler)
 {
 	static const yajl_callbacks callbacks = {
 		DecodeNull,
@@ -316,10 +393,10 @@ Value icinga::JsonDecode(const String& data)
 		DecodeNumber,
 		DecodeString,
 		DecodeStartMap,
-		DecodeString,
-		DecodeEndMapOrArray,
+		DecodeMapKey,
+		DecodeEndMap,
 		DecodeStartArray,
-		DecodeEndMapOrArray
+		DecodeEndArray
 	};
 
 	yajl_handle handle;
@@ -327,6 +404,7 @@ Value icinga::JsonDecode(const String& data)
 	yajl_parser_config cfg = { 1, 0 };
 #endif /* YAJL_MAJOR */
 	JsonContext context;
+	context.Handler = &handler;
 
 #if YAJL_MAJOR < 2
 	handle = yajl_alloc(&callbacks, &cfg, NULL, &context);
@@ -350,12 +428,113 @@ Value icinga::JsonDecode(const String& data)
 		yajl_free(handle);
 
 		/* throw saved exception (if there is one) */
-		context.ThrowException();
+		if (context.Exception)
+			boost::rethrow_exception(context.Exception);
 
 		BOOST_THROW_EXCEPTION(std::invalid_argument(msg));
 	}
 
 	yajl_free(handle);
+}
+
+struct JsonElement
+{
+	Dictionary::Ptr Dict;
+	Array::Ptr Arr;
+	String Key;
+};
+
+/**
+ * Builds the Dictionary/Array tree returned by JsonDecode(). The stack keeps
+ * typed pointers to the open containers so that values can be added without
+ * type checks or copying the elements.
+ */
+class JsonTreeBuilder : public JsonSaxHandler
+{
+public:
+	virtual void HandleNull(void)
+	{
+		AddValue(Empty);
+	}
+
+	virtual void HandleBoolean(bool value)
+	{
+		AddValue(value);
+	}
+
+	virtual void HandleNumber(double value)
+	{
+		AddValue(value);
+	}
+
+	virtual void HandleString(const char *str, size_t len)
+	{
+		AddValue(String(str, str + len));
+	}
+
+	virtual void HandleKey(const char *str, size_t len)
+	{
+		ASSERT(!m_Stack.empty());
+		m_Stack.back().Key = String(str, str + len);
+	}
+
+	virtual void HandleStartMap(void)
+	{
+		m_Stack.push_back(JsonElement());
+		m_Stack.back().Dict = new Dictionary();
+	}
+
+	virtual void HandleEndMap(void)
+	{
+		Dictionary::Ptr dict = m_Stack.back().Dict;
+		m_Stack.pop_back();
+		AddValue(dict);
+	}
+
+	virtual void HandleStartArray(void)
+	{
+		m_Stack.push_back(JsonElement());
+		m_Stack.back().Arr = new Array();
+	}
+
+	virtual void HandleEndArray(void)
+	{
+		Array::Ptr arr = m_Stack.back().Arr;
+		m_Stack.pop_back();
+		AddValue(arr);
+	}
+
+	Value GetValue(void) const
+	{
+		ASSERT(m_Stack.empty());
+		return m_Result;
+	}
+
+private:
+	std::vector<JsonElement> m_Stack;
+	Value m_Result;
+
+	void AddValue(const Value& value)
+	{
+		if (m_Stack.empty()) {
+			m_Result = value;
+			return;
+		}
+
+		JsonElement& element = m_Stack.back();
+
+		if (element.Dict)
+			element.Dict->Set(element.Key, value);
+		else
+			element.Arr->Add(value);
+	}
+};
+
+Value icinga::JsonDecode(const String& data)
+{
+	JsonTreeBuilder builder;
+
+	JsonParse(data, builder);
 
-	return context.GetValue();
+	return builder.GetValue();
 }
@@ -28,8 +28,34 @@ namespace icinga
 class String;
 class Value;
 
+/**
+ * Receives the events generated by JsonParse(). The default implementation
+ * ignores all events so that handlers only need to override the callbacks
+ * they are interested in. Exceptions thrown by a callback abort the parser
+ * and are re-thrown by JsonParse().
+ *
+ * @ingroup base
+ */
+class I2_BASE_API JsonSaxHandler
+{
+public:
+	virtual ~JsonSaxHandler(void);
+
+	virtual void HandleNull(void);
+	virtual void HandleBoolean(bool value);
+	virtual void HandleNumber(double value);
+	virtual void HandleString(const char *str, size_t len);
+	virtual void HandleKey(const char *str, size_t len);
+	virtual void HandleStartMap(void);
+	virtual void HandleEndMap(void);
+	virtual void HandleStartArray(void);
+	virtual void HandleEndArray(void);
+};
+
 I2_BASE_API String JsonEncode(const Value& value, bool pretty_print = false);
+I2_BASE_API String JsonSerialize(const Value& value, int attributeTypes, bool pretty_print = false);
 I2_BASE_API Value JsonDecode(const String& data);
+I2_BASE_API void JsonParse(const String& data, JsonSaxHandler& handler);
 
 }
 
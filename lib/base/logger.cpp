@@ -26,7 +26,11 @@
 #include "base/objectlock.hpp"
 #include "base/context.hpp"
 #include "base/scriptglobal.hpp"
+#include "base/convert.hpp"
+#include "base/statsfunction.hpp"
 #include <boost/foreach.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <iostream>
 
 using namespace icinga;
@@ -40,6 +44,46 @@ bool Logger::m_ConsoleLogEnabled = true;
 bool Logger::m_TimestampEnabled = true;
 LogSeverity Logger::m_ConsoleLogSeverity = LogInformation;
 
+/**
+ * A log entry which is waiting in the asynchronous log queue. The
+ * context trace is captured by the thread which created the entry
+ * and formatted by the log thread.
+ */
+struct AsyncLogEntry
+{
+	LogEntry Entry;
+	ContextTrace Context;
+};
+
+static boost::mutex l_AsyncLogMutex;
+static boost::condition_variable l_AsyncLogCV;
+static boost::condition_variable l_AsyncLogSpaceCV;
+static boost::condition_variable l_AsyncLogWrittenCV;
+static std::vector<AsyncLogEntry> l_AsyncLogRing;
+static size_t l_AsyncLogHead = 0;
+static size_t l_AsyncLogCount = 0;
+static unsigned long long l_AsyncLogQueued = 0;
+static unsigned long long l_AsyncLogWritten = 0;
+static bool l_AsyncLogEnabled = false;
+/* Set while the log thread is running, i.e. until all queued entries have been
+ * written after async logging was disabled. Read without holding the lock. */
+static volatile bool l_AsyncLogActive = false;
+static bool l_AsyncLogStop = false;
+static LogOverflowPolicy l_AsyncLogPolicy = LogOverflowBlock;
+static unsigned long l_AsyncLogDropped = 0;
+static unsigned long l_AsyncLogBlocked = 0;
+static boost::thread l_AsyncLogThread;
+static boost::thread::id l_AsyncLogThreadID;
+
+static void AsyncLogStatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
+{
+	Dictionary::Ptr stats = new Dictionary();
+	Logger::GetAsyncLogStats(stats, perfdata);
+	status->Set("logger", stats);
+}
+
+REGISTER_STATSFUNCTION(Logger, &AsyncLogStatsFunc);
+
 void Logger::StaticInitialize(void)
 {
 	ScriptGlobal::Set("LogDebug", LogDebug);
@@ -76,6 +120,181 @@ std::set<Logger::Ptr> Logger::GetLoggers(void)
 	return m_Loggers;
 }
 
+/**
+ * Passes log entries to all active loggers and the console. Each logger is
+ * locked once for the whole batch.
+ *
+ * @param entries The log entries.
+ * @param count The number of log entries.
+ */
+static void DispatchLogEntries(const LogEntry *entries, size_t count)
+{
+	BOOST_FOREACH(const Logger::Ptr& logger, Logger::GetLoggers()) {
+		ObjectLock llock(logger);
+
+		if (!logger->IsActive())
+			continue;
+
+		LogSeverity minSeverity = logger->GetMinSeverity();
+
+		for (size_t i = 0; i < count; i++) {
+			if (entries[i].Severity >= minSeverity)
+				logger->ProcessLogEntry(entries[i]);
+		}
+	}
+
+	if (!Logger::IsConsoleLogEnabled())
+		return;
+
+	for (size_t i = 0; i < count; i++) {
+		if (entries[i].Severity >= Logger::GetConsoleLogSeverity())
+			StreamLogger::ProcessLogEntry(std::cout, entries[i]);
+	}
+}
+
+static void AppendContextTrace(LogEntry& entry, const ContextTrace& context)
+{
+	if (context.GetLength() > 0) {
+		std::ostringstream trace;
+		trace << context;
+		entry.Message += "\nContext:" + trace.str();
+	}
+}
+
+/**
+ * Waits until the log thread has written all queued log entries.
+ *
+ * @param lock The lock for l_AsyncLogMutex.
+ */
+static void WaitForAsyncLog(boost::mutex::scoped_lock& lock)
+{
+	unsigned long long queued = l_AsyncLogQueued;
+
+	while (l_AsyncLogWritten < queued)
+		l_AsyncLogWrittenCV.wait(lock);
+}
+
+/**
+ * Adds a log entry to the asynchronous log queue.
+ *
+ * @returns false if the entry has to be logged synchronously. All entries
+ * which were queued earlier have been written at this point.
+ */
+static bool QueueLogEntry(const LogEntry& entry)
+{
+	/* async logging is disabled by default, don't serialize all log calls on the mutex */
+	if (!l_AsyncLogActive)
+		return false;
+
+	boost::mutex::scoped_lock lock(l_AsyncLogMutex);
+
+	if (boost::this_thread::get_id() == l_AsyncLogThreadID)
+		return false;
+
+	/* critical messages often precede a crash and are never queued */
+	if (!l_AsyncLogEnabled || entry.Severity >= LogCritical) {
+		WaitForAsyncLog(lock);
+		return false;
+	}
+
+	if (l_AsyncLogCount == l_AsyncLogRing.size()) {
+		if (l_AsyncLogPolicy == LogOverflowDrop) {
+			l_AsyncLogDropped++;
+			return true;
+		}
+
+		l_AsyncLogBlocked++;
+
+		while (l_AsyncLogEnabled && l_AsyncLogCount == l_AsyncLogRing.size())
+			l_AsyncLogSpaceCV.wait(lock);
+
+		if (!l_AsyncLogEnabled) {
+			WaitForAsyncLog(lock);
+			return false;
+		}
+	}
+
+	AsyncLogEntry& slot = l_AsyncLogRing[(l_AsyncLogHead + l_AsyncLogCount) % l_AsyncLogRing.size()];
+	slot.Entry = entry;
+
+	if (entry.Severity >= LogWarning)
+		slot.Context = ContextTrace();
+
+	l_AsyncLogCount++;
+	l_AsyncLogQueued++;
+
+	if (l_AsyncLogCount == 1)
+		l_AsyncLogCV.notify_one();
+
+	return true;
+}
+
+static void AsyncLogThreadProc(unsigned long reportedDropped)
+{
+	Utility::SetThreadName("Logger");
+
+	std::vector<LogEntry> batch;
+
+	for (;;) {
+		unsigned long dropped;
+		size_t queued;
+		bool stop;
+
+		{
+			boost::mutex::scoped_lock lock(l_AsyncLogMutex);
+
+			while (l_AsyncLogCount == 0 && !l_AsyncLogStop)
+				l_AsyncLogCV.wait(lock);
+
+			queued = l_AsyncLogCount;
+			batch.resize(queued);
+
+			for (size_t i = 0; i < l_AsyncLogCount; i++) {
+				AsyncLogEntry& slot = l_AsyncLogRing[(l_AsyncLogHead + i) % l_AsyncLogRing.size()];
+
+				std::swap(batch[i], slot.Entry);
+
+				if (batch[i].Severity >= LogWarning) {
+					AppendContextTrace(batch[i], slot.Context);
+					slot.Context = ContextTrace();
+				}
+			}
+
+			l_AsyncLogHead = (l_AsyncLogHead + l_AsyncLogCount) % l_AsyncLogRing.size();
+			l_AsyncLogCount = 0;
+
+			dropped = l_AsyncLogDropped;
+			stop = l_AsyncLogStop;
+
+			l_AsyncLogSpaceCV.notify_all();
+		}
+
+		if (dropped != reportedDropped) {
+			LogEntry entry;
+			entry.Timestamp = Utility::GetTime();
+			entry.Severity = LogWarning;
+			entry.Facility = "Logger";
+			entry.Message = "Log queue is full: Dropped " + Convert::ToString(dropped - reportedDropped) + " log messages.";
+			batch.push_back(entry);
+
+			reportedDropped = dropped;
+		}
+
+		if (!batch.empty())
+			DispatchLogEntries(&batch[0], batch.size());
+
+		{
+			boost::mutex::scoped_lock lock(l_AsyncLogMutex);
+			l_AsyncLogWritten += queued;
+			l_AsyncLogWrittenCV.notify_all();
+		}
+
+		/* no new entries are queued once the log thread was told to stop */
+		if (stop)
+			break;
+	}
+}
+
 /**
  * Writes a message to the application's log.
  *
@@ -92,28 +311,13 @@ void icinga::IcingaLog(LogSeverity severity, const String& facility,
 	entry.Facility = facility;
 	entry.Message = message;
 
-	if (severity >= LogWarning) {
-		ContextTrace context;
+	if (QueueLogEntry(entry))
+		return;
 
-		if (context.GetLength() > 0) {
-			std::ostringstream trace;
-			trace << context;
-			entry.Message += "\nContext:" + trace.str();
-		}
-	}
-
-	BOOST_FOREACH(const Logger::Ptr& logger, Logger::GetLoggers()) {
-		ObjectLock llock(logger);
-
-		if (!logger->IsActive())
-			continue;
+	if (severity >= LogWarning)
+		AppendContextTrace(entry, ContextTrace());
 
-		if (entry.Severity >= logger->GetMinSeverity())
-			logger->ProcessLogEntry(entry);
-	}
-
-	if (Logger::IsConsoleLogEnabled() && entry.Severity >= Logger::GetConsoleLogSeverity())
-		StreamLogger::ProcessLogEntry(std::cout, entry);
+	DispatchLogEntries(&entry, 1);
 }
 
 /**
@@ -219,3 +423,99 @@ bool Logger::IsTimestampEnabled(void)
 {
 	return m_TimestampEnabled;
 }
+
+/**
+ * Starts a thread which writes log entries in batches. Other threads
+ * only add their log entries to a bounded queue.
+ *
+ * @param queueSize The maximum number of queued log entries.
+ * @param policy What to do when the queue is full.
+ */
+void Logger::EnableAsyncLog(size_t queueSize, LogOverflowPolicy policy)
+{
+	DisableAsyncLog();
+
+	boost::mutex::scoped_lock lock(l_AsyncLogMutex);
+
+	l_AsyncLogRing.resize(std::max(queueSize, static_cast<size_t>(1)));
+	l_AsyncLogHead = 0;
+	l_AsyncLogCount = 0;
+	l_AsyncLogPolicy = policy;
+	l_AsyncLogStop = false;
+	l_AsyncLogThread = boost::thread(&AsyncLogThreadProc, l_AsyncLogDropped);
+	l_AsyncLogThreadID = l_AsyncLogThread.get_id();
+	l_AsyncLogEnabled = true;
+	l_AsyncLogActive = true;
+}
+
+/**
+ * Writes all queued log entries and stops the log thread.
+ */
+void Logger::DisableAsyncLog(void)
+{
+	{
+		boost::mutex::scoped_lock lock(l_AsyncLogMutex);
+
+		if (!l_AsyncLogEnabled)
+			return;
+
+		l_AsyncLogEnabled = false;
+		l_AsyncLogStop = true;
+		l_AsyncLogCV.notify_all();
+		l_AsyncLogSpaceCV.notify_all();
+	}
+
+	l_AsyncLogThread.join();
+
+	boost::mutex::scoped_lock lock(l_AsyncLogMutex);
+	l_AsyncLogThreadID = boost::thread::id();
+	std::vector<AsyncLogEntry>().swap(l_AsyncLogRing);
+
+	/* the log thread has written all queued entries before it terminated */
+	l_AsyncLogActive = false;
+}
+
+bool Logger::IsAsyncLogEnabled(void)
+{
+	boost::mutex::scoped_lock lock(l_AsyncLogMutex);
+	return l_AsyncLogEnabled;
+}
+
+/**
+ * Applies the LogAsync, LogQueueSize and LogOverflowPolicy constants.
+ */
+void Logger::UpdateAsyncLog(void)
+{
+	Value defaultQueueSize = 10000;
+	Value defaultPolicy = "block";
+
+	if (!ScriptGlobal::Get("LogAsync", &Empty).ToBool()) {
+		DisableAsyncLog();
+		return;
+	}
+
+	int queueSize = ScriptGlobal::Get("LogQueueSize", &defaultQueueSize);
+	String policy = ScriptGlobal::Get("LogOverflowPolicy", &defaultPolicy);
+
+	if (policy != "block" && policy != "drop") {
+		Log(LogWarning, "Logger")
+		    << "Invalid value for LogOverflowPolicy: '" << policy << "'. Using 'block'.";
+		policy = "block";
+	}
+
+	EnableAsyncLog(std::max(queueSize, 1), policy == "drop" ? LogOverflowDrop : LogOverflowBlock);
+}
+
+void Logger::GetAsyncLogStats(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
+{
+	boost::mutex::scoped_lock lock(l_AsyncLogMutex);
+
+	status->Set("async", l_AsyncLogEnabled);
+	status->Set("queue_size", l_AsyncLogRing.size());
+	status->Set("pending", l_AsyncLogCount);
+	status->Set("dropped", l_AsyncLogDropped);
+	status->Set("blocked", l_AsyncLogBlocked);
+
+	perfdata->Add("'log_pending'=" + Convert::ToString(l_AsyncLogCount));
+	perfdata->Add("'log_dropped'=" + Convert::ToString(l_AsyncLogDropped) + "c");
+}
@@ -42,6 +42,17 @@ enum LogSeverity
 	LogCritical
 };
 
+/**
+ * What to do when the asynchronous log queue is full.
+ *
+ * @ingroup base
+ */
+enum LogOverflowPolicy
+{
+	LogOverflowBlock, /**< Wait until the log thread has caught up. */
+	LogOverflowDrop /**< Discard the new log entry. */
+};
+
 /**
  * A log entry.
  *
@@ -90,6 +101,12 @@ public:
 	static void SetConsoleLogSeverity(LogSeverity logSeverity);
 	static LogSeverity GetConsoleLogSeverity(void);
 
+	static void EnableAsyncLog(size_t queueSize, LogOverflowPolicy policy);
+	static void DisableAsyncLog(void);
+	static bool IsAsyncLogEnabled(void);
+	static void UpdateAsyncLog(void);
+	static void GetAsyncLogStats(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
+
 	static void StaticInitialize(void);
 
 protected:
@@ -108,10 +108,21 @@ StreamReadStatus NetString::ReadStringFromStream(const Stream::Ptr& stream, Stri
  * @param str The String that is to be written.
  */
 void NetString::WriteStringToStream(const Stream::Ptr& stream, const String& str)
+{
+	String msg = Encode(str);
+	stream->Write(msg.CStr(), msg.GetLength());
+}
+
+/**
+ * Encodes a String in the netstring format.
+ *
+ * @param str The String that is to be encoded.
+ * @returns The encoded String.
+ */
+String NetString::Encode(const String& str)
 {
 	std::ostringstream msgbuf;
 	msgbuf << str.GetLength() << ":" << str << ",";
 
-	String msg = msgbuf.str();
-	stream->Write(msg.CStr(), msg.GetLength());
+	return msgbuf.str();
 }
@@ -27,13 +27,18 @@
 #include "base/logger.hpp"
 #include "base/utility.hpp"
 #include "base/scriptglobal.hpp"
+#include "base/application.hpp"
+#include "base/json.hpp"
 #include <boost/foreach.hpp>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/thread/once.hpp>
+#include <set>
 
 #ifndef _WIN32
 #	include <execvpe.h>
 #	include <poll.h>
+#	include <spawn.h>
+#	include <sys/socket.h>
 
 #	ifndef __APPLE__
 extern char **environ;
@@ -45,24 +50,49 @@ extern char **environ;
 
 using namespace icinga;
 
-#define IOTHREADS 2
+#define MAXIOTHREADS 32
 
-static boost::mutex l_ProcessMutex[IOTHREADS];
-static std::map<Process::ProcessHandle, Process::Ptr> l_Processes[IOTHREADS];
+static int l_IOThreadCount = 2;
+static boost::mutex l_ProcessMutex[MAXIOTHREADS];
+static std::map<Process::ProcessHandle, Process::Ptr> l_Processes[MAXIOTHREADS];
 #ifdef _WIN32
-static HANDLE l_Events[IOTHREADS];
+static HANDLE l_Events[MAXIOTHREADS];
 #else /* _WIN32 */
-static int l_EventFDs[IOTHREADS][2];
-static std::map<Process::ConsoleHandle, Process::ProcessHandle> l_FDs[IOTHREADS];
+static int l_EventFDs[MAXIOTHREADS][2];
+static std::map<Process::ConsoleHandle, Process::ProcessHandle> l_FDs[MAXIOTHREADS];
+
+/* Spawn requests are small unless the environment is huge; larger requests fall back to fork(). */
+#define SPAWNHELPER_MAXMESSAGE (1024 * 1024)
+/* minimum number of seconds between attempts to start the spawn helper */
+#define SPAWNHELPER_RESTARTINTERVAL 5
+/* number of seconds to wait for the spawn helper to report the PID of a new process */
+#define SPAWNHELPER_REPLYTIMEOUT 5
+/* number of seconds to wait for the spawn helper to report the exit status of a killed process */
+#define SPAWNHELPER_EXITTIMEOUT 5
+/* the spawn helper moves its socket to a file descriptor above this one */
+#define SPAWNHELPER_MINFD 64
+
+static boost::mutex l_SpawnHelperMutex;
+static boost::condition_variable l_SpawnHelperCV;
+static int l_SpawnHelperFD = -1;
+static pid_t l_SpawnHelperPID = -1;
+static unsigned long l_SpawnHelperGeneration = 0;
+static double l_SpawnHelperLastStart = 0;
+static unsigned long l_SpawnHelperNextID = 1;
+static std::map<unsigned long, pid_t> l_SpawnHelperPIDs;
+static std::map<pid_t, int> l_SpawnHelperExitStatus;
+static std::set<pid_t> l_SpawnHelperAbandonedPIDs;
+static int l_SpawnHelperSignalFDs[2];
+static std::set<pid_t> l_SpawnHelperChildren;
 #endif /* _WIN32 */
 static boost::once_flag l_OnceFlag = BOOST_ONCE_INIT;
 
-INITIALIZE_ONCE(&Process::StaticInitialize);
-
 Process::Process(const Process::Arguments& arguments, const Dictionary::Ptr& extraEnvironment)
 	: m_Arguments(arguments), m_ExtraEnvironment(extraEnvironment), m_Timeout(600)
 #ifdef _WIN32
 	, m_ReadPending(false), m_ReadFailed(false), m_Overlapped()
+#else /* _WIN32 */
+	, m_SpawnHelper(false), m_SpawnHelperGeneration(0)
 #endif /* _WIN32 */
 {
 #ifdef _WIN32
@@ -77,9 +107,24 @@ Process::~Process(void)
 #endif /* _WIN32 */
 }
 
-void Process::StaticInitialize(void)
+/**
+ * Starts the I/O threads. The number of I/O threads can be set with the
+ * ProcessIOThreads constant.
+ */
+void Process::ThreadInitialize(void)
 {
-	for (int tid = 0; tid < IOTHREADS; tid++) {
+	/* Note to self: Make sure this runs _after_ we've daemonized. */
+	Value defaultThreads = 2;
+	int count = ScriptGlobal::Get("ProcessIOThreads", &defaultThreads);
+
+	if (count < 1)
+		count = 1;
+	else if (count > MAXIOTHREADS)
+		count = MAXIOTHREADS;
+
+	l_IOThreadCount = count;
+
+	for (int tid = 0; tid < l_IOThreadCount; tid++) {
 #ifdef _WIN32
 		l_Events[tid] = CreateEvent(NULL, TRUE, FALSE, NULL);
 #else /* _WIN32 */
@@ -104,13 +149,7 @@ void Process::StaticInitialize(void)
 		}
 #	endif /* HAVE_PIPE2 */
 #endif /* _WIN32 */
-	}
-}
 
-void Process::ThreadInitialize(void)
-{
-	/* Note to self: Make sure this runs _after_ we've daemonized. */
-	for (int tid = 0; tid < IOTHREADS; tid++) {
 		boost::thread t(boost::bind(&Process::IOThreadProc, tid));
 		t.detach();
 	}
@@ -536,111 +575,118 @@ void Process::Run(const boost::function<void(const ProcessResult&)>& callback)
 	}
 #endif /* HAVE_PIPE2 */
 
-	// build argv
-	char **argv = new char *[m_Arguments.size() + 1];
+	m_SpawnHelper = SpawnViaHelper(fds[1]);
 
-	for (unsigned int i = 0; i < m_Arguments.size(); i++)
-		argv[i] = strdup(m_Arguments[i].CStr());
+	if (!m_SpawnHelper) {
+		/* the timeout starts once the process has actually been started */
+		m_Result.ExecutionStart = Utility::GetTime();
 
-	argv[m_Arguments.size()] = NULL;
+		// build argv
+		char **argv = new char *[m_Arguments.size() + 1];
 
-	// build envp
-	int envc = 0;
+		for (unsigned int i = 0; i < m_Arguments.size(); i++)
+			argv[i] = strdup(m_Arguments[i].CStr());
 
-	/* count existing environment variables */
-	while (environ[envc] != NULL)
-		envc++;
+		argv[m_Arguments.size()] = NULL;
 
-	char **envp = new char *[envc + (m_ExtraEnvironment ? m_ExtraEnvironment->GetLength() : 0) + 2];
+		// build envp
+		int envc = 0;
 
-	for (int i = 0; i < envc; i++)
-		envp[i] = strdup(environ[i]);
+		/* count existing environment variables */
+		while (environ[envc] != NULL)
+			envc++;
 
-	if (m_ExtraEnvironment) {
-		ObjectLock olock(m_ExtraEnvironment);
+		char **envp = new char *[envc + (m_ExtraEnvironment ? m_ExtraEnvironment->GetLength() : 0) + 2];
 
-		int index = envc;
-		BOOST_FOREACH(const Dictionary::Pair& kv, m_ExtraEnvironment) {
-			String skv = kv.first + "=" + Convert::ToString(kv.second);
-			envp[index] = strdup(skv.CStr());
-			index++;
+		for (int i = 0; i < envc; i++)
+			envp[i] = strdup(environ[i]);
+
+		if (m_ExtraEnvironment) {
+			ObjectLock olock(m_ExtraEnvironment);
+
+			int index = envc;
+			BOOST_FOREACH(const Dictionary::Pair& kv, m_ExtraEnvironment) {
+				String skv = kv.first + "=" + Convert::ToString(kv.second);
+				envp[index] = strdup(skv.CStr());
+				index++;
+			}
 		}
-	}
 
-	envp[envc + (m_ExtraEnvironment ? m_ExtraEnvironment->GetLength() : 0)] = strdup("LC_NUMERIC=C");
-	envp[envc + (m_ExtraEnvironment ? m_ExtraEnvironment->GetLength() : 0) + 1] = NULL;
+		envp[envc + (m_ExtraEnvironment ? m_ExtraEnvironment->GetLength() : 0)] = strdup("LC_NUMERIC=C");
+		envp[envc + (m_ExtraEnvironment ? m_ExtraEnvironment->GetLength() : 0) + 1] = NULL;
 
-	m_ExtraEnvironment.reset();
+		m_ExtraEnvironment.reset();
 
 #ifdef HAVE_VFORK
-	Value use_vfork = ScriptGlobal::Get("UseVfork");
+		Value use_vfork = ScriptGlobal::Get("UseVfork");
 
-	if (use_vfork.IsEmpty() || static_cast<bool>(use_vfork))
-		m_Process = vfork();
-	else
-		m_Process = fork();
+		if (use_vfork.IsEmpty() || static_cast<bool>(use_vfork))
+			m_Process = vfork();
+		else
+			m_Process = fork();
 #else /* HAVE_VFORK */
-	m_Process = fork();
+		m_Process = fork();
 #endif /* HAVE_VFORK */
 
-	if (m_Process < 0) {
-		BOOST_THROW_EXCEPTION(posix_error()
-			<< boost::errinfo_api_function("fork")
-			<< boost::errinfo_errno(errno));
-	}
+		if (m_Process < 0) {
+			BOOST_THROW_EXCEPTION(posix_error()
+				<< boost::errinfo_api_function("fork")
+				<< boost::errinfo_errno(errno));
+		}
 
-	if (m_Process == 0) {
-		// child process
+		if (m_Process == 0) {
+			// child process
 
-		if (setsid() < 0) {
-			perror("setsid() failed");
-			_exit(128);
-		}
+			if (setsid() < 0) {
+				perror("setsid() failed");
+				_exit(128);
+			}
 
-		if (dup2(fds[1], STDOUT_FILENO) < 0 || dup2(fds[1], STDERR_FILENO) < 0) {
-			perror("dup2() failed");
-			_exit(128);
-		}
+			if (dup2(fds[1], STDOUT_FILENO) < 0 || dup2(fds[1], STDERR_FILENO) < 0) {
+				perror("dup2() failed");
+				_exit(128);
+			}
 
-		(void)close(fds[0]);
-		(void)close(fds[1]);
+			(void)close(fds[0]);
+			(void)close(fds[1]);
 
 #ifdef HAVE_NICE
-		if (nice(5) < 0)
-			Log(LogWarning, "base", "Failed to renice child process.");
+			if (nice(5) < 0)
+				Log(LogWarning, "base", "Failed to renice child process.");
 #endif /* HAVE_NICE */
 
-		if (icinga2_execvpe(argv[0], argv, envp) < 0) {
-			char errmsg[512];
-			strcpy(errmsg, "execvpe(");
-			strncat(errmsg, argv[0], sizeof(errmsg) - strlen(errmsg) - 1);
-			strncat(errmsg, ") failed", sizeof(errmsg) - strlen(errmsg) - 1);
-			errmsg[sizeof(errmsg) - 1] = '\0';
-			perror(errmsg);
+			if (icinga2_execvpe(argv[0], argv, envp) < 0) {
+				char errmsg[512];
+				strcpy(errmsg, "execvpe(");
+				strncat(errmsg, argv[0], sizeof(errmsg) - strlen(errmsg) - 1);
+				strncat(errmsg, ") failed", sizeof(errmsg) - strlen(errmsg) - 1);
+				errmsg[sizeof(errmsg) - 1] = '\0';
+				perror(errmsg);
+				_exit(128);
+			}
+
 			_exit(128);
 		}
 
-		_exit(128);
-	}
+		// parent process
 
-	// parent process
+		// free arguments
+		for (int i = 0; argv[i] != NULL; i++)
+			free(argv[i]);
 
-	m_PID = m_Process;
+		delete[] argv;
 
-	Log(LogNotice, "Process")
-	    << "Running command " << PrettyPrintArguments(m_Arguments) <<": PID " << m_PID;
-
-	// free arguments
-	for (int i = 0; argv[i] != NULL; i++)
-		free(argv[i]);
+		// free environment
+		for (int i = 0; envp[i] != NULL; i++)
+			free(envp[i]);
 
-	delete[] argv;
+		delete[] envp;
+	}
 
-	// free environment
-	for (int i = 0; envp[i] != NULL; i++)
-		free(envp[i]);
+	m_PID = m_Process;
 
-	delete[] envp;
+	Log(LogNotice, "Process")
+	    << "Running command " << PrettyPrintArguments(m_Arguments) <<": PID " << m_PID;
 
 	(void)close(fds[1]);
 
@@ -685,7 +731,10 @@ bool Process::DoEvents(void)
 #ifdef _WIN32
 			TerminateProcess(m_Process, 1);
 #else /* _WIN32 */
-			kill(-m_Process, SIGKILL);
+			if (m_SpawnHelper)
+				KillViaHelper();
+			else
+				kill(-m_Process, SIGKILL);
 #endif /* _WIN32 */
 
 			is_timeout = true;
@@ -731,13 +780,22 @@ bool Process::DoEvents(void)
 	    << "PID " << m_PID << " (" << PrettyPrintArguments(m_Arguments) << ") terminated with exit code " << exitcode;
 #else /* _WIN32 */
 	int status, exitcode;
-	if (waitpid(m_Process, &status, 0) != m_Process) {
+
+	if (m_SpawnHelper)
+		status = WaitForSpawnHelperExit(m_Process, m_SpawnHelperGeneration, is_timeout ? SPAWNHELPER_EXITTIMEOUT : m_Timeout);
+	else if (waitpid(m_Process, &status, 0) != m_Process) {
 		BOOST_THROW_EXCEPTION(posix_error()
 			<< boost::errinfo_api_function("waitpid")
 			<< boost::errinfo_errno(errno));
 	}
 
-	if (WIFEXITED(status)) {
+	if (m_SpawnHelper && status == -1) {
+		Log(LogWarning, "Process")
+		    << "Exit status for PID " << m_PID << " is unknown because the spawn helper did not report it";
+
+		output = output + "<Exit status unknown.>";
+		exitcode = 128;
+	} else if (WIFEXITED(status)) {
 		exitcode = WEXITSTATUS(status);
 
 		Log(LogNotice, "Process")
@@ -785,6 +843,699 @@ pid_t Process::GetPID(void) const
 
 int Process::GetTID(void) const
 {
-	return (reinterpret_cast<uintptr_t>(this) / sizeof(void *)) % IOTHREADS;
+	return (reinterpret_cast<uintptr_t>(this) / sizeof(void *)) % l_IOThreadCount;
+}
+
+
+#ifndef _WIN32
+/**
+ * Sends a message over a SOCK_SEQPACKET socket, optionally passing a file descriptor.
+ */
+static bool SendSpawnHelperMessage(int sock, const String& message, int fd = -1, int flags = 0)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	char control[CMSG_SPACE(sizeof(int))];
+
+	memset(&msg, 0, sizeof(msg));
+
+	iov.iov_base = const_cast<char *>(message.CStr());
+	iov.iov_len = message.GetLength();
+
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	if (fd != -1) {
+		memset(control, 0, sizeof(control));
+
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+	}
+
+	for (;;) {
+		if (sendmsg(sock, &msg, flags) >= 0)
+			return true;
+
+		if (errno != EINTR)
+			return false;
+	}
+}
+
+/**
+ * Receives a message and the file descriptor which was passed along with it (if any).
+ */
+static ssize_t ReceiveSpawnHelperMessage(int sock, char *buffer, size_t size, int *fd)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	char control[CMSG_SPACE(sizeof(int))];
+
+	memset(&msg, 0, sizeof(msg));
+
+	iov.iov_base = buffer;
+	iov.iov_len = size;
+
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	*fd = -1;
+
+	ssize_t rc = recvmsg(sock, &msg, 0);
+
+	if (rc < 0)
+		return rc;
+
+	for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+			memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+	}
+
+	return rc;
+}
+
+/**
+ * Starts the spawn helper: a small process which starts plugins on behalf of
+ * the daemon so that we don't have to fork() a process with a large address
+ * space for every check. The caller must hold l_SpawnHelperMutex.
+ */
+void Process::StartSpawnHelper(void)
+{
+	char **uargv = Application::GetArgV();
+
+	if (!uargv || !uargv[0])
+		return;
+
+	int fds[2];
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) < 0) {
+		Log(LogCritical, "Process")
+		    << "socketpair() failed with error code " << errno << ", \"" << Utility::FormatErrorNumber(errno) << "\"";
+		return;
+	}
+
+	Utility::SetCloExec(fds[0]);
+	Utility::SetCloExec(fds[1]);
+
+	int bufsize = SPAWNHELPER_MAXMESSAGE;
+	(void) setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
+
+	String exe = Application::GetExePath(uargv[0]);
+
+	char *argv[] = {
+		strdup(exe.CStr()),
+		strdup("internal"),
+		strdup("spawn-helper"),
+		NULL
+	};
+
+#ifdef HAVE_VFORK
+	pid_t pid = vfork();
+#else /* HAVE_VFORK */
+	pid_t pid = fork();
+#endif /* HAVE_VFORK */
+
+	if (pid == 0) {
+		// child process
+
+		if (dup2(fds[1], STDIN_FILENO) < 0)
+			_exit(128);
+
+		(void) execv(argv[0], argv);
+		_exit(128);
+	}
+
+	int error = errno;
+
+	for (int i = 0; argv[i] != NULL; i++)
+		free(argv[i]);
+
+	(void) close(fds[1]);
+
+	if (pid < 0) {
+		Log(LogCritical, "Process")
+		    << "fork() failed with error code " << error << ", \"" << Utility::FormatErrorNumber(error) << "\"";
+		(void) close(fds[0]);
+		return;
+	}
+
+	Log(LogInformation, "Process")
+	    << "Started spawn helper (PID " << pid << ")";
+
+	l_SpawnHelperFD = fds[0];
+	l_SpawnHelperPID = pid;
+
+	boost::thread t(boost::bind(&Process::SpawnHelperThreadProc, fds[0], pid));
+	t.detach();
+}
+
+/**
+ * Receives spawn replies and exit notifications from the spawn helper.
+ */
+void Process::SpawnHelperThreadProc(int fd, pid_t pid)
+{
+	Utility::SetThreadName("SpawnHelper");
+
+	char buffer[4096];
+
+	for (;;) {
+		int rfd;
+		ssize_t rc = ReceiveSpawnHelperMessage(fd, buffer, sizeof(buffer), &rfd);
+
+		if (rc < 0 && errno == EINTR)
+			continue;
+
+		if (rc <= 0)
+			break;
+
+		if (rfd != -1)
+			(void) close(rfd);
+
+		Dictionary::Ptr message;
+
+		try {
+			message = JsonDecode(String(buffer, buffer + rc));
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "Process")
+			    << "Invalid message from spawn helper: " << DiagnosticInformation(ex);
+			continue;
+		}
+
+		{
+			boost::mutex::scoped_lock lock(l_SpawnHelperMutex);
+
+			/* the spawn helper was given up on, see SpawnViaHelper() */
+			if (l_SpawnHelperFD != fd)
+				continue;
+
+			if (message->Get("type") == "spawn") {
+				unsigned long id = static_cast<long>(message->Get("id"));
+				l_SpawnHelperPIDs[id] = static_cast<long>(message->Get("pid"));
+			} else if (message->Get("type") == "exit") {
+				pid_t cpid = static_cast<long>(message->Get("pid"));
+
+				if (l_SpawnHelperAbandonedPIDs.erase(cpid) == 0)
+					l_SpawnHelperExitStatus[cpid] = static_cast<long>(message->Get("status"));
+			}
+
+			l_SpawnHelperCV.notify_all();
+		}
+	}
+
+	{
+		boost::mutex::scoped_lock lock(l_SpawnHelperMutex);
+
+		if (l_SpawnHelperFD == fd) {
+			Log(LogCritical, "Process", "Spawn helper terminated. It is restarted when the next process is started.");
+
+			l_SpawnHelperFD = -1;
+			l_SpawnHelperGeneration++;
+			l_SpawnHelperAbandonedPIDs.clear();
+			l_SpawnHelperCV.notify_all();
+		}
+
+		/* requests are sent while holding l_SpawnHelperMutex, closing the
+		 * socket here makes sure its descriptor isn't reused by a sender */
+		(void) close(fd);
+	}
+
+	(void) waitpid(pid, NULL, 0);
+}
+
+/**
+ * Waits for a message from the spawn helper. The caller must hold
+ * l_SpawnHelperMutex.
+ *
+ * @param deadline The time until which to wait, or 0 to wait indefinitely.
+ * @returns false if the deadline has passed, true otherwise.
+ */
+static bool WaitForSpawnHelper(boost::mutex::scoped_lock& lock, double deadline)
+{
+	if (deadline == 0) {
+		l_SpawnHelperCV.wait(lock);
+		return true;
+	}
+
+	double timeout = deadline - Utility::GetTime();
+
+	if (timeout <= 0)
+		return false;
+
+	l_SpawnHelperCV.timed_wait(lock, boost::posix_time::milliseconds(static_cast<long>(timeout * 1000) + 1));
+
+	return true;
 }
 
+/**
+ * Asks the spawn helper to start the process. The spawn helper is started
+ * if it is enabled (UseSpawnHelper) and not running yet, e.g. because it
+ * has crashed. If the spawn helper doesn't report the new process within
+ * SPAWNHELPER_REPLYTIMEOUT seconds it is killed and processes are started
+ * with fork() until it has been restarted.
+ *
+ * @param fd The file descriptor the process should use for stdout and stderr.
+ * @returns true if the spawn helper started the process, false if the caller
+ *          should fork() itself.
+ */
+bool Process::SpawnViaHelper(int fd)
+{
+	Array::Ptr arguments = new Array();
+
+	BOOST_FOREACH(const String& argument, m_Arguments) {
+		arguments->Add(argument);
+	}
+
+	Array::Ptr environment = new Array();
+
+	if (m_ExtraEnvironment) {
+		ObjectLock olock(m_ExtraEnvironment);
+
+		BOOST_FOREACH(const Dictionary::Pair& kv, m_ExtraEnvironment) {
+			environment->Add(kv.first + "=" + Convert::ToString(kv.second));
+		}
+	}
+
+	environment->Add("LC_NUMERIC=C");
+
+	Dictionary::Ptr request = new Dictionary();
+	request->Set("arguments", arguments);
+	request->Set("environment", environment);
+
+	boost::mutex::scoped_lock lock(l_SpawnHelperMutex);
+
+	if (l_SpawnHelperFD == -1) {
+		Value useSpawnHelper = ScriptGlobal::Get("UseSpawnHelper", &Empty);
+
+		if (useSpawnHelper.IsEmpty() || !static_cast<bool>(useSpawnHelper))
+			return false;
+
+		/* processes are started with fork() until the spawn helper can be restarted */
+		double now = Utility::GetTime();
+
+		if (l_SpawnHelperLastStart != 0 && now - l_SpawnHelperLastStart < SPAWNHELPER_RESTARTINTERVAL)
+			return false;
+
+		l_SpawnHelperLastStart = now;
+
+		StartSpawnHelper();
+
+		if (l_SpawnHelperFD == -1)
+			return false;
+	}
+
+	unsigned long id = l_SpawnHelperNextID++;
+	unsigned long generation = l_SpawnHelperGeneration;
+
+	request->Set("id", id);
+
+	/* The request is sent while holding l_SpawnHelperMutex so that
+	 * SpawnHelperThreadProc() can't close the socket in the meantime. The
+	 * send must not block because that thread needs the mutex to read the
+	 * spawn helper's replies; a full socket buffer falls back to fork(). */
+	if (!SendSpawnHelperMessage(l_SpawnHelperFD, JsonEncode(request), fd, MSG_DONTWAIT)) {
+		Log(LogWarning, "Process")
+		    << "Could not send request to spawn helper: " << Utility::FormatErrorNumber(errno);
+		return false;
+	}
+
+	std::map<unsigned long, pid_t>::iterator it;
+	double deadline = Utility::GetTime() + SPAWNHELPER_REPLYTIMEOUT;
+
+	while ((it = l_SpawnHelperPIDs.find(id)) == l_SpawnHelperPIDs.end() && l_SpawnHelperGeneration == generation) {
+		if (!WaitForSpawnHelper(lock, deadline))
+			break;
+	}
+
+	if (it == l_SpawnHelperPIDs.end()) {
+		if (l_SpawnHelperGeneration == generation) {
+			Log(LogWarning, "Process")
+			    << "Spawn helper (PID " << l_SpawnHelperPID << ") did not respond within " << SPAWNHELPER_REPLYTIMEOUT
+			    << " seconds, killing it and starting " << PrettyPrintArguments(m_Arguments) << " with fork()";
+
+			/* Killing the spawn helper makes sure it doesn't start the process
+			 * as well. SpawnHelperThreadProc() reaps it. */
+			(void) kill(l_SpawnHelperPID, SIGKILL);
+
+			l_SpawnHelperFD = -1;
+			l_SpawnHelperGeneration++;
+			l_SpawnHelperLastStart = Utility::GetTime();
+			l_SpawnHelperAbandonedPIDs.clear();
+			l_SpawnHelperCV.notify_all();
+		}
+
+		return false;
+	}
+
+	pid_t pid = it->second;
+	l_SpawnHelperPIDs.erase(it);
+
+	if (pid <= 0)
+		return false;
+
+	m_Process = pid;
+	m_SpawnHelperGeneration = generation;
+	m_ExtraEnvironment.reset();
+
+	return true;
+}
+
+/**
+ * Asks the spawn helper to kill the process group. Only the spawn helper
+ * knows whether the process is still running: once it has reaped the
+ * process the PID may already belong to another process.
+ */
+void Process::KillViaHelper(void)
+{
+	Dictionary::Ptr request = new Dictionary();
+	request->Set("type", "kill");
+	request->Set("pid", m_Process);
+
+	boost::mutex::scoped_lock lock(l_SpawnHelperMutex);
+
+	/* the process was started by a spawn helper which has terminated */
+	if (l_SpawnHelperGeneration != m_SpawnHelperGeneration || l_SpawnHelperFD == -1)
+		return;
+
+	/* see SpawnViaHelper() */
+	if (!SendSpawnHelperMessage(l_SpawnHelperFD, JsonEncode(request), -1, MSG_DONTWAIT)) {
+		Log(LogWarning, "Process")
+		    << "Could not send kill request for PID " << m_Process << " to spawn helper: " << Utility::FormatErrorNumber(errno);
+	}
+}
+
+/**
+ * Waits until the spawn helper reports that the process has terminated.
+ *
+ * @param pid The process ID.
+ * @param generation The spawn helper instance which started the process.
+ * @param timeout The maximum number of seconds to wait, or 0 to wait indefinitely.
+ * @returns The wait status, or -1 if the spawn helper has terminated or didn't
+ *          report the exit status in time.
+ */
+int Process::WaitForSpawnHelperExit(pid_t pid, unsigned long generation, double timeout)
+{
+	boost::mutex::scoped_lock lock(l_SpawnHelperMutex);
+
+	std::map<pid_t, int>::iterator it;
+	double deadline = (timeout > 0) ? Utility::GetTime() + timeout : 0;
+
+	while ((it = l_SpawnHelperExitStatus.find(pid)) == l_SpawnHelperExitStatus.end() && l_SpawnHelperGeneration == generation) {
+		if (!WaitForSpawnHelper(lock, deadline))
+			break;
+	}
+
+	if (it == l_SpawnHelperExitStatus.end()) {
+		if (l_SpawnHelperGeneration == generation) {
+			Log(LogWarning, "Process")
+			    << "Spawn helper did not report the exit status for PID " << pid << " within " << timeout << " seconds";
+
+			l_SpawnHelperAbandonedPIDs.insert(pid);
+		}
+
+		return -1;
+	}
+
+	int status = it->second;
+	l_SpawnHelperExitStatus.erase(it);
+
+	return status;
+}
+
+static void SpawnHelperSigChldHandler(int)
+{
+	int saved_errno = errno;
+	(void) write(l_SpawnHelperSignalFDs[1], "C", 1);
+	errno = saved_errno;
+}
+
+static void SpawnHelperReapChildren(int sock)
+{
+	pid_t pid;
+	int status;
+
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+		l_SpawnHelperChildren.erase(pid);
+
+		Dictionary::Ptr message = new Dictionary();
+		message->Set("type", "exit");
+		message->Set("pid", pid);
+		message->Set("status", status);
+
+		(void) SendSpawnHelperMessage(sock, JsonEncode(message));
+	}
+}
+
+static pid_t SpawnHelperSpawn(const Dictionary::Ptr& request, int fd)
+{
+	Array::Ptr arguments = request->Get("arguments");
+	Array::Ptr environment = request->Get("environment");
+
+	if (!arguments || arguments->GetLength() == 0 || !environment)
+		return -1;
+
+	// build argv
+	std::vector<char *> argv;
+
+	{
+		ObjectLock olock(arguments);
+		BOOST_FOREACH(const String& argument, arguments) {
+			argv.push_back(strdup(argument.CStr()));
+		}
+	}
+
+	argv.push_back(NULL);
+
+	// build envp
+	std::vector<char *> envp;
+
+	for (int i = 0; environ[i] != NULL; i++)
+		envp.push_back(strdup(environ[i]));
+
+	{
+		ObjectLock olock(environment);
+		BOOST_FOREACH(const String& kv, environment) {
+			envp.push_back(strdup(kv.CStr()));
+		}
+	}
+
+	envp.push_back(NULL);
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+	posix_spawn_file_actions_adddup2(&actions, fd, STDOUT_FILENO);
+	posix_spawn_file_actions_adddup2(&actions, fd, STDERR_FILENO);
+	posix_spawn_file_actions_addclose(&actions, fd);
+
+	sigset_t mask;
+	sigemptyset(&mask);
+
+	posix_spawnattr_t attr;
+	posix_spawnattr_init(&attr);
+	posix_spawnattr_setsigmask(&attr, &mask);
+
+	/* The process must get its own process group so that Process::DoEvents() can kill it on timeout. */
+#ifdef POSIX_SPAWN_SETSID
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSID | POSIX_SPAWN_SETSIGMASK);
+#else /* POSIX_SPAWN_SETSID */
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK);
+	posix_spawnattr_setpgroup(&attr, 0);
+#endif /* POSIX_SPAWN_SETSID */
+
+	pid_t pid;
+	int rc = posix_spawnp(&pid, argv[0], &actions, &attr, &argv[0], &envp[0]);
+
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&actions);
+
+	if (rc != 0) {
+		/* Report the error the same way the fork() code path does. */
+		pid = fork();
+
+		if (pid == 0) {
+			(void) setpgid(0, 0);
+
+			if (dup2(fd, STDERR_FILENO) < 0)
+				_exit(128);
+
+			char errmsg[512];
+			strcpy(errmsg, "execvpe(");
+			strncat(errmsg, argv[0], sizeof(errmsg) - strlen(errmsg) - 1);
+			strncat(errmsg, ") failed", sizeof(errmsg) - strlen(errmsg) - 1);
+			errmsg[sizeof(errmsg) - 1] = '\0';
+			errno = rc;
+			perror(errmsg);
+			_exit(128);
+		}
+	}
+
+	// free arguments
+	for (std::vector<char *>::size_type i = 0; i < argv.size(); i++)
+		free(argv[i]);
+
+	// free environment
+	for (std::vector<char *>::size_type i = 0; i < envp.size(); i++)
+		free(envp[i]);
+
+	if (pid > 0)
+		l_SpawnHelperChildren.insert(pid);
+
+	return pid;
+}
+
+/**
+ * Kills the process group of a process which was started by the spawn
+ * helper, unless the process has already been reaped.
+ */
+static void SpawnHelperKill(const Dictionary::Ptr& request)
+{
+	pid_t pid = static_cast<long>(request->Get("pid"));
+
+	if (l_SpawnHelperChildren.find(pid) == l_SpawnHelperChildren.end())
+		return;
+
+	(void) kill(-pid, SIGKILL);
+}
+
+/**
+ * The main loop of the spawn helper. Reads spawn requests from the socket,
+ * starts the processes and reports their PIDs and exit status.
+ *
+ * @param fd The socket which is connected to the daemon.
+ * @returns An exit status.
+ */
+int Process::RunSpawnHelper(int fd)
+{
+	/* The processes inherit stdin. They must neither be able to read
+	 * requests from the socket nor to send messages to the daemon. */
+#ifdef F_DUPFD_CLOEXEC
+	int sock = fcntl(fd, F_DUPFD_CLOEXEC, SPAWNHELPER_MINFD);
+#else /* F_DUPFD_CLOEXEC */
+	int sock = fcntl(fd, F_DUPFD, SPAWNHELPER_MINFD);
+
+	if (sock >= 0)
+		Utility::SetCloExec(sock);
+#endif /* F_DUPFD_CLOEXEC */
+
+	if (sock < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+		    << boost::errinfo_api_function("fcntl")
+		    << boost::errinfo_errno(errno));
+	}
+
+	int nullfd = open("/dev/null", O_RDONLY);
+
+	if (nullfd < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+		    << boost::errinfo_api_function("open")
+		    << boost::errinfo_errno(errno)
+		    << boost::errinfo_file_name("/dev/null"));
+	}
+
+	if (dup2(nullfd, fd) < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+		    << boost::errinfo_api_function("dup2")
+		    << boost::errinfo_errno(errno));
+	}
+
+	(void) close(nullfd);
+
+	fd = sock;
+
+	if (pipe(l_SpawnHelperSignalFDs) < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+		    << boost::errinfo_api_function("pipe")
+		    << boost::errinfo_errno(errno));
+	}
+
+	Utility::SetCloExec(l_SpawnHelperSignalFDs[0]);
+	Utility::SetCloExec(l_SpawnHelperSignalFDs[1]);
+	Utility::SetNonBlocking(l_SpawnHelperSignalFDs[0]);
+	Utility::SetNonBlocking(l_SpawnHelperSignalFDs[1]);
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = &SpawnHelperSigChldHandler;
+	sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+	sigaction(SIGCHLD, &sa, NULL);
+
+#ifdef HAVE_NICE
+	/* Processes inherit the nice value from the spawn helper. */
+	if (nice(5) < 0)
+		Log(LogWarning, "Process", "Failed to renice spawn helper.");
+#endif /* HAVE_NICE */
+
+	std::vector<char> buffer(SPAWNHELPER_MAXMESSAGE);
+
+	for (;;) {
+		pollfd pfds[2];
+
+		pfds[0].fd = fd;
+		pfds[0].events = POLLIN;
+		pfds[0].revents = 0;
+
+		pfds[1].fd = l_SpawnHelperSignalFDs[0];
+		pfds[1].events = POLLIN;
+		pfds[1].revents = 0;
+
+		if (poll(pfds, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+
+			break;
+		}
+
+		if (pfds[1].revents & POLLIN) {
+			char sbuffer[512];
+			while (read(l_SpawnHelperSignalFDs[0], sbuffer, sizeof(sbuffer)) > 0)
+				; /* empty loop */
+
+			SpawnHelperReapChildren(fd);
+		}
+
+		if (pfds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+			int ofd;
+			ssize_t rc = ReceiveSpawnHelperMessage(fd, &buffer[0], buffer.size(), &ofd);
+
+			if (rc < 0 && errno == EINTR)
+				continue;
+
+			/* The daemon has terminated. */
+			if (rc <= 0)
+				break;
+
+			Dictionary::Ptr reply = new Dictionary();
+			reply->Set("type", "spawn");
+
+			try {
+				Dictionary::Ptr request = JsonDecode(String(buffer.begin(), buffer.begin() + rc));
+
+				if (request->Get("type") == "kill")
+					SpawnHelperKill(request);
+				else if (ofd != -1) {
+					reply->Set("id", request->Get("id"));
+					reply->Set("pid", SpawnHelperSpawn(request, ofd));
+				}
+			} catch (const std::exception& ex) {
+				Log(LogWarning, "Process")
+				    << "Invalid spawn helper request: " << DiagnosticInformation(ex);
+			}
+
+			if (ofd != -1)
+				(void) close(ofd);
+
+			if (reply->Contains("id"))
+				(void) SendSpawnHelperMessage(fd, JsonEncode(reply));
+		}
+	}
+
+	return 0;
+}
+#endif /* _WIN32 */
@@ -79,11 +79,14 @@ public:
 
 	static Arguments PrepareCommand(const Value& command);
 
-	static void StaticInitialize(void);
 	static void ThreadInitialize(void);
 
 	static String PrettyPrintArguments(const Arguments& arguments);
 
+#ifndef _WIN32
+	static int RunSpawnHelper(int fd);
+#endif /* _WIN32 */
+
 private:
 	Arguments m_Arguments;
 	Dictionary::Ptr m_ExtraEnvironment;
@@ -94,6 +97,11 @@ private:
 	pid_t m_PID;
 	ConsoleHandle m_FD;
 
+#ifndef _WIN32
+	bool m_SpawnHelper;
+	unsigned long m_SpawnHelperGeneration;
+#endif /* _WIN32 */
+
 #ifdef _WIN32
 	bool m_ReadPending;
 	bool m_ReadFailed;
@@ -108,6 +116,15 @@ private:
 	static void IOThreadProc(int tid);
 	bool DoEvents(void);
 	int GetTID(void) const;
+
+#ifndef _WIN32
+	bool SpawnViaHelper(int fd);
+	void KillViaHelper(void);
+
+	static void StartSpawnHelper(void);
+	static void SpawnHelperThreadProc(int fd, pid_t pid);
+	static int WaitForSpawnHelperExit(pid_t pid, unsigned long generation, double timeout);
+#endif /* _WIN32 */
 };
 
 }
@@ -0,0 +1,197 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/socketevents.hpp"
+#include "base/exception.hpp"
+#include "base/logger.hpp"
+#include "base/utility.hpp"
+#include <boost/foreach.hpp>
+
+#ifdef HAVE_EPOLL
+#include <sys/epoll.h>
+#include <poll.h>
+#include <errno.h>
+
+using namespace icinga;
+
+void SocketEventEngineEpoll::InitializeThread(SocketEventThread& thread)
+{
+	thread.EventFDs[0] = epoll_create1(EPOLL_CLOEXEC);
+
+	if (thread.EventFDs[0] < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+		    << boost::errinfo_api_function("epoll_create1")
+		    << boost::errinfo_errno(errno));
+	}
+}
+
+void SocketEventEngineEpoll::ThreadProc(SocketEventThread& thread)
+{
+	Utility::SetThreadName("SocketIO");
+
+	for (;;) {
+		epoll_event pevents[64];
+
+		int ready = epoll_wait(thread.EventFDs[0], pevents, sizeof(pevents) / sizeof(pevents[0]), -1);
+
+		for (int i = 0; i < ready; i++)
+			DispatchEvent(thread, pevents[i].data.fd, EpollToPoll(pevents[i].events));
+	}
+}
+
+int SocketEventEngineEpoll::PollToEpoll(int events)
+{
+	int result = 0;
+
+	if (events & POLLIN)
+		result |= EPOLLIN;
+
+	if (events & POLLOUT)
+		result |= EPOLLOUT;
+
+	return result;
+}
+
+int SocketEventEngineEpoll::EpollToPoll(int events)
+{
+	int result = 0;
+
+	if (events & EPOLLIN)
+		result |= POLLIN;
+
+	if (events & EPOLLOUT)
+		result |= POLLOUT;
+
+	if (events & EPOLLHUP)
+		result |= POLLHUP;
+
+	if (events & EPOLLERR)
+		result |= POLLERR;
+
+	return result;
+}
+
+void SocketEventEngineEpoll::Register(SocketEvents *se, Object *lifesupportObject)
+{
+	SocketEventThread& thread = GetThread(se);
+
+	boost::mutex::scoped_lock lock(thread.Mutex);
+
+	VERIFY(se->m_FD != INVALID_SOCKET);
+
+	SocketEventDescriptor desc;
+	desc.Events = 0;
+	desc.EventInterface = se;
+	desc.LifesupportObject = lifesupportObject;
+
+	VERIFY(thread.Sockets.find(se->m_FD) == thread.Sockets.end());
+
+	thread.Sockets[se->m_FD] = desc;
+
+	epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.data.fd = se->m_FD;
+	event.events = EPOLLET;
+
+	/* ChangeEvents() adds the socket again if this fails */
+	if (epoll_ctl(thread.EventFDs[0], EPOLL_CTL_ADD, se->m_FD, &event) < 0) {
+		int error = errno;
+
+		Log(LogCritical, "SocketEvents")
+		    << "epoll_ctl(EPOLL_CTL_ADD) failed for socket " << se->m_FD << " with error code "
+		    << error << ", \"" << Utility::FormatErrorNumber(error) << "\"";
+	}
+
+	se->m_Events = true;
+}
+
+void SocketEventEngineEpoll::Unregister(SocketEvents *se)
+{
+	SocketEventThread& thread = GetThread(se);
+
+	boost::mutex::scoped_lock lock(thread.Mutex);
+
+	if (se->m_FD == INVALID_SOCKET)
+		return;
+
+	thread.Sockets.erase(se->m_FD);
+
+	if (epoll_ctl(thread.EventFDs[0], EPOLL_CTL_DEL, se->m_FD, NULL) < 0) {
+		int error = errno;
+
+		Log(LogWarning, "SocketEvents")
+		    << "epoll_ctl(EPOLL_CTL_DEL) failed for socket " << se->m_FD << " with error code "
+		    << error << ", \"" << Utility::FormatErrorNumber(error) << "\"";
+	}
+
+	se->m_FD = INVALID_SOCKET;
+	se->m_Events = false;
+
+	/* Events which have already been returned by epoll_wait() are dropped
+	 * by DispatchEvent(); we only have to wait for a handler which is
+	 * currently running. */
+	WaitForDispatch(thread, se, lock);
+}
+
+/**
+ * Changes the events for a socket. The socket is edge-triggered; modifying
+ * it re-arms the socket, i.e. the I/O thread is notified again if the
+ * socket is still readable or writable. Event handlers therefore must call
+ * ChangeEvents() once they're done processing an event.
+ */
+void SocketEventEngineEpoll::ChangeEvents(SocketEvents *se, int events)
+{
+	SocketEventThread& thread = GetThread(se);
+
+	boost::mutex::scoped_lock lock(thread.Mutex);
+
+	if (se->m_FD == INVALID_SOCKET)
+		BOOST_THROW_EXCEPTION(std::runtime_error("Tried to read/write from a closed socket."));
+
+	std::map<SOCKET, SocketEventDescriptor>::iterator it = thread.Sockets.find(se->m_FD);
+
+	if (it == thread.Sockets.end())
+		return;
+
+	it->second.Events = events;
+
+	epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.data.fd = se->m_FD;
+	event.events = PollToEpoll(events) | EPOLLET;
+
+	if (epoll_ctl(thread.EventFDs[0], EPOLL_CTL_MOD, se->m_FD, &event) < 0) {
+		const char *op = "EPOLL_CTL_MOD";
+		int error = errno;
+
+		/* the socket isn't in the epoll set, e.g. because Register() failed to add it */
+		if (error == ENOENT) {
+			if (epoll_ctl(thread.EventFDs[0], EPOLL_CTL_ADD, se->m_FD, &event) == 0)
+				return;
+
+			op = "EPOLL_CTL_ADD";
+			error = errno;
+		}
+
+		Log(LogCritical, "SocketEvents")
+		    << "epoll_ctl(" << op << ") failed for socket " << se->m_FD << " with error code "
+		    << error << ", \"" << Utility::FormatErrorNumber(error) << "\"";
+	}
+}
+#endif /* HAVE_EPOLL */
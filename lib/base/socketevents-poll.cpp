@@ -0,0 +1,192 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/socketevents.hpp"
+#include "base/exception.hpp"
+#include "base/logger.hpp"
+#include <boost/foreach.hpp>
+
+#ifndef _WIN32
+#	include <poll.h>
+#endif /* _WIN32 */
+
+using namespace icinga;
+
+void SocketEventEnginePoll::InitializeThread(SocketEventThread& thread)
+{
+	Socket::SocketPair(thread.EventFDs);
+
+	Utility::SetNonBlockingSocket(thread.EventFDs[0]);
+	Utility::SetNonBlockingSocket(thread.EventFDs[1]);
+
+#ifndef _WIN32
+	Utility::SetCloExec(thread.EventFDs[0]);
+	Utility::SetCloExec(thread.EventFDs[1]);
+#endif /* _WIN32 */
+
+	SocketEventDescriptor sed;
+	sed.Events = POLLIN;
+
+	thread.Sockets[thread.EventFDs[0]] = sed;
+}
+
+void SocketEventEnginePoll::ThreadProc(SocketEventThread& thread)
+{
+	Utility::SetThreadName("SocketIO");
+
+	for (;;) {
+		pollfd *pfds;
+		int pfdcount;
+
+		typedef std::map<SOCKET, SocketEventDescriptor>::value_type SocketDesc;
+
+		{
+			boost::mutex::scoped_lock lock(thread.Mutex);
+
+			pfdcount = thread.Sockets.size();
+			pfds  = new pollfd[pfdcount];
+
+			int i = 0;
+
+			BOOST_FOREACH(const SocketDesc& desc, thread.Sockets) {
+				pfds[i].fd = desc.first;
+				pfds[i].events = desc.second.Events;
+				pfds[i].revents = 0;
+
+				i++;
+			}
+		}
+
+#ifdef _WIN32
+		(void) WSAPoll(pfds, pfdcount, -1);
+#else /* _WIN32 */
+		(void) poll(pfds, pfdcount, -1);
+#endif /* _WIN32 */
+
+		{
+			boost::mutex::scoped_lock lock(thread.Mutex);
+
+			if (thread.FDChanged) {
+				thread.FDChanged = false;
+				thread.CV.notify_all();
+				delete [] pfds;
+				continue;
+			}
+		}
+
+		for (int i = 0; i < pfdcount; i++) {
+			if ((pfds[i].revents & (POLLIN | POLLOUT | POLLHUP | POLLERR)) == 0)
+				continue;
+
+			if (pfds[i].fd == thread.EventFDs[0]) {
+				char buffer[512];
+				if (recv(thread.EventFDs[0], buffer, sizeof(buffer), 0) < 0)
+					Log(LogCritical, "SocketEvents", "Read from event FD failed.");
+
+				continue;
+			}
+
+			DispatchEvent(thread, pfds[i].fd, pfds[i].revents);
+		}
+
+		delete [] pfds;
+	}
+}
+
+void SocketEventEnginePoll::WakeUpThread(SocketEventThread& thread, bool wait)
+{
+	if (wait) {
+		if (boost::this_thread::get_id() != thread.Thread.get_id()) {
+			boost::mutex::scoped_lock lock(thread.Mutex);
+
+			thread.FDChanged = true;
+
+			while (thread.FDChanged) {
+				(void) send(thread.EventFDs[1], "T", 1, 0);
+
+				boost::system_time const timeout = boost::get_system_time() + boost::posix_time::milliseconds(50);
+				thread.CV.timed_wait(lock, timeout);
+			}
+		}
+	} else {
+		(void) send(thread.EventFDs[1], "T", 1, 0);
+	}
+}
+
+void SocketEventEnginePoll::Register(SocketEvents *se, Object *lifesupportObject)
+{
+	SocketEventThread& thread = GetThread(se);
+
+	boost::mutex::scoped_lock lock(thread.Mutex);
+
+	VERIFY(se->m_FD != INVALID_SOCKET);
+
+	SocketEventDescriptor desc;
+	desc.Events = 0;
+	desc.EventInterface = se;
+	desc.LifesupportObject = lifesupportObject;
+
+	VERIFY(thread.Sockets.find(se->m_FD) == thread.Sockets.end());
+
+	thread.Sockets[se->m_FD] = desc;
+
+	se->m_Events = true;
+
+	/* There's no need to wake up the I/O thread here. */
+}
+
+void SocketEventEnginePoll::Unregister(SocketEvents *se)
+{
+	SocketEventThread& thread = GetThread(se);
+
+	{
+		boost::mutex::scoped_lock lock(thread.Mutex);
+
+		if (se->m_FD == INVALID_SOCKET)
+			return;
+
+		thread.Sockets.erase(se->m_FD);
+		se->m_FD = INVALID_SOCKET;
+
+		se->m_Events = false;
+	}
+
+	WakeUpThread(thread, true);
+}
+
+void SocketEventEnginePoll::ChangeEvents(SocketEvents *se, int events)
+{
+	SocketEventThread& thread = GetThread(se);
+
+	{
+		boost::mutex::scoped_lock lock(thread.Mutex);
+
+		if (se->m_FD == INVALID_SOCKET)
+			BOOST_THROW_EXCEPTION(std::runtime_error("Tried to read/write from a closed socket."));
+
+		std::map<SOCKET, SocketEventDescriptor>::iterator it = thread.Sockets.find(se->m_FD);
+
+		if (it == thread.Sockets.end())
+			return;
+
+		it->second.Events = events;
+	}
+
+	WakeUpThread(thread);
+}
@@ -20,171 +20,133 @@
 #include "base/socketevents.hpp"
 #include "base/exception.hpp"
 #include "base/logger.hpp"
+#include "base/scriptglobal.hpp"
 #include <boost/thread/once.hpp>
+#include <boost/smart_ptr/make_shared.hpp>
 #include <boost/foreach.hpp>
-#include <map>
-
-#ifndef _WIN32
-#	include <poll.h>
-#endif /* _WIN32 */
 
 using namespace icinga;
 
-struct SocketEventDescriptor
-{
-	int Events;
-	SocketEvents *EventInterface;
-	Object *LifesupportObject;
-
-	SocketEventDescriptor(void)
-		: Events(0), EventInterface(NULL), LifesupportObject(NULL)
-	{ }
-};
-
-static boost::thread l_SocketIOThread;
 static boost::once_flag l_SocketIOOnceFlag = BOOST_ONCE_INIT;
-static SOCKET l_SocketIOEventFDs[2];
-static boost::mutex l_SocketIOMutex;
-static boost::condition_variable l_SocketIOCV;
-static bool l_SocketIOFDChanged;
-static std::map<SOCKET, SocketEventDescriptor> l_SocketIOSockets;
+static SocketEventEngine *l_SocketIOEngine;
+static boost::mutex l_SocketIONextIDMutex;
+static unsigned int l_SocketIONextID;
 
-void SocketEvents::InitializeThread(void)
+/**
+ * Starts the I/O threads. The number of threads can be set with the
+ * SocketIOThreads constant.
+ */
+void SocketEventEngine::Start(void)
 {
-	Socket::SocketPair(l_SocketIOEventFDs);
-
-	Utility::SetNonBlockingSocket(l_SocketIOEventFDs[0]);
-	Utility::SetNonBlockingSocket(l_SocketIOEventFDs[1]);
-
-#ifndef _WIN32
-	Utility::SetCloExec(l_SocketIOEventFDs[0]);
-	Utility::SetCloExec(l_SocketIOEventFDs[1]);
-#endif /* _WIN32 */
+	Value defaultThreads = 1;
+	int count = ScriptGlobal::Get("SocketIOThreads", &defaultThreads);
 
-	SocketEventDescriptor sed;
-	sed.Events = POLLIN;
+	if (count < 1)
+		count = 1;
 
-	l_SocketIOSockets[l_SocketIOEventFDs[0]] = sed;
+	for (int i = 0; i < count; i++) {
+		boost::shared_ptr<SocketEventThread> thread = boost::make_shared<SocketEventThread>();
+		InitializeThread(*thread);
+		m_Threads.push_back(thread);
+	}
 
-	l_SocketIOThread = boost::thread(&SocketEvents::ThreadProc);
+	BOOST_FOREACH(const boost::shared_ptr<SocketEventThread>& thread, m_Threads) {
+		thread->Thread = boost::thread(boost::bind(&SocketEventEngine::ThreadProc, this, boost::ref(*thread)));
+	}
 }
 
-void SocketEvents::ThreadProc(void)
+SocketEventThread& SocketEventEngine::GetThread(SocketEvents *se)
 {
-	Utility::SetThreadName("SocketIO");
-
-	for (;;) {
-		pollfd *pfds;
-		int pfdcount;
-
-		typedef std::map<SOCKET, SocketEventDescriptor>::value_type SocketDesc;
-
-		{
-			boost::mutex::scoped_lock lock(l_SocketIOMutex);
-
-			pfdcount = l_SocketIOSockets.size();
-			pfds  = new pollfd[pfdcount];
-
-			int i = 0;
-
-			BOOST_FOREACH(const SocketDesc& desc, l_SocketIOSockets) {
-				pfds[i].fd = desc.first;
-				pfds[i].events = desc.second.Events;
-				pfds[i].revents = 0;
-
-				i++;
-			}
-		}
-
-#ifdef _WIN32
-		(void) WSAPoll(pfds, pfdcount, -1);
-#else /* _WIN32 */
-		(void) poll(pfds, pfdcount, -1);
-#endif /* _WIN32 */
-
-		{
-			boost::mutex::scoped_lock lock(l_SocketIOMutex);
-
-			if (l_SocketIOFDChanged) {
-				l_SocketIOFDChanged = false;
-				l_SocketIOCV.notify_all();
-				delete [] pfds;
-				continue;
-			}
-		}
-
-		for (int i = 0; i < pfdcount; i++) {
-			if ((pfds[i].revents & (POLLIN | POLLOUT | POLLHUP | POLLERR)) == 0)
-				continue;
+	return *m_Threads[se->m_ID % m_Threads.size()];
+}
 
-			if (pfds[i].fd == l_SocketIOEventFDs[0]) {
-				char buffer[512];
-				if (recv(l_SocketIOEventFDs[0], buffer, sizeof(buffer), 0) < 0)
-					Log(LogCritical, "SocketEvents", "Read from event FD failed.");
+boost::mutex& SocketEventEngine::GetMutex(SocketEvents *se)
+{
+	return GetThread(se).Mutex;
+}
 
-				continue;
-			}
+/**
+ * Calls the event handler for the specified socket.
+ *
+ * @param thread The I/O thread the socket belongs to.
+ * @param fd The socket.
+ * @param revents The events which occurred on the socket.
+ */
+void SocketEventEngine::DispatchEvent(SocketEventThread& thread, SOCKET fd, int revents)
+{
+	SocketEventDescriptor desc;
+	Object::Ptr ltref;
 
-			SocketEventDescriptor desc;
-			Object::Ptr ltref;
+	{
+		boost::mutex::scoped_lock lock(thread.Mutex);
 
-			{
-				boost::mutex::scoped_lock lock(l_SocketIOMutex);
+		std::map<SOCKET, SocketEventDescriptor>::const_iterator it = thread.Sockets.find(fd);
 
-				std::map<SOCKET, SocketEventDescriptor>::const_iterator it = l_SocketIOSockets.find(pfds[i].fd);
+		if (it == thread.Sockets.end())
+			return;
 
-				if (it == l_SocketIOSockets.end())
-					continue;
+		desc = it->second;
 
-				desc = it->second;
+		/* We must hold a ref-counted reference to the event object to keep it alive. */
+		ltref = desc.LifesupportObject;
+		VERIFY(ltref);
 
-				/* We must hold a ref-counted reference to the event object to keep it alive. */
-				ltref = desc.LifesupportObject;
-				VERIFY(ltref);
-			}
+		thread.Dispatching = desc.EventInterface;
+	}
 
-			try {
-				desc.EventInterface->OnEvent(pfds[i].revents);
-			} catch (const std::exception& ex) {
-				Log(LogCritical, "SocketEvents")
-				    << "Exception thrown in socket I/O handler:\n"
-				    << DiagnosticInformation(ex);
-			} catch (...) {
-				Log(LogCritical, "SocketEvents", "Exception of unknown type thrown in socket I/O handler.");
-			}
-		}
+	try {
+		desc.EventInterface->OnEvent(revents);
+	} catch (const std::exception& ex) {
+		Log(LogCritical, "SocketEvents")
+		    << "Exception thrown in socket I/O handler:\n"
+		    << DiagnosticInformation(ex);
+	} catch (...) {
+		Log(LogCritical, "SocketEvents", "Exception of unknown type thrown in socket I/O handler.");
+	}
 
-		delete [] pfds;
+	{
+		boost::mutex::scoped_lock lock(thread.Mutex);
+		thread.Dispatching = NULL;
+		thread.CV.notify_all();
 	}
 }
 
-void SocketEvents::WakeUpThread(bool wait)
+/**
+ * Waits until the I/O thread has finished calling the event handler for
+ * the specified socket. Returns immediately when called from the I/O thread.
+ */
+void SocketEventEngine::WaitForDispatch(SocketEventThread& thread, SocketEvents *se, boost::mutex::scoped_lock& lock)
 {
-	if (wait) {
-		if (boost::this_thread::get_id() != l_SocketIOThread.get_id()) {
-			boost::mutex::scoped_lock lock(l_SocketIOMutex);
+	if (boost::this_thread::get_id() == thread.Thread.get_id())
+		return;
 
-			l_SocketIOFDChanged = true;
+	while (thread.Dispatching == se)
+		thread.CV.wait(lock);
+}
 
-			while (l_SocketIOFDChanged) {
-				(void) send(l_SocketIOEventFDs[1], "T", 1, 0);
+void SocketEvents::InitializeEngine(void)
+{
+#ifdef HAVE_EPOLL
+	l_SocketIOEngine = new SocketEventEngineEpoll();
+#else /* HAVE_EPOLL */
+	l_SocketIOEngine = new SocketEventEnginePoll();
+#endif /* HAVE_EPOLL */
 
-				boost::system_time const timeout = boost::get_system_time() + boost::posix_time::milliseconds(50);
-				l_SocketIOCV.timed_wait(lock, timeout);
-			}
-		}
-	} else {
-		(void) send(l_SocketIOEventFDs[1], "T", 1, 0);
-	}
+	l_SocketIOEngine->Start();
 }
 
 /**
  * Constructor for the SocketEvents class.
  */
 SocketEvents::SocketEvents(const Socket::Ptr& socket, Object *lifesupportObject)
-	: m_FD(socket->GetFD())
+	: m_FD(socket->GetFD()), m_Events(false)
 {
-	boost::call_once(l_SocketIOOnceFlag, &SocketEvents::InitializeThread);
+	boost::call_once(l_SocketIOOnceFlag, &SocketEvents::InitializeEngine);
+
+	{
+		boost::mutex::scoped_lock lock(l_SocketIONextIDMutex);
+		m_ID = l_SocketIONextID++;
+	}
 
 	Register(lifesupportObject);
 }
@@ -196,63 +158,23 @@ SocketEvents::~SocketEvents(void)
 
 void SocketEvents::Register(Object *lifesupportObject)
 {
-	boost::mutex::scoped_lock lock(l_SocketIOMutex);
-
-	VERIFY(m_FD != INVALID_SOCKET);
-
-	SocketEventDescriptor desc;
-	desc.Events = 0;
-	desc.EventInterface = this;
-	desc.LifesupportObject = lifesupportObject;
-
-	VERIFY(l_SocketIOSockets.find(m_FD) == l_SocketIOSockets.end());
-
-	l_SocketIOSockets[m_FD] = desc;
-
-	m_Events = true;
-
-	/* There's no need to wake up the I/O thread here. */
+	l_SocketIOEngine->Register(this, lifesupportObject);
 }
 
 void SocketEvents::Unregister(void)
 {
-	{
-		boost::mutex::scoped_lock lock(l_SocketIOMutex);
-
-		if (m_FD == INVALID_SOCKET)
-			return;
-
-		l_SocketIOSockets.erase(m_FD);
-		m_FD = INVALID_SOCKET;
-
-		m_Events = false;
-	}
-
-	WakeUpThread(true);
+	l_SocketIOEngine->Unregister(this);
 }
 
 void SocketEvents::ChangeEvents(int events)
 {
-	{
-		boost::mutex::scoped_lock lock(l_SocketIOMutex);
-
-		if (m_FD == INVALID_SOCKET)
-			BOOST_THROW_EXCEPTION(std::runtime_error("Tried to read/write from a closed socket."));
-
-		std::map<SOCKET, SocketEventDescriptor>::iterator it = l_SocketIOSockets.find(m_FD);
-
-		if (it == l_SocketIOSockets.end())
-			return;
-
-		it->second.Events = events;
-	}
-
-	WakeUpThread();
+	l_SocketIOEngine->ChangeEvents(this, events);
 }
 
 bool SocketEvents::IsHandlingEvents(void) const
 {
-	boost::mutex::scoped_lock lock(l_SocketIOMutex);
+	SocketEvents *se = const_cast<SocketEvents *>(this);
+	boost::mutex::scoped_lock lock(l_SocketIOEngine->GetMutex(se));
 	return m_Events;
 }
 
@@ -260,4 +182,3 @@ void SocketEvents::OnEvent(int revents)
 {
 
 }
-
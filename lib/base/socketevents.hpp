@@ -22,6 +22,12 @@
 
 #include "base/i2-base.hpp"
 #include "base/socket.hpp"
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/smart_ptr/shared_ptr.hpp>
+#include <map>
+#include <vector>
 
 namespace icinga
 {
@@ -48,18 +54,133 @@ protected:
 	SocketEvents(const Socket::Ptr& socket, Object *lifesupportObject);
 
 private:
+	unsigned int m_ID;
 	SOCKET m_FD;
 	bool m_Events;
 
-	static void InitializeThread(void);
-	static void ThreadProc(void);
+	static void InitializeEngine(void);
 
-	static void WakeUpThread(bool wait = false);
+	void Register(Object *lifesupportObject);
 
-	int GetPollEvents(void) const;
+	friend class SocketEventEngine;
+	friend class SocketEventEnginePoll;
+	friend class SocketEventEngineEpoll;
+};
 
-	void Register(Object *lifesupportObject);
+struct SocketEventDescriptor
+{
+	int Events;
+	SocketEvents *EventInterface;
+	Object *LifesupportObject;
+
+	SocketEventDescriptor(void)
+		: Events(0), EventInterface(NULL), LifesupportObject(NULL)
+	{ }
+};
+
+/**
+ * State for one of the socket I/O threads.
+ *
+ * @ingroup base
+ */
+struct SocketEventThread
+{
+	boost::thread Thread;
+	boost::mutex Mutex;
+	boost::condition_variable CV;
+	std::map<SOCKET, SocketEventDescriptor> Sockets;
+
+	/* The poll engine uses a socket pair to interrupt poll(),
+	 * the epoll engine keeps its epoll FD in EventFDs[0]. */
+	SOCKET EventFDs[2];
+	bool FDChanged;
+
+	/* The event interface whose OnEvent() handler is currently
+	 * being called by this thread. */
+	SocketEvents *Dispatching;
+
+	SocketEventThread(void)
+		: FDChanged(false), Dispatching(NULL)
+	{
+		EventFDs[0] = INVALID_SOCKET;
+		EventFDs[1] = INVALID_SOCKET;
+	}
+};
+
+/**
+ * Distributes sockets across a number of I/O threads and calls their
+ * event handlers.
+ *
+ * @ingroup base
+ */
+class I2_BASE_API SocketEventEngine
+{
+public:
+	void Start(void);
+
+	virtual void Register(SocketEvents *se, Object *lifesupportObject) = 0;
+	virtual void Unregister(SocketEvents *se) = 0;
+	virtual void ChangeEvents(SocketEvents *se, int events) = 0;
+
+	boost::mutex& GetMutex(SocketEvents *se);
+
+protected:
+	std::vector<boost::shared_ptr<SocketEventThread> > m_Threads;
+
+	virtual void InitializeThread(SocketEventThread& thread) = 0;
+	virtual void ThreadProc(SocketEventThread& thread) = 0;
+
+	SocketEventThread& GetThread(SocketEvents *se);
+
+	static void DispatchEvent(SocketEventThread& thread, SOCKET fd, int revents);
+	static void WaitForDispatch(SocketEventThread& thread, SocketEvents *se, boost::mutex::scoped_lock& lock);
+};
+
+/**
+ * Socket event engine which uses poll(). Each thread rebuilds its
+ * list of file descriptors whenever one of its sockets changes.
+ *
+ * @ingroup base
+ */
+class I2_BASE_API SocketEventEnginePoll : public SocketEventEngine
+{
+public:
+	virtual void Register(SocketEvents *se, Object *lifesupportObject) override;
+	virtual void Unregister(SocketEvents *se) override;
+	virtual void ChangeEvents(SocketEvents *se, int events) override;
+
+protected:
+	virtual void InitializeThread(SocketEventThread& thread) override;
+	virtual void ThreadProc(SocketEventThread& thread) override;
+
+private:
+	void WakeUpThread(SocketEventThread& thread, bool wait = false);
+};
+
+#ifdef HAVE_EPOLL
+/**
+ * Socket event engine which uses edge-triggered epoll. Changing the
+ * events for a socket is a single epoll_ctl() call and doesn't require
+ * the I/O thread to wake up.
+ *
+ * @ingroup base
+ */
+class I2_BASE_API SocketEventEngineEpoll : public SocketEventEngine
+{
+public:
+	virtual void Register(SocketEvents *se, Object *lifesupportObject) override;
+	virtual void Unregister(SocketEvents *se) override;
+	virtual void ChangeEvents(SocketEvents *se, int events) override;
+
+protected:
+	virtual void InitializeThread(SocketEventThread& thread) override;
+	virtual void ThreadProc(SocketEventThread& thread) override;
+
+private:
+	static int PollToEpoll(int events);
+	static int EpollToPoll(int events);
 };
+#endif /* HAVE_EPOLL */
 
 }
 
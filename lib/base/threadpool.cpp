@@ -23,18 +23,37 @@
 #include "base/utility.hpp"
 #include "base/exception.hpp"
 #include "base/application.hpp"
+#include "base/convert.hpp"
+#include "base/objectlock.hpp"
+#include "base/statsfunction.hpp"
 #include <boost/bind.hpp>
+#include <boost/thread/tss.hpp>
 #include <iostream>
 
 using namespace icinga;
 
 int ThreadPool::m_NextID = 1;
 
+/* Upper bounds (in seconds) for the task latency histogram; the last bucket is unbounded. */
+static const double l_LatencyBuckets[LATENCYBUCKETS - 1] = { 0.001, 0.01, 0.1, 1, 10 };
+static const char *l_LatencyBucketNames[LATENCYBUCKETS] = { "lt_1ms", "lt_10ms", "lt_100ms", "lt_1s", "lt_10s", "ge_10s" };
+
+/* Set for worker threads so that work items which post further work items are never throttled. */
+static boost::thread_specific_ptr<bool> l_IsWorkerThread;
+
+static void ThreadPoolStatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
+{
+	Dictionary::Ptr stats = new Dictionary();
+	Application::GetTP().GetStats(stats, perfdata);
+	status->Set("threadpool", stats);
+}
+
+REGISTER_STATSFUNCTION(ThreadPool, &ThreadPoolStatsFunc);
+
 ThreadPool::ThreadPool(size_t max_threads)
-	: m_ID(m_NextID++), m_MaxThreads(max_threads), m_Stopped(true)
+	: m_ID(m_NextID++), m_MaxThreads(UINT_MAX), m_MaxPending(0), m_Stopped(true)
 {
-	if (m_MaxThreads != UINT_MAX && m_MaxThreads < sizeof(m_Queues) / sizeof(m_Queues[0]))
-		m_MaxThreads = sizeof(m_Queues) / sizeof(m_Queues[0]);
+	SetMaxThreads(max_threads);
 
 	Start();
 }
@@ -52,7 +71,7 @@ void ThreadPool::Start(void)
 	m_Stopped = false;
 
 	for (size_t i = 0; i < sizeof(m_Queues) / sizeof(m_Queues[0]); i++)
-		m_Queues[i].SpawnWorker(m_ThreadGroup);
+		m_Queues[i].SpawnWorker(*this, m_ThreadGroup);
 
 	m_MgmtThread = boost::thread(boost::bind(&ThreadPool::ManagerThreadProc, this));
 }
@@ -75,6 +94,7 @@ void ThreadPool::Stop(void)
 		boost::mutex::scoped_lock lock(m_Queues[i].Mutex);
 		m_Queues[i].Stopped = true;
 		m_Queues[i].CV.notify_all();
+		m_Queues[i].CVFull.notify_all();
 	}
 
 	m_ThreadGroup.join_all();
@@ -88,37 +108,119 @@ void ThreadPool::Stop(void)
 }
 
 /**
- * Waits for work items and processes them.
+ * Sets the maximum number of worker threads. The limit is split evenly
+ * between the queues; each queue has at least one thread.
+ *
+ * @param max_threads The maximum number of threads, UINT_MAX for the default of 16 threads per queue.
+ */
+void ThreadPool::SetMaxThreads(size_t max_threads)
+{
+	size_t queue_threads;
+
+	if (max_threads == UINT_MAX)
+		queue_threads = 16;
+	else
+		queue_threads = std::max<size_t>(max_threads / QUEUECOUNT, 1);
+
+	{
+		boost::mutex::scoped_lock lock(m_MgmtMutex);
+		m_MaxThreads = max_threads;
+	}
+
+	for (size_t i = 0; i < sizeof(m_Queues) / sizeof(m_Queues[0]); i++) {
+		boost::mutex::scoped_lock lock(m_Queues[i].Mutex);
+		m_Queues[i].MaxThreads = queue_threads;
+	}
+}
+
+size_t ThreadPool::GetMaxThreads(void) const
+{
+	return m_MaxThreads;
+}
+
+/**
+ * Sets the maximum number of pending work items. Once a queue is full, Post()
+ * blocks until a worker has taken an item off the queue. Only work items which
+ * are posted with ThrottledScheduler from threads other than worker threads
+ * are throttled: event loop threads (timers, sockets, work queues) must never
+ * block because workers might be waiting for them.
+ *
+ * @param max_pending The maximum number of pending work items, 0 to disable the limit.
+ */
+void ThreadPool::SetMaxPending(size_t max_pending)
+{
+	size_t queue_items = 0;
+
+	if (max_pending > 0)
+		queue_items = std::max<size_t>(max_pending / QUEUECOUNT, 1);
+
+	{
+		boost::mutex::scoped_lock lock(m_MgmtMutex);
+		m_MaxPending = max_pending;
+	}
+
+	for (size_t i = 0; i < sizeof(m_Queues) / sizeof(m_Queues[0]); i++) {
+		boost::mutex::scoped_lock lock(m_Queues[i].Mutex);
+		m_Queues[i].MaxItems = queue_items;
+		m_Queues[i].CVFull.notify_all();
+	}
+}
+
+size_t ThreadPool::GetMaxPending(void) const
+{
+	return m_MaxPending;
+}
+
+/**
+ * Waits for work items and processes them. Idle workers try to steal work
+ * items from the other queues before going to sleep.
  */
-void ThreadPool::WorkerThread::ThreadProc(Queue& queue)
+void ThreadPool::WorkerThread::ThreadProc(ThreadPool& pool, Queue& queue)
 {
 	std::ostringstream idbuf;
 	idbuf << "Q #" << &queue << " W #" << this;
 	Utility::SetThreadName(idbuf.str());
 
+	l_IsWorkerThread.reset(new bool(true));
+
 	for (;;) {
 		WorkItem wi;
+		bool stolen = false;
 
 		{
 			boost::mutex::scoped_lock lock(queue.Mutex);
 
 			UpdateUtilization(ThreadIdle);
 
+			queue.IdleWorkers++;
+
 			while (queue.Items.empty() && !queue.Stopped && !Zombie) {
-				if (queue.Items.empty())
-					queue.CVStarved.notify_all();
+				queue.CVStarved.notify_all();
 
-				queue.CV.wait(lock);
+				lock.unlock();
+				stolen = pool.StealWorkItem(queue, wi);
+				lock.lock();
+
+				if (stolen)
+					break;
+
+				/* Post() sets WorkPosted when another queue has work items but no idle workers. */
+				if (queue.Items.empty() && !queue.Stopped && !Zombie && !queue.WorkPosted)
+					queue.CV.wait(lock);
+
+				queue.WorkPosted = false;
 			}
 
-			if (Zombie)
-				break;
+			queue.IdleWorkers--;
 
-			if (queue.Items.empty() && queue.Stopped)
+			if (stolen)
+				queue.StolenCount++;
+			else if (Zombie)
 				break;
-
-			wi = queue.Items.front();
-			queue.Items.pop_front();
+			else if (queue.Items.empty() && queue.Stopped)
+				break;
+			else
+				queue.PopItem(wi);
 
 			UpdateUtilization(ThreadBusy);
 		}
@@ -153,6 +255,13 @@ void ThreadPool::WorkerThread::ThreadProc(Queue& queue)
 			queue.WaitTime += latency;
 			queue.ServiceTime += et - st;
 			queue.TaskCount++;
+
+			size_t bucket = 0;
+
+			while (bucket < LATENCYBUCKETS - 1 && latency >= l_LatencyBuckets[bucket])
+				bucket++;
+
+			queue.LatencyHistogram[bucket]++;
 		}
 
 #ifdef I2_DEBUG
@@ -203,6 +312,7 @@ bool ThreadPool::Post(const ThreadPool::WorkFunction& callback, SchedulerPolicy
 	wi.Timestamp = Utility::GetTime();
 
 	Queue& queue = m_Queues[Utility::Random() % (sizeof(m_Queues) / sizeof(m_Queues[0]))];
+	bool idle;
 
 	{
 		boost::mutex::scoped_lock lock(queue.Mutex);
@@ -211,12 +321,30 @@ bool ThreadPool::Post(const ThreadPool::WorkFunction& callback, SchedulerPolicy
 			return false;
 
 		if (policy == LowLatencyScheduler)
-			queue.SpawnWorker(m_ThreadGroup);
+			queue.SpawnWorker(*this, m_ThreadGroup);
+		else if (policy == ThrottledScheduler && queue.MaxItems > 0 && queue.Items.size() >= queue.MaxItems && !l_IsWorkerThread.get()) {
+			queue.ThrottledCount++;
+
+			while (queue.MaxItems > 0 && queue.Items.size() >= queue.MaxItems && !queue.Stopped) {
+				queue.FullWaiters++;
+				queue.CVFull.wait(lock);
+				queue.FullWaiters--;
+			}
+
+			if (queue.Stopped)
+				return false;
+		}
 
 		queue.Items.push_back(wi);
 		queue.CV.notify_one();
+
+		idle = (queue.IdleWorkers > 0);
 	}
 
+	/* All of the queue's workers are busy, let an idle worker steal the item. */
+	if (!idle)
+		WakeIdleWorker(queue);
+
 	return true;
 }
 
@@ -252,12 +380,12 @@ void ThreadPool::ManagerThreadProc(void)
 
 			boost::mutex::scoped_lock lock(queue.Mutex);
 
-			for (size_t i = 0; i < sizeof(queue.Threads) / sizeof(queue.Threads[0]); i++)
+			for (size_t i = 0; i < queue.Threads.size(); i++)
 				queue.Threads[i].UpdateUtilization();
 
 			pending = queue.Items.size();
 
-			for (size_t i = 0; i < sizeof(queue.Threads) / sizeof(queue.Threads[0]); i++) {
+			for (size_t i = 0; i < queue.Threads.size(); i++) {
 				if (queue.Threads[i].State != ThreadDead && !queue.Threads[i].Zombie) {
 					alive++;
 					utilization += queue.Threads[i].Utilization * 100;
@@ -288,8 +416,8 @@ void ThreadPool::ManagerThreadProc(void)
 				if (tthreads > 0 && pending > 0)
 					tthreads = 2;
 
-				if (m_MaxThreads != UINT_MAX && (alive + tthreads) * (sizeof(m_Queues) / sizeof(m_Queues[0])) > m_MaxThreads)
-					tthreads = m_MaxThreads / (sizeof(m_Queues) / sizeof(m_Queues[0])) - alive;
+				if (static_cast<int>(alive) + tthreads > static_cast<int>(queue.MaxThreads))
+					tthreads = static_cast<int>(queue.MaxThreads) - static_cast<int>(alive);
 
 				if (tthreads != 0) {
 					Log(LogNotice, "ThreadPool")
@@ -300,9 +428,13 @@ void ThreadPool::ManagerThreadProc(void)
 					queue.KillWorker(m_ThreadGroup);
 
 				for (int i = 0; i < tthreads; i++)
-					queue.SpawnWorker(m_ThreadGroup);
+					queue.SpawnWorker(*this, m_ThreadGroup);
 			}
 
+			queue.AvgLatency = avg_latency;
+			queue.Utilization = utilization;
+			queue.Alive = alive;
+
 			queue.WaitTime = 0;
 			queue.ServiceTime = 0;
 			queue.TaskCount = 0;
@@ -328,20 +460,154 @@ void ThreadPool::ManagerThreadProc(void)
 }
 
 /**
- * Note: Caller must hold m_Mutex
+ * Tries to take the oldest work item from one of the other queues.
+ * Queues which are currently locked are skipped rather than waited for.
+ *
+ * @param thief The queue which is looking for work.
+ * @param wi The stolen work item.
+ * @returns true if a work item was stolen, false otherwise.
+ */
+bool ThreadPool::StealWorkItem(const Queue& thief, WorkItem& wi)
+{
+	size_t count = sizeof(m_Queues) / sizeof(m_Queues[0]);
+	size_t offset = Utility::Random() % count;
+
+	for (size_t i = 0; i < count; i++) {
+		Queue& victim = m_Queues[(offset + i) % count];
+
+		if (&victim == &thief)
+			continue;
+
+		boost::mutex::scoped_try_lock lock(victim.Mutex);
+
+		if (!lock.owns_lock() || victim.Items.empty())
+			continue;
+
+		victim.PopItem(wi);
+
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * Wakes up an idle worker of one of the other queues so that it can steal
+ * a work item. Queues which are currently locked are skipped.
+ *
+ * @param busy The queue whose workers are busy.
+ */
+void ThreadPool::WakeIdleWorker(const Queue& busy)
+{
+	size_t count = sizeof(m_Queues) / sizeof(m_Queues[0]);
+	size_t offset = Utility::Random() % count;
+
+	for (size_t i = 0; i < count; i++) {
+		Queue& queue = m_Queues[(offset + i) % count];
+
+		if (&queue == &busy)
+			continue;
+
+		boost::mutex::scoped_try_lock lock(queue.Mutex);
+
+		if (!lock.owns_lock() || queue.IdleWorkers == 0)
+			continue;
+
+		queue.WorkPosted = true;
+		queue.CV.notify_one();
+
+		return;
+	}
+}
+
+void ThreadPool::GetStats(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
+{
+	size_t pending = 0, alive = 0, stolen = 0, throttled = 0;
+	double avg_latency = 0, utilization = 0;
+	size_t histogram[LATENCYBUCKETS] = { 0 };
+	Array::Ptr queue_pending = new Array();
+
+	for (size_t i = 0; i < sizeof(m_Queues) / sizeof(m_Queues[0]); i++) {
+		Queue& queue = m_Queues[i];
+
+		boost::mutex::scoped_lock lock(queue.Mutex);
+
+		queue_pending->Add(queue.Items.size());
+
+		pending += queue.Items.size();
+		alive += queue.Alive;
+		stolen += queue.StolenCount;
+		throttled += queue.ThrottledCount;
+		avg_latency += queue.AvgLatency;
+		utilization += queue.Utilization;
+
+		for (size_t k = 0; k < LATENCYBUCKETS; k++)
+			histogram[k] += queue.LatencyHistogram[k];
+	}
+
+	avg_latency /= sizeof(m_Queues) / sizeof(m_Queues[0]);
+	utilization /= sizeof(m_Queues) / sizeof(m_Queues[0]);
+
+	Dictionary::Ptr latency_histogram = new Dictionary();
+
+	for (size_t k = 0; k < LATENCYBUCKETS; k++)
+		latency_histogram->Set(l_LatencyBucketNames[k], histogram[k]);
+
+	status->Set("pending", pending);
+	status->Set("queue_pending", queue_pending);
+	status->Set("threads", alive);
+	status->Set("max_threads", m_MaxThreads == UINT_MAX ? Value(Empty) : Value(m_MaxThreads));
+	status->Set("max_pending", m_MaxPending);
+	status->Set("avg_latency", avg_latency);
+	status->Set("utilization", utilization);
+	status->Set("stolen", stolen);
+	status->Set("throttled", throttled);
+	status->Set("latency_histogram", latency_histogram);
+
+	perfdata->Add("'threadpool_pending'=" + Convert::ToString(pending));
+	perfdata->Add("'threadpool_threads'=" + Convert::ToString(alive));
+	perfdata->Add("'threadpool_avg_latency'=" + Convert::ToString(avg_latency) + "s");
+	perfdata->Add("'threadpool_utilization'=" + Convert::ToString(utilization) + "%");
+}
+
+/**
+ * Takes the oldest work item off the queue and wakes up a thread which
+ * is waiting for free space in the queue.
+ *
+ * Note: Caller must hold Mutex.
  */
-void ThreadPool::Queue::SpawnWorker(boost::thread_group& group)
+void ThreadPool::Queue::PopItem(WorkItem& wi)
 {
-	for (size_t i = 0; i < sizeof(Threads) / sizeof(Threads[0]); i++) {
-		if (Threads[i].State == ThreadDead) {
-			Log(LogDebug, "ThreadPool", "Spawning worker thread.");
+	wi = Items.front();
+	Items.pop_front();
+
+	if (FullWaiters > 0)
+		CVFull.notify_one();
+}
 
-			Threads[i] = WorkerThread(ThreadIdle);
-			Threads[i].Thread = group.create_thread(boost::bind(&ThreadPool::WorkerThread::ThreadProc, boost::ref(Threads[i]), boost::ref(*this)));
+/**
+ * Note: Caller must hold Mutex.
+ */
+void ThreadPool::Queue::SpawnWorker(ThreadPool& pool, boost::thread_group& group)
+{
+	size_t i;
 
+	for (i = 0; i < Threads.size(); i++) {
+		if (Threads[i].State == ThreadDead)
 			break;
-		}
 	}
+
+	if (i == Threads.size()) {
+		if (Threads.size() >= MaxThreads)
+			return;
+
+		Threads.push_back(WorkerThread());
+	}
+
+	Log(LogDebug, "ThreadPool", "Spawning worker thread.");
+
+	Threads[i] = WorkerThread(ThreadIdle);
+	Threads[i].Thread = group.create_thread(boost::bind(&ThreadPool::WorkerThread::ThreadProc, boost::ref(Threads[i]), boost::ref(pool), boost::ref(*this)));
 }
 
 /**
@@ -349,7 +615,7 @@ void ThreadPool::Queue::SpawnWorker(boost::thread_group& group)
  */
 void ThreadPool::Queue::KillWorker(boost::thread_group& group)
 {
-	for (size_t i = 0; i < sizeof(Threads) / sizeof(Threads[0]); i++) {
+	for (size_t i = 0; i < Threads.size(); i++) {
 		if (Threads[i].State == ThreadIdle && !Threads[i].Zombie) {
 			Log(LogDebug, "ThreadPool", "Killing worker thread.");
 
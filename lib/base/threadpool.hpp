@@ -21,21 +21,27 @@
 #define THREADPOOL_H
 
 #include "base/i2-base.hpp"
+#include "base/dictionary.hpp"
+#include "base/array.hpp"
 #include <boost/function.hpp>
 #include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
 #include <deque>
+#include <algorithm>
 
 namespace icinga
 {
 
 #define QUEUECOUNT 4U
+#define LATENCYBUCKETS 6U
 
 enum SchedulerPolicy
 {
 	DefaultScheduler,
-	LowLatencyScheduler
+	LowLatencyScheduler,
+	/* like DefaultScheduler, but Post() blocks while the queue is full */
+	ThrottledScheduler
 };
 
 /**
@@ -56,6 +62,14 @@ public:
 
 	bool Post(const WorkFunction& callback, SchedulerPolicy policy = DefaultScheduler);
 
+	void SetMaxThreads(size_t max_threads);
+	size_t GetMaxThreads(void) const;
+
+	void SetMaxPending(size_t max_pending);
+	size_t GetMaxPending(void) const;
+
+	void GetStats(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
+
 private:
 	enum ThreadState
 	{
@@ -87,7 +101,7 @@ private:
 
 		void UpdateUtilization(ThreadState state = ThreadUnspecified);
 
-		void ThreadProc(Queue& queue);
+		void ThreadProc(ThreadPool& pool, Queue& queue);
 	};
 
 	struct Queue
@@ -95,6 +109,7 @@ private:
 		boost::mutex Mutex;
 		boost::condition_variable CV;
 		boost::condition_variable CVStarved;
+		boost::condition_variable CVFull;
 
 		std::deque<WorkItem> Items;
 
@@ -102,15 +117,35 @@ private:
 		double ServiceTime;
 		int TaskCount;
 
+		double AvgLatency;
+		double Utilization;
+		size_t Alive;
+		size_t StolenCount;
+		size_t ThrottledCount;
+		size_t FullWaiters;
+		size_t IdleWorkers;
+		bool WorkPosted;
+		size_t LatencyHistogram[LATENCYBUCKETS];
+
+		size_t MaxThreads;
+		size_t MaxItems;
+
 		bool Stopped;
 
-		WorkerThread Threads[16];
+		/* std::deque doesn't invalidate references to its elements on push_back(). */
+		std::deque<WorkerThread> Threads;
 
 		Queue(void)
-			: WaitTime(0), ServiceTime(0), TaskCount(0), Stopped(false)
-		{ }
+			: WaitTime(0), ServiceTime(0), TaskCount(0), AvgLatency(0), Utilization(0),
+			  Alive(0), StolenCount(0), ThrottledCount(0), FullWaiters(0), IdleWorkers(0),
+			  WorkPosted(false), MaxThreads(16), MaxItems(0), Stopped(false)
+		{
+			std::fill(LatencyHistogram, LatencyHistogram + LATENCYBUCKETS, 0);
+		}
 
-		void SpawnWorker(boost::thread_group& group);
+		void PopItem(WorkItem& wi);
+
+		void SpawnWorker(ThreadPool& pool, boost::thread_group& group);
 		void KillWorker(boost::thread_group& group);
 	};
 
@@ -118,6 +153,7 @@ private:
 	static int m_NextID;
 
 	size_t m_MaxThreads;
+	size_t m_MaxPending;
 
 	boost::thread_group m_ThreadGroup;
 
@@ -129,6 +165,9 @@ private:
 	Queue m_Queues[QUEUECOUNT];
 
 	void ManagerThreadProc(void);
+
+	bool StealWorkItem(const Queue& thief, WorkItem& wi);
+	void WakeIdleWorker(const Queue& busy);
 };
 
 }
@@ -20,30 +20,20 @@
 #include "base/timer.hpp"
 #include "base/debug.hpp"
 #include "base/utility.hpp"
+#include "base/timingwheel.hpp"
 #include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 #include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
-#include <boost/multi_index_container.hpp>
-#include <boost/multi_index/ordered_index.hpp>
-#include <boost/multi_index/key_extractors.hpp>
 
 using namespace icinga;
 
-typedef boost::multi_index_container<
-	Timer::Holder,
-	boost::multi_index::indexed_by<
-		boost::multi_index::ordered_unique<boost::multi_index::const_mem_fun<Timer::Holder, Timer *, &Timer::Holder::GetObject> >,
-		boost::multi_index::ordered_non_unique<boost::multi_index::const_mem_fun<Timer::Holder, double, &Timer::Holder::GetNextUnlocked> >
-	>
-> TimerSet;
-
 static boost::mutex l_TimerMutex;
 static boost::condition_variable l_TimerCV;
 static boost::thread l_TimerThread;
 static bool l_StopTimerThread;
-static TimerSet l_Timers;
+static TimingWheel<Timer *> l_Timers;
 
 /**
  * Constructor for the Timer class.
@@ -157,7 +147,7 @@ void Timer::Stop(bool wait)
 	boost::mutex::scoped_lock lock(l_TimerMutex);
 
 	m_Started = false;
-	l_Timers.erase(this);
+	l_Timers.Remove(this);
 
 	/* Notify the worker thread that we've disabled a timer. */
 	l_TimerCV.notify_all();
@@ -198,9 +188,8 @@ void Timer::InternalReschedule(bool completed, double next)
 	m_Next = next;
 
 	if (m_Started && !m_Running) {
-		/* Remove and re-add the timer to update the index. */
-		l_Timers.erase(this);
-		l_Timers.insert(this);
+		/* Add the timer or move it to its new slot. */
+		l_Timers.Insert(this, m_Next);
 
 		/* Notify the worker that we've rescheduled a timer. */
 		l_TimerCV.notify_all();
@@ -232,24 +221,17 @@ void Timer::AdjustTimers(double adjustment)
 
 	double now = Utility::GetTime();
 
-	typedef boost::multi_index::nth_index<TimerSet, 1>::type TimerView;
-	TimerView& idx = boost::get<1>(l_Timers);
-
 	std::vector<Timer *> timers;
+	l_Timers.GetItems(timers);
 
-	BOOST_FOREACH(Timer *timer, idx) {
+	BOOST_FOREACH(Timer *timer, timers) {
 		if (std::fabs(now - (timer->m_Next + adjustment)) <
 		    std::fabs(now - timer->m_Next)) {
 			timer->m_Next += adjustment;
-			timers.push_back(timer);
+			l_Timers.Insert(timer, timer->m_Next);
 		}
 	}
 
-	BOOST_FOREACH(Timer *timer, timers) {
-		l_Timers.erase(timer);
-		l_Timers.insert(timer);
-	}
-
 	/* Notify the worker that we've rescheduled some timers. */
 	l_TimerCV.notify_all();
 }
@@ -264,34 +246,30 @@ void Timer::TimerThreadProc(void)
 	for (;;) {
 		boost::mutex::scoped_lock lock(l_TimerMutex);
 
-		typedef boost::multi_index::nth_index<TimerSet, 1>::type NextTimerView;
-		NextTimerView& idx = boost::get<1>(l_Timers);
-
 		/* Wait until there is at least one timer. */
-		while (idx.empty() && !l_StopTimerThread)
+		while (l_Timers.IsEmpty() && !l_StopTimerThread)
 			l_TimerCV.wait(lock);
 
 		if (l_StopTimerThread)
 			break;
 
-		NextTimerView::iterator it = idx.begin();
-		Timer *timer = *it;
+		double now = Utility::GetTime();
+		Timer *timer;
 
-		double wait = timer->m_Next - Utility::GetTime();
+		/* Timers which are due within the next 10 milliseconds are called
+		 * right away. Popping the timer removes it from the list so it
+		 * doesn't get called again until the current call is completed. */
+		if (!l_Timers.Pop(now + 0.01, timer)) {
+			double wait = l_Timers.GetNextDeadline() - now;
 
-		if (wait > 0.01) {
 			/* Wait for the next timer. */
-			l_TimerCV.timed_wait(lock, boost::posix_time::milliseconds(wait * 1000));
+			l_TimerCV.timed_wait(lock, boost::posix_time::milliseconds(long(wait * 1000)));
 
 			continue;
 		}
 
 		Timer::Ptr ptimer = timer;
 
-		/* Remove the timer from the list so it doesn't get called again
-		 * until the current call is completed. */
-		l_Timers.erase(timer);
-
 		timer->m_Running = true;
 
 		lock.unlock();
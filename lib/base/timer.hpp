@@ -52,31 +52,6 @@ public:
 
 	boost::signals2::signal<void(const Timer::Ptr&)> OnTimerExpired;
 
-	class Holder {
-	public:
-		Holder(Timer *timer)
-			: m_Timer(timer)
-		{ }
-
-		inline Timer *GetObject(void) const
-		{
-			return m_Timer;
-		}
-
-		inline double GetNextUnlocked(void) const
-		{
-			return m_Timer->m_Next;
-		}
-
-		operator Timer *(void) const
-		{
-			return m_Timer;
-		}
-
-	private:
-		Timer *m_Timer;
-	};
-
 private:
 	double m_Interval; /**< The interval of the timer. */
 	double m_Next; /**< When the next event should happen. */
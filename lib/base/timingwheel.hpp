@@ -0,0 +1,459 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef TIMINGWHEEL_H
+#define TIMINGWHEEL_H
+
+#include "base/i2-base.hpp"
+#include "base/utility.hpp"
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/get_pointer.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+namespace icinga
+{
+
+/**
+ * Hashes smart and raw pointers by the address of the object they refer to.
+ *
+ * @ingroup base
+ */
+struct TimingWheelPointerHash
+{
+	template<typename T>
+	size_t operator()(const T& item) const
+	{
+		using boost::get_pointer;
+		return boost::hash<const void *>()(get_pointer(item));
+	}
+};
+
+/**
+ * A hierarchical timing wheel which keeps items ordered by their deadline.
+ *
+ * Time is divided into ticks of a fixed resolution. Each of the eight levels
+ * has 256 slots and covers 256 times the range of the level below it. An item
+ * is stored in the level which corresponds to the most significant byte in
+ * which its tick differs from the wheel's current tick. Inserting, removing
+ * and rescheduling an item are therefore constant-time operations. Items are
+ * moved to lower levels when the wheel's current tick reaches their slot.
+ * Items which are due are returned in deadline order; items with the same
+ * deadline are returned in the order they were inserted.
+ *
+ * The wheel is not thread-safe; callers are expected to hold their own lock.
+ *
+ * @ingroup base
+ */
+template<typename T, typename Hash = TimingWheelPointerHash>
+class TimingWheel : private boost::noncopyable
+{
+public:
+	typedef size_t SizeType;
+
+	TimingWheel(double resolution = 0.01)
+		: m_Resolution(resolution), m_NextSeq(0)
+	{
+		Clear();
+	}
+
+	/**
+	 * Adds an item to the wheel or reschedules it if it is already
+	 * part of the wheel.
+	 *
+	 * @param item The item.
+	 * @param when The time when the item is due.
+	 */
+	void Insert(const T& item, double when)
+	{
+		std::pair<typename NodeMap::iterator, bool> res = m_Nodes.insert(std::make_pair(item, Node()));
+		Node& node = res.first->second;
+
+		if (!res.second)
+			Unlink(&node);
+
+		node.Item = item;
+		node.When = when;
+		node.Seq = m_NextSeq++;
+
+		Link(&node);
+	}
+
+	/**
+	 * Removes an item from the wheel.
+	 *
+	 * @param item The item.
+	 * @returns true if the item was removed, false if it wasn't part of the wheel.
+	 */
+	bool Remove(const T& item)
+	{
+		typename NodeMap::iterator it = m_Nodes.find(item);
+
+		if (it == m_Nodes.end())
+			return false;
+
+		Unlink(&it->second);
+		m_Nodes.erase(it);
+
+		return true;
+	}
+
+	bool Contains(const T& item) const
+	{
+		return m_Nodes.find(item) != m_Nodes.end();
+	}
+
+	SizeType GetLength(void) const
+	{
+		return m_Nodes.size();
+	}
+
+	bool IsEmpty(void) const
+	{
+		return m_Nodes.empty();
+	}
+
+	void Clear(void)
+	{
+		m_Nodes.clear();
+
+		for (int level = 0; level < Levels; level++) {
+			for (int slot = 0; slot < Slots; slot++)
+				m_Slots[level][slot] = NULL;
+
+			for (int word = 0; word < BitmapWords; word++)
+				m_Bitmaps[level][word] = 0;
+		}
+
+		m_Expired = NULL;
+		m_Now = GetTick(Utility::GetTime());
+	}
+
+	/**
+	 * Returns all items which are currently part of the wheel.
+	 *
+	 * @param items Receives the items, in no particular order.
+	 */
+	void GetItems(std::vector<T>& items) const
+	{
+		items.reserve(items.size() + m_Nodes.size());
+
+		for (typename NodeMap::const_iterator it = m_Nodes.begin(); it != m_Nodes.end(); it++)
+			items.push_back(it->first);
+	}
+
+	/**
+	 * Returns the time at which the next item might become due. This is
+	 * exact for items which are due within the next 256 ticks and a lower
+	 * bound for all other items.
+	 *
+	 * @returns The timestamp or 0 if an item is already due.
+	 */
+	double GetNextDeadline(void) const
+	{
+		if (m_Expired)
+			return 0;
+
+		for (int level = 0; level < Levels; level++) {
+			int slot = FindSlot(level, SlotIndex(m_Now, level));
+
+			if (slot == -1)
+				continue;
+
+			if (level == 0) {
+				double when = m_Slots[0][slot]->When;
+
+				for (Node *node = m_Slots[0][slot]->Next; node; node = node->Next) {
+					if (node->When < when)
+						when = node->When;
+				}
+
+				return when;
+			}
+
+			boost::uint64_t mask = (static_cast<boost::uint64_t>(Slots) << (level * 8)) - 1;
+			boost::uint64_t tick = (m_Now & ~mask) | (static_cast<boost::uint64_t>(slot) << (level * 8));
+
+			return tick * m_Resolution;
+		}
+
+		return 0;
+	}
+
+	/**
+	 * Removes an item which is due at the specified time.
+	 *
+	 * @param now The current time.
+	 * @param item Receives the item.
+	 * @returns true if an item was due, false otherwise.
+	 */
+	bool Pop(double now, T& item)
+	{
+		if (m_Nodes.empty())
+			return false;
+
+		Advance(now);
+
+		/* The list of expired items is sorted, items in the current slot are not. */
+		Node *node = m_Expired;
+
+		for (Node *current = m_Slots[0][SlotIndex(m_Now, 0)]; current; current = current->Next) {
+			if (current->When <= now && (!node || NodeLess(current, node)))
+				node = current;
+		}
+
+		if (!node)
+			return false;
+
+		item = node->Item;
+		Remove(item);
+
+		return true;
+	}
+
+private:
+	enum {
+		Levels = 8,
+		Slots = 256,
+		BitmapWords = Slots / 64
+	};
+
+	struct Node
+	{
+		T Item;
+		double When;
+		boost::uint64_t Seq;
+		boost::uint64_t Tick;
+		int Level;
+		int Slot;
+		Node *Prev;
+		Node *Next;
+	};
+
+	typedef boost::unordered_map<T, Node, Hash> NodeMap;
+
+	double m_Resolution;
+	boost::uint64_t m_Now;
+	NodeMap m_Nodes;
+	Node *m_Slots[Levels][Slots];
+	boost::uint64_t m_Bitmaps[Levels][BitmapWords];
+	Node *m_Expired;
+	boost::uint64_t m_NextSeq;
+
+	static bool NodeLess(const Node *a, const Node *b)
+	{
+		if (a->When != b->When)
+			return a->When < b->When;
+
+		return a->Seq < b->Seq;
+	}
+
+	static int SlotIndex(boost::uint64_t tick, int level)
+	{
+		return (tick >> (level * 8)) & (Slots - 1);
+	}
+
+	boost::uint64_t GetTick(double when) const
+	{
+		if (when <= 0)
+			return 0;
+
+		return static_cast<boost::uint64_t>(std::floor(when / m_Resolution));
+	}
+
+	/**
+	 * Finds the first non-empty slot at or after the specified slot.
+	 */
+	int FindSlot(int level, int start) const
+	{
+		for (int word = start / 64; word < BitmapWords; word++) {
+			boost::uint64_t bits = m_Bitmaps[level][word];
+
+			if (word == start / 64)
+				bits &= ~static_cast<boost::uint64_t>(0) << (start % 64);
+
+			if (bits == 0)
+				continue;
+
+			int bit = 0;
+
+			while (!(bits & (static_cast<boost::uint64_t>(1) << bit)))
+				bit++;
+
+			return word * 64 + bit;
+		}
+
+		return -1;
+	}
+
+	void Link(Node *node)
+	{
+		node->Tick = GetTick(node->When);
+
+		if (node->Tick < m_Now)
+			node->Tick = m_Now;
+
+		boost::uint64_t diff = node->Tick ^ m_Now;
+		int level = 0;
+
+		while (diff >= Slots) {
+			diff >>= 8;
+			level++;
+		}
+
+		node->Level = level;
+		node->Slot = SlotIndex(node->Tick, level);
+
+		PushFront(&m_Slots[level][node->Slot], node);
+		m_Bitmaps[level][node->Slot / 64] |= static_cast<boost::uint64_t>(1) << (node->Slot % 64);
+	}
+
+	void Unlink(Node *node)
+	{
+		if (node->Prev)
+			node->Prev->Next = node->Next;
+		else if (node->Level == -1)
+			m_Expired = node->Next;
+		else
+			m_Slots[node->Level][node->Slot] = node->Next;
+
+		if (node->Next)
+			node->Next->Prev = node->Prev;
+
+		if (node->Level != -1 && !m_Slots[node->Level][node->Slot])
+			m_Bitmaps[node->Level][node->Slot / 64] &= ~(static_cast<boost::uint64_t>(1) << (node->Slot % 64));
+	}
+
+	static void PushFront(Node **head, Node *node)
+	{
+		node->Prev = NULL;
+		node->Next = *head;
+
+		if (*head)
+			(*head)->Prev = node;
+
+		*head = node;
+	}
+
+	/**
+	 * Removes all nodes from a slot and adds them to a temporary list so
+	 * they can either be expired or re-linked later on.
+	 */
+	void DrainSlot(int level, int slot, std::vector<Node *>& nodes)
+	{
+		Node *node = m_Slots[level][slot];
+
+		m_Slots[level][slot] = NULL;
+		m_Bitmaps[level][slot / 64] &= ~(static_cast<boost::uint64_t>(1) << (slot % 64));
+
+		while (node) {
+			nodes.push_back(node);
+			node = node->Next;
+		}
+	}
+
+	/**
+	 * Merges nodes into the sorted list of expired nodes.
+	 */
+	void Expire(std::vector<Node *>& nodes)
+	{
+		std::sort(nodes.begin(), nodes.end(), &TimingWheel::NodeLess);
+
+		Node *prev = NULL;
+		Node *next = m_Expired;
+
+		for (typename std::vector<Node *>::iterator it = nodes.begin(); it != nodes.end(); it++) {
+			Node *node = *it;
+
+			while (next && !NodeLess(node, next)) {
+				prev = next;
+				next = next->Next;
+			}
+
+			node->Level = -1;
+			node->Prev = prev;
+			node->Next = next;
+
+			if (prev)
+				prev->Next = node;
+			else
+				m_Expired = node;
+
+			if (next)
+				next->Prev = node;
+
+			prev = node;
+		}
+	}
+
+	/**
+	 * Advances the wheel's current tick. Items whose tick is before the new
+	 * tick are moved to the list of expired items, items from the slot
+	 * which contains the new tick are moved to lower levels.
+	 */
+	void Advance(double now)
+	{
+		boost::uint64_t target = GetTick(now);
+
+		if (target <= m_Now)
+			return;
+
+		boost::uint64_t diff = target ^ m_Now;
+		int top = 0;
+
+		while (diff >= Slots) {
+			diff >>= 8;
+			top++;
+		}
+
+		std::vector<Node *> expired, cascade;
+
+		for (int level = 0; level <= top; level++) {
+			int first = SlotIndex(m_Now, level);
+			int last = (level == top) ? SlotIndex(target, level) : Slots;
+
+			/* Items in the current slot of higher levels are not due before
+			 * the wheel moves past their slot. */
+			if (level > 0)
+				first++;
+
+			for (int slot = FindSlot(level, first); slot != -1 && slot < last; slot = FindSlot(level, slot + 1))
+				DrainSlot(level, slot, expired);
+
+			if (level == top && level > 0 && m_Slots[level][last])
+				DrainSlot(level, last, cascade);
+		}
+
+		m_Now = target;
+
+		if (!expired.empty())
+			Expire(expired);
+
+		for (typename std::vector<Node *>::iterator it = cascade.begin(); it != cascade.end(); it++)
+			Link(*it);
+	}
+};
+
+}
+
+#endif /* TIMINGWHEEL_H */
@@ -128,6 +128,7 @@ void TlsStream::OnEvent(int revents)
 {
 	int rc, err;
 	size_t count;
+	bool drained = false;
 
 	boost::mutex::scoped_lock lock(m_Mutex);
 
@@ -164,8 +165,10 @@ void TlsStream::OnEvent(int revents)
 
 			rc = SSL_write(m_SSL.get(), buffer, count);
 
-			if (rc > 0)
+			if (rc > 0) {
 				m_SendQ->Read(NULL, rc, true);
+				drained = (m_SendQ->GetAvailableBytes() == 0);
+			}
 
 			break;
 		case TlsActionHandshake:
@@ -196,6 +199,9 @@ void TlsStream::OnEvent(int revents)
 		while (m_RecvQ->IsDataAvailable() && IsHandlingEvents())
 			SignalDataAvailable();
 
+		if (drained)
+			OnWritable();
+
 		if (m_Shutdown && !m_SendQ->IsDataAvailable())
 			Close();
 
@@ -246,6 +252,13 @@ void TlsStream::OnEvent(int revents)
 
 			break;
 	}
+
+	/* writers need to stop using the stream */
+	if (m_Eof) {
+		lock.unlock();
+
+		OnWritable();
+	}
 }
 
 void TlsStream::HandleError(void) const
@@ -308,6 +321,29 @@ void TlsStream::Write(const void *buffer, size_t count)
 	ChangeEvents(POLLIN|POLLOUT);
 }
 
+/**
+ * Returns the number of bytes which have been written to the stream
+ * but not yet sent to the peer.
+ */
+size_t TlsStream::GetSendQueueSize(void) const
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	return m_SendQ->GetAvailableBytes();
+}
+
+/**
+ * Registers a handler which is called whenever all queued data has been
+ * sent to the peer and when the peer closes the connection.
+ *
+ * @returns The connection which the caller has to disconnect once it no
+ *          longer uses the stream.
+ */
+boost::signals2::connection TlsStream::RegisterWritableHandler(const boost::function<void (void)>& handler)
+{
+	return OnWritable.connect(handler);
+}
+
 void TlsStream::Shutdown(void)
 {
 	m_Shutdown = true;
@@ -70,6 +70,9 @@ public:
 
 	bool IsVerifyOK(void) const;
 
+	size_t GetSendQueueSize(void) const;
+	boost::signals2::connection RegisterWritableHandler(const boost::function<void (void)>& handler);
+
 private:
 	boost::shared_ptr<SSL> m_SSL;
 	bool m_Eof;
@@ -90,6 +93,8 @@ private:
 	bool m_Retry;
 	bool m_Shutdown;
 
+	boost::signals2::signal<void (void)> OnWritable;
+
 	static int m_SSLIndex;
 	static bool m_SSLIndexInitialized;
 
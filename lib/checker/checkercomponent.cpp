@@ -43,16 +43,46 @@ void CheckerComponent::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr
 	Dictionary::Ptr nodes = new Dictionary();
 
 	BOOST_FOREACH(const CheckerComponent::Ptr& checker, ConfigType::GetObjectsByType<CheckerComponent>()) {
-		unsigned long idle = checker->GetIdleCheckables();
-		unsigned long pending = checker->GetPendingCheckables();
+		unsigned long idle = 0;
+		unsigned long pending = 0;
+
+		String perfdata_prefix = "checkercomponent_" + checker->GetName() + "_";
+
+		Array::Ptr shards = new Array();
+
+		for (std::vector<boost::shared_ptr<CheckerShard> >::size_type i = 0; i < checker->m_Shards.size(); i++) {
+			CheckerShard& shard = *checker->m_Shards[i];
+
+			unsigned long shard_idle, shard_pending;
+
+			{
+				boost::mutex::scoped_lock lock(shard.Mutex);
+				shard_idle = shard.IdleCheckables.GetLength();
+				shard_pending = shard.PendingCheckables.size();
+			}
+
+			idle += shard_idle;
+			pending += shard_pending;
+
+			Dictionary::Ptr shard_stats = new Dictionary();
+			shard_stats->Set("idle", shard_idle);
+			shard_stats->Set("pending", shard_pending);
+			shards->Add(shard_stats);
+
+			if (checker->m_Shards.size() > 1) {
+				String shard_prefix = perfdata_prefix + "shard" + Convert::ToString(i) + "_";
+				perfdata->Add(new PerfdataValue(shard_prefix + "idle", Convert::ToDouble(shard_idle)));
+				perfdata->Add(new PerfdataValue(shard_prefix + "pending", Convert::ToDouble(shard_pending)));
+			}
+		}
 
 		Dictionary::Ptr stats = new Dictionary();
 		stats->Set("idle", idle);
 		stats->Set("pending", pending);
+		stats->Set("shards", shards);
 
 		nodes->Set(checker->GetName(), stats);
 
-		String perfdata_prefix = "checkercomponent_" + checker->GetName() + "_";
 		perfdata->Add(new PerfdataValue(perfdata_prefix + "idle", Convert::ToDouble(idle)));
 		perfdata->Add(new PerfdataValue(perfdata_prefix + "pending", Convert::ToDouble(pending)));
 	}
@@ -61,22 +91,33 @@ void CheckerComponent::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr
 }
 
 CheckerComponent::CheckerComponent(void)
-    : m_Stopped(false)
 { }
 
 void CheckerComponent::OnConfigLoaded(void)
 {
+	for (int i = 0; i < GetSchedulerThreads(); i++)
+		m_Shards.push_back(boost::make_shared<CheckerShard>());
+
 	ConfigObject::OnActiveChanged.connect(bind(&CheckerComponent::ObjectHandler, this, _1));
 	ConfigObject::OnPausedChanged.connect(bind(&CheckerComponent::ObjectHandler, this, _1));
 
 	Checkable::OnNextCheckChanged.connect(bind(&CheckerComponent::NextCheckChangedHandler, this, _1));
 }
 
+void CheckerComponent::ValidateSchedulerThreads(int value, const ValidationUtils& utils)
+{
+	ObjectImpl<CheckerComponent>::ValidateSchedulerThreads(value, utils);
+
+	if (value < 1)
+		BOOST_THROW_EXCEPTION(ValidationError(this, boost::assign::list_of("scheduler_threads"), "At least one scheduler thread is required."));
+}
+
 void CheckerComponent::Start(void)
 {
 	ObjectImpl<CheckerComponent>::Start();
 
-	m_Thread = boost::thread(boost::bind(&CheckerComponent::CheckThreadProc, this));
+	for (std::vector<boost::shared_ptr<CheckerShard> >::size_type i = 0; i < m_Shards.size(); i++)
+		m_Shards[i]->Thread = boost::thread(boost::bind(&CheckerComponent::CheckThreadProc, this, i));
 
 	m_ResultTimer = new Timer();
 	m_ResultTimer->SetInterval(5);
@@ -88,48 +129,64 @@ void CheckerComponent::Stop(void)
 {
 	Log(LogInformation, "CheckerComponent", "Checker stopped.");
 
-	{
-		boost::mutex::scoped_lock lock(m_Mutex);
-		m_Stopped = true;
-		m_CV.notify_all();
+	BOOST_FOREACH(const boost::shared_ptr<CheckerShard>& shard, m_Shards) {
+		boost::mutex::scoped_lock lock(shard->Mutex);
+		shard->Stopped = true;
+		shard->CV.notify_all();
 	}
 
 	m_ResultTimer->Stop();
-	m_Thread.join();
+
+	BOOST_FOREACH(const boost::shared_ptr<CheckerShard>& shard, m_Shards) {
+		shard->Thread.join();
+	}
 
 	ObjectImpl<CheckerComponent>::Stop();
 }
 
-void CheckerComponent::CheckThreadProc(void)
+/**
+ * Returns the scheduler shard which is responsible for the specified checkable.
+ *
+ * @threadsafety Always.
+ */
+CheckerComponent::CheckerShard& CheckerComponent::GetShard(const Checkable::Ptr& checkable) const
 {
-	Utility::SetThreadName("Check Scheduler");
+	if (m_Shards.size() == 1)
+		return *m_Shards[0];
 
-	boost::mutex::scoped_lock lock(m_Mutex);
+	return *m_Shards[Utility::SDBM(checkable->GetName()) % m_Shards.size()];
+}
 
-	for (;;) {
-		typedef boost::multi_index::nth_index<CheckableSet, 1>::type CheckTimeView;
-		CheckTimeView& idx = boost::get<1>(m_IdleCheckables);
+void CheckerComponent::CheckThreadProc(int sid)
+{
+	if (m_Shards.size() > 1)
+		Utility::SetThreadName("Check Scheduler #" + Convert::ToString(sid));
+	else
+		Utility::SetThreadName("Check Scheduler");
 
-		while (idx.begin() == idx.end() && !m_Stopped)
-			m_CV.wait(lock);
+	CheckerShard& shard = *m_Shards[sid];
 
-		if (m_Stopped)
+	boost::mutex::scoped_lock lock(shard.Mutex);
+
+	for (;;) {
+		while (shard.IdleCheckables.IsEmpty() && !shard.Stopped)
+			shard.CV.wait(lock);
+
+		if (shard.Stopped)
 			break;
 
-		CheckTimeView::iterator it = idx.begin();
-		Checkable::Ptr checkable = *it;
+		double now = Utility::GetTime();
+		Checkable::Ptr checkable;
 
-		double wait = checkable->GetNextCheck() - Utility::GetTime();
+		if (!shard.IdleCheckables.Pop(now, checkable)) {
+			double wait = shard.IdleCheckables.GetNextDeadline() - now;
 
-		if (wait > 0) {
 			/* Wait for the next check. */
-			m_CV.timed_wait(lock, boost::posix_time::milliseconds(wait * 1000));
+			shard.CV.timed_wait(lock, boost::posix_time::milliseconds(long(wait * 1000) + 1));
 
 			continue;
 		}
 
-		m_IdleCheckables.erase(checkable);
-
 		bool forced = checkable->GetForceNextCheck();
 		bool check = true;
 
@@ -166,7 +223,7 @@ void CheckerComponent::CheckThreadProc(void)
 
 		/* reschedule the checkable if checks are disabled */
 		if (!check) {
-			m_IdleCheckables.insert(checkable);
+			shard.IdleCheckables.Insert(checkable, checkable->GetNextCheck());
 			lock.unlock();
 
 			checkable->UpdateNextCheck();
@@ -176,7 +233,7 @@ void CheckerComponent::CheckThreadProc(void)
 			continue;
 		}
 
-		m_PendingCheckables.insert(checkable);
+		shard.PendingCheckables.insert(checkable);
 
 		lock.unlock();
 
@@ -188,7 +245,9 @@ void CheckerComponent::CheckThreadProc(void)
 		Log(LogDebug, "CheckerComponent")
 		    << "Executing check for '" << checkable->GetName() << "'";
 
-		Utility::QueueAsyncCallback(boost::bind(&CheckerComponent::ExecuteCheckHelper, CheckerComponent::Ptr(this), checkable));
+		/* the scheduler thread doesn't hold any locks here, it's safe to
+		 * block it while the thread pool is full */
+		Utility::QueueAsyncCallback(boost::bind(&CheckerComponent::ExecuteCheckHelper, CheckerComponent::Ptr(this), checkable), ThrottledScheduler);
 
 		lock.lock();
 	}
@@ -217,20 +276,22 @@ void CheckerComponent::ExecuteCheckHelper(const Checkable::Ptr& checkable)
 	}
 
 	{
-		boost::mutex::scoped_lock lock(m_Mutex);
+		CheckerShard& shard = GetShard(checkable);
+
+		boost::mutex::scoped_lock lock(shard.Mutex);
 
 		/* remove the object from the list of pending objects; if it's not in the
 		 * list this was a manual (i.e. forced) check and we must not re-add the
 		 * object to the list because it's already there. */
 		CheckerComponent::CheckableSet::iterator it;
-		it = m_PendingCheckables.find(checkable);
-		if (it != m_PendingCheckables.end()) {
-			m_PendingCheckables.erase(it);
+		it = shard.PendingCheckables.find(checkable);
+		if (it != shard.PendingCheckables.end()) {
+			shard.PendingCheckables.erase(it);
 
 			if (checkable->IsActive())
-				m_IdleCheckables.insert(checkable);
+				shard.IdleCheckables.Insert(checkable, checkable->GetNextCheck());
 
-			m_CV.notify_all();
+			shard.CV.notify_all();
 		}
 	}
 
@@ -242,12 +303,8 @@ void CheckerComponent::ResultTimerHandler(void)
 {
 	std::ostringstream msgbuf;
 
-	{
-		boost::mutex::scoped_lock lock(m_Mutex);
-
-		msgbuf << "Pending checkables: " << m_PendingCheckables.size() << "; Idle checkables: " << m_IdleCheckables.size() << "; Checks/s: "
-		    << (CIB::GetActiveHostChecksStatistics(5) + CIB::GetActiveServiceChecksStatistics(5)) / 5.0;
-	}
+	msgbuf << "Pending checkables: " << GetPendingCheckables() << "; Idle checkables: " << GetIdleCheckables() << "; Checks/s: "
+	    << (CIB::GetActiveHostChecksStatistics(5) + CIB::GetActiveServiceChecksStatistics(5)) / 5.0;
 
 	Log(LogNotice, "CheckerComponent", msgbuf.str());
 }
@@ -263,49 +320,58 @@ void CheckerComponent::ObjectHandler(const ConfigObject::Ptr& object)
 	bool same_zone = (!zone || Zone::GetLocalZone() == zone);
 
 	{
-		boost::mutex::scoped_lock lock(m_Mutex);
+		CheckerShard& shard = GetShard(checkable);
+
+		boost::mutex::scoped_lock lock(shard.Mutex);
 
 		if (object->IsActive() && !object->IsPaused() && same_zone) {
-			if (m_PendingCheckables.find(checkable) != m_PendingCheckables.end())
+			if (shard.PendingCheckables.find(checkable) != shard.PendingCheckables.end())
 				return;
 
-			m_IdleCheckables.insert(checkable);
+			shard.IdleCheckables.Insert(checkable, checkable->GetNextCheck());
 		} else {
-			m_IdleCheckables.erase(checkable);
-			m_PendingCheckables.erase(checkable);
+			shard.IdleCheckables.Remove(checkable);
+			shard.PendingCheckables.erase(checkable);
 		}
 
-		m_CV.notify_all();
+		shard.CV.notify_all();
 	}
 }
 
 void CheckerComponent::NextCheckChangedHandler(const Checkable::Ptr& checkable)
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
+	CheckerShard& shard = GetShard(checkable);
 
-	/* remove and re-insert the object from the set in order to force an index update */
-	typedef boost::multi_index::nth_index<CheckableSet, 0>::type CheckableView;
-	CheckableView& idx = boost::get<0>(m_IdleCheckables);
+	boost::mutex::scoped_lock lock(shard.Mutex);
 
-	CheckableView::iterator it = idx.find(checkable);
-	if (it == idx.end())
+	if (!shard.IdleCheckables.Contains(checkable))
 		return;
 
-	idx.erase(checkable);
-	idx.insert(checkable);
-	m_CV.notify_all();
+	/* move the object to the slot for its new check time */
+	shard.IdleCheckables.Insert(checkable, checkable->GetNextCheck());
+	shard.CV.notify_all();
 }
 
 unsigned long CheckerComponent::GetIdleCheckables(void)
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
+	unsigned long count = 0;
 
-	return m_IdleCheckables.size();
+	BOOST_FOREACH(const boost::shared_ptr<CheckerShard>& shard, m_Shards) {
+		boost::mutex::scoped_lock lock(shard->Mutex);
+		count += shard->IdleCheckables.GetLength();
+	}
+
+	return count;
 }
 
 unsigned long CheckerComponent::GetPendingCheckables(void)
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
+	unsigned long count = 0;
+
+	BOOST_FOREACH(const boost::shared_ptr<CheckerShard>& shard, m_Shards) {
+		boost::mutex::scoped_lock lock(shard->Mutex);
+		count += shard->PendingCheckables.size();
+	}
 
-	return m_PendingCheckables.size();
+	return count;
 }
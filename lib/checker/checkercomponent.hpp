@@ -25,32 +25,16 @@
 #include "base/configobject.hpp"
 #include "base/timer.hpp"
 #include "base/utility.hpp"
+#include "base/timingwheel.hpp"
 #include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
-#include <boost/multi_index_container.hpp>
-#include <boost/multi_index/ordered_index.hpp>
-#include <boost/multi_index/key_extractors.hpp>
+#include <boost/smart_ptr/make_shared.hpp>
+#include <set>
 
 namespace icinga
 {
 
-/**
- * @ingroup checker
- */
-struct CheckableNextCheckExtractor
-{
-	typedef double result_type;
-
-	/**
-	 * @threadsafety Always.
-	 */
-	double operator()(const Checkable::Ptr& checkable)
-	{
-		return checkable->GetNextCheck();
-	}
-};
-
 /**
  * @ingroup checker
  */
@@ -60,13 +44,8 @@ public:
 	DECLARE_OBJECT(CheckerComponent);
 	DECLARE_OBJECTNAME(CheckerComponent);
 
-	typedef boost::multi_index_container<
-		Checkable::Ptr,
-		boost::multi_index::indexed_by<
-			boost::multi_index::ordered_unique<boost::multi_index::identity<Checkable::Ptr> >,
-			boost::multi_index::ordered_non_unique<CheckableNextCheckExtractor>
-		>
-	> CheckableSet;
+	typedef TimingWheel<Checkable::Ptr> CheckableQueue;
+	typedef std::set<Checkable::Ptr> CheckableSet;
 
 	CheckerComponent(void);
 
@@ -74,22 +53,42 @@ public:
 	virtual void Start(void) override;
 	virtual void Stop(void) override;
 
+	virtual void ValidateSchedulerThreads(int value, const ValidationUtils& utils) override;
+
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
 	unsigned long GetIdleCheckables(void);
 	unsigned long GetPendingCheckables(void);
 
 private:
-	boost::mutex m_Mutex;
-	boost::condition_variable m_CV;
-	bool m_Stopped;
-	boost::thread m_Thread;
+	/**
+	 * A scheduler shard owns a subset of the checkables along with the
+	 * lock and the thread which is used to dispatch their checks.
+	 *
+	 * @ingroup checker
+	 */
+	struct CheckerShard
+	{
+		boost::mutex Mutex;
+		boost::condition_variable CV;
+		boost::thread Thread;
 
-	CheckableSet m_IdleCheckables;
-	CheckableSet m_PendingCheckables;
+		CheckableQueue IdleCheckables;
+		CheckableSet PendingCheckables;
+
+		bool Stopped;
+
+		CheckerShard(void)
+			: Stopped(false)
+		{ }
+	};
+
+	std::vector<boost::shared_ptr<CheckerShard> > m_Shards;
 
 	Timer::Ptr m_ResultTimer;
 
-	void CheckThreadProc(void);
+	CheckerShard& GetShard(const Checkable::Ptr& checkable) const;
+
+	void CheckThreadProc(int sid);
 	void ResultTimerHandler(void);
 
 	void ExecuteCheckHelper(const Checkable::Ptr& checkable);
@@ -258,6 +258,9 @@ int DaemonCommand::Run(const po::variables_map& vm, const std::vector<std::strin
 		}
 	}
 
+	Application::UpdateThreadPoolLimits();
+	Logger::UpdateAsyncLog();
+
 	{
 		WorkQueue upq(25000, Application::GetConcurrency());
 
@@ -0,0 +1,64 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+
+#include "cli/internalspawnhelpercommand.hpp"
+#include "base/process.hpp"
+#include "base/logger.hpp"
+
+using namespace icinga;
+
+REGISTER_CLICOMMAND("internal/spawn-helper", InternalSpawnHelperCommand);
+
+String InternalSpawnHelperCommand::GetDescription(void) const
+{
+	return "Starts processes on behalf of the Icinga 2 daemon. This command is used internally.";
+}
+
+String InternalSpawnHelperCommand::GetShortDescription(void) const
+{
+	return "starts processes for the daemon";
+}
+
+bool InternalSpawnHelperCommand::IsHidden(void) const
+{
+	return true;
+}
+
+ImpersonationLevel InternalSpawnHelperCommand::GetImpersonationLevel(void) const
+{
+	/* The daemon has already dropped its privileges. */
+	return ImpersonateNone;
+}
+
+/**
+ * The entry point for the "internal spawn-helper" CLI command. The daemon
+ * passes the socket it uses for spawn requests as stdin.
+ *
+ * @returns An exit status.
+ */
+int InternalSpawnHelperCommand::Run(const boost::program_options::variables_map& vm, const std::vector<std::string>& ap) const
+{
+#ifndef _WIN32
+	return Process::RunSpawnHelper(STDIN_FILENO);
+#else /* _WIN32 */
+	Log(LogCritical, "cli", "The spawn helper is not supported on Windows.");
+	return 1;
+#endif /* _WIN32 */
+}
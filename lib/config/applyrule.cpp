@@ -20,12 +20,17 @@
 #include "config/applyrule.hpp"
 #include "base/logger.hpp"
 #include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
 #include <set>
 
 using namespace icinga;
 
 ApplyRule::RuleMap ApplyRule::m_Rules;
 ApplyRule::TypeMap ApplyRule::m_Types;
+boost::mutex ApplyRule::m_IndexMutex;
+std::map<String, ApplyRuleIndex::Ptr> ApplyRule::m_Indexes;
+unsigned long ApplyRule::m_IndexEvaluations;
+unsigned long ApplyRule::m_IndexSkipped;
 
 ApplyRule::ApplyRule(const String& targetType, const String& name, const boost::shared_ptr<Expression>& expression,
     const boost::shared_ptr<Expression>& filter, const String& package, const String& fkvar, const String& fvvar, const boost::shared_ptr<Expression>& fterm,
@@ -94,6 +99,9 @@ void ApplyRule::AddRule(const String& sourceType, const String& targetType, cons
     const String& fvvar, const boost::shared_ptr<Expression>& fterm, bool ignoreOnError, const DebugInfo& di, const Dictionary::Ptr& scope)
 {
 	m_Rules[sourceType].push_back(ApplyRule(targetType, name, expression, filter, package, fkvar, fvvar, fterm, ignoreOnError, di, scope));
+
+	boost::mutex::scoped_lock lock(m_IndexMutex);
+	m_Indexes.erase(sourceType);
 }
 
 bool ApplyRule::EvaluateFilter(ScriptFrame& frame) const
@@ -159,6 +167,49 @@ std::vector<ApplyRule>& ApplyRule::GetRules(const String& type)
 	return it->second;
 }
 
+/**
+ * Returns the rules for the specified type whose filters might match an
+ * object with the specified variables (e.g. "host"). Rules which are not
+ * returned are guaranteed not to match.
+ */
+std::vector<ApplyRule *> ApplyRule::GetCandidateRules(const String& type, const Dictionary::Ptr& variables)
+{
+	std::vector<ApplyRule>& rules = GetRules(type);
+	ApplyRuleIndex::Ptr index;
+
+	{
+		boost::mutex::scoped_lock lock(m_IndexMutex);
+
+		ApplyRuleIndex::Ptr& entry = m_Indexes[type];
+
+		if (!entry)
+			entry = boost::make_shared<ApplyRuleIndex>(boost::cref(rules));
+
+		index = entry;
+	}
+
+	std::vector<ApplyRule *> result;
+
+	BOOST_FOREACH(size_t i, index->GetCandidates(variables)) {
+		result.push_back(&rules[i]);
+	}
+
+	{
+		boost::mutex::scoped_lock lock(m_IndexMutex);
+		m_IndexEvaluations += rules.size();
+		m_IndexSkipped += rules.size() - result.size();
+	}
+
+	return result;
+}
+
+void ApplyRule::GetIndexStats(unsigned long& evaluations, unsigned long& skipped)
+{
+	boost::mutex::scoped_lock lock(m_IndexMutex);
+	evaluations = m_IndexEvaluations;
+	skipped = m_IndexSkipped;
+}
+
 void ApplyRule::CheckMatches(void)
 {
 	BOOST_FOREACH(const RuleMap::value_type& kv, m_Rules) {
@@ -173,5 +224,10 @@ void ApplyRule::CheckMatches(void)
 void ApplyRule::DiscardRules(void)
 {
 	m_Rules.clear();
+
+	boost::mutex::scoped_lock lock(m_IndexMutex);
+	m_Indexes.clear();
+	m_IndexEvaluations = 0;
+	m_IndexSkipped = 0;
 }
 
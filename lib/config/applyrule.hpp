@@ -22,8 +22,10 @@
 
 #include "config/i2-config.hpp"
 #include "config/expression.hpp"
+#include "config/applyruleindex.hpp"
 #include "base/debuginfo.hpp"
 #include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
 
 namespace icinga
 {
@@ -57,6 +59,8 @@ public:
 	    const boost::shared_ptr<Expression>& filter, const String& package, const String& fkvar, const String& fvvar, const boost::shared_ptr<Expression>& fterm,
 	    bool ignoreOnError, const DebugInfo& di, const Dictionary::Ptr& scope);
 	static std::vector<ApplyRule>& GetRules(const String& type);
+	static std::vector<ApplyRule *> GetCandidateRules(const String& type, const Dictionary::Ptr& variables);
+	static void GetIndexStats(unsigned long& evaluations, unsigned long& skipped);
 
 	static void RegisterType(const String& sourceType, const std::vector<String>& targetTypes);
 	static bool IsValidSourceType(const String& sourceType);
@@ -83,6 +87,11 @@ private:
 	static TypeMap m_Types;
 	static RuleMap m_Rules;
 
+	static boost::mutex m_IndexMutex;
+	static std::map<String, ApplyRuleIndex::Ptr> m_Indexes;
+	static unsigned long m_IndexEvaluations;
+	static unsigned long m_IndexSkipped;
+
 	ApplyRule(const String& targetType, const String& name, const boost::shared_ptr<Expression>& expression,
 	    const boost::shared_ptr<Expression>& filter, const String& package, const String& fkvar, const String& fvvar, const boost::shared_ptr<Expression>& fterm,
 	    bool ignoreOnError, const DebugInfo& di, const Dictionary::Ptr& scope);
@@ -0,0 +1,243 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "config/applyruleindex.hpp"
+#include "config/applyrule.hpp"
+#include "config/vmops.hpp"
+#include "base/objectlock.hpp"
+#include <boost/foreach.hpp>
+#include <algorithm>
+
+using namespace icinga;
+
+ApplyRuleIndex::ApplyRuleIndex(const std::vector<ApplyRule>& rules)
+{
+	for (std::vector<ApplyRule>::size_type i = 0; i < rules.size(); i++) {
+		const ApplyRule& rule = rules[i];
+		std::vector<ApplyRulePredicate> predicates;
+
+		if (!GetPredicates(rule.GetFilter().get(), rule, predicates)) {
+			m_UnindexedRules.push_back(i);
+			continue;
+		}
+
+		BOOST_FOREACH(const ApplyRulePredicate& predicate, predicates) {
+			String key = predicate.Variable;
+
+			BOOST_FOREACH(const String& field, predicate.Path) {
+				key += '\0';
+				key += field;
+			}
+
+			key += '\0';
+			key += predicate.Contains ? "in" : "eq";
+
+			AttributeIndex& attr = m_Attributes[key];
+			attr.Variable = predicate.Variable;
+			attr.Path = predicate.Path;
+			attr.Contains = predicate.Contains;
+
+			if (attr.AllRules.empty() || attr.AllRules.back() != i)
+				attr.AllRules.push_back(i);
+
+			std::vector<size_t>& valueRules = attr.Rules[predicate.Value];
+
+			if (valueRules.empty() || valueRules.back() != i)
+				valueRules.push_back(i);
+		}
+	}
+}
+
+/**
+ * Determines a set of predicates at least one of which must be true for
+ * the expression to evaluate to true.
+ *
+ * @returns false if no such set can be determined for the expression.
+ */
+bool ApplyRuleIndex::GetPredicates(const Expression *expr, const ApplyRule& rule, std::vector<ApplyRulePredicate>& predicates)
+{
+	if (!expr)
+		return false;
+
+	if (dynamic_cast<const LogicalOrExpression *>(expr)) {
+		const BinaryExpression *bexpr = static_cast<const BinaryExpression *>(expr);
+		std::vector<ApplyRulePredicate> left, right;
+
+		if (!GetPredicates(bexpr->m_Operand1, rule, left) || !GetPredicates(bexpr->m_Operand2, rule, right))
+			return false;
+
+		predicates.insert(predicates.end(), left.begin(), left.end());
+		predicates.insert(predicates.end(), right.begin(), right.end());
+		return true;
+	}
+
+	if (dynamic_cast<const LogicalAndExpression *>(expr)) {
+		const BinaryExpression *bexpr = static_cast<const BinaryExpression *>(expr);
+
+		/* Either side is sufficient, e.g. for "assign && !ignore". */
+		return GetPredicates(bexpr->m_Operand1, rule, predicates) || GetPredicates(bexpr->m_Operand2, rule, predicates);
+	}
+
+	ApplyRulePredicate predicate;
+
+	if (dynamic_cast<const EqualExpression *>(expr)) {
+		const BinaryExpression *bexpr = static_cast<const BinaryExpression *>(expr);
+
+		if (GetPath(bexpr->m_Operand1, rule, &predicate.Variable, &predicate.Path) && GetStringLiteral(bexpr->m_Operand2, &predicate.Value)) {
+			predicate.Contains = false;
+			predicates.push_back(predicate);
+			return true;
+		}
+
+		if (GetStringLiteral(bexpr->m_Operand1, &predicate.Value) && GetPath(bexpr->m_Operand2, rule, &predicate.Variable, &predicate.Path)) {
+			predicate.Contains = false;
+			predicates.push_back(predicate);
+			return true;
+		}
+
+		return false;
+	}
+
+	if (dynamic_cast<const InExpression *>(expr)) {
+		const BinaryExpression *bexpr = static_cast<const BinaryExpression *>(expr);
+
+		if (GetStringLiteral(bexpr->m_Operand1, &predicate.Value) && GetPath(bexpr->m_Operand2, rule, &predicate.Variable, &predicate.Path)) {
+			predicate.Contains = true;
+			predicates.push_back(predicate);
+			return true;
+		}
+
+		return false;
+	}
+
+	return false;
+}
+
+bool ApplyRuleIndex::GetPath(const Expression *expr, const ApplyRule& rule, String *variable, std::vector<String> *path)
+{
+	const VariableExpression *vexpr = dynamic_cast<const VariableExpression *>(expr);
+
+	if (vexpr) {
+		*variable = vexpr->GetVariable();
+
+		/* The iterator variables of 'apply for' rules shadow the object. */
+		return *variable != rule.GetFKVar() && *variable != rule.GetFVVar();
+	}
+
+	if (dynamic_cast<const IndexerExpression *>(expr)) {
+		const BinaryExpression *bexpr = static_cast<const BinaryExpression *>(expr);
+		String field;
+
+		if (!GetStringLiteral(bexpr->m_Operand2, &field))
+			return false;
+
+		if (!GetPath(bexpr->m_Operand1, rule, variable, path))
+			return false;
+
+		path->push_back(field);
+		return true;
+	}
+
+	return false;
+}
+
+bool ApplyRuleIndex::GetStringLiteral(const Expression *expr, String *value)
+{
+	const LiteralExpression *lexpr = dynamic_cast<const LiteralExpression *>(expr);
+
+	if (!lexpr)
+		return false;
+
+	Value literal = lexpr->GetValue();
+
+	/* Empty strings also compare equal to null values. */
+	if (!literal.IsString() || literal.IsEmpty())
+		return false;
+
+	*value = literal;
+	return true;
+}
+
+/**
+ * Returns the indices of all rules whose filters might match the specified
+ * variables, in the order the rules were defined.
+ */
+std::vector<size_t> ApplyRuleIndex::GetCandidates(const Dictionary::Ptr& variables) const
+{
+	std::vector<size_t> candidates = m_UnindexedRules;
+
+	typedef std::map<String, AttributeIndex>::value_type kv_pair;
+	BOOST_FOREACH(const kv_pair& kv, m_Attributes) {
+		const AttributeIndex& attr = kv.second;
+		Value value;
+		bool known = true;
+
+		if (!variables->Get(attr.Variable, &value))
+			known = false;
+		else {
+			try {
+				BOOST_FOREACH(const String& field, attr.Path) {
+					value = VMOps::GetField(value, field);
+				}
+			} catch (const std::exception&) {
+				/* Let the filter report the error. */
+				known = false;
+			}
+		}
+
+		/* 'in' with anything other than an array raises an error. */
+		if (known && attr.Contains && !value.IsEmpty() && !value.IsObjectType<Array>())
+			known = false;
+
+		if (!known) {
+			candidates.insert(candidates.end(), attr.AllRules.begin(), attr.AllRules.end());
+			continue;
+		}
+
+		std::map<String, std::vector<size_t> >::const_iterator it;
+
+		if (attr.Contains) {
+			if (value.IsEmpty())
+				continue;
+
+			Array::Ptr arr = value;
+
+			ObjectLock olock(arr);
+			BOOST_FOREACH(const Value& item, arr) {
+				if (!item.IsString())
+					continue;
+
+				it = attr.Rules.find(item);
+
+				if (it != attr.Rules.end())
+					candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+			}
+		} else if (value.IsString()) {
+			it = attr.Rules.find(value);
+
+			if (it != attr.Rules.end())
+				candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+		}
+	}
+
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+	return candidates;
+}
@@ -0,0 +1,84 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef APPLYRULEINDEX_H
+#define APPLYRULEINDEX_H
+
+#include "config/i2-config.hpp"
+#include "config/expression.hpp"
+#include <boost/shared_ptr.hpp>
+#include <vector>
+#include <map>
+
+namespace icinga
+{
+
+class ApplyRule;
+
+/**
+ * A predicate which must hold for an apply rule's filter to match, i.e.
+ * "variable.path == value" or "value in variable.path".
+ *
+ * @ingroup config
+ */
+struct ApplyRulePredicate
+{
+	String Variable;
+	std::vector<String> Path;
+	String Value;
+	bool Contains;
+};
+
+/**
+ * Maps attribute values to the apply rules whose filters can only match
+ * objects with those values.
+ *
+ * @ingroup config
+ */
+class I2_CONFIG_API ApplyRuleIndex
+{
+public:
+	typedef boost::shared_ptr<ApplyRuleIndex> Ptr;
+
+	ApplyRuleIndex(const std::vector<ApplyRule>& rules);
+
+	std::vector<size_t> GetCandidates(const Dictionary::Ptr& variables) const;
+
+	static bool GetPredicates(const Expression *expr, const ApplyRule& rule, std::vector<ApplyRulePredicate>& predicates);
+
+private:
+	struct AttributeIndex
+	{
+		String Variable;
+		std::vector<String> Path;
+		bool Contains;
+		std::vector<size_t> AllRules;
+		std::map<String, std::vector<size_t> > Rules;
+	};
+
+	std::vector<size_t> m_UnindexedRules;
+	std::map<String, AttributeIndex> m_Attributes;
+
+	static bool GetPath(const Expression *expr, const ApplyRule& rule, String *variable, std::vector<String> *path);
+	static bool GetStringLiteral(const Expression *expr, String *value);
+};
+
+}
+
+#endif /* APPLYRULEINDEX_H */
@@ -20,6 +20,7 @@
 #include "config/configcompilercontext.hpp"
 #include "base/singleton.hpp"
 #include "base/json.hpp"
+#include "base/type.hpp"
 #include "base/netstring.hpp"
 #include "base/exception.hpp"
 #include <boost/foreach.hpp>
@@ -52,7 +53,7 @@ void ConfigCompilerContext::WriteObject(const Dictionary::Ptr& object)
 	if (!m_ObjectsFP)
 		return;
 
-	String json = JsonEncode(object);
+	String json = JsonSerialize(object, FAConfig);
 
 	{
 		boost::mutex::scoped_lock lock(m_Mutex);
@@ -31,7 +31,6 @@
 #include "base/exception.hpp"
 #include "base/stdiostream.hpp"
 #include "base/netstring.hpp"
-#include "base/serializer.hpp"
 #include "base/json.hpp"
 #include "base/exception.hpp"
 #include "base/function.hpp"
@@ -235,7 +234,7 @@ ConfigObject::Ptr ConfigItem::Commit(bool discard)
 
 	persistentItem->Set("type", GetType());
 	persistentItem->Set("name", GetName());
-	persistentItem->Set("properties", Serialize(dobj, FAConfig));
+	persistentItem->Set("properties", dobj);
 
 	Dictionary::Ptr dhint = debugHints.ToDictionary();
 	persistentItem->Set("debug_hints", dhint);
@@ -480,6 +479,14 @@ bool ConfigItem::CommitItems(WorkQueue& upq)
 
 	ApplyRule::CheckMatches();
 
+	unsigned long ruleEvaluations, ruleEvaluationsSkipped;
+	ApplyRule::GetIndexStats(ruleEvaluations, ruleEvaluationsSkipped);
+
+	if (ruleEvaluations > 0) {
+		Log(LogInformation, "ApplyRule")
+		    << "Skipped " << ruleEvaluationsSkipped << " of " << ruleEvaluations << " apply rule evaluations using the apply rule index.";
+	}
+
 	/* log stats for external parsers */
 	typedef std::map<Type::Ptr, int> ItemCountMap;
 	ItemCountMap itemCounts;
@@ -229,6 +229,11 @@ class I2_CONFIG_API LiteralExpression : public Expression
 public:
 	LiteralExpression(const Value& value = Value());
 
+	Value GetValue(void) const
+	{
+		return m_Value;
+	}
+
 protected:
 	virtual ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override;
 
@@ -286,6 +291,8 @@ public:
 protected:
 	Expression *m_Operand1;
 	Expression *m_Operand2;
+
+	friend class ApplyRuleIndex;
 };
 
 class I2_CONFIG_API VariableExpression : public DebuggableExpression
@@ -39,7 +39,7 @@ Timer::Ptr DbConnection::m_ProgramStatusTimer;
 boost::once_flag DbConnection::m_OnceFlag = BOOST_ONCE_INIT;
 
 DbConnection::DbConnection(void)
-	: m_QueryStats(15 * 60)
+	: m_QueryStats(15 * 60), m_CoalescedQueryStats(15 * 60), m_NextCoalescedQueryID(0)
 { }
 
 void DbConnection::OnConfigLoaded(void)
@@ -446,3 +446,124 @@ int DbConnection::GetQueryCount(RingBuffer::SizeType span) const
 	boost::mutex::scoped_lock lock(m_StatsMutex);
 	return m_QueryStats.GetValues(span);
 }
+
+int DbConnection::GetCoalescedQueryCount(RingBuffer::SizeType span) const
+{
+	boost::mutex::scoped_lock lock(m_StatsMutex);
+	return m_CoalescedQueryStats.GetValues(span);
+}
+
+/**
+ * Checks whether a query is a status update which may be merged with other
+ * pending updates for the same row. Only the status row of an object is
+ * coalesced: it is identified by the object alone, no matter whether the
+ * where criteria additionally contain the instance ID.
+ *
+ * @param query The query.
+ * @returns true if the query can be coalesced, false otherwise.
+ */
+bool DbConnection::CanCoalesceQuery(const DbQuery& query)
+{
+	return query.Category == DbCatState && query.Type == (DbQueryInsert | DbQueryUpdate) &&
+	    query.StatusUpdate && !query.ConfigUpdate && query.Object && query.WhereCriteria && query.Fields;
+}
+
+/**
+ * Adds a status update to the set of pending updates. If there already is
+ * a pending update for the same table and object the new fields are merged
+ * into it.
+ *
+ * @param query The query.
+ * @param id Receives the ID of the pending update the caller needs to schedule.
+ * @returns true if the caller needs to schedule the query, false if it
+ *          was merged into a query which is already scheduled.
+ */
+bool DbConnection::AddCoalescedQuery(const DbQuery& query, unsigned long *id)
+{
+	{
+		boost::mutex::scoped_lock lock(m_CoalesceMutex);
+
+		std::pair<DbObject::Ptr, String> key = std::make_pair(query.Object, query.Table);
+		std::map<std::pair<DbObject::Ptr, String>, unsigned long>::iterator it = m_OpenCoalescedQueries.find(key);
+
+		if (it == m_OpenCoalescedQueries.end()) {
+			*id = m_NextCoalescedQueryID++;
+			m_CoalescedQueries[*id] = query;
+			m_OpenCoalescedQueries[key] = *id;
+			return true;
+		}
+
+		DbQuery& pending = m_CoalescedQueries[it->second];
+
+		Dictionary::Ptr fields = pending.Fields->ShallowClone();
+		query.Fields->CopyTo(fields);
+
+		pending.Fields = fields;
+	}
+
+	double now = Utility::GetTime();
+
+	boost::mutex::scoped_lock lock(m_StatsMutex);
+	m_CoalescedQueryStats.InsertValue(now, 1);
+
+	return false;
+}
+
+/**
+ * Prevents further status updates from being merged into pending updates
+ * which are queued before the specified query. This is necessary for queries
+ * for the same object and for queries for the same table which are not
+ * restricted to a single object: merging a later update into an earlier
+ * pending update would move it ahead of them. Queries for other objects
+ * touch other rows and do not need to be ordered relative to the update.
+ *
+ * @param query The query which is about to be queued.
+ */
+void DbConnection::CloseCoalescedQueries(const DbQuery& query)
+{
+	boost::mutex::scoped_lock lock(m_CoalesceMutex);
+
+	typedef std::map<std::pair<DbObject::Ptr, String>, unsigned long>::iterator it_type;
+
+	if (query.Object) {
+		it_type it = m_OpenCoalescedQueries.lower_bound(std::make_pair(query.Object, String()));
+
+		while (it != m_OpenCoalescedQueries.end() && it->first.first == query.Object)
+			m_OpenCoalescedQueries.erase(it++);
+	} else {
+		for (it_type it = m_OpenCoalescedQueries.begin(); it != m_OpenCoalescedQueries.end(); ) {
+			if (it->first.second == query.Table)
+				m_OpenCoalescedQueries.erase(it++);
+			else
+				it++;
+		}
+	}
+}
+
+/**
+ * Removes a pending status update so that it can be executed.
+ *
+ * @param id The ID returned by AddCoalescedQuery().
+ * @param query Receives the query.
+ * @returns true if a query was pending, false otherwise.
+ */
+bool DbConnection::TakeCoalescedQuery(unsigned long id, DbQuery *query)
+{
+	boost::mutex::scoped_lock lock(m_CoalesceMutex);
+
+	std::map<unsigned long, DbQuery>::iterator it = m_CoalescedQueries.find(id);
+
+	if (it == m_CoalescedQueries.end())
+		return false;
+
+	*query = it->second;
+	m_CoalescedQueries.erase(it);
+
+	std::map<std::pair<DbObject::Ptr, String>, unsigned long>::iterator ot =
+	    m_OpenCoalescedQueries.find(std::make_pair(query->Object, query->Table));
+
+	if (ot != m_OpenCoalescedQueries.end() && ot->second == id)
+		m_OpenCoalescedQueries.erase(ot);
+
+	return true;
+}
@@ -72,6 +72,7 @@ public:
 	bool GetStatusUpdate(const DbObject::Ptr& dbobj) const;
 
 	int GetQueryCount(RingBuffer::SizeType span) const;
+	int GetCoalescedQueryCount(RingBuffer::SizeType span) const;
 	virtual int GetPendingQueryCount(void) const = 0;
 
 	virtual void ValidateFailoverTimeout(double value, const ValidationUtils& utils) override;
@@ -97,6 +98,11 @@ protected:
 
 	void IncreaseQueryCount(void);
 
+	static bool CanCoalesceQuery(const DbQuery& query);
+	bool AddCoalescedQuery(const DbQuery& query, unsigned long *id);
+	void CloseCoalescedQueries(const DbQuery& query);
+	bool TakeCoalescedQuery(unsigned long id, DbQuery *query);
+
 private:
 	std::map<DbObject::Ptr, DbReference> m_ObjectIDs;
 	std::map<std::pair<DbType::Ptr, DbReference>, DbReference> m_InsertIDs;
@@ -118,6 +124,12 @@ private:
 
 	mutable boost::mutex m_StatsMutex;
 	RingBuffer m_QueryStats;
+	RingBuffer m_CoalescedQueryStats;
+
+	boost::mutex m_CoalesceMutex;
+	unsigned long m_NextCoalescedQueryID;
+	std::map<unsigned long, DbQuery> m_CoalescedQueries;
+	std::map<std::pair<DbObject::Ptr, String>, unsigned long> m_OpenCoalescedQueries;
 };
 
 struct database_error : virtual std::exception, virtual boost::exception { };
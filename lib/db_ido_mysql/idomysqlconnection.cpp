@@ -39,7 +39,7 @@ REGISTER_TYPE(IdoMysqlConnection);
 REGISTER_STATSFUNCTION(IdoMysqlConnection, &IdoMysqlConnection::StatsFunc);
 
 IdoMysqlConnection::IdoMysqlConnection(void)
-	: m_QueryQueue(500000)
+	: m_QueryQueue(500000), m_UpsertRowStats(15 * 60), m_UpsertBatchStats(15 * 60)
 { }
 
 void IdoMysqlConnection::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
@@ -49,15 +49,32 @@ void IdoMysqlConnection::StatsFunc(const Dictionary::Ptr& status, const Array::P
 	BOOST_FOREACH(const IdoMysqlConnection::Ptr& idomysqlconnection, ConfigType::GetObjectsByType<IdoMysqlConnection>()) {
 		size_t items = idomysqlconnection->m_QueryQueue.GetLength();
 
+		int upsertRows, upsertBatches;
+
+		{
+			boost::mutex::scoped_lock lock(idomysqlconnection->m_UpsertStatsMutex);
+			upsertRows = idomysqlconnection->m_UpsertRowStats.GetValues(60);
+			upsertBatches = idomysqlconnection->m_UpsertBatchStats.GetValues(60);
+		}
+
+		double upsertRowsRate = upsertRows / 60.0;
+		double upsertBatchSize = (upsertBatches > 0) ? static_cast<double>(upsertRows) / upsertBatches : 0;
+
 		Dictionary::Ptr stats = new Dictionary();
 		stats->Set("version", idomysqlconnection->GetSchemaVersion());
 		stats->Set("instance_name", idomysqlconnection->GetInstanceName());
 		stats->Set("connected", idomysqlconnection->GetConnected());
 		stats->Set("query_queue_items", items);
+		stats->Set("coalesced_queries_1min", idomysqlconnection->GetCoalescedQueryCount(60));
+		stats->Set("batched_status_rows_rate", upsertRowsRate);
+		stats->Set("batched_status_rows_per_query", upsertBatchSize);
 
 		nodes->Set(idomysqlconnection->GetName(), stats);
 
 		perfdata->Add(new PerfdataValue("idomysqlconnection_" + idomysqlconnection->GetName() + "_query_queue_items", items));
+		perfdata->Add(new PerfdataValue("idomysqlconnection_" + idomysqlconnection->GetName() + "_coalesced_queries_1min", idomysqlconnection->GetCoalescedQueryCount(60)));
+		perfdata->Add(new PerfdataValue("idomysqlconnection_" + idomysqlconnection->GetName() + "_batched_status_rows_rate", upsertRowsRate));
+		perfdata->Add(new PerfdataValue("idomysqlconnection_" + idomysqlconnection->GetName() + "_batched_status_rows_per_query", upsertBatchSize));
 	}
 
 	status->Set("idomysqlconnection", nodes);
@@ -145,6 +162,8 @@ void IdoMysqlConnection::InternalNewTransaction(void)
 	if (!GetConnected())
 		return;
 
+	FlushUpsertBatches();
+
 	AsyncQuery("COMMIT");
 	AsyncQuery("BEGIN");
 }
@@ -178,6 +197,8 @@ void IdoMysqlConnection::Reconnect(void)
 
 	ClearIDCache();
 
+	m_UpsertBatches.clear();
+
 	String ihost, isocket_path, iuser, ipasswd, idb;
 	const char *host, *socket_path, *user , *passwd, *db;
 	long port;
@@ -491,6 +512,7 @@ IdoMysqlResult IdoMysqlConnection::Query(const String& query)
 	AssertOnWorkQueue();
 
 	/* finish all async queries to maintain the right order for queries */
+	FlushUpsertBatches();
 	FinishAsyncQueries(true);
 
 	Log(LogDebug, "IdoMysqlConnection")
@@ -726,9 +748,33 @@ void IdoMysqlConnection::ExecuteQuery(const DbQuery& query)
 {
 	ASSERT(query.Category != DbCatInvalid);
 
+	/* newer status updates replace the fields of pending updates for the same row */
+	if (CanCoalesceQuery(query)) {
+		unsigned long id;
+
+		if (AddCoalescedQuery(query, &id))
+			m_QueryQueue.Enqueue(boost::bind(&IdoMysqlConnection::InternalExecuteCoalescedQuery, this, id), true);
+
+		return;
+	}
+
+	CloseCoalescedQueries(query);
+
 	m_QueryQueue.Enqueue(boost::bind(&IdoMysqlConnection::InternalExecuteQuery, this, query, (DbQueryType *)NULL), true);
 }
 
+void IdoMysqlConnection::InternalExecuteCoalescedQuery(unsigned long id)
+{
+	AssertOnWorkQueue();
+
+	DbQuery query;
+
+	if (!TakeCoalescedQuery(id, &query))
+		return;
+
+	InternalExecuteQuery(query);
+}
+
 void IdoMysqlConnection::InternalExecuteQuery(const DbQuery& query, DbQueryType *typeOverride)
 {
 	AssertOnWorkQueue();
@@ -742,6 +788,14 @@ void IdoMysqlConnection::InternalExecuteQuery(const DbQuery& query, DbQueryType
 	if (query.Object && query.Object->GetObject()->GetExtension("agent_check").ToBool())
 		return;
 
+	if (!typeOverride && IsBatchedUpsert(query)) {
+		AddBatchedUpsert(query);
+		return;
+	}
+
+	/* pending status rows for this table must be written before any other query touches it */
+	FlushUpsertBatch(query.Table);
+
 	std::ostringstream qbuf, where;
 	int type;
 
@@ -870,6 +924,145 @@ void IdoMysqlConnection::FinishExecuteQuery(const DbQuery& query, int type, bool
 	}
 }
 
+bool IdoMysqlConnection::IsBatchedUpsert(const DbQuery& query)
+{
+	if (query.Category != DbCatState || query.Type != (DbQueryInsert | DbQueryUpdate))
+		return false;
+
+	/* these tables have a unique key on the object (and varname) columns */
+	return query.Table == "servicestatus" || query.Table == "hoststatus" || query.Table == "customvariablestatus";
+}
+
+void IdoMysqlConnection::AddBatchedUpsert(const DbQuery& query)
+{
+	AssertOnWorkQueue();
+
+	/* Partial status updates only identify their row in the where criteria,
+	 * however the key columns must be part of the inserted row. */
+	Dictionary::Ptr fields = query.Fields->ShallowClone();
+
+	if (query.WhereCriteria)
+		query.WhereCriteria->CopyTo(fields);
+
+	std::ostringstream colbuf, valbuf, updbuf;
+
+	ObjectLock olock(fields);
+
+	bool first = true;
+	BOOST_FOREACH(const Dictionary::Pair& kv, fields) {
+		Value value;
+
+		if (kv.second.IsEmpty() && !kv.second.IsString())
+			continue;
+
+		if (!FieldToEscapedString(kv.first, kv.second, &value)) {
+			/* The row can't be identified yet, e.g. because the object ID isn't known. */
+			if (query.WhereCriteria && query.WhereCriteria->Contains(kv.first))
+				m_QueryQueue.Enqueue(boost::bind(&IdoMysqlConnection::InternalExecuteQuery, this, query, (DbQueryType *)NULL));
+
+			return;
+		}
+
+		if (!first) {
+			colbuf << ", ";
+			valbuf << ", ";
+			updbuf << ", ";
+		}
+
+		colbuf << kv.first;
+		valbuf << value;
+		updbuf << kv.first << " = VALUES(" << kv.first << ")";
+
+		if (first)
+			first = false;
+	}
+
+	String columns = colbuf.str();
+	String row = "(" + valbuf.str() + ")";
+
+	IdoUpsertBatch& batch = m_UpsertBatches[query.Table];
+
+	if (!batch.Rows.empty() && batch.Columns != columns)
+		FlushUpsertBatch(query.Table);
+
+	size_t size_header = 64 + GetTablePrefix().GetLength() + query.Table.GetLength() + columns.GetLength() * 2 + updbuf.str().size();
+	size_t size_row = row.GetLength() + 2;
+
+	if (!batch.Rows.empty() && size_header + batch.Bytes + size_row > static_cast<size_t>(m_MaxPacketSize - 512))
+		FlushUpsertBatch(query.Table);
+
+	if (batch.Rows.empty()) {
+		batch.Columns = columns;
+		batch.Updates = updbuf.str();
+	}
+
+	batch.Rows.push_back(row);
+	batch.Queries.push_back(query);
+	batch.Bytes += size_row;
+}
+
+void IdoMysqlConnection::FlushUpsertBatch(const String& table)
+{
+	AssertOnWorkQueue();
+
+	std::map<String, IdoUpsertBatch>::iterator it = m_UpsertBatches.find(table);
+
+	if (it == m_UpsertBatches.end() || it->second.Rows.empty())
+		return;
+
+	IdoUpsertBatch& batch = it->second;
+
+	std::ostringstream qbuf;
+	qbuf << "INSERT INTO " << GetTablePrefix() << table << " (" << batch.Columns << ") VALUES ";
+
+	bool first = true;
+	BOOST_FOREACH(const String& row, batch.Rows) {
+		if (!first)
+			qbuf << ", ";
+
+		qbuf << row;
+
+		if (first)
+			first = false;
+	}
+
+	qbuf << " ON DUPLICATE KEY UPDATE " << batch.Updates;
+
+	{
+		double now = Utility::GetTime();
+
+		boost::mutex::scoped_lock lock(m_UpsertStatsMutex);
+		m_UpsertRowStats.InsertValue(now, batch.Rows.size());
+		m_UpsertBatchStats.InsertValue(now, 1);
+	}
+
+	std::vector<DbQuery> queries;
+	queries.swap(batch.Queries);
+
+	batch.Rows.clear();
+	batch.Bytes = 0;
+
+	AsyncQuery(qbuf.str(), boost::bind(&IdoMysqlConnection::FinishBatchedUpsert, this, queries));
+}
+
+void IdoMysqlConnection::FlushUpsertBatches(void)
+{
+	AssertOnWorkQueue();
+
+	typedef std::map<String, IdoUpsertBatch>::value_type kv_pair;
+	BOOST_FOREACH(const kv_pair& kv, m_UpsertBatches) {
+		FlushUpsertBatch(kv.first);
+	}
+}
+
+void IdoMysqlConnection::FinishBatchedUpsert(const std::vector<DbQuery>& queries)
+{
+	BOOST_FOREACH(const DbQuery& query, queries) {
+		if (query.StatusUpdate && query.Object)
+			SetStatusUpdate(query.Object, true);
+	}
+}
+
 void IdoMysqlConnection::CleanUpExecuteQuery(const String& table, const String& time_column, double max_age)
 {
 	m_QueryQueue.Enqueue(boost::bind(&IdoMysqlConnection::InternalCleanUpExecuteQuery, this, table, time_column, max_age), true);
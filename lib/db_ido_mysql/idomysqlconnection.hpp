@@ -23,6 +23,7 @@
 #include "db_ido_mysql/idomysqlconnection.thpp"
 #include "base/array.hpp"
 #include "base/timer.hpp"
+#include "base/ringbuffer.hpp"
 #include "base/workqueue.hpp"
 #include <mysql.h>
 
@@ -39,6 +40,25 @@ struct IdoAsyncQuery
 	IdoAsyncCallback Callback;
 };
 
+/**
+ * Status rows for a single table which are written using one multi-row
+ * INSERT ... ON DUPLICATE KEY UPDATE query.
+ *
+ * @ingroup ido
+ */
+struct IdoUpsertBatch
+{
+	String Columns;
+	String Updates;
+	std::vector<String> Rows;
+	std::vector<DbQuery> Queries;
+	size_t Bytes;
+
+	IdoUpsertBatch(void)
+		: Bytes(0)
+	{ }
+};
+
 /**
  * An IDO MySQL database connection.
  *
@@ -77,6 +97,11 @@ private:
 	int m_MaxPacketSize;
 
 	std::vector<IdoAsyncQuery> m_AsyncQueries;
+	std::map<String, IdoUpsertBatch> m_UpsertBatches;
+
+	mutable boost::mutex m_UpsertStatsMutex;
+	RingBuffer m_UpsertRowStats;
+	RingBuffer m_UpsertBatchStats;
 
 	Timer::Ptr m_ReconnectTimer;
 	Timer::Ptr m_TxTimer;
@@ -91,6 +116,12 @@ private:
 	void AsyncQuery(const String& query, const IdoAsyncCallback& callback = IdoAsyncCallback());
 	void FinishAsyncQueries(bool force = false);
 
+	static bool IsBatchedUpsert(const DbQuery& query);
+	void AddBatchedUpsert(const DbQuery& query);
+	void FlushUpsertBatch(const String& table);
+	void FlushUpsertBatches(void);
+	void FinishBatchedUpsert(const std::vector<DbQuery>& queries);
+
 	bool FieldToEscapedString(const String& key, const Value& value, Value *result);
 	void InternalActivateObject(const DbObject::Ptr& dbobj);
 	void InternalDeactivateObject(const DbObject::Ptr& dbobj);
@@ -104,6 +135,7 @@ private:
 	void ReconnectTimerHandler(void);
 
 	void InternalExecuteQuery(const DbQuery& query, DbQueryType *typeOverride = NULL);
+	void InternalExecuteCoalescedQuery(unsigned long id);
 	void FinishExecuteQuery(const DbQuery& query, int type, bool upsert);
 	void InternalCleanUpExecuteQuery(const String& table, const String& time_key, double time_value);
 	void InternalNewTransaction(void);
@@ -56,10 +56,12 @@ void IdoPgsqlConnection::StatsFunc(const Dictionary::Ptr& status, const Array::P
 		stats->Set("connected", idopgsqlconnection->GetConnected());
 		stats->Set("instance_name", idopgsqlconnection->GetInstanceName());
 		stats->Set("query_queue_items", items);
+		stats->Set("coalesced_queries_1min", idopgsqlconnection->GetCoalescedQueryCount(60));
 
 		nodes->Set(idopgsqlconnection->GetName(), stats);
 
 		perfdata->Add(new PerfdataValue("idopgsqlconnection_" + idopgsqlconnection->GetName() + "_query_queue_items", items));
+		perfdata->Add(new PerfdataValue("idopgsqlconnection_" + idopgsqlconnection->GetName() + "_coalesced_queries_1min", idopgsqlconnection->GetCoalescedQueryCount(60)));
 	}
 
 	status->Set("idopgsqlconnection", nodes);
@@ -136,6 +138,7 @@ void IdoPgsqlConnection::TxTimerHandler(void)
 void IdoPgsqlConnection::NewTransaction(void)
 {
 	m_QueryQueue.Enqueue(boost::bind(&IdoPgsqlConnection::InternalNewTransaction, this), true);
+	m_QueryQueue.Enqueue(boost::bind(&IdoPgsqlConnection::FinishAsyncQueries, this, true));
 }
 
 void IdoPgsqlConnection::InternalNewTransaction(void)
@@ -145,8 +148,8 @@ void IdoPgsqlConnection::InternalNewTransaction(void)
 	if (!GetConnected())
 		return;
 
-	Query("COMMIT");
-	Query("BEGIN");
+	AsyncQuery("COMMIT");
+	AsyncQuery("BEGIN");
 }
 
 void IdoPgsqlConnection::ReconnectTimerHandler(void)
@@ -372,16 +375,128 @@ void IdoPgsqlConnection::ClearConfigTable(const String& table)
 	Query("DELETE FROM " + GetTablePrefix() + table + " WHERE instance_id = " + Convert::ToString(static_cast<long>(m_InstanceID)));
 }
 
+void IdoPgsqlConnection::AsyncQuery(const String& query, const IdoPgsqlAsyncCallback& callback)
+{
+	AssertOnWorkQueue();
+
+	IdoPgsqlAsyncQuery aq;
+	aq.Query = query;
+	aq.Callback = callback;
+	m_AsyncQueries.push_back(aq);
+
+	if (m_AsyncQueries.size() > 500)
+		FinishAsyncQueries(true);
+	else
+		m_QueryQueue.Enqueue(boost::bind(&IdoPgsqlConnection::FinishAsyncQueries, this, false));
+}
+
+void IdoPgsqlConnection::FinishAsyncQueries(bool force)
+{
+	if (m_AsyncQueries.size() < 10 && !force)
+		return;
+
+	if (m_AsyncQueries.empty())
+		return;
+
+	std::vector<IdoPgsqlAsyncQuery> queries;
+	m_AsyncQueries.swap(queries);
+
+	if (!GetConnected())
+		return;
+
+	std::ostringstream querybuf;
+
+	for (std::vector<IdoPgsqlAsyncQuery>::size_type i = 0; i < queries.size(); i++) {
+		if (i > 0)
+			querybuf << ";";
+
+		querybuf << queries[i].Query;
+
+		IncreaseQueryCount();
+	}
+
+	String query = querybuf.str();
+
+	Log(LogDebug, "IdoPgsqlConnection")
+	    << "Query: " << query;
+
+	/* all statements are sent in a single round-trip, the server returns one result for each of them */
+	if (!SendStatements(query)) {
+		String message = PQerrorMessage(m_Connection);
+		Log(LogCritical, "IdoPgsqlConnection")
+		    << "Error \"" << message << "\" when executing query \"" << query << "\"";
+
+		BOOST_THROW_EXCEPTION(
+		    database_error()
+			<< errinfo_message(message)
+			<< errinfo_database_query(query)
+		);
+	}
+
+	/* Collect all results before running the callbacks, they might send further queries. */
+	std::vector<IdoPgsqlResult> results;
+	bool failed = false;
+	String message;
+
+	PGresult *result;
+
+	while ((result = GetNextResult())) {
+		if (!failed && PQresultStatus(result) != PGRES_COMMAND_OK && PQresultStatus(result) != PGRES_TUPLES_OK) {
+			failed = true;
+			message = PQresultErrorMessage(result);
+
+			if (message.IsEmpty())
+				message = PQresStatus(PQresultStatus(result));
+		}
+
+		results.push_back(IdoPgsqlResult(result, std::ptr_fun(PQclear)));
+	}
+
+	if (!failed && results.size() != queries.size()) {
+		failed = true;
+		message = "Unexpected number of results";
+	}
+
+	if (failed) {
+		Log(LogCritical, "IdoPgsqlConnection")
+		    << "Error \"" << message << "\" when executing query \"" << query << "\"";
+
+		BOOST_THROW_EXCEPTION(
+		    database_error()
+			<< errinfo_message(message)
+			<< errinfo_database_query(query)
+		);
+	}
+
+	for (std::vector<IdoPgsqlAsyncQuery>::size_type i = 0; i < queries.size(); i++) {
+		const IdoPgsqlAsyncQuery& aq = queries[i];
+		const IdoPgsqlResult& iresult = results[i];
+
+		m_AffectedRows = GetResultAffectedRows(iresult.get());
+
+		if (!aq.Callback)
+			continue;
+
+		if (PQresultStatus(iresult.get()) == PGRES_TUPLES_OK)
+			aq.Callback(iresult);
+		else
+			aq.Callback(IdoPgsqlResult());
+	}
+}
+
 IdoPgsqlResult IdoPgsqlConnection::Query(const String& query)
 {
 	AssertOnWorkQueue();
 
+	/* finish all async queries to maintain the right order for queries */
+	FinishAsyncQueries(true);
+
 	Log(LogDebug, "IdoPgsqlConnection")
 	    << "Query: " << query;
 
 	IncreaseQueryCount();
 
-	PGresult *result = PQexec(m_Connection, query.CStr());
+	PGresult *result = ExecuteStatement(query);
 
 	if (!result) {
 		String message = PQerrorMessage(m_Connection);
@@ -395,8 +510,7 @@ IdoPgsqlResult IdoPgsqlConnection::Query(const String& query)
 		);
 	}
 
-	char *rowCount = PQcmdTuples(result);
-	m_AffectedRows = atoi(rowCount);
+	m_AffectedRows = GetResultAffectedRows(result);
 
 	if (PQresultStatus(result) == PGRES_COMMAND_OK) {
 		PQclear(result);
@@ -420,6 +534,26 @@ IdoPgsqlResult IdoPgsqlConnection::Query(const String& query)
 	return IdoPgsqlResult(result, std::ptr_fun(PQclear));
 }
 
+PGresult *IdoPgsqlConnection::ExecuteStatement(const String& query)
+{
+	return PQexec(m_Connection, query.CStr());
+}
+
+bool IdoPgsqlConnection::SendStatements(const String& query)
+{
+	return PQsendQuery(m_Connection, query.CStr());
+}
+
+PGresult *IdoPgsqlConnection::GetNextResult(void)
+{
+	return PQgetResult(m_Connection);
+}
+
+int IdoPgsqlConnection::GetResultAffectedRows(PGresult *result)
+{
+	return atoi(PQcmdTuples(result));
+}
+
 DbReference IdoPgsqlConnection::GetSequenceValue(const String& table, const String& column)
 {
 	AssertOnWorkQueue();
@@ -512,7 +646,7 @@ void IdoPgsqlConnection::InternalActivateObject(const DbObject::Ptr& dbobj)
 		SetObjectID(dbobj, GetSequenceValue(GetTablePrefix() + "objects", "object_id"));
 	} else {
 		qbuf << "UPDATE " + GetTablePrefix() + "objects SET is_active = 1 WHERE object_id = " << static_cast<long>(dbref);
-		Query(qbuf.str());
+		AsyncQuery(qbuf.str());
 	}
 }
 
@@ -535,7 +669,7 @@ void IdoPgsqlConnection::InternalDeactivateObject(const DbObject::Ptr& dbobj)
 
 	std::ostringstream qbuf;
 	qbuf << "UPDATE " + GetTablePrefix() + "objects SET is_active = 0 WHERE object_id = " << static_cast<long>(dbref);
-	Query(qbuf.str());
+	AsyncQuery(qbuf.str());
 
 	/* Note that we're _NOT_ clearing the db refs via SetReference/SetConfigUpdate/SetStatusUpdate
 	 * because the object is still in the database. */
@@ -607,9 +741,33 @@ void IdoPgsqlConnection::ExecuteQuery(const DbQuery& query)
 {
 	ASSERT(query.Category != DbCatInvalid);
 
+	/* newer status updates replace the fields of pending updates for the same row */
+	if (CanCoalesceQuery(query)) {
+		unsigned long id;
+
+		if (AddCoalescedQuery(query, &id))
+			m_QueryQueue.Enqueue(boost::bind(&IdoPgsqlConnection::InternalExecuteCoalescedQuery, this, id), true);
+
+		return;
+	}
+
+	CloseCoalescedQueries(query);
+
 	m_QueryQueue.Enqueue(boost::bind(&IdoPgsqlConnection::InternalExecuteQuery, this, query, (DbQueryType *)NULL), true);
 }
 
+void IdoPgsqlConnection::InternalExecuteCoalescedQuery(unsigned long id)
+{
+	AssertOnWorkQueue();
+
+	DbQuery query;
+
+	if (!TakeCoalescedQuery(id, &query))
+		return;
+
+	InternalExecuteQuery(query);
+}
+
 void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, DbQueryType *typeOverride)
 {
 	AssertOnWorkQueue();
@@ -721,13 +879,29 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, DbQueryType
 	if (type != DbQueryInsert)
 		qbuf << where.str();
 
-	Query(qbuf.str());
+	/* Upserts need the number of affected rows before deciding whether to insert the row: if
+	 * a batch contained two updates for a row which does not exist yet both would insert it.
+	 * CURRVAL() is only accurate if no other insert for the same table happened in between. */
+	if (upsert || (type == DbQueryInsert && ((query.Object && query.ConfigUpdate) || (query.Table == "notifications" && query.NotificationObject)))) {
+		Query(qbuf.str());
+		FinishExecuteQuery(query, type, upsert);
+	} else
+		AsyncQuery(qbuf.str(), boost::bind(&IdoPgsqlConnection::FinishExecuteQuery, this, query, type, upsert));
+}
+
+void IdoPgsqlConnection::FinishExecuteQuery(const DbQuery& query, int type, bool upsert)
+{
+	if (upsert) {
+		if (GetAffectedRows() == 0) {
+			DbQueryType to = DbQueryInsert;
+			InternalExecuteQuery(query, &to);
 
-	if (upsert && GetAffectedRows() == 0) {
-		DbQueryType to = DbQueryInsert;
-		InternalExecuteQuery(query, &to);
+			return;
+		}
 
-		return;
+		/* the row exists, further updates can be sent without checking the number of affected rows */
+		if (!query.ConfigUpdate && query.StatusUpdate)
+			SetStatusUpdate(query.Object, true);
 	}
 
 	if (type == DbQueryInsert && query.Object) {
@@ -765,7 +939,7 @@ void IdoPgsqlConnection::InternalCleanUpExecuteQuery(const String& table, const
 	if (!GetConnected())
 		return;
 
-	Query("DELETE FROM " + GetTablePrefix() + table + " WHERE instance_id = " +
+	AsyncQuery("DELETE FROM " + GetTablePrefix() + table + " WHERE instance_id = " +
 	    Convert::ToString(static_cast<long>(m_InstanceID)) + " AND " + time_column +
 	    " < TO_TIMESTAMP(" + Convert::ToString(static_cast<long>(max_age)) + ")");
 }
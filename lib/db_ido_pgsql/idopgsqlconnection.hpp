@@ -31,6 +31,14 @@ namespace icinga
 
 typedef boost::shared_ptr<PGresult> IdoPgsqlResult;
 
+typedef boost::function<void (const IdoPgsqlResult&)> IdoPgsqlAsyncCallback;
+
+struct IdoPgsqlAsyncQuery
+{
+	String Query;
+	IdoPgsqlAsyncCallback Callback;
+};
+
 /**
  * An IDO pgSQL database connection.
  *
@@ -59,6 +67,13 @@ protected:
 	virtual void FillIDCache(const DbType::Ptr& type) override;
 	virtual void NewTransaction(void) override;
 
+	/* libpq calls which talk to the server, the unit tests replace them */
+	virtual PGresult *ExecuteStatement(const String& query);
+	virtual bool SendStatements(const String& query);
+	virtual PGresult *GetNextResult(void);
+	virtual int GetResultAffectedRows(PGresult *result);
+	virtual String Escape(const String& s);
+
 private:
 	DbReference m_InstanceID;
 
@@ -67,15 +82,19 @@ private:
 	PGconn *m_Connection;
 	int m_AffectedRows;
 
+	std::vector<IdoPgsqlAsyncQuery> m_AsyncQueries;
+
 	Timer::Ptr m_ReconnectTimer;
 	Timer::Ptr m_TxTimer;
 
 	IdoPgsqlResult Query(const String& query);
 	DbReference GetSequenceValue(const String& table, const String& column);
 	int GetAffectedRows(void);
-	String Escape(const String& s);
 	Dictionary::Ptr FetchRow(const IdoPgsqlResult& result, int row);
 
+	void AsyncQuery(const String& query, const IdoPgsqlAsyncCallback& callback = IdoPgsqlAsyncCallback());
+	void FinishAsyncQueries(bool force = false);
+
 	bool FieldToEscapedString(const String& key, const Value& value, Value *result);
 	void InternalActivateObject(const DbObject::Ptr& dbobj);
 	void InternalDeactivateObject(const DbObject::Ptr& dbobj);
@@ -90,6 +109,8 @@ private:
 	void ReconnectTimerHandler(void);
 
 	void InternalExecuteQuery(const DbQuery& query, DbQueryType *typeOverride = NULL);
+	void InternalExecuteCoalescedQuery(unsigned long id);
+	void FinishExecuteQuery(const DbQuery& query, int type, bool upsert);
 	void InternalCleanUpExecuteQuery(const String& table, const String& time_key, double time_value);
 
 	virtual void ClearConfigTable(const String& table) override;
@@ -20,20 +20,59 @@
 #include "icinga/service.hpp"
 #include "icinga/dependency.hpp"
 #include "base/logger.hpp"
+#include "base/initialize.hpp"
 #include <boost/foreach.hpp>
 
 using namespace icinga;
 
+INITIALIZE_ONCE(&Checkable::StaticInitializeReachability);
+
+/* called after the reachability was evaluated and before the result is cached */
+boost::signals2::signal<void (const Checkable::Ptr&, DependencyType)> Checkable::OnReachabilityEvaluated;
+
+/* Incremented before and after the reachability cache entries are
+ * invalidated: results computed while an invalidation is in progress
+ * are not cached. */
+static boost::mutex l_ReachabilityEpochMutex;
+static unsigned long l_ReachabilityEpoch = 0;
+
+static unsigned long GetReachabilityEpoch(void)
+{
+	boost::mutex::scoped_lock lock(l_ReachabilityEpochMutex);
+	return l_ReachabilityEpoch;
+}
+
+static void IncrementReachabilityEpoch(void)
+{
+	boost::mutex::scoped_lock lock(l_ReachabilityEpochMutex);
+	l_ReachabilityEpoch++;
+}
+
+void Checkable::StaticInitializeReachability(void)
+{
+	Checkable::OnStateRawChanged.connect(boost::bind(&Checkable::ReachabilityStateChangedHandler, _1));
+	Checkable::OnStateTypeChanged.connect(boost::bind(&Checkable::ReachabilityStateChangedHandler, _1));
+	Checkable::OnLastCheckResultChanged.connect(boost::bind(&Checkable::ReachabilityStateChangedHandler, _1));
+}
+
 void Checkable::AddDependency(const Dependency::Ptr& dep)
 {
-	boost::mutex::scoped_lock lock(m_DependencyMutex);
-	m_Dependencies.insert(dep);
+	{
+		boost::mutex::scoped_lock lock(m_DependencyMutex);
+		m_Dependencies.insert(dep);
+	}
+
+	InvalidateReachability();
 }
 
 void Checkable::RemoveDependency(const Dependency::Ptr& dep)
 {
-	boost::mutex::scoped_lock lock(m_DependencyMutex);
-	m_Dependencies.erase(dep);
+	{
+		boost::mutex::scoped_lock lock(m_DependencyMutex);
+		m_Dependencies.erase(dep);
+	}
+
+	InvalidateReachability();
 }
 
 std::set<Dependency::Ptr> Checkable::GetDependencies(void) const
@@ -62,16 +101,78 @@ std::set<Dependency::Ptr> Checkable::GetReverseDependencies(void) const
 
 bool Checkable::IsReachable(DependencyType dt, Dependency::Ptr *failedDependency, int rstack) const
 {
+	bool cacheable;
+	return IsReachableInternal(dt, failedDependency, rstack, &cacheable);
+}
+
+bool Checkable::IsReachableInternal(DependencyType dt, Dependency::Ptr *failedDependency, int rstack, bool *cacheable) const
+{
+	{
+		boost::mutex::scoped_lock lock(m_ReachabilityMutex);
+
+		const ReachabilityCacheEntry& entry = m_ReachabilityCache[dt];
+
+		if (entry.Valid) {
+			m_ReachabilityCacheHits++;
+
+			if (failedDependency)
+				*failedDependency = entry.FailedDependency;
+
+			*cacheable = true;
+			return entry.Reachable;
+		}
+
+		m_ReachabilityCacheMisses++;
+	}
+
+	unsigned long epoch = GetReachabilityEpoch();
+
+	Dependency::Ptr failed;
+	bool reachable = EvaluateReachability(dt, &failed, rstack, cacheable);
+
+	if (failedDependency)
+		*failedDependency = failed;
+
+	OnReachabilityEvaluated(const_cast<Checkable *>(this), dt);
+
+	if (*cacheable) {
+		boost::mutex::scoped_lock lock(m_ReachabilityMutex);
+
+		/* InvalidateReachability() increments the epoch before it clears
+		 * the entries, which requires m_ReachabilityMutex */
+		if (GetReachabilityEpoch() == epoch) {
+			ReachabilityCacheEntry& entry = m_ReachabilityCache[dt];
+			entry.Valid = true;
+			entry.Reachable = reachable;
+			entry.FailedDependency = failed;
+		}
+	}
+
+	return reachable;
+}
+
+bool Checkable::EvaluateReachability(DependencyType dt, Dependency::Ptr *failedDependency, int rstack, bool *cacheable) const
+{
+	*cacheable = true;
+
 	if (rstack > 20) {
 		Log(LogWarning, "Checkable")
 		    << "Too many nested dependencies for service '" << GetName() << "': Dependency failed.";
 
+		*cacheable = false;
 		return false;
 	}
 
 	BOOST_FOREACH(const Checkable::Ptr& checkable, GetParents()) {
-		if (!checkable->IsReachable(dt, failedDependency, rstack + 1))
+		bool parentCacheable;
+
+		if (!checkable->IsReachableInternal(dt, failedDependency, rstack + 1, &parentCacheable)) {
+			*cacheable = parentCacheable;
 			return false;
+		}
+
+		if (!parentCacheable)
+			*cacheable = false;
 	}
 
 	/* implicit dependency on host if this is a service */
@@ -80,28 +181,106 @@ bool Checkable::IsReachable(DependencyType dt, Dependency::Ptr *failedDependency
 		Host::Ptr host = service->GetHost();
 
 		if (host && host->GetState() != HostUp && host->GetStateType() == StateTypeHard) {
-			if (failedDependency)
-				*failedDependency = Dependency::Ptr();
-
+			*failedDependency = Dependency::Ptr();
 			return false;
 		}
 	}
 
 	BOOST_FOREACH(const Dependency::Ptr& dep, GetDependencies()) {
-		if (!dep->IsAvailable(dt)) {
-			if (failedDependency)
-				*failedDependency = dep;
+		/* time periods change without notice */
+		if (dep->GetPeriod())
+			*cacheable = false;
 
+		if (!dep->IsAvailable(dt)) {
+			*failedDependency = dep;
 			return false;
 		}
 	}
 
-	if (failedDependency)
-		*failedDependency = Dependency::Ptr();
-
+	*failedDependency = Dependency::Ptr();
 	return true;
 }
 
+/**
+ * Invalidates the cached reachability of this checkable and all checkables
+ * which depend on it.
+ */
+void Checkable::InvalidateReachability(void)
+{
+	IncrementReachabilityEpoch();
+
+	std::vector<Checkable::Ptr> pending;
+	std::set<Checkable *> seen;
+
+	pending.push_back(this);
+
+	while (!pending.empty()) {
+		Checkable::Ptr checkable = pending.back();
+		pending.pop_back();
+
+		if (!seen.insert(checkable.get()).second)
+			continue;
+
+		{
+			boost::mutex::scoped_lock lock(checkable->m_ReachabilityMutex);
+
+			for (int i = 0; i <= DependencyNotification; i++) {
+				checkable->m_ReachabilityCache[i].Valid = false;
+				checkable->m_ReachabilityCache[i].FailedDependency.reset();
+			}
+		}
+
+		BOOST_FOREACH(const Checkable::Ptr& child, checkable->GetChildren()) {
+			pending.push_back(child);
+		}
+
+		Host::Ptr host = dynamic_pointer_cast<Host>(checkable);
+
+		if (host) {
+			BOOST_FOREACH(const Service::Ptr& service, host->GetServices()) {
+				pending.push_back(service);
+			}
+		}
+	}
+
+	IncrementReachabilityEpoch();
+}
+
+void Checkable::ReachabilityStateChangedHandler(const Checkable::Ptr& checkable)
+{
+	/* Only the state, state type and whether the checkable has been checked
+	 * at all are relevant for the dependencies on this checkable. */
+	int key = checkable->GetStateRaw() * 4 + checkable->GetStateType() * 2 + (checkable->GetLastCheckResult() ? 1 : 0);
+
+	{
+		boost::mutex::scoped_lock lock(checkable->m_ReachabilityMutex);
+
+		if (checkable->m_ReachabilityStateKey == key)
+			return;
+
+		checkable->m_ReachabilityStateKey = key;
+	}
+
+	BOOST_FOREACH(const Checkable::Ptr& child, checkable->GetChildren()) {
+		child->InvalidateReachability();
+	}
+
+	Host::Ptr host = dynamic_pointer_cast<Host>(checkable);
+
+	if (host) {
+		BOOST_FOREACH(const Service::Ptr& service, host->GetServices()) {
+			service->InvalidateReachability();
+		}
+	}
+}
+
+void Checkable::GetReachabilityCacheStatistics(unsigned long& hits, unsigned long& misses) const
+{
+	boost::mutex::scoped_lock lock(m_ReachabilityMutex);
+	hits += m_ReachabilityCacheHits;
+	misses += m_ReachabilityCacheMisses;
+}
+
 std::set<Checkable::Ptr> Checkable::GetParents(void) const
 {
 	std::set<Checkable::Ptr> parents;
@@ -35,9 +35,12 @@ boost::signals2::signal<void (const Checkable::Ptr&, const String&, const String
 boost::signals2::signal<void (const Checkable::Ptr&, const MessageOrigin::Ptr&)> Checkable::OnAcknowledgementCleared;
 
 Checkable::Checkable(void)
-	: m_CheckRunning(false)
+	: m_CheckRunning(false), m_ReachabilityCacheHits(0), m_ReachabilityCacheMisses(0), m_ReachabilityStateKey(-1)
 {
 	SetSchedulingOffset(Utility::Random());
+
+	for (int i = 0; i <= DependencyNotification; i++)
+		m_ReachabilityCache[i].Valid = false;
 }
 
 void Checkable::Start(void)
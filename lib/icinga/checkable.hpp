@@ -78,6 +78,10 @@ public:
 	//bool IsHostCheck(void) const;
 
 	bool IsReachable(DependencyType dt = DependencyState, intrusive_ptr<Dependency> *failedDependency = NULL, int rstack = 0) const;
+	void InvalidateReachability(void);
+	void GetReachabilityCacheStatistics(unsigned long& hits, unsigned long& misses) const;
+
+	static void StaticInitializeReachability(void);
 
 	AcknowledgementType GetAcknowledgement(void);
 
@@ -113,6 +117,7 @@ public:
 	static boost::signals2::signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, const MessageOrigin::Ptr&)> OnNewCheckResult;
 	static boost::signals2::signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, StateType, const MessageOrigin::Ptr&)> OnStateChange;
 	static boost::signals2::signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, std::set<Checkable::Ptr>, const MessageOrigin::Ptr&)> OnReachabilityChanged;
+	static boost::signals2::signal<void (const Checkable::Ptr&, DependencyType)> OnReachabilityEvaluated;
 	static boost::signals2::signal<void (const Checkable::Ptr&, NotificationType, const CheckResult::Ptr&,
 	    const String&, const String&)> OnNotificationsRequested;
 	static boost::signals2::signal<void (const Notification::Ptr&, const Checkable::Ptr&, const std::set<User::Ptr>&,
@@ -234,6 +239,25 @@ private:
 	mutable boost::mutex m_DependencyMutex;
 	std::set<intrusive_ptr<Dependency> > m_Dependencies;
 	std::set<intrusive_ptr<Dependency> > m_ReverseDependencies;
+
+	/* Reachability */
+	struct ReachabilityCacheEntry
+	{
+		bool Valid;
+		bool Reachable;
+		intrusive_ptr<Dependency> FailedDependency;
+	};
+
+	mutable boost::mutex m_ReachabilityMutex;
+	mutable ReachabilityCacheEntry m_ReachabilityCache[DependencyNotification + 1];
+	mutable unsigned long m_ReachabilityCacheHits;
+	mutable unsigned long m_ReachabilityCacheMisses;
+	int m_ReachabilityStateKey;
+
+	bool IsReachableInternal(DependencyType dt, intrusive_ptr<Dependency> *failedDependency, int rstack, bool *cacheable) const;
+	bool EvaluateReachability(DependencyType dt, intrusive_ptr<Dependency> *failedDependency, int rstack, bool *cacheable) const;
+
+	static void ReachabilityStateChangedHandler(const Checkable::Ptr& checkable);
 };
 
 }
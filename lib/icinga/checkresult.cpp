@@ -19,7 +19,11 @@
 
 #include "icinga/checkresult.hpp"
 #include "icinga/checkresult.tcpp"
+#include "icinga/perfdatavalue.hpp"
 #include "base/scriptglobal.hpp"
+#include "base/objectlock.hpp"
+#include "base/logger.hpp"
+#include <boost/foreach.hpp>
 
 using namespace icinga;
 
@@ -36,3 +40,45 @@ void CheckResult::StaticInitialize(void)
 	ScriptGlobal::Set("HostUp", HostUp);
 	ScriptGlobal::Set("HostDown", HostDown);
 }
+
+/**
+ * Returns the performance data as PerfdataValue objects. The values are
+ * parsed only once and the array is shared by all callers, so it must not
+ * be modified. Invalid values are skipped.
+ *
+ * @returns The performance data values.
+ */
+Array::Ptr CheckResult::GetPerfdataValues(void) const
+{
+	Array::Ptr perfdata = GetPerformanceData();
+
+	ObjectLock olock(this);
+
+	if (m_PerfdataValues && m_PerfdataSource == perfdata)
+		return m_PerfdataValues;
+
+	Array::Ptr values = new Array();
+
+	if (perfdata) {
+		ObjectLock plock(perfdata);
+
+		BOOST_FOREACH(const Value& val, perfdata) {
+			if (val.IsObjectType<PerfdataValue>()) {
+				values->Add(val);
+				continue;
+			}
+
+			try {
+				values->Add(PerfdataValue::Parse(val));
+			} catch (const std::exception&) {
+				Log(LogWarning, "CheckResult")
+				    << "Ignoring invalid perfdata value: " << val;
+			}
+		}
+	}
+
+	m_PerfdataSource = perfdata;
+	m_PerfdataValues = values;
+
+	return values;
+}
@@ -37,6 +37,12 @@ public:
 	DECLARE_OBJECT(CheckResult);
 
 	static void StaticInitialize(void);
+
+	Array::Ptr GetPerfdataValues(void) const;
+
+private:
+	mutable Array::Ptr m_PerfdataSource;
+	mutable Array::Ptr m_PerfdataValues;
 };
 
 }
@@ -315,4 +315,20 @@ void CIB::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata) {
 	status->Set("num_hosts_flapping", hs.hosts_flapping);
 	status->Set("num_hosts_in_downtime", hs.hosts_in_downtime);
 	status->Set("num_hosts_acknowledged", hs.hosts_acknowledged);
+
+	unsigned long reachabilityHits = 0, reachabilityMisses = 0;
+
+	BOOST_FOREACH(const Host::Ptr& host, ConfigType::GetObjectsByType<Host>()) {
+		host->GetReachabilityCacheStatistics(reachabilityHits, reachabilityMisses);
+	}
+
+	BOOST_FOREACH(const Service::Ptr& service, ConfigType::GetObjectsByType<Service>()) {
+		service->GetReachabilityCacheStatistics(reachabilityHits, reachabilityMisses);
+	}
+
+	status->Set("reachability_cache_hits", reachabilityHits);
+	status->Set("reachability_cache_misses", reachabilityMisses);
+
+	unsigned long reachabilityLookups = reachabilityHits + reachabilityMisses;
+	status->Set("reachability_cache_hit_rate", reachabilityLookups > 0 ? reachabilityHits * 100.0 / reachabilityLookups : 0);
 }
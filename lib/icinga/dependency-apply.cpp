@@ -159,12 +159,15 @@ void Dependency::EvaluateApplyRules(const Host::Ptr& host)
 {
 	CONTEXT("Evaluating 'apply' rules for host '" + host->GetName() + "'");
 
-	BOOST_FOREACH(ApplyRule& rule, ApplyRule::GetRules("Dependency")) {
-		if (rule.GetTargetType() != "Host")
+	Dictionary::Ptr variables = new Dictionary();
+	variables->Set("host", host);
+
+	BOOST_FOREACH(ApplyRule *rule, ApplyRule::GetCandidateRules("Dependency", variables)) {
+		if (rule->GetTargetType() != "Host")
 			continue;
 
-		if (EvaluateApplyRule(host, rule))
-			rule.AddMatch();
+		if (EvaluateApplyRule(host, *rule))
+			rule->AddMatch();
 	}
 }
 
@@ -172,11 +175,15 @@ void Dependency::EvaluateApplyRules(const Service::Ptr& service)
 {
 	CONTEXT("Evaluating 'apply' rules for service '" + service->GetName() + "'");
 
-	BOOST_FOREACH(ApplyRule& rule, ApplyRule::GetRules("Dependency")) {
-		if (rule.GetTargetType() != "Service")
+	Dictionary::Ptr variables = new Dictionary();
+	variables->Set("host", service->GetHost());
+	variables->Set("service", service);
+
+	BOOST_FOREACH(ApplyRule *rule, ApplyRule::GetCandidateRules("Dependency", variables)) {
+		if (rule->GetTargetType() != "Service")
 			continue;
 
-		if (EvaluateApplyRule(service, rule))
-			rule.AddMatch();
+		if (EvaluateApplyRule(service, *rule))
+			rule->AddMatch();
 	}
 }
@@ -22,6 +22,7 @@
 #include "icinga/service.hpp"
 #include "base/logger.hpp"
 #include "base/exception.hpp"
+#include "base/initialize.hpp"
 #include <boost/foreach.hpp>
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/classification.hpp>
@@ -29,6 +30,25 @@
 using namespace icinga;
 
 REGISTER_TYPE(Dependency);
+INITIALIZE_ONCE(&Dependency::StaticInitialize);
+
+void Dependency::StaticInitialize(void)
+{
+	OnPeriodRawChanged.connect(boost::bind(&Dependency::ConfigChangedHandler, _1));
+	OnStatesChanged.connect(boost::bind(&Dependency::ConfigChangedHandler, _1));
+	OnStateFilterChanged.connect(boost::bind(&Dependency::ConfigChangedHandler, _1));
+	OnIgnoreSoftStatesChanged.connect(boost::bind(&Dependency::ConfigChangedHandler, _1));
+	OnDisableChecksChanged.connect(boost::bind(&Dependency::ConfigChangedHandler, _1));
+	OnDisableNotificationsChanged.connect(boost::bind(&Dependency::ConfigChangedHandler, _1));
+}
+
+void Dependency::ConfigChangedHandler(const Dependency::Ptr& dependency)
+{
+	Checkable::Ptr child = dependency->GetChild();
+
+	if (child)
+		child->InvalidateReachability();
+}
 
 String DependencyNameComposer::MakeName(const String& shortName, const Object::Ptr& context) const
 {
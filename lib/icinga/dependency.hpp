@@ -50,6 +50,7 @@ public:
 	bool IsAvailable(DependencyType dt) const;
 
 	static void RegisterApplyRuleHandler(void);
+	static void StaticInitialize(void);
 
 	virtual void ValidateStates(const Array::Ptr& value, const ValidationUtils& utils) override;
 
@@ -67,6 +68,8 @@ private:
 
 	static bool EvaluateApplyRuleInstance(const Checkable::Ptr& checkable, const String& name, ScriptFrame& frame, const ApplyRule& rule);
 	static bool EvaluateApplyRule(const Checkable::Ptr& checkable, const ApplyRule& rule);
+
+	static void ConfigChangedHandler(const Dependency::Ptr& dependency);
 };
 
 }
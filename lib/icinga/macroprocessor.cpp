@@ -23,13 +23,14 @@
 #include "base/array.hpp"
 #include "base/objectlock.hpp"
 #include "base/logger.hpp"
-#include "base/context.hpp"
 #include "base/configobject.hpp"
 #include "base/scriptframe.hpp"
 #include "base/convert.hpp"
 #include "base/exception.hpp"
 #include <boost/assign.hpp>
 #include <boost/foreach.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/locks.hpp>
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/classification.hpp>
@@ -89,22 +90,120 @@ Value MacroProcessor::ResolveMacros(const Value& str, const ResolverList& resolv
 	return result;
 }
 
-bool MacroProcessor::ResolveMacro(const String& macro, const ResolverList& resolvers,
-    const CheckResult::Ptr& cr, Value *result, bool *recursive_macro)
+namespace icinga
 {
-	CONTEXT("Resolving macro '" + macro + "'");
 
-	*recursive_macro = false;
+/**
+ * A macro in a format string. The macro name is split into the resolver
+ * name and the attribute path when the format string is compiled.
+ *
+ * @ingroup icinga
+ */
+struct MacroReference
+{
+	String Name;
+	String ObjName;
+	std::vector<String> Tokens;
+	String Path;
+};
 
-	std::vector<String> tokens;
-	boost::algorithm::split(tokens, macro, boost::is_any_of("."));
+/**
+ * A compiled format string. The literal text before, between and after the
+ * macros is stored in Literals, which has one more element than Macros.
+ *
+ * @ingroup icinga
+ */
+class MacroTemplate : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(MacroTemplate);
 
-	String objName;
-	if (tokens.size() > 1) {
-		objName = tokens[0];
-		tokens.erase(tokens.begin());
+	std::vector<String> Literals;
+	std::vector<MacroReference> Macros;
+
+	static MacroTemplate::Ptr Compile(const String& str);
+	static MacroTemplate::Ptr GetByString(const String& str);
+};
+
+}
+
+static boost::shared_mutex l_MacroTemplateMutex;
+static std::map<String, MacroTemplate::Ptr> l_MacroTemplates;
+
+/* format strings usually come from the configuration; this only guards
+ * against unbounded growth when they don't */
+static const size_t l_MacroTemplateCacheSize = 50000;
+
+MacroTemplate::Ptr MacroTemplate::Compile(const String& str)
+{
+	MacroTemplate::Ptr tmpl = new MacroTemplate();
+
+	size_t offset = 0, pos_first, pos_second;
+
+	while ((pos_first = str.FindFirstOf("$", offset)) != String::NPos) {
+		pos_second = str.FindFirstOf("$", pos_first + 1);
+
+		if (pos_second == String::NPos)
+			BOOST_THROW_EXCEPTION(std::runtime_error("Closing $ not found in macro format string '" + str + "'."));
+
+		tmpl->Literals.push_back(str.SubStr(offset, pos_first - offset));
+
+		MacroReference macro;
+		macro.Name = str.SubStr(pos_first + 1, pos_second - pos_first - 1);
+
+		boost::algorithm::split(macro.Tokens, macro.Name, boost::is_any_of("."));
+
+		if (macro.Tokens.size() > 1) {
+			macro.ObjName = macro.Tokens[0];
+			macro.Tokens.erase(macro.Tokens.begin());
+		}
+
+		macro.Path = boost::algorithm::join(macro.Tokens, ".");
+
+		tmpl->Macros.push_back(macro);
+
+		offset = pos_second + 1;
 	}
 
+	tmpl->Literals.push_back(str.SubStr(offset));
+
+	return tmpl;
+}
+
+/**
+ * Returns the compiled template for a format string. Templates are
+ * compiled once and shared by all threads.
+ */
+MacroTemplate::Ptr MacroTemplate::GetByString(const String& str)
+{
+	{
+		/* lookups only share the lock, the cache is filled when templates are first used */
+		boost::shared_lock<boost::shared_mutex> lock(l_MacroTemplateMutex);
+
+		std::map<String, MacroTemplate::Ptr>::const_iterator it = l_MacroTemplates.find(str);
+
+		if (it != l_MacroTemplates.end())
+			return it->second;
+	}
+
+	MacroTemplate::Ptr tmpl = Compile(str);
+
+	boost::unique_lock<boost::shared_mutex> lock(l_MacroTemplateMutex);
+
+	if (l_MacroTemplates.size() < l_MacroTemplateCacheSize)
+		l_MacroTemplates[str] = tmpl;
+
+	return tmpl;
+}
+
+bool MacroProcessor::ResolveMacro(const MacroReference& macro, const ResolverList& resolvers,
+    const CheckResult::Ptr& cr, Value *result, bool *recursive_macro)
+{
+	*recursive_macro = false;
+
+	const String& objName = macro.ObjName;
+	const std::vector<String>& tokens = macro.Tokens;
+
 	BOOST_FOREACH(const ResolverSpec& resolver, resolvers) {
 		if (!objName.IsEmpty() && objName != resolver.first)
 			continue;
@@ -115,8 +214,8 @@ bool MacroProcessor::ResolveMacro(const String& macro, const ResolverList& resol
 			if (dobj) {
 				Dictionary::Ptr vars = dobj->GetVars();
 
-				if (vars && vars->Contains(macro)) {
-					*result = vars->Get(macro);
+				if (vars && vars->Contains(macro.Name)) {
+					*result = vars->Get(macro.Name);
 					*recursive_macro = true;
 					return true;
 				}
@@ -125,9 +224,8 @@ bool MacroProcessor::ResolveMacro(const String& macro, const ResolverList& resol
 
 		MacroResolver *mresolver = dynamic_cast<MacroResolver *>(resolver.second.get());
 
-		if (mresolver && mresolver->ResolveMacro(boost::algorithm::join(tokens, "."), cr, result))
+		if (mresolver && mresolver->ResolveMacro(macro.Path, cr, result))
 			return true;
-
 		Value ref = resolver.second;
 		bool valid = true;
 
@@ -227,43 +325,35 @@ Value MacroProcessor::InternalResolveMacros(const String& str, const ResolverLis
     const MacroProcessor::EscapeCallback& escapeFn, const Dictionary::Ptr& resolvedMacros,
     bool useResolvedMacros, int recursionLevel)
 {
-	CONTEXT("Resolving macros for string '" + str + "'");
-
 	if (recursionLevel > 15)
 		BOOST_THROW_EXCEPTION(std::runtime_error("Infinite recursion detected while resolving macros"));
 
-	size_t offset, pos_first, pos_second;
-	offset = 0;
-
-	Dictionary::Ptr resolvers_this;
+	if (str.FindFirstOf("$") == String::NPos)
+		return str;
 
-	String result = str;
-	while ((pos_first = result.FindFirstOf("$", offset)) != String::NPos) {
-		pos_second = result.FindFirstOf("$", pos_first + 1);
+	MacroTemplate::Ptr tmpl = MacroTemplate::GetByString(str);
 
-		if (pos_second == String::NPos)
-			BOOST_THROW_EXCEPTION(std::runtime_error("Closing $ not found in macro format string."));
+	String result = tmpl->Literals[0];
 
-		String name = result.SubStr(pos_first + 1, pos_second - pos_first - 1);
+	for (std::vector<MacroReference>::size_type i = 0; i < tmpl->Macros.size(); i++) {
+		const MacroReference& macro = tmpl->Macros[i];
+		const String& name = macro.Name;
 
 		Value resolved_macro;
-		bool recursive_macro;
+		bool recursive_macro = false;
 		bool found;
 
-		if (useResolvedMacros) {
-			recursive_macro = false;
+		/* $$ is an escape sequence for $. */
+		if (name.IsEmpty()) {
+			resolved_macro = "$";
+			found = true;
+		} else if (useResolvedMacros) {
 			found = resolvedMacros->Contains(name);
 
 			if (found)
 				resolved_macro = resolvedMacros->Get(name);
 		} else
-			found = ResolveMacro(name, resolvers, cr, &resolved_macro, &recursive_macro);
-
-		/* $$ is an escape sequence for $. */
-		if (name.IsEmpty()) {
-			resolved_macro = "$";
-			found = true;
-		}
+			found = ResolveMacro(macro, resolvers, cr, &resolved_macro, &recursive_macro);
 
 		if (resolved_macro.IsObjectType<Function>()) {
 			resolved_macro = EvaluateFunction(resolved_macro, resolvers, cr, escapeFn,
@@ -309,29 +399,20 @@ Value MacroProcessor::InternalResolveMacros(const String& str, const ResolverLis
 			resolved_macro = escapeFn(resolved_macro);
 
 		/* we're done if this is the only macro and there are no other non-macro parts in the string */
-		if (pos_first == 0 && pos_second == str.GetLength() - 1)
-			return resolved_macro;
-		else if (resolved_macro.IsObjectType<Array>())
-				BOOST_THROW_EXCEPTION(std::invalid_argument("Mixing both strings and non-strings in macros is not allowed."));
-
-		if (resolved_macro.IsObjectType<Array>()) {
-			/* don't allow mixing strings and arrays in macro strings */
-			if (pos_first != 0 || pos_second != str.GetLength() - 1)
-				BOOST_THROW_EXCEPTION(std::invalid_argument("Mixing both strings and non-strings in macros is not allowed."));
-
+		if (tmpl->Macros.size() == 1 && tmpl->Literals[0].IsEmpty() && tmpl->Literals[1].IsEmpty())
 			return resolved_macro;
-		}
 
-		String resolved_macro_str = resolved_macro;
+		/* don't allow mixing strings and arrays in macro strings */
+		if (resolved_macro.IsObjectType<Array>())
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Mixing both strings and non-strings in macros is not allowed."));
 
-		result.Replace(pos_first, pos_second - pos_first + 1, resolved_macro_str);
-		offset = pos_first + resolved_macro_str.GetLength();
+		result += static_cast<String>(resolved_macro);
+		result += tmpl->Literals[i + 1];
 	}
 
 	return result;
 }
 
-
 bool MacroProcessor::ValidateMacroString(const String& macro)
 {
 	if (macro.IsEmpty())
@@ -29,6 +29,8 @@
 namespace icinga
 {
 
+struct MacroReference;
+
 /**
  * Resolves macros.
  *
@@ -57,7 +59,7 @@ public:
 private:
 	MacroProcessor(void);
 
-	static bool ResolveMacro(const String& macro, const ResolverList& resolvers,
+	static bool ResolveMacro(const MacroReference& macro, const ResolverList& resolvers,
 		const CheckResult::Ptr& cr, Value *result, bool *recursive_macro);
 	static Value InternalResolveMacros(const String& str,
 	    const ResolverList& resolvers, const CheckResult::Ptr& cr,
@@ -157,13 +157,15 @@ void Notification::EvaluateApplyRules(const Host::Ptr& host)
 {
 	CONTEXT("Evaluating 'apply' rules for host '" + host->GetName() + "'");
 
-	BOOST_FOREACH(ApplyRule& rule, ApplyRule::GetRules("Notification"))
-	{
-		if (rule.GetTargetType() != "Host")
+	Dictionary::Ptr variables = new Dictionary();
+	variables->Set("host", host);
+
+	BOOST_FOREACH(ApplyRule *rule, ApplyRule::GetCandidateRules("Notification", variables)) {
+		if (rule->GetTargetType() != "Host")
 			continue;
 
-		if (EvaluateApplyRule(host, rule))
-			rule.AddMatch();
+		if (EvaluateApplyRule(host, *rule))
+			rule->AddMatch();
 	}
 }
 
@@ -171,11 +173,15 @@ void Notification::EvaluateApplyRules(const Service::Ptr& service)
 {
 	CONTEXT("Evaluating 'apply' rules for service '" + service->GetName() + "'");
 
-	BOOST_FOREACH(ApplyRule& rule, ApplyRule::GetRules("Notification")) {
-		if (rule.GetTargetType() != "Service")
+	Dictionary::Ptr variables = new Dictionary();
+	variables->Set("host", service->GetHost());
+	variables->Set("service", service);
+
+	BOOST_FOREACH(ApplyRule *rule, ApplyRule::GetCandidateRules("Notification", variables)) {
+		if (rule->GetTargetType() != "Service")
 			continue;
 
-		if (EvaluateApplyRule(service, rule))
-			rule.AddMatch();
+		if (EvaluateApplyRule(service, *rule))
+			rule->AddMatch();
 	}
 }
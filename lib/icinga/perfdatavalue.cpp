@@ -23,9 +23,11 @@
 #include "base/exception.hpp"
 #include "base/logger.hpp"
 #include "base/function.hpp"
-#include <boost/algorithm/string/case_conv.hpp>
-#include <boost/algorithm/string/split.hpp>
-#include <boost/algorithm/string/classification.hpp>
+#include <algorithm>
+#include <functional>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
 
 using namespace icinga;
 
@@ -49,11 +51,42 @@ PerfdataValue::PerfdataValue(String label, double value, bool counter,
 	SetMax(max, true);
 }
 
+static inline bool IsNumberChar(char ch)
+{
+	return (ch >= '0' && ch <= '9') || ch == '+' || ch == '-' || ch == '.' || ch == 'e';
+}
+
+/**
+ * Converts a number which consists of the characters "+-0123456789.e".
+ * Like Convert::ToDouble() the whole string must be a valid number.
+ */
+static double ParseNumber(const char *begin, const char *end)
+{
+	char buf[64];
+	size_t length = end - begin;
+
+	if (length == 0 || length >= sizeof(buf))
+		return Convert::ToDouble(String(begin, end));
+
+	memcpy(buf, begin, length);
+	buf[length] = '\0';
+
+	char *last;
+	double value = strtod(buf, &last);
+
+	if (last != buf + length)
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Can't convert '" + String(begin, end) + "' to a floating point number."));
+
+	return value;
+}
+
 PerfdataValue::Ptr PerfdataValue::Parse(const String& perfdata)
 {
-	size_t eqp = perfdata.FindLastOf('=');
+	const std::string& data = perfdata.GetData();
+
+	size_t eqp = data.rfind('=');
 
-	if (eqp == String::NPos)
+	if (eqp == std::string::npos)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid performance data value: " + perfdata));
 
 	String label = perfdata.SubStr(0, eqp);
@@ -61,82 +94,82 @@ PerfdataValue::Ptr PerfdataValue::Parse(const String& perfdata)
 	if (label.GetLength() > 2 && label[0] == '\'' && label[label.GetLength() - 1] == '\'')
 		label = label.SubStr(1, label.GetLength() - 2);
 
-	size_t spq = perfdata.FindFirstOf(' ', eqp);
+	size_t spq = data.find(' ', eqp);
 
-	if (spq == String::NPos)
-		spq = perfdata.GetLength();
+	if (spq == std::string::npos)
+		spq = data.size();
 
-	String valueStr = perfdata.SubStr(eqp + 1, spq - eqp - 1);
-		
-	size_t pos = valueStr.FindFirstNotOf("+-0123456789.e");
+	/* value[unit][;warn[;crit[;min[;max]]]] */
+	const char *begin = data.c_str() + eqp + 1;
+	const char *end = data.c_str() + spq;
 
-	double value = Convert::ToDouble(valueStr.SubStr(0, pos));
+	const char *tokenEnd = std::find(begin, end, ';');
+	const char *unitBegin = begin;
 
-	std::vector<String> tokens;
-	boost::algorithm::split(tokens, valueStr, boost::is_any_of(";"));
+	while (unitBegin < tokenEnd && IsNumberChar(*unitBegin))
+		unitBegin++;
 
-	bool counter = false;
-	String unit;
-	Value warn, crit, min, max;
+	double value = ParseNumber(begin, unitBegin);
+
+	char unitBuf[8];
+	size_t unitLength = tokenEnd - unitBegin;
 
-	if (pos != String::NPos)
-		unit = valueStr.SubStr(pos, tokens[0].GetLength() - pos);
+	if (unitLength >= sizeof(unitBuf))
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid performance data unit: " + String(unitBegin, tokenEnd)));
 
-	boost::algorithm::to_lower(unit);
+	for (size_t i = 0; i < unitLength; i++)
+		unitBuf[i] = tolower(static_cast<unsigned char>(unitBegin[i]));
 
+	unitBuf[unitLength] = '\0';
+
+	bool counter = false;
+	String unit;
 	double base = 1.0;
 
-	if (unit == "us") {
+	if (strcmp(unitBuf, "us") == 0) {
 		base /= 1000.0 * 1000.0;
 		unit = "seconds";
-	} else if (unit == "ms") {
+	} else if (strcmp(unitBuf, "ms") == 0) {
 		base /= 1000.0;
 		unit = "seconds";
-	} else if (unit == "s") {
+	} else if (strcmp(unitBuf, "s") == 0) {
 		unit = "seconds";
-	} else if (unit == "tb") {
+	} else if (strcmp(unitBuf, "tb") == 0) {
 		base *= 1024.0 * 1024.0 * 1024.0 * 1024.0;
 		unit = "bytes";
-	} else if (unit == "gb") {
+	} else if (strcmp(unitBuf, "gb") == 0) {
 		base *= 1024.0 * 1024.0 * 1024.0;
 		unit = "bytes";
-	} else if (unit == "mb") {
+	} else if (strcmp(unitBuf, "mb") == 0) {
 		base *= 1024.0 * 1024.0;
 		unit = "bytes";
-	} else if (unit == "kb") {
+	} else if (strcmp(unitBuf, "kb") == 0) {
 		base *= 1024.0;
 		unit = "bytes";
-	} else if (unit == "b") {
+	} else if (strcmp(unitBuf, "b") == 0) {
 		unit = "bytes";
-	} else if (unit == "%") {
+	} else if (strcmp(unitBuf, "%") == 0) {
 		unit = "percent";
-	} else if (unit == "c") {
+	} else if (strcmp(unitBuf, "c") == 0) {
 		counter = true;
-		unit = "";
-	} else if (unit != "") {
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid performance data unit: " + unit));
+	} else if (unitLength > 0) {
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid performance data unit: " + String(unitBuf)));
 	}
 
-	warn = ParseWarnCritMinMaxToken(tokens, 1, "warning");
-	crit = ParseWarnCritMinMaxToken(tokens, 2, "critical");
-	min = ParseWarnCritMinMaxToken(tokens, 3, "minimum");
-	max = ParseWarnCritMinMaxToken(tokens, 4, "maximum");
+	static const char * const descriptions[] = { "warning", "critical", "minimum", "maximum" };
+	Value thresholds[4];
 
-	value = value * base;
+	for (int i = 0; i < 4 && tokenEnd < end; i++) {
+		const char *tokenBegin = tokenEnd + 1;
+		tokenEnd = std::find(tokenBegin, end, ';');
 
-	if (!warn.IsEmpty())
-		warn = warn * base;
+		thresholds[i] = ParseWarnCritMinMaxToken(tokenBegin, tokenEnd, descriptions[i]);
 
-	if (!crit.IsEmpty())
-		crit = crit * base;
-
-	if (!min.IsEmpty())
-		min = min * base;
-
-	if (!max.IsEmpty())
-		max = max * base;
+		if (!thresholds[i].IsEmpty())
+			thresholds[i] = static_cast<double>(thresholds[i]) * base;
+	}
 
-	return new PerfdataValue(label, value, counter, unit, warn, crit, min, max);
+	return new PerfdataValue(label, value * base, counter, unit, thresholds[0], thresholds[1], thresholds[2], thresholds[3]);
 }
 
 String PerfdataValue::Format(void) const
@@ -182,14 +215,15 @@ String PerfdataValue::Format(void) const
 	return result.str();
 }
 
-Value PerfdataValue::ParseWarnCritMinMaxToken(const std::vector<String>& tokens, std::vector<String>::size_type index, const String& description)
+Value PerfdataValue::ParseWarnCritMinMaxToken(const char *begin, const char *end, const char *description)
 {
-	if (tokens.size() > index && tokens[index] != "U" && tokens[index] != "" && tokens[index].FindFirstNotOf("+-0123456789.e") == String::NPos)
-		return Convert::ToDouble(tokens[index]);
-	else {
-		if (tokens.size() > index && tokens[index] != "")
-			Log(LogDebug, "PerfdataValue")
-			    << "Ignoring unsupported perfdata " << description << " range, value: '" << tokens[index] << "'.";
+	if (begin == end)
 		return Empty;
-	}
+
+	if (!(end - begin == 1 && *begin == 'U') && std::find_if(begin, end, std::not1(std::ptr_fun(IsNumberChar))) == end)
+		return ParseNumber(begin, end);
+
+	Log(LogDebug, "PerfdataValue")
+	    << "Ignoring unsupported perfdata " << description << " range, value: '" << String(begin, end) << "'.";
+	return Empty;
 }
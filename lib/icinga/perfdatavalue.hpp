@@ -41,8 +41,7 @@ public:
 	String Format(void) const;
 
 private:
-	static Value ParseWarnCritMinMaxToken(const std::vector<String>& tokens,
-	    std::vector<String>::size_type index, const String& description);
+	static Value ParseWarnCritMinMaxToken(const char *begin, const char *end, const char *description);
 };
 
 }
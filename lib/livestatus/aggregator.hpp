@@ -23,10 +23,26 @@
 #include "livestatus/i2-livestatus.hpp"
 #include "livestatus/table.hpp"
 #include "livestatus/filter.hpp"
+#include <boost/shared_ptr.hpp>
 
 namespace icinga
 {
 
+/**
+ * Per-group state for an aggregator. Each group produced by a Stats query
+ * owns one state object for every aggregator. The state is created when
+ * the first row is added to the group, so groups without any rows have
+ * no state and GetResult() is called with NULL.
+ *
+ * @ingroup livestatus
+ */
+struct I2_LIVESTATUS_API AggregatorState
+{
+	typedef boost::shared_ptr<AggregatorState> Ptr;
+
+	virtual ~AggregatorState(void);
+};
+
 /**
  * @ingroup livestatus
  */
@@ -35,8 +51,8 @@ class I2_LIVESTATUS_API Aggregator : public Object
 public:
 	DECLARE_PTR_TYPEDEFS(Aggregator);
 
-	virtual void Apply(const Table::Ptr& table, const Value& row) = 0;
-	virtual double GetResult(void) const = 0;
+	virtual void Apply(const Table::Ptr& table, const Value& row, AggregatorState::Ptr& state) = 0;
+	virtual double GetResult(const AggregatorState *state) const = 0;
 	void SetFilter(const Filter::Ptr& filter);
 
 protected:
@@ -23,26 +23,80 @@
 #include "base/objectlock.hpp"
 #include "base/logger.hpp"
 #include <boost/foreach.hpp>
-#include <boost/regex.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 
 using namespace icinga;
 
 AttributeFilter::AttributeFilter(const String& column, const String& op, const String& operand)
-	: m_Column(column), m_Operator(op), m_Operand(operand)
-{ }
+	: m_Column(column), m_Operator(op), m_Operand(operand), m_Op(FilterUnknown),
+	  m_OperandIsNumber(false), m_OperandNumber(0)
+{
+	if (op == "=")
+		m_Op = FilterEqual;
+	else if (op == "=~")
+		m_Op = FilterEqualCaseInsensitive;
+	else if (op == "~")
+		m_Op = FilterRegex;
+	else if (op == "~~")
+		m_Op = FilterRegexCaseInsensitive;
+	else if (op == "<")
+		m_Op = FilterLess;
+	else if (op == ">")
+		m_Op = FilterGreater;
+	else if (op == "<=")
+		m_Op = FilterLessEqual;
+	else if (op == ">=")
+		m_Op = FilterGreaterEqual;
 
-bool AttributeFilter::Apply(const Table::Ptr& table, const Value& row)
+	try {
+		m_OperandNumber = Convert::ToDouble(operand);
+		m_OperandIsNumber = true;
+	} catch (const std::exception&) {
+		/* Not a number; GetOperandNumber() re-throws if the column needs one. */
+	}
+
+	if (m_Op == FilterRegex || m_Op == FilterRegexCaseInsensitive) {
+		try {
+			m_Regex = boost::make_shared<boost::regex>(operand.GetData(),
+			    m_Op == FilterRegexCaseInsensitive ? boost::regex::icase : boost::regex::normal);
+		} catch (const std::exception&) {
+			Log(LogWarning, "AttributeFilter")
+			    << "Regex '" << m_Column << " " << m_Operator << " " << m_Operand << "' error.";
+		}
+	}
+}
+
+/**
+ * Looks up the column once per table rather than once per row.
+ */
+const Column& AttributeFilter::GetColumn(const Table::Ptr& table)
 {
-	Column column = table->GetColumn(m_Column);
+	if (!m_ColumnCache || m_ColumnTable != table) {
+		m_ColumnCache = boost::make_shared<Column>(table->GetColumn(m_Column));
+		m_ColumnTable = table;
+	}
 
-	Value value = column.ExtractValue(row);
+	return *m_ColumnCache;
+}
+
+double AttributeFilter::GetOperandNumber(void) const
+{
+	if (m_OperandIsNumber)
+		return m_OperandNumber;
+	else
+		return Convert::ToDouble(m_Operand);
+}
+
+bool AttributeFilter::Apply(const Table::Ptr& table, const Value& row)
+{
+	Value value = GetColumn(table).ExtractValue(row);
 
 	if (value.IsObjectType<Array>()) {
 		Array::Ptr array = value;
 
-		if (m_Operator == ">=" || m_Operator == "<") {
-			bool negate = (m_Operator == "<");
+		if (m_Op == FilterGreaterEqual || m_Op == FilterLess) {
+			bool negate = (m_Op == FilterLess);
 
 			ObjectLock olock(array);
 			BOOST_FOREACH(const String& item, array) {
@@ -51,89 +105,62 @@ bool AttributeFilter::Apply(const Table::Ptr& table, const Value& row)
 			}
 
 			return negate; /* Item not found in list. */
-		} else if (m_Operator == "=") {
+		} else if (m_Op == FilterEqual) {
 			return (array->GetLength() == 0);
 		} else {
 			BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid operator for column '" + m_Column + "': " + m_Operator + " (expected '>=' or '=')."));
 		}
-	} else {
-		if (m_Operator == "=") {
+	}
+
+	switch (m_Op) {
+		case FilterEqual:
 			if (value.GetType() == ValueNumber || value.GetType() == ValueBoolean)
-				return (static_cast<double>(value) == Convert::ToDouble(m_Operand));
+				return (static_cast<double>(value) == GetOperandNumber());
 			else
 				return (static_cast<String>(value) == m_Operand);
-		} else if (m_Operator == "~") {
-			bool ret;
-			try {
-				boost::regex expr(m_Operand.GetData());
-				String operand = value;
-				boost::smatch what;
-				ret = boost::regex_search(operand.GetData(), what, expr);
-			} catch (boost::exception&) {
-				Log(LogWarning, "AttributeFilter")
-				    << "Regex '" << m_Operand << " " << m_Operator << " " << value << "' error.";
-				ret = false;
-			}
 
-			//Log(LogDebug, "LivestatusListener/AttributeFilter")
-			//    << "Attribute filter '" << m_Operand + " " << m_Operator << " "
-			//    << value << "' " << (ret ? "matches" : "doesn't match") << ".";
+		case FilterEqualCaseInsensitive:
+			return boost::iequals(static_cast<String>(value).GetData(), m_Operand.GetData());
 
-			return ret;
-		} else if (m_Operator == "=~") {
-			bool ret;
-			try {
-				String operand = value;
-				ret = boost::iequals(operand, m_Operand.GetData());
-			} catch (boost::exception&) {
-				Log(LogWarning, "AttributeFilter")
-				    << "Case-insensitive equality '" << m_Operand << " " << m_Operator << " " << value << "' error.";
-				ret = false;
-			}
+		case FilterRegex:
+		case FilterRegexCaseInsensitive:
+			if (!m_Regex)
+				return false;
 
-			return ret;
-		} else if (m_Operator == "~~") {
-			bool ret;
 			try {
-				boost::regex expr(m_Operand.GetData(), boost::regex::icase);
 				String operand = value;
-				boost::smatch what;
-				ret = boost::regex_search(operand.GetData(), what, expr);
-			} catch (boost::exception&) {
+				return boost::regex_search(operand.GetData(), *m_Regex);
+			} catch (const std::exception&) {
 				Log(LogWarning, "AttributeFilter")
 				    << "Regex '" << m_Operand << " " << m_Operator << " " << value << "' error.";
-				ret = false;
+				return false;
 			}
 
-			//Log(LogDebug, "LivestatusListener/AttributeFilter")
-			//    << "Attribute filter '" << m_Operand << " " << m_Operator << " "
-			//    << value << "' " << (ret ? "matches" : "doesn't match") << ".";
-
-			return ret;
-		} else if (m_Operator == "<") {
-			if (value.GetType() == ValueNumber)
-				return (static_cast<double>(value) < Convert::ToDouble(m_Operand));
-			else
-				return (static_cast<String>(value) < m_Operand);
-		} else if (m_Operator == ">") {
-			if (value.GetType() == ValueNumber)
-				return (static_cast<double>(value) > Convert::ToDouble(m_Operand));
-			else
-				return (static_cast<String>(value) > m_Operand);
-		} else if (m_Operator == "<=") {
-			if (value.GetType() == ValueNumber)
-				return (static_cast<double>(value) <= Convert::ToDouble(m_Operand));
-			else
-				return (static_cast<String>(value) <= m_Operand);
-		} else if (m_Operator == ">=") {
+		case FilterLess:
+		case FilterGreater:
+		case FilterLessEqual:
+		case FilterGreaterEqual:
 			if (value.GetType() == ValueNumber)
-				return (static_cast<double>(value) >= Convert::ToDouble(m_Operand));
+				return Compare<double>(m_Op, value, GetOperandNumber());
 			else
-				return (static_cast<String>(value) >= m_Operand);
-		} else {
+				return Compare<String>(m_Op, value, m_Operand);
+
+		default:
 			BOOST_THROW_EXCEPTION(std::invalid_argument("Unknown operator for column '" + m_Column + "': " + m_Operator));
-		}
 	}
+}
 
-	return false;
+String AttributeFilter::GetColumn(void) const
+{
+	return m_Column;
+}
+
+String AttributeFilter::GetOperator(void) const
+{
+	return m_Operator;
+}
+
+String AttributeFilter::GetOperand(void) const
+{
+	return m_Operand;
 }
@@ -21,6 +21,8 @@
 #define ATTRIBUTEFILTER_H
 
 #include "livestatus/filter.hpp"
+#include <boost/regex.hpp>
+#include <boost/smart_ptr/shared_ptr.hpp>
 
 using namespace icinga;
 
@@ -28,6 +30,9 @@ namespace icinga
 {
 
 /**
+ * A filter which compares a column with an operand. The operator, the operand
+ * and regular expressions are compiled once when the filter is created.
+ *
  * @ingroup livestatus
  */
 class I2_LIVESTATUS_API AttributeFilter : public Filter
@@ -39,10 +44,55 @@ public:
 
 	virtual bool Apply(const Table::Ptr& table, const Value& row) override;
 
+	String GetColumn(void) const;
+	String GetOperator(void) const;
+	String GetOperand(void) const;
+
 protected:
+	enum FilterOperator
+	{
+		FilterUnknown,
+		FilterEqual,
+		FilterEqualCaseInsensitive,
+		FilterRegex,
+		FilterRegexCaseInsensitive,
+		FilterLess,
+		FilterGreater,
+		FilterLessEqual,
+		FilterGreaterEqual
+	};
+
 	String m_Column;
 	String m_Operator;
 	String m_Operand;
+
+	FilterOperator m_Op;
+	bool m_OperandIsNumber;
+	double m_OperandNumber;
+	boost::shared_ptr<boost::regex> m_Regex;
+
+	Table::Ptr m_ColumnTable;
+	boost::shared_ptr<Column> m_ColumnCache;
+
+	const Column& GetColumn(const Table::Ptr& table);
+	double GetOperandNumber(void) const;
+
+	template<typename T>
+	static bool Compare(FilterOperator op, const T& value, const T& operand)
+	{
+		switch (op) {
+			case FilterLess:
+				return value < operand;
+			case FilterGreater:
+				return value > operand;
+			case FilterLessEqual:
+				return value <= operand;
+			case FilterGreaterEqual:
+				return value >= operand;
+			default:
+				return value == operand;
+		}
+	}
 };
 
 }
@@ -22,20 +22,35 @@
 using namespace icinga;
 
 AvgAggregator::AvgAggregator(const String& attr)
-    : m_Avg(0), m_AvgCount(0), m_AvgAttr(attr)
+    : m_AvgAttr(attr)
 { }
 
-void AvgAggregator::Apply(const Table::Ptr& table, const Value& row)
+AvgAggregatorState *AvgAggregator::EnsureState(AggregatorState::Ptr& state)
+{
+	if (!state)
+		state.reset(new AvgAggregatorState());
+
+	return static_cast<AvgAggregatorState *>(state.get());
+}
+
+void AvgAggregator::Apply(const Table::Ptr& table, const Value& row, AggregatorState::Ptr& state)
 {
 	Column column = table->GetColumn(m_AvgAttr);
 
 	Value value = column.ExtractValue(row);
 
-	m_Avg += value;
-	m_AvgCount++;
+	AvgAggregatorState *pstate = EnsureState(state);
+
+	pstate->Avg += value;
+	pstate->AvgCount++;
 }
 
-double AvgAggregator::GetResult(void) const
+double AvgAggregator::GetResult(const AggregatorState *state) const
 {
-	return (m_Avg / m_AvgCount);
+	if (!state)
+		return 0;
+
+	const AvgAggregatorState *pstate = static_cast<const AvgAggregatorState *>(state);
+
+	return pstate->Avg / pstate->AvgCount;
 }
@@ -66,34 +66,42 @@ String CommentsTable::GetPrefix(void) const
 void CommentsTable::FetchRows(const AddRowFunction& addRowFn)
 {
 	BOOST_FOREACH(const Host::Ptr& host, ConfigType::GetObjectsByType<Host>()) {
-		Dictionary::Ptr comments = host->GetComments();
-
-		ObjectLock olock(comments);
-
-		String id;
-		Comment::Ptr comment;
-		BOOST_FOREACH(tie(id, comment), comments) {
-			if (Host::GetOwnerByCommentID(id) == host) {
-				if (!addRowFn(comment, LivestatusGroupByNone, Empty))
-					return;
-			}
-		}
+		if (!AddRows(host->GetComments(), host, addRowFn))
+			return;
 	}
 
 	BOOST_FOREACH(const Service::Ptr& service, ConfigType::GetObjectsByType<Service>()) {
-		Dictionary::Ptr comments = service->GetComments();
+		if (!AddRows(service->GetComments(), service, addRowFn))
+			return;
+	}
+}
+
+/**
+ * Adds the comments which belong to the checkable. The comments are copied
+ * first: rows are written to the client while they are added, which must
+ * not happen while the dictionary is locked.
+ */
+bool CommentsTable::AddRows(const Dictionary::Ptr& comments, const Checkable::Ptr& checkable, const AddRowFunction& addRowFn)
+{
+	std::vector<Comment::Ptr> rows;
 
+	{
 		ObjectLock olock(comments);
 
 		String id;
 		Comment::Ptr comment;
 		BOOST_FOREACH(tie(id, comment), comments) {
-			if (Service::GetOwnerByCommentID(id) == service) {
-				if (!addRowFn(comment, LivestatusGroupByNone, Empty))
-					return;
-			}
+			if (Checkable::GetOwnerByCommentID(id) == checkable)
+				rows.push_back(comment);
 		}
 	}
+
+	BOOST_FOREACH(const Comment::Ptr& comment, rows) {
+		if (!addRowFn(comment, LivestatusGroupByNone, Empty))
+			return false;
+	}
+
+	return true;
 }
 
 Object::Ptr CommentsTable::HostAccessor(const Value& row, const Column::ObjectAccessor&)
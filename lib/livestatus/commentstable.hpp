@@ -21,6 +21,7 @@
 #define COMMENTSTABLE_H
 
 #include "livestatus/table.hpp"
+#include "icinga/checkable.hpp"
 
 using namespace icinga;
 
@@ -47,6 +48,8 @@ protected:
 	virtual void FetchRows(const AddRowFunction& addRowFn) override;
 
 private:
+	static bool AddRows(const Dictionary::Ptr& comments, const Checkable::Ptr& checkable, const AddRowFunction& addRowFn);
+
 	static Object::Ptr HostAccessor(const Value& row, const Column::ObjectAccessor& parentObjectAccessor);
 	static Object::Ptr ServiceAccessor(const Value& row, const Column::ObjectAccessor& parentObjectAccessor);
 
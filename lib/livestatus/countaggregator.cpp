@@ -22,16 +22,30 @@
 using namespace icinga;
 
 CountAggregator::CountAggregator(void)
-    : m_Count(0)
 { }
 
-void CountAggregator::Apply(const Table::Ptr& table, const Value& row)
+CountAggregatorState *CountAggregator::EnsureState(AggregatorState::Ptr& state)
 {
+	if (!state)
+		state.reset(new CountAggregatorState());
+
+	return static_cast<CountAggregatorState *>(state.get());
+}
+
+void CountAggregator::Apply(const Table::Ptr& table, const Value& row, AggregatorState::Ptr& state)
+{
+	CountAggregatorState *pstate = EnsureState(state);
+
 	if (GetFilter()->Apply(table, row))
-		m_Count++;
+		pstate->Count++;
 }
 
-double CountAggregator::GetResult(void) const
+double CountAggregator::GetResult(const AggregatorState *state) const
 {
-	return m_Count;
+	if (!state)
+		return 0;
+
+	const CountAggregatorState *pstate = static_cast<const CountAggregatorState *>(state);
+
+	return pstate->Count;
 }
@@ -26,6 +26,18 @@
 namespace icinga
 {
 
+/**
+ * @ingroup livestatus
+ */
+struct I2_LIVESTATUS_API CountAggregatorState : public AggregatorState
+{
+	CountAggregatorState(void)
+	    : Count(0)
+	{ }
+
+	int Count;
+};
+
 /**
  * @ingroup livestatus
  */
@@ -36,11 +48,11 @@ public:
 
 	CountAggregator(void);
 
-	virtual void Apply(const Table::Ptr& table, const Value& row) override;
-	virtual double GetResult(void) const override;
-	
+	virtual void Apply(const Table::Ptr& table, const Value& row, AggregatorState::Ptr& state) override;
+	virtual double GetResult(const AggregatorState *state) const override;
+
 private:
-	int m_Count;
+	static CountAggregatorState *EnsureState(AggregatorState::Ptr& state);
 };
 
 }
@@ -66,34 +66,42 @@ String DowntimesTable::GetPrefix(void) const
 void DowntimesTable::FetchRows(const AddRowFunction& addRowFn)
 {
 	BOOST_FOREACH(const Host::Ptr& host, ConfigType::GetObjectsByType<Host>()) {
-		Dictionary::Ptr downtimes = host->GetDowntimes();
-
-		ObjectLock olock(downtimes);
-
-		String id;
-		Downtime::Ptr downtime;
-		BOOST_FOREACH(boost::tie(id, downtime), downtimes) {
-			if (Host::GetOwnerByDowntimeID(id) == host) {
-				if (!addRowFn(downtime, LivestatusGroupByNone, Empty))
-					return;
-			}
-		}
+		if (!AddRows(host->GetDowntimes(), host, addRowFn))
+			return;
 	}
 
 	BOOST_FOREACH(const Service::Ptr& service, ConfigType::GetObjectsByType<Service>()) {
-		Dictionary::Ptr downtimes = service->GetDowntimes();
+		if (!AddRows(service->GetDowntimes(), service, addRowFn))
+			return;
+	}
+}
+
+/**
+ * Adds the downtimes which belong to the checkable. The downtimes are copied
+ * first: rows are written to the client while they are added, which must
+ * not happen while the dictionary is locked.
+ */
+bool DowntimesTable::AddRows(const Dictionary::Ptr& downtimes, const Checkable::Ptr& checkable, const AddRowFunction& addRowFn)
+{
+	std::vector<Downtime::Ptr> rows;
 
+	{
 		ObjectLock olock(downtimes);
 
 		String id;
 		Downtime::Ptr downtime;
 		BOOST_FOREACH(boost::tie(id, downtime), downtimes) {
-			if (Service::GetOwnerByDowntimeID(id) == service) {
-				if (!addRowFn(downtime, LivestatusGroupByNone, Empty))
-					return;
-			}
+			if (Checkable::GetOwnerByDowntimeID(id) == checkable)
+				rows.push_back(downtime);
 		}
 	}
+
+	BOOST_FOREACH(const Downtime::Ptr& downtime, rows) {
+		if (!addRowFn(downtime, LivestatusGroupByNone, Empty))
+			return false;
+	}
+
+	return true;
 }
 
 Object::Ptr DowntimesTable::HostAccessor(const Value& row, const Column::ObjectAccessor&)
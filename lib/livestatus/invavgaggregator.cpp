@@ -22,20 +22,35 @@
 using namespace icinga;
 
 InvAvgAggregator::InvAvgAggregator(const String& attr)
-    : m_InvAvg(0), m_InvAvgCount(0), m_InvAvgAttr(attr)
+    : m_InvAvgAttr(attr)
 { }
 
-void InvAvgAggregator::Apply(const Table::Ptr& table, const Value& row)
+InvAvgAggregatorState *InvAvgAggregator::EnsureState(AggregatorState::Ptr& state)
+{
+	if (!state)
+		state.reset(new InvAvgAggregatorState());
+
+	return static_cast<InvAvgAggregatorState *>(state.get());
+}
+
+void InvAvgAggregator::Apply(const Table::Ptr& table, const Value& row, AggregatorState::Ptr& state)
 {
 	Column column = table->GetColumn(m_InvAvgAttr);
 
 	Value value = column.ExtractValue(row);
 
-	m_InvAvg += (1.0 / value);
-	m_InvAvgCount++;
+	InvAvgAggregatorState *pstate = EnsureState(state);
+
+	pstate->InvAvg += (1.0 / value);
+	pstate->InvAvgCount++;
 }
 
-double InvAvgAggregator::GetResult(void) const
+double InvAvgAggregator::GetResult(const AggregatorState *state) const
 {
-	return (m_InvAvg / m_InvAvgCount);
+	if (!state)
+		return 0;
+
+	const InvAvgAggregatorState *pstate = static_cast<const InvAvgAggregatorState *>(state);
+
+	return pstate->InvAvg / pstate->InvAvgCount;
 }
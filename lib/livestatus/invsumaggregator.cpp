@@ -22,19 +22,34 @@
 using namespace icinga;
 
 InvSumAggregator::InvSumAggregator(const String& attr)
-    : m_InvSum(0), m_InvSumAttr(attr)
+    : m_InvSumAttr(attr)
 { }
 
-void InvSumAggregator::Apply(const Table::Ptr& table, const Value& row)
+InvSumAggregatorState *InvSumAggregator::EnsureState(AggregatorState::Ptr& state)
+{
+	if (!state)
+		state.reset(new InvSumAggregatorState());
+
+	return static_cast<InvSumAggregatorState *>(state.get());
+}
+
+void InvSumAggregator::Apply(const Table::Ptr& table, const Value& row, AggregatorState::Ptr& state)
 {
 	Column column = table->GetColumn(m_InvSumAttr);
 
 	Value value = column.ExtractValue(row);
 
-	m_InvSum += (1.0 / value);
+	InvSumAggregatorState *pstate = EnsureState(state);
+
+	pstate->InvSum += (1.0 / value);
 }
 
-double InvSumAggregator::GetResult(void) const
+double InvSumAggregator::GetResult(const AggregatorState *state) const
 {
-	return m_InvSum;
+	if (!state)
+		return 0;
+
+	const InvSumAggregatorState *pstate = static_cast<const InvSumAggregatorState *>(state);
+
+	return pstate->InvSum;
 }
@@ -26,6 +26,18 @@
 namespace icinga
 {
 
+/**
+ * @ingroup livestatus
+ */
+struct I2_LIVESTATUS_API InvSumAggregatorState : public AggregatorState
+{
+	InvSumAggregatorState(void)
+	    : InvSum(0)
+	{ }
+
+	double InvSum;
+};
+
 /**
  * @ingroup livestatus
  */
@@ -36,12 +48,13 @@ public:
 
 	InvSumAggregator(const String& attr);
 
-	virtual void Apply(const Table::Ptr& table, const Value& row) override;
-	virtual double GetResult(void) const override;
+	virtual void Apply(const Table::Ptr& table, const Value& row, AggregatorState::Ptr& state) override;
+	virtual double GetResult(const AggregatorState *state) const override;
 
 private:
-	double m_InvSum;
 	String m_InvSumAttr;
+
+	static InvSumAggregatorState *EnsureState(AggregatorState::Ptr& state);
 };
 
 }
@@ -0,0 +1,636 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+
+#include "livestatus/livestatuslogindex.hpp"
+#include "base/utility.hpp"
+#include "base/convert.hpp"
+#include "base/logger.hpp"
+#include "base/objectlock.hpp"
+#include "base/exception.hpp"
+#include "base/array.hpp"
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/noncopyable.hpp>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <string.h>
+
+#ifndef _WIN32
+#	include <sys/mman.h>
+#	include <fcntl.h>
+#endif /* _WIN32 */
+
+using namespace icinga;
+
+/* number of lines per index block */
+#define LOGINDEXBLOCKLINES 128
+#define LOGINDEXVERSION 2
+/* minimum number of seconds between saving the index while only the current log file changes */
+#define LOGINDEXSAVEINTERVAL 300
+
+static boost::mutex l_LogIndexesMutex;
+static std::map<String, LivestatusLogIndex::Ptr> l_LogIndexes;
+
+namespace
+{
+
+/**
+ * Read-only view of the first bytes of a log file. The file is
+ * memory-mapped where possible.
+ */
+class LogFileMapping : private boost::noncopyable
+{
+public:
+	LogFileMapping(const String& path, size_t length)
+		: m_Data(NULL), m_Length(0)
+	{
+		if (length == 0)
+			return;
+
+#ifndef _WIN32
+		int fd = open(path.CStr(), O_RDONLY);
+
+		if (fd < 0) {
+			BOOST_THROW_EXCEPTION(posix_error()
+			    << boost::errinfo_api_function("open")
+			    << boost::errinfo_errno(errno)
+			    << boost::errinfo_file_name(path));
+		}
+
+		struct stat statbuf;
+
+		if (fstat(fd, &statbuf) < 0) {
+			close(fd);
+
+			BOOST_THROW_EXCEPTION(posix_error()
+			    << boost::errinfo_api_function("fstat")
+			    << boost::errinfo_errno(errno)
+			    << boost::errinfo_file_name(path));
+		}
+
+		/* Accessing pages beyond the end of the file raises SIGBUS, the
+		 * file might have been truncated since it was indexed. */
+		if (static_cast<size_t>(statbuf.st_size) < length)
+			length = statbuf.st_size;
+
+		if (length == 0) {
+			close(fd);
+			return;
+		}
+
+		void *data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		close(fd);
+
+		if (data == MAP_FAILED) {
+			BOOST_THROW_EXCEPTION(posix_error()
+			    << boost::errinfo_api_function("mmap")
+			    << boost::errinfo_errno(errno)
+			    << boost::errinfo_file_name(path));
+		}
+
+		m_Data = static_cast<const char *>(data);
+#else /* _WIN32 */
+		std::ifstream fp;
+		fp.open(path.CStr(), std::ifstream::in | std::ifstream::binary);
+
+		if (!fp)
+			BOOST_THROW_EXCEPTION(std::runtime_error("Could not open log file: " + path));
+
+		m_Buffer.resize(length);
+		fp.read(&m_Buffer[0], length);
+		length = fp.gcount();
+
+		m_Data = &m_Buffer[0];
+#endif /* _WIN32 */
+
+		m_Length = length;
+	}
+
+	~LogFileMapping(void)
+	{
+#ifndef _WIN32
+		if (m_Data)
+			munmap(const_cast<char *>(m_Data), m_Length);
+#endif /* _WIN32 */
+	}
+
+	const char *GetData(void) const
+	{
+		return m_Data;
+	}
+
+	size_t GetLength(void) const
+	{
+		return m_Length;
+	}
+
+private:
+	const char *m_Data;
+	size_t m_Length;
+#ifdef _WIN32
+	std::vector<char> m_Buffer;
+#endif /* _WIN32 */
+};
+
+}
+
+/* [1379025342] SERVICE ALERT: ... */
+static time_t GetLogTimestamp(const char *line, size_t length)
+{
+	if (length < 2 || line[0] != '[')
+		return 0;
+
+	time_t ts = 0;
+
+	for (size_t i = 1; i < length && line[i] >= '0' && line[i] <= '9'; i++)
+		ts = ts * 10 + (line[i] - '0');
+
+	return ts;
+}
+
+/* Returns the semicolon-separated token with the specified index, or an
+ * empty string if there is none. */
+static String GetLogToken(const String& options, int token)
+{
+	size_t start = 0;
+
+	for (int i = 0; i < token; i++) {
+		start = options.Find(";", start);
+
+		if (start == String::NPos)
+			return String();
+
+		start++;
+	}
+
+	size_t end = options.Find(";", start);
+
+	if (end == String::NPos)
+		return options.SubStr(start);
+	else
+		return options.SubStr(start, end - start);
+}
+
+/* Gets the host name and service description which
+ * LivestatusLogUtility::GetAttributes() would extract from the log line.
+ * Both are empty if the line doesn't reference a host. */
+static void GetLogHostService(const char *line, size_t length, String& host_name, String& service_description)
+{
+	host_name = String();
+	service_description = String();
+
+	String text(line, line + length);
+
+	size_t colon = text.FindFirstOf(':');
+
+	if (colon == String::NPos || colon < 13)
+		return;
+
+	String type = text.SubStr(13, colon - 13);
+	int token;
+
+	if (type.Contains("NOTIFICATION"))
+		token = 1;
+	else if (type.Contains("HOST") || type.Contains("SERVICE") || type.Contains("TIMEPERIOD TRANSITION"))
+		token = 0;
+	else
+		return;
+
+	String options = String(text.SubStr(colon + 1)).Trim();
+
+	host_name = GetLogToken(options, token);
+
+	/* the service description follows the host name */
+	if (!host_name.IsEmpty() && (type.Contains("SERVICE") || type.Contains("TIMEPERIOD TRANSITION")))
+		service_description = GetLogToken(options, token + 1);
+}
+
+LivestatusLogIndex::LivestatusLogIndex(const String& path)
+	: m_Path(path), m_Dirty(false), m_LastSave(0)
+{
+	LoadIndex();
+}
+
+LivestatusLogIndex::Ptr LivestatusLogIndex::GetByPath(const String& path)
+{
+	boost::mutex::scoped_lock lock(l_LogIndexesMutex);
+
+	std::map<String, LivestatusLogIndex::Ptr>::const_iterator it = l_LogIndexes.find(path);
+
+	if (it != l_LogIndexes.end())
+		return it->second;
+
+	LivestatusLogIndex::Ptr index = new LivestatusLogIndex(path);
+	l_LogIndexes[path] = index;
+	return index;
+}
+
+String LivestatusLogIndex::GetIndexPath(const String& path)
+{
+	return path + "/livestatus-index.json";
+}
+
+/**
+ * Brings the index up to date with the log files on disk. Files which
+ * have not changed are skipped, files which were appended to are
+ * indexed from the previous end of the file.
+ */
+void LivestatusLogIndex::Update(void)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	std::map<String, LivestatusLogFile::Ptr> files;
+	bool changed = false;
+
+	Utility::Glob(m_Path + "/icinga.log", boost::bind(&LivestatusLogIndex::UpdateFileHandler, this, _1, boost::ref(files), boost::ref(changed)), GlobFile);
+	Utility::Glob(m_Path + "/archives/*.log", boost::bind(&LivestatusLogIndex::UpdateFileHandler, this, _1, boost::ref(files), boost::ref(changed)), GlobFile);
+
+	/* log files were added or removed */
+	bool rotated = (files.size() != m_Files.size());
+
+	for (std::map<String, LivestatusLogFile::Ptr>::const_iterator it = files.begin(); !rotated && it != files.end(); it++) {
+		if (m_Files.find(it->first) == m_Files.end())
+			rotated = true;
+	}
+
+	m_Files.swap(files);
+
+	if (changed || rotated)
+		m_Dirty = true;
+
+	/* The current log file is appended to between almost all queries. Lines
+	 * which were written since the index was saved are indexed again after a
+	 * restart, which is cheap compared to rewriting the index every time. */
+	double now = Utility::GetTime();
+
+	if (!m_Dirty || (!rotated && now - m_LastSave < LOGINDEXSAVEINTERVAL))
+		return;
+
+	m_LastSave = now;
+
+	try {
+		SaveIndex();
+		m_Dirty = false;
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "LivestatusLogIndex")
+		    << "Could not save log index '" << GetIndexPath(m_Path) << "': " << DiagnosticInformation(ex);
+	}
+}
+
+void LivestatusLogIndex::UpdateFileHandler(const String& path, std::map<String, LivestatusLogFile::Ptr>& files, bool& changed)
+{
+	struct stat statbuf;
+
+	if (stat(path.CStr(), &statbuf) < 0 || !S_ISREG(statbuf.st_mode))
+		return;
+
+	size_t size = statbuf.st_size;
+	time_t mtime = statbuf.st_mtime;
+
+	LivestatusLogFile::Ptr file;
+	std::map<String, LivestatusLogFile::Ptr>::const_iterator it = m_Files.find(path);
+
+	if (it != m_Files.end()) {
+		const LivestatusLogFile::Ptr& oldFile = it->second;
+
+		if (oldFile->Size == size && oldFile->MTime == mtime) {
+			files[path] = oldFile;
+			return;
+		}
+
+		/* indexed entries are shared with running queries, update a copy */
+		if (size > oldFile->Size)
+			file = boost::make_shared<LivestatusLogFile>(*oldFile);
+	}
+
+	LogFileMapping mapping(path, size);
+
+	/* read the first bytes to get the timestamp: [123456789] */
+	if (mapping.GetLength() < 12 || mapping.GetData()[0] != '[' || mapping.GetData()[11] != ']')
+		return;
+
+	time_t ts_start = GetLogTimestamp(mapping.GetData(), mapping.GetLength());
+
+	/* the file was rotated, replaced or truncated and written again */
+	if (file && (file->StartTime != ts_start || file->Size > mapping.GetLength() ||
+	    (file->Size > 0 && mapping.GetData()[file->Size - 1] != '\n')))
+		file.reset();
+
+	if (!file) {
+		file = boost::make_shared<LivestatusLogFile>();
+		file->Path = path;
+		file->StartTime = ts_start;
+		file->EndTime = ts_start;
+	}
+
+	Log(LogDebug, "LivestatusLogIndex")
+	    << "Indexing log file '" << path << "' from offset " << file->Size << ".";
+
+	IndexFile(file, mapping.GetData(), mapping.GetLength());
+	file->MTime = mtime;
+
+	files[path] = file;
+	changed = true;
+}
+
+void LivestatusLogIndex::IndexFile(const LivestatusLogFile::Ptr& file, const char *data, size_t length)
+{
+	size_t offset = file->Size;
+
+	while (offset < length) {
+		const char *line = data + offset;
+		const char *eol = static_cast<const char *>(memchr(line, '\n', length - offset));
+
+		/* incomplete lines are indexed once they have been written */
+		if (!eol)
+			break;
+
+		size_t len = eol - line;
+
+		if (len > 0) {
+			time_t ts = GetLogTimestamp(line, len);
+
+			if (file->Lines % LOGINDEXBLOCKLINES == 0) {
+				LivestatusLogBlock block;
+				block.Offset = offset;
+				block.Lineno = file->Lines;
+				block.MinTime = ts;
+				block.MaxTime = ts;
+				file->Blocks.push_back(block);
+			}
+
+			LivestatusLogBlock& block = file->Blocks.back();
+
+			if (ts < block.MinTime)
+				block.MinTime = ts;
+
+			if (ts > block.MaxTime)
+				block.MaxTime = ts;
+
+			if (ts > file->EndTime)
+				file->EndTime = ts;
+
+			String host_name, service_description;
+			GetLogHostService(line, len, host_name, service_description);
+
+			if (!host_name.IsEmpty())
+				file->HostBlocks[host_name].insert(file->Blocks.size() - 1);
+
+			if (!service_description.IsEmpty())
+				file->ServiceBlocks[host_name + "!" + service_description].insert(file->Blocks.size() - 1);
+
+			file->Lines++;
+		}
+
+		offset += len + 1;
+		file->Size = offset;
+	}
+}
+
+/**
+ * Calls lineFn for all lines with a timestamp between from and until, in
+ * the order of the log files' start time. When host_name is not empty
+ * only blocks which reference the host are read, when service_description
+ * is not empty as well only blocks which reference the service.
+ */
+void LivestatusLogIndex::Query(time_t from, time_t until, const String& host_name,
+    const String& service_description, const LogLineFunction& lineFn)
+{
+	std::multimap<time_t, LivestatusLogFile::Ptr> files;
+
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		typedef std::pair<String, LivestatusLogFile::Ptr> kv_pair;
+		BOOST_FOREACH(const kv_pair& kv, m_Files) {
+			/* skip log files not in range */
+			if (kv.second->EndTime < from || kv.second->StartTime > until)
+				continue;
+
+			files.insert(std::make_pair(kv.second->StartTime, kv.second));
+		}
+	}
+
+	typedef std::pair<time_t, LivestatusLogFile::Ptr> kv_pair;
+	BOOST_FOREACH(const kv_pair& kv, files) {
+		QueryFile(kv.second, from, until, host_name, service_description, lineFn);
+	}
+}
+
+void LivestatusLogIndex::QueryFile(const LivestatusLogFile::Ptr& file, time_t from, time_t until,
+    const String& host_name, const String& service_description, const LogLineFunction& lineFn)
+{
+	std::vector<size_t> blocks;
+
+	if (host_name.IsEmpty()) {
+		for (size_t i = 0; i < file->Blocks.size(); i++)
+			blocks.push_back(i);
+	} else {
+		std::map<String, std::set<size_t> >::const_iterator it;
+
+		if (service_description.IsEmpty()) {
+			it = file->HostBlocks.find(host_name);
+
+			if (it == file->HostBlocks.end())
+				return;
+		} else {
+			it = file->ServiceBlocks.find(host_name + "!" + service_description);
+
+			if (it == file->ServiceBlocks.end())
+				return;
+		}
+
+		blocks.insert(blocks.end(), it->second.begin(), it->second.end());
+	}
+
+	LogFileMapping mapping(file->Path, file->Size);
+	const char *data = mapping.GetData();
+
+	BOOST_FOREACH(size_t index, blocks) {
+		const LivestatusLogBlock& block = file->Blocks[index];
+
+		if (block.MaxTime < from || block.MinTime > until)
+			continue;
+
+		size_t end = file->Size;
+
+		if (index + 1 < file->Blocks.size())
+			end = file->Blocks[index + 1].Offset;
+
+		/* the file was truncated since it was indexed */
+		if (end > mapping.GetLength())
+			return;
+
+		size_t offset = block.Offset;
+		unsigned long lineno = block.Lineno;
+
+		while (offset < end) {
+			const char *line = data + offset;
+			const char *eol = static_cast<const char *>(memchr(line, '\n', end - offset));
+			size_t len = eol ? eol - line : end - offset;
+
+			if (len > 0) {
+				time_t ts = GetLogTimestamp(line, len);
+
+				if (ts >= from && ts <= until)
+					lineFn(String(line, line + len), lineno);
+
+				lineno++;
+			}
+
+			offset += len + 1;
+		}
+	}
+}
+
+void LivestatusLogIndex::LoadIndex(void)
+{
+	String indexPath = GetIndexPath(m_Path);
+
+	if (!Utility::PathExists(indexPath))
+		return;
+
+	try {
+		Dictionary::Ptr index = Utility::LoadJsonFile(indexPath);
+
+		if (!index || index->Get("version") != LOGINDEXVERSION)
+			return;
+
+		Array::Ptr files = index->Get("files");
+
+		ObjectLock olock(files);
+		BOOST_FOREACH(const Dictionary::Ptr& data, files) {
+			LivestatusLogFile::Ptr file = DeserializeFile(data);
+			m_Files[file->Path] = file;
+		}
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "LivestatusLogIndex")
+		    << "Ignoring invalid log index '" << indexPath << "': " << DiagnosticInformation(ex);
+
+		m_Files.clear();
+	}
+}
+
+void LivestatusLogIndex::SaveIndex(void) const
+{
+	Array::Ptr files = new Array();
+
+	typedef std::pair<String, LivestatusLogFile::Ptr> kv_pair;
+	BOOST_FOREACH(const kv_pair& kv, m_Files) {
+		files->Add(SerializeFile(kv.second));
+	}
+
+	Dictionary::Ptr index = new Dictionary();
+	index->Set("version", LOGINDEXVERSION);
+	index->Set("files", files);
+
+	Utility::SaveJsonFile(GetIndexPath(m_Path), index);
+}
+
+Dictionary::Ptr LivestatusLogIndex::SerializeFile(const LivestatusLogFile::Ptr& file)
+{
+	Array::Ptr blocks = new Array();
+	blocks->Reserve(file->Blocks.size());
+
+	BOOST_FOREACH(const LivestatusLogBlock& block, file->Blocks) {
+		Array::Ptr data = new Array();
+		data->Add(static_cast<double>(block.Offset));
+		data->Add(static_cast<double>(block.Lineno));
+		data->Add(static_cast<double>(block.MinTime));
+		data->Add(static_cast<double>(block.MaxTime));
+		blocks->Add(data);
+	}
+
+	Dictionary::Ptr result = new Dictionary();
+	result->Set("path", file->Path);
+	result->Set("size", static_cast<double>(file->Size));
+	result->Set("mtime", static_cast<double>(file->MTime));
+	result->Set("start_time", static_cast<double>(file->StartTime));
+	result->Set("end_time", static_cast<double>(file->EndTime));
+	result->Set("lines", static_cast<double>(file->Lines));
+	result->Set("blocks", blocks);
+	result->Set("hosts", SerializeBlockMap(file->HostBlocks));
+	result->Set("services", SerializeBlockMap(file->ServiceBlocks));
+	return result;
+}
+
+LivestatusLogFile::Ptr LivestatusLogIndex::DeserializeFile(const Dictionary::Ptr& data)
+{
+	LivestatusLogFile::Ptr file = boost::make_shared<LivestatusLogFile>();
+	file->Path = data->Get("path");
+	file->Size = static_cast<double>(data->Get("size"));
+	file->MTime = static_cast<double>(data->Get("mtime"));
+	file->StartTime = static_cast<double>(data->Get("start_time"));
+	file->EndTime = static_cast<double>(data->Get("end_time"));
+	file->Lines = static_cast<double>(data->Get("lines"));
+
+	Array::Ptr blocks = data->Get("blocks");
+
+	{
+		ObjectLock olock(blocks);
+		BOOST_FOREACH(const Array::Ptr& blockData, blocks) {
+			LivestatusLogBlock block;
+			block.Offset = static_cast<double>(blockData->Get(0));
+			block.Lineno = static_cast<double>(blockData->Get(1));
+			block.MinTime = static_cast<double>(blockData->Get(2));
+			block.MaxTime = static_cast<double>(blockData->Get(3));
+			file->Blocks.push_back(block);
+		}
+	}
+
+	DeserializeBlockMap(data->Get("hosts"), file->HostBlocks);
+	DeserializeBlockMap(data->Get("services"), file->ServiceBlocks);
+
+	return file;
+}
+
+Dictionary::Ptr LivestatusLogIndex::SerializeBlockMap(const std::map<String, std::set<size_t> >& blockMap)
+{
+	Dictionary::Ptr result = new Dictionary();
+
+	typedef std::pair<String, std::set<size_t> > kv_pair;
+	BOOST_FOREACH(const kv_pair& kv, blockMap) {
+		Array::Ptr indexes = new Array();
+
+		BOOST_FOREACH(size_t index, kv.second) {
+			indexes->Add(static_cast<double>(index));
+		}
+
+		result->Set(kv.first, indexes);
+	}
+
+	return result;
+}
+
+void LivestatusLogIndex::DeserializeBlockMap(const Dictionary::Ptr& data, std::map<String, std::set<size_t> >& blockMap)
+{
+	ObjectLock olock(data);
+	BOOST_FOREACH(const Dictionary::Pair& kv, data) {
+		Array::Ptr indexes = kv.second;
+		std::set<size_t>& blocks = blockMap[kv.first];
+
+		ObjectLock ilock(indexes);
+		BOOST_FOREACH(const Value& index, indexes) {
+			blocks.insert(static_cast<double>(index));
+		}
+	}
+}
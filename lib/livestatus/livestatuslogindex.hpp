@@ -0,0 +1,127 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+
+#ifndef LIVESTATUSLOGINDEX_H
+#define LIVESTATUSLOGINDEX_H
+
+#include "livestatus/i2-livestatus.hpp"
+#include "base/object.hpp"
+#include "base/dictionary.hpp"
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/smart_ptr/shared_ptr.hpp>
+#include <vector>
+#include <map>
+#include <set>
+
+namespace icinga
+{
+
+/**
+ * A block of consecutive lines in a compat log file.
+ *
+ * @ingroup livestatus
+ */
+struct LivestatusLogBlock
+{
+	size_t Offset;
+	unsigned long Lineno;
+	time_t MinTime;
+	time_t MaxTime;
+
+	LivestatusLogBlock(void)
+		: Offset(0), Lineno(0), MinTime(0), MaxTime(0)
+	{ }
+};
+
+/**
+ * Index information for a single compat log file.
+ *
+ * @ingroup livestatus
+ */
+struct LivestatusLogFile
+{
+	typedef boost::shared_ptr<LivestatusLogFile> Ptr;
+
+	String Path;
+	size_t Size;
+	time_t MTime;
+	time_t StartTime;
+	time_t EndTime;
+	unsigned long Lines;
+	std::vector<LivestatusLogBlock> Blocks;
+	std::map<String, std::set<size_t> > HostBlocks;
+	std::map<String, std::set<size_t> > ServiceBlocks;
+
+	LivestatusLogFile(void)
+		: Size(0), MTime(0), StartTime(0), EndTime(0), Lines(0)
+	{ }
+};
+
+typedef boost::function<void (const String& line, unsigned long lineno)> LogLineFunction;
+
+/**
+ * Persistent index for the compat log files used by the livestatus 'log'
+ * and 'statehist' tables. The index stores the time range of every file and
+ * the offset of every block of lines together with the block's time range
+ * and the hosts and services it references. Files are memory-mapped when
+ * queried so that only the blocks which match a query need to be parsed.
+ *
+ * @ingroup livestatus
+ */
+class I2_LIVESTATUS_API LivestatusLogIndex : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(LivestatusLogIndex);
+
+	static LivestatusLogIndex::Ptr GetByPath(const String& path);
+
+	void Update(void);
+	void Query(time_t from, time_t until, const String& host_name,
+	    const String& service_description, const LogLineFunction& lineFn);
+
+	static String GetIndexPath(const String& path);
+
+private:
+	String m_Path;
+	boost::mutex m_Mutex;
+	std::map<String, LivestatusLogFile::Ptr> m_Files;
+	bool m_Dirty;
+	double m_LastSave;
+
+	LivestatusLogIndex(const String& path);
+
+	void LoadIndex(void);
+	void SaveIndex(void) const;
+	void UpdateFileHandler(const String& path, std::map<String, LivestatusLogFile::Ptr>& files, bool& changed);
+
+	static void IndexFile(const LivestatusLogFile::Ptr& file, const char *data, size_t length);
+	static void QueryFile(const LivestatusLogFile::Ptr& file, time_t from, time_t until,
+	    const String& host_name, const String& service_description, const LogLineFunction& lineFn);
+
+	static Dictionary::Ptr SerializeFile(const LivestatusLogFile::Ptr& file);
+	static LivestatusLogFile::Ptr DeserializeFile(const Dictionary::Ptr& data);
+	static Dictionary::Ptr SerializeBlockMap(const std::map<String, std::set<size_t> >& blockMap);
+	static void DeserializeBlockMap(const Dictionary::Ptr& data, std::map<String, std::set<size_t> >& blockMap);
+};
+
+}
+
+#endif /* LIVESTATUSLOGINDEX_H */
@@ -18,6 +18,7 @@
  ******************************************************************************/
 
 #include "livestatus/livestatuslogutility.hpp"
+#include "livestatus/livestatuslogindex.hpp"
 #include "icinga/service.hpp"
 #include "icinga/host.hpp"
 #include "icinga/user.hpp"
@@ -28,96 +29,45 @@
 #include "base/convert.hpp"
 #include "base/logger.hpp"
 #include <boost/foreach.hpp>
-#include <boost/tuple/tuple.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/predicate.hpp>
-#include <fstream>
 
 using namespace icinga;
 
-void LivestatusLogUtility::CreateLogIndex(const String& path, std::map<time_t, String>& index)
+void LivestatusLogUtility::CreateLogCache(const String& path, HistoryTable *table, time_t from, time_t until,
+    const String& host_name, const String& service_description, const AddRowFunction& addRowFn)
 {
-	Utility::Glob(path + "/icinga.log", boost::bind(&LivestatusLogUtility::CreateLogIndexFileHandler, _1, boost::ref(index)), GlobFile);
-	Utility::Glob(path + "/archives/*.log", boost::bind(&LivestatusLogUtility::CreateLogIndexFileHandler, _1, boost::ref(index)), GlobFile);
-}
-
-void LivestatusLogUtility::CreateLogIndexFileHandler(const String& path, std::map<time_t, String>& index)
-{
-	std::ifstream stream;
-	stream.open(path.CStr(), std::ifstream::in);
-
-	if (!stream)
-		BOOST_THROW_EXCEPTION(std::runtime_error("Could not open log file: " + path));
-
-	/* read the first bytes to get the timestamp: [123456789] */
-	char buffer[12];
-
-	stream.read(buffer, 12);
-
-	if (buffer[0] != '[' || buffer[11] != ']') {
-		/* this can happen for directories too, silently ignore them */
-		return;
-	}
+	ASSERT(table);
 
-	/* extract timestamp */
-	buffer[11] = 0;
-	time_t ts_start = atoi(buffer+1);
+	LivestatusLogIndex::Ptr index = LivestatusLogIndex::GetByPath(path);
 
-	stream.close();
+	/* index new and changed log files */
+	index->Update();
 
-	Log(LogDebug, "LivestatusLogUtility")
-	    << "Indexing log file: '" << path << "' with timestamp start: '" << ts_start << "'.";
+	unsigned long line_count = 0;
 
-	index[ts_start] = path;
+	index->Query(from, until, host_name, service_description, boost::bind(&LivestatusLogUtility::CreateLogCacheLineHandler,
+	    table, _1, _2, boost::ref(line_count), boost::cref(addRowFn)));
 }
 
-void LivestatusLogUtility::CreateLogCache(std::map<time_t, String> index, HistoryTable *table,
-    time_t from, time_t until, const AddRowFunction& addRowFn)
+void LivestatusLogUtility::CreateLogCacheLineHandler(HistoryTable *table, const String& line, unsigned long lineno,
+    unsigned long& line_count, const AddRowFunction& addRowFn)
 {
-	ASSERT(table);
+	Dictionary::Ptr log_entry_attrs = LivestatusLogUtility::GetAttributes(line);
 
-	/* m_LogFileIndex map tells which log files are involved ordered by their start timestamp */
-	unsigned int ts;
-	unsigned long line_count = 0;
-	BOOST_FOREACH(boost::tie(ts, boost::tuples::ignore), index) {
-		/* skip log files not in range (performance optimization) */
-		if (ts < from || ts > until)
-			continue;
-
-		String log_file = index[ts];
-		int lineno = 0;
-
-		std::ifstream fp;
-		fp.exceptions(std::ifstream::badbit);
-		fp.open(log_file.CStr(), std::ifstream::in);
-
-		while (fp.good()) {
-			std::string line;
-			std::getline(fp, line);
-
-			if (line.empty())
-				continue; /* Ignore empty lines */
-
-			Dictionary::Ptr log_entry_attrs = LivestatusLogUtility::GetAttributes(line);
-
-			/* no attributes available - invalid log line */
-			if (!log_entry_attrs) {
-				Log(LogDebug, "LivestatusLogUtility")
-				    << "Skipping invalid log line: '" << line << "'.";
-				continue;
-			}
-
-			table->UpdateLogEntries(log_entry_attrs, line_count, lineno, addRowFn);
+	/* no attributes available - invalid log line */
+	if (!log_entry_attrs) {
+		Log(LogDebug, "LivestatusLogUtility")
+		    << "Skipping invalid log line: '" << line << "'.";
+		return;
+	}
 
-			line_count++;
-			lineno++;
-		}
+	table->UpdateLogEntries(log_entry_attrs, line_count, lineno, addRowFn);
 
-		fp.close();
-	}
+	line_count++;
 }
 
 Dictionary::Ptr LivestatusLogUtility::GetAttributes(const String& text)
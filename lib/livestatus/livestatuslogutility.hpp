@@ -63,13 +63,15 @@ enum LogEntryClass {
 class I2_LIVESTATUS_API LivestatusLogUtility
 {
 public:
-	static void CreateLogIndex(const String& path, std::map<time_t, String>& index);
-	static void CreateLogIndexFileHandler(const String& path, std::map<time_t, String>& index);
-	static void CreateLogCache(std::map<time_t, String> index, HistoryTable *table, time_t from, time_t until, const AddRowFunction& addRowFn);
+	static void CreateLogCache(const String& path, HistoryTable *table, time_t from, time_t until,
+	    const String& host_name, const String& service_description, const AddRowFunction& addRowFn);
 	static Dictionary::Ptr GetAttributes(const String& text);
 
 private:
 	LivestatusLogUtility(void);
+
+	static void CreateLogCacheLineHandler(HistoryTable *table, const String& line, unsigned long lineno,
+	    unsigned long& line_count, const AddRowFunction& addRowFn);
 };
 
 }
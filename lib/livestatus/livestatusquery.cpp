@@ -39,7 +39,6 @@
 #include "base/exception.hpp"
 #include "base/utility.hpp"
 #include "base/json.hpp"
-#include "base/serializer.hpp"
 #include "base/timer.hpp"
 #include "base/initialize.hpp"
 #include <boost/algorithm/string/classification.hpp>
@@ -315,6 +314,16 @@ LivestatusQuery::LivestatusQuery(const std::vector<String>& lines, const String&
 
 	BOOST_FOREACH(const Filter::Ptr& filter, filters) {
 		top_filter->AddSubFilter(filter);
+
+		/* pre-select log lines for a single host or service */
+		AttributeFilter::Ptr attr_filter = dynamic_pointer_cast<AttributeFilter>(filter);
+
+		if (attr_filter && attr_filter->GetOperator() == "=") {
+			if (attr_filter->GetColumn() == "host_name")
+				m_LogHostName = attr_filter->GetOperand();
+			else if (attr_filter->GetColumn() == "service_description")
+				m_LogServiceDescription = attr_filter->GetOperand();
+		}
 	}
 
 	m_Filter = top_filter;
@@ -405,34 +414,110 @@ Filter::Ptr LivestatusQuery::ParseFilter(const String& params, unsigned long& fr
 
 void LivestatusQuery::PrintResultSet(std::ostream& fp, const Array::Ptr& rs) const
 {
-	if (m_OutputFormat == "csv") {
-		ObjectLock olock(rs);
-
-		BOOST_FOREACH(const Array::Ptr& row, rs) {
-			bool first = true;
-
-			ObjectLock rlock(row);
-			BOOST_FOREACH(const Value& value, row) {
-				if (first)
-					first = false;
-				else
-					fp << m_Separators[1];
-
-				if (value.IsObjectType<Array>())
-					PrintCsvArray(fp, value, 0);
-				else
-					fp << value;
-			}
+	BeginResultSet(fp);
+
+	bool first = true;
+
+	ObjectLock olock(rs);
+	BOOST_FOREACH(const Array::Ptr& row, rs) {
+		PrintResultRow(fp, row, first);
+		first = false;
+	}
+
+	EndResultSet(fp);
+}
 
-			fp << m_Separators[0];
+void LivestatusQuery::BeginResultSet(std::ostream& fp) const
+{
+	if (m_OutputFormat == "json")
+		fp << "[";
+	else if (m_OutputFormat == "python")
+		fp << "[ ";
+}
+
+/**
+ * Prints a single row of the result set. The output is the same as if
+ * the row had been printed as part of an array of rows.
+ */
+void LivestatusQuery::PrintResultRow(std::ostream& fp, const Array::Ptr& row, bool first) const
+{
+	if (m_OutputFormat == "csv") {
+		bool first_value = true;
+
+		ObjectLock rlock(row);
+		BOOST_FOREACH(const Value& value, row) {
+			if (first_value)
+				first_value = false;
+			else
+				fp << m_Separators[1];
+
+			if (value.IsObjectType<Array>())
+				PrintCsvArray(fp, value, 0);
+			else
+				fp << value;
 		}
+
+		fp << m_Separators[0];
 	} else if (m_OutputFormat == "json") {
-		fp << JsonEncode(rs);
+		if (!first)
+			fp << ",";
+
+		fp << JsonEncode(row);
 	} else if (m_OutputFormat == "python") {
-		PrintPythonArray(fp, rs);
+		if (!first)
+			fp << ", ";
+
+		PrintPythonArray(fp, row);
 	}
 }
 
+void LivestatusQuery::EndResultSet(std::ostream& fp) const
+{
+	if (m_OutputFormat == "json")
+		fp << "]";
+	else if (m_OutputFormat == "python")
+		fp << " ]";
+}
+
+/**
+ * Formats a row (and the column headers before the first row) into the
+ * response writer as soon as it has been fetched.
+ */
+bool LivestatusQuery::PrintRow(LivestatusResponseWriter& writer, const std::vector<ColumnPair>& columns,
+    size_t& count, const LivestatusRowValue& object) const
+{
+	if (writer.IsFailed())
+		return false;
+
+	std::ostream& fp = writer.GetStream();
+
+	if (count == 0 && m_ColumnHeaders) {
+		Array::Ptr header = new Array();
+
+		header->Reserve(columns.size());
+
+		BOOST_FOREACH(const ColumnPair& cv, columns)
+			header->Add(cv.first);
+
+		PrintResultRow(fp, header, true);
+		count++;
+	}
+
+	Array::Ptr row = new Array();
+
+	row->Reserve(columns.size());
+
+	BOOST_FOREACH(const ColumnPair& cv, columns)
+		row->Add(cv.second.ExtractValue(object.Row, object.GroupByType, object.GroupByObject));
+
+	PrintResultRow(fp, row, count == 0);
+	count++;
+
+	writer.Commit();
+
+	return true;
+}
+
 void LivestatusQuery::PrintCsvArray(std::ostream& fp, const Array::Ptr& array, int level) const
 {
 	bool first = true;
@@ -482,12 +567,60 @@ String LivestatusQuery::QuoteStringPython(const String& str) {
 	return "r\"" + result + "\"";
 }
 
+static void AppendGroupKey(std::string& key, const Value& value)
+{
+	key += static_cast<char>('0' + value.GetType());
+
+	if (value.IsNumber() || value.IsBoolean())
+		key += Convert::ToString(static_cast<double>(value)).GetData();
+	else if (value.IsString())
+		key += static_cast<String>(value).GetData();
+	else if (!value.IsEmpty())
+		key += JsonEncode(value).GetData();
+
+	key += '\0';
+}
+
+bool LivestatusQuery::AggregateRow(const Table::Ptr& table, const std::vector<Column>& columns,
+    boost::unordered_map<std::string, size_t>& groupIndex, std::vector<LivestatusStatsGroup>& groups,
+    const LivestatusRowValue& object) const
+{
+	Array::Ptr values = new Array();
+	values->Reserve(columns.size());
+
+	std::string key;
+
+	BOOST_FOREACH(const Column& column, columns) {
+		Value value = column.ExtractValue(object.Row, object.GroupByType, object.GroupByObject);
+		AppendGroupKey(key, value);
+		values->Add(value);
+	}
+
+	size_t index;
+	boost::unordered_map<std::string, size_t>::const_iterator it = groupIndex.find(key);
+
+	if (it == groupIndex.end()) {
+		index = groups.size();
+		groups.push_back(LivestatusStatsGroup(values, m_Aggregators.size()));
+		groupIndex[key] = index;
+	} else
+		index = it->second;
+
+	LivestatusStatsGroup& group = groups[index];
+
+	for (size_t i = 0; i < m_Aggregators.size(); i++)
+		m_Aggregators[i]->Apply(table, object.Row, group.States[i]);
+
+	return true;
+}
+
 void LivestatusQuery::ExecuteGetHelper(const Stream::Ptr& stream)
 {
 	Log(LogNotice, "LivestatusQuery")
 	    << "Table: " << m_Table;
 
-	Table::Ptr table = Table::GetByName(m_Table, m_CompatLogPath, m_LogTimeFrom, m_LogTimeUntil);
+	Table::Ptr table = Table::GetByName(m_Table, m_CompatLogPath, m_LogTimeFrom, m_LogTimeUntil,
+	    m_LogHostName, m_LogServiceDescription);
 
 	if (!table) {
 		SendResponse(stream, LivestatusErrorNotFound, "Table '" + m_Table + "' does not exist.");
@@ -495,7 +628,6 @@ void LivestatusQuery::ExecuteGetHelper(const Stream::Ptr& stream)
 		return;
 	}
 
-	std::vector<LivestatusRowValue> objects = table->FilterRows(m_Filter, m_Limit);
 	std::vector<String> columns;
 
 	if (m_Columns.size() > 0)
@@ -503,53 +635,71 @@ void LivestatusQuery::ExecuteGetHelper(const Stream::Ptr& stream)
 	else
 		columns = table->GetColumnNames();
 
-	Array::Ptr rs = new Array();
+	/* fixed16 needs the length of the response up front, so the response is spooled. */
+	bool fixed16 = (m_ResponseHeader == "fixed16");
 
-	if (m_Aggregators.empty()) {
-		Array::Ptr header = new Array();
+	LivestatusResponseWriter writer(stream, fixed16);
+
+	try {
+		ExecuteGetRows(writer, table, columns);
+	} catch (const std::exception& ex) {
+		if (!writer.IsWritten())
+			throw;
+
+		/* Appending an error message to a partially sent response would
+		 * corrupt it: the client notices the error by the closed connection. */
+		Log(LogCritical, "LivestatusQuery")
+		    << "Error while sending the response for table '" << m_Table << "', closing the connection: "
+		    << DiagnosticInformation(ex);
 
-		typedef std::pair<String, Column> ColumnPair;
+		m_KeepAlive = false;
+		return;
+	}
+
+	if (fixed16) {
+		PrintFixed16(stream, LivestatusErrorOK, writer.GetLength());
+		writer.WriteSpool();
+	}
+}
 
+void LivestatusQuery::ExecuteGetRows(LivestatusResponseWriter& writer, const Table::Ptr& table, const std::vector<String>& columns)
+{
+	if (m_Aggregators.empty()) {
 		std::vector<ColumnPair> column_objs;
 		column_objs.reserve(columns.size());
 
 		BOOST_FOREACH(const String& columnName, columns)
 			column_objs.push_back(std::make_pair(columnName, table->GetColumn(columnName)));
 
-		rs->Reserve(1 + objects.size());
+		size_t count = 0;
 
-		BOOST_FOREACH(const LivestatusRowValue& object, objects) {
-			Array::Ptr row = new Array();
+		BeginResultSet(writer.GetStream());
 
-			row->Reserve(column_objs.size());
+		table->FilterRows(m_Filter, m_Limit, boost::bind(&LivestatusQuery::PrintRow, this,
+		    boost::ref(writer), boost::cref(column_objs), boost::ref(count), _1));
 
-			BOOST_FOREACH(const ColumnPair& cv, column_objs) {
-				if (m_ColumnHeaders)
-					header->Add(cv.first);
+		EndResultSet(writer.GetStream());
+	} else {
+		std::vector<Column> column_objs;
+		column_objs.reserve(m_Columns.size());
 
-				row->Add(cv.second.ExtractValue(object.Row, object.GroupByType, object.GroupByObject));
-			}
+		BOOST_FOREACH(const String& columnName, m_Columns)
+			column_objs.push_back(table->GetColumn(columnName));
 
-			if (m_ColumnHeaders) {
-				rs->Add(header);
-				m_ColumnHeaders = false;
-			}
+		/* Columns act as group-by keys: all aggregators are updated in a single pass over the rows. */
+		std::vector<LivestatusStatsGroup> groups;
+		boost::unordered_map<std::string, size_t> groupIndex;
 
-			rs->Add(row);
-		}
-	} else {
-		std::vector<double> stats(m_Aggregators.size(), 0);
-		int index = 0;
+		table->FilterRows(m_Filter, m_Limit, boost::bind(&LivestatusQuery::AggregateRow, this,
+		    table, boost::cref(column_objs), boost::ref(groupIndex), boost::ref(groups), _1));
 
-		/* add aggregated stats */
-		BOOST_FOREACH(const Aggregator::Ptr aggregator, m_Aggregators) {
-			BOOST_FOREACH(const LivestatusRowValue& object, objects) {
-				aggregator->Apply(table, object.Row);
-			}
+		/* Without any group-by columns there is always exactly one result row. */
+		if (groups.empty() && m_Columns.empty())
+			groups.push_back(LivestatusStatsGroup(new Array(), m_Aggregators.size()));
 
-			stats[index] = aggregator->GetResult();
-			index++;
-		}
+		BeginResultSet(writer.GetStream());
+
+		bool first = true;
 
 		/* add column headers both for raw and aggregated data */
 		if (m_ColumnHeaders) {
@@ -563,37 +713,28 @@ void LivestatusQuery::ExecuteGetHelper(const Stream::Ptr& stream)
 				header->Add("stats_" + Convert::ToString(i));
 			}
 
-			rs->Add(header);
+			PrintResultRow(writer.GetStream(), header, first);
+			first = false;
 		}
 
-		Array::Ptr row = new Array();
+		BOOST_FOREACH(LivestatusStatsGroup& group, groups) {
+			Array::Ptr row = group.Columns;
 
-		row->Reserve(m_Columns.size() + m_Aggregators.size());
+			row->Reserve(m_Columns.size() + m_Aggregators.size());
 
-		/*
-		 * add selected columns next to stats
-		 * may not be accurate for grouping!
-		 */
-		if (objects.size() > 0 && m_Columns.size() > 0) {
-			BOOST_FOREACH(const String& columnName, m_Columns) {
-				Column column = table->GetColumn(columnName);
+			for (size_t i = 0; i < m_Aggregators.size(); i++)
+				row->Add(m_Aggregators[i]->GetResult(group.States[i].get()));
 
-				LivestatusRowValue object = objects[0]; //first object wins
+			PrintResultRow(writer.GetStream(), row, first);
+			first = false;
 
-				row->Add(column.ExtractValue(object.Row, object.GroupByType, object.GroupByObject));
-			}
+			writer.Commit();
 		}
 
-		for (size_t i = 0; i < m_Aggregators.size(); i++)
-			row->Add(stats[i]);
-
-		rs->Add(row);
+		EndResultSet(writer.GetStream());
 	}
 
-	std::ostringstream result;
-	PrintResultSet(result, rs);
-
-	SendResponse(stream, LivestatusErrorOK, result.str());
+	writer.Commit(true);
 }
 
 void LivestatusQuery::ExecuteCommandHelper(const Stream::Ptr& stream)
@@ -655,7 +796,7 @@ void LivestatusQuery::ExecuteScriptHelper(const Stream::Ptr& stream)
 		throw;
 	}
 	delete expr;
-	SendResponse(stream, LivestatusErrorOK, JsonEncode(Serialize(result, FAEphemeral | FAState | FAConfig), true));
+	SendResponse(stream, LivestatusErrorOK, JsonSerialize(result, FAEphemeral | FAState | FAConfig, true));
 }
 
 void LivestatusQuery::ExecuteErrorHelper(const Stream::Ptr& stream)
@@ -668,7 +809,7 @@ void LivestatusQuery::ExecuteErrorHelper(const Stream::Ptr& stream)
 void LivestatusQuery::SendResponse(const Stream::Ptr& stream, int code, const String& data)
 {
 	if (m_ResponseHeader == "fixed16")
-		PrintFixed16(stream, code, data);
+		PrintFixed16(stream, code, data.GetLength());
 
 	if (m_ResponseHeader == "fixed16" || code == LivestatusErrorOK) {
 		try {
@@ -679,12 +820,12 @@ void LivestatusQuery::SendResponse(const Stream::Ptr& stream, int code, const St
 	}
 }
 
-void LivestatusQuery::PrintFixed16(const Stream::Ptr& stream, int code, const String& data)
+void LivestatusQuery::PrintFixed16(const Stream::Ptr& stream, int code, size_t length)
 {
 	ASSERT(code >= 100 && code <= 999);
 
 	String sCode = Convert::ToString(code);
-	String sLength = Convert::ToString(static_cast<long>(data.GetLength()));
+	String sLength = Convert::ToString(static_cast<long>(length));
 
 	String header = sCode + String(16 - 3 - sLength.GetLength() - 1, ' ') + sLength + m_Separators[0];
 
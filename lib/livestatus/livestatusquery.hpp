@@ -22,10 +22,12 @@
 
 #include "livestatus/filter.hpp"
 #include "livestatus/aggregator.hpp"
+#include "livestatus/livestatusresponsewriter.hpp"
 #include "base/object.hpp"
 #include "base/array.hpp"
 #include "base/stream.hpp"
 #include "base/scriptframe.hpp"
+#include <boost/unordered_map.hpp>
 #include <deque>
 
 using namespace icinga;
@@ -52,6 +54,22 @@ struct LivestatusScriptFrame
 	{ }
 };
 
+/**
+ * A single result row of a Stats query: the values of the group-by
+ * columns and one aggregator state per Stats line.
+ *
+ * @ingroup livestatus
+ */
+struct LivestatusStatsGroup
+{
+	Array::Ptr Columns;
+	std::vector<AggregatorState::Ptr> States;
+
+	LivestatusStatsGroup(const Array::Ptr& columns, size_t aggregators)
+		: Columns(columns), States(aggregators)
+	{ }
+};
+
 /**
  * @ingroup livestatus
  */
@@ -95,20 +113,33 @@ private:
 	
 	unsigned long m_LogTimeFrom;
 	unsigned long m_LogTimeUntil;
+	String m_LogHostName;
+	String m_LogServiceDescription;
 	String m_CompatLogPath;
 
+	typedef std::pair<String, Column> ColumnPair;
+
 	void PrintResultSet(std::ostream& fp, const Array::Ptr& rs) const;
+	void BeginResultSet(std::ostream& fp) const;
+	void PrintResultRow(std::ostream& fp, const Array::Ptr& row, bool first) const;
+	void EndResultSet(std::ostream& fp) const;
+	bool PrintRow(LivestatusResponseWriter& writer, const std::vector<ColumnPair>& columns,
+	    size_t& count, const LivestatusRowValue& object) const;
+	bool AggregateRow(const Table::Ptr& table, const std::vector<Column>& columns,
+	    boost::unordered_map<std::string, size_t>& groupIndex, std::vector<LivestatusStatsGroup>& groups,
+	    const LivestatusRowValue& object) const;
 	void PrintCsvArray(std::ostream& fp, const Array::Ptr& array, int level) const;
 	void PrintPythonArray(std::ostream& fp, const Array::Ptr& array) const;
 	static String QuoteStringPython(const String& str);
 
 	void ExecuteGetHelper(const Stream::Ptr& stream);
+	void ExecuteGetRows(LivestatusResponseWriter& writer, const Table::Ptr& table, const std::vector<String>& columns);
 	void ExecuteCommandHelper(const Stream::Ptr& stream);
 	void ExecuteScriptHelper(const Stream::Ptr& stream);
 	void ExecuteErrorHelper(const Stream::Ptr& stream);
 
 	void SendResponse(const Stream::Ptr& stream, int code, const String& data);
-	void PrintFixed16(const Stream::Ptr& stream, int code, const String& data);
+	void PrintFixed16(const Stream::Ptr& stream, int code, size_t length);
 	
 	static Filter::Ptr ParseFilter(const String& params, unsigned long& from, unsigned long& until);
 };
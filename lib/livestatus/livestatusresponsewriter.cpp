@@ -0,0 +1,170 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+
+#include "livestatus/livestatusresponsewriter.hpp"
+#include "base/logger.hpp"
+#include <boost/foreach.hpp>
+
+using namespace icinga;
+
+/* Chunks are written to the stream (or the spool) once they reach this size. */
+#define RESPONSE_CHUNK_SIZE (64 * 1024)
+
+/* Spooled responses larger than this are moved to a temporary file. */
+#define RESPONSE_MAX_MEMORY_SPOOL (4 * 1024 * 1024)
+
+LivestatusResponseWriter::LivestatusResponseWriter(const Stream::Ptr& stream, bool spool)
+	: m_Stream(stream), m_Spool(spool), m_ChunkBytes(0), m_SpoolFile(NULL),
+	  m_Length(0), m_Failed(false)
+{ }
+
+LivestatusResponseWriter::~LivestatusResponseWriter(void)
+{
+	if (m_SpoolFile)
+		fclose(m_SpoolFile);
+}
+
+/**
+ * Returns the stream the caller should format the response into. Call
+ * Commit() once a row is complete.
+ */
+std::ostream& LivestatusResponseWriter::GetStream(void)
+{
+	return m_Buffer;
+}
+
+/**
+ * Hands off the formatted data once enough of it has been buffered.
+ *
+ * @param force Whether to hand off the data regardless of the buffer size.
+ */
+void LivestatusResponseWriter::Commit(bool force)
+{
+	if (!force && m_Buffer.tellp() < RESPONSE_CHUNK_SIZE)
+		return;
+
+	std::string data = m_Buffer.str();
+	m_Buffer.str("");
+
+	if (data.empty())
+		return;
+
+	m_Length += data.size();
+
+	if (!m_Spool)
+		Write(data.c_str(), data.size());
+	else if (!m_SpoolFile && m_ChunkBytes + data.size() <= RESPONSE_MAX_MEMORY_SPOOL) {
+		m_ChunkBytes += data.size();
+		m_Chunks.push_back(data);
+	} else
+		SpoolToFile(data);
+}
+
+/**
+ * Returns the number of bytes which have been committed so far.
+ */
+size_t LivestatusResponseWriter::GetLength(void) const
+{
+	return m_Length;
+}
+
+/**
+ * Returns whether part of the response has already been written to the
+ * stream, i.e. whether it's too late to send an error response instead.
+ */
+bool LivestatusResponseWriter::IsWritten(void) const
+{
+	return !m_Spool && m_Length > 0;
+}
+
+/**
+ * Returns whether writing to the stream has failed, in which case the
+ * caller may stop producing rows.
+ */
+bool LivestatusResponseWriter::IsFailed(void) const
+{
+	return m_Failed;
+}
+
+/**
+ * Writes the spooled response to the stream.
+ */
+void LivestatusResponseWriter::WriteSpool(void)
+{
+	BOOST_FOREACH(const std::string& chunk, m_Chunks) {
+		Write(chunk.c_str(), chunk.size());
+	}
+
+	m_Chunks.clear();
+	m_ChunkBytes = 0;
+
+	if (m_SpoolFile) {
+		rewind(m_SpoolFile);
+
+		std::vector<char> buffer(RESPONSE_CHUNK_SIZE);
+		size_t rc;
+
+		while ((rc = fread(&buffer[0], 1, buffer.size(), m_SpoolFile)) > 0)
+			Write(&buffer[0], rc);
+
+		fclose(m_SpoolFile);
+		m_SpoolFile = NULL;
+	}
+}
+
+void LivestatusResponseWriter::Write(const char *data, size_t length)
+{
+	if (m_Failed)
+		return;
+
+	try {
+		m_Stream->Write(data, length);
+	} catch (const std::exception&) {
+		Log(LogCritical, "LivestatusQuery", "Cannot write query response to socket.");
+		m_Failed = true;
+	}
+}
+
+void LivestatusResponseWriter::SpoolToFile(const std::string& data)
+{
+	if (!m_SpoolFile) {
+		m_SpoolFile = tmpfile();
+
+		if (!m_SpoolFile) {
+			Log(LogWarning, "LivestatusQuery", "Could not create temporary file for the response. Spooling in memory.");
+
+			m_ChunkBytes += data.size();
+			m_Chunks.push_back(data);
+			return;
+		}
+
+		BOOST_FOREACH(const std::string& chunk, m_Chunks) {
+			fwrite(chunk.c_str(), 1, chunk.size(), m_SpoolFile);
+		}
+
+		m_Chunks.clear();
+		m_ChunkBytes = 0;
+	}
+
+	if (fwrite(data.c_str(), 1, data.size(), m_SpoolFile) != data.size()) {
+		Log(LogCritical, "LivestatusQuery", "Cannot write query response to temporary file.");
+		m_Failed = true;
+	}
+}
@@ -0,0 +1,73 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+
+#ifndef LIVESTATUSRESPONSEWRITER_H
+#define LIVESTATUSRESPONSEWRITER_H
+
+#include "livestatus/i2-livestatus.hpp"
+#include "base/stream.hpp"
+#include <boost/noncopyable.hpp>
+#include <sstream>
+#include <vector>
+#include <cstdio>
+
+namespace icinga
+{
+
+/**
+ * Writes a livestatus response to a stream in chunks while it is being
+ * formatted. When the response needs a length header (fixed16) the chunks
+ * are spooled - in memory for small responses and in a temporary file for
+ * large ones - until the response is complete.
+ *
+ * @ingroup livestatus
+ */
+class I2_LIVESTATUS_API LivestatusResponseWriter : private boost::noncopyable
+{
+public:
+	LivestatusResponseWriter(const Stream::Ptr& stream, bool spool);
+	~LivestatusResponseWriter(void);
+
+	std::ostream& GetStream(void);
+	void Commit(bool force = false);
+
+	size_t GetLength(void) const;
+	bool IsWritten(void) const;
+	bool IsFailed(void) const;
+
+	void WriteSpool(void);
+
+private:
+	Stream::Ptr m_Stream;
+	bool m_Spool;
+	std::ostringstream m_Buffer;
+	std::vector<std::string> m_Chunks;
+	size_t m_ChunkBytes;
+	FILE *m_SpoolFile;
+	size_t m_Length;
+	bool m_Failed;
+
+	void Write(const char *data, size_t length);
+	void SpoolToFile(const std::string& data);
+};
+
+}
+
+#endif /* LIVESTATUSRESPONSEWRITER_H */
@@ -36,7 +36,8 @@ class I2_LIVESTATUS_API LogTable : public HistoryTable
 public:
 	DECLARE_PTR_TYPEDEFS(LogTable);
 
-	LogTable(const String& compat_log_path, time_t from, time_t until);
+	LogTable(const String& compat_log_path, time_t from, time_t until,
+	    const String& host_name = String(), const String& service_description = String());
 
 	static void AddColumns(Table *table, const String& prefix = String(),
 	    const Column::ObjectAccessor& objectAccessor = Column::ObjectAccessor());
@@ -71,10 +72,11 @@ protected:
 	static Value CommandNameAccessor(const Value& row);
 
 private:
-	std::map<time_t, String> m_LogFileIndex;
 	std::map<time_t, Dictionary::Ptr> m_RowsCache;
 	time_t m_TimeFrom;
 	time_t m_TimeUntil;
+	String m_HostName;
+	String m_ServiceDescription;
 	String m_CompatLogPath;
 };
 
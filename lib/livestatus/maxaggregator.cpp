@@ -22,20 +22,35 @@
 using namespace icinga;
 
 MaxAggregator::MaxAggregator(const String& attr)
-    : m_Max(0), m_MaxAttr(attr)
+    : m_MaxAttr(attr)
 { }
 
-void MaxAggregator::Apply(const Table::Ptr& table, const Value& row)
+MaxAggregatorState *MaxAggregator::EnsureState(AggregatorState::Ptr& state)
+{
+	if (!state)
+		state.reset(new MaxAggregatorState());
+
+	return static_cast<MaxAggregatorState *>(state.get());
+}
+
+void MaxAggregator::Apply(const Table::Ptr& table, const Value& row, AggregatorState::Ptr& state)
 {
 	Column column = table->GetColumn(m_MaxAttr);
 
 	Value value = column.ExtractValue(row);
 
-	if (value > m_Max)
-		m_Max = value;
+	MaxAggregatorState *pstate = EnsureState(state);
+
+	if (value > pstate->Max)
+		pstate->Max = value;
 }
 
-double MaxAggregator::GetResult(void) const
+double MaxAggregator::GetResult(const AggregatorState *state) const
 {
-	return m_Max;
+	if (!state)
+		return 0;
+
+	const MaxAggregatorState *pstate = static_cast<const MaxAggregatorState *>(state);
+
+	return pstate->Max;
 }
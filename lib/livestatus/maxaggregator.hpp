@@ -26,6 +26,18 @@
 namespace icinga
 {
 
+/**
+ * @ingroup livestatus
+ */
+struct I2_LIVESTATUS_API MaxAggregatorState : public AggregatorState
+{
+	MaxAggregatorState(void)
+	    : Max(0)
+	{ }
+
+	double Max;
+};
+
 /**
  * @ingroup livestatus
  */
@@ -36,12 +48,13 @@ public:
 
 	MaxAggregator(const String& attr);
 
-	virtual void Apply(const Table::Ptr& table, const Value& row) override;
-	virtual double GetResult(void) const override;
+	virtual void Apply(const Table::Ptr& table, const Value& row, AggregatorState::Ptr& state) override;
+	virtual double GetResult(const AggregatorState *state) const override;
 
 private:
-	double m_Max;
 	String m_MaxAttr;
+
+	static MaxAggregatorState *EnsureState(AggregatorState::Ptr& state);
 };
 
 }
@@ -22,20 +22,42 @@
 using namespace icinga;
 
 MinAggregator::MinAggregator(const String& attr)
-    : m_Min(0), m_MinAttr(attr)
+    : m_MinAttr(attr)
 { }
 
-void MinAggregator::Apply(const Table::Ptr& table, const Value& row)
+MinAggregatorState *MinAggregator::EnsureState(AggregatorState::Ptr& state)
+{
+	if (!state)
+		state.reset(new MinAggregatorState());
+
+	return static_cast<MinAggregatorState *>(state.get());
+}
+
+void MinAggregator::Apply(const Table::Ptr& table, const Value& row, AggregatorState::Ptr& state)
 {
 	Column column = table->GetColumn(m_MinAttr);
 
 	Value value = column.ExtractValue(row);
 
-	if (value < m_Min)
-		m_Min = value;
+	MinAggregatorState *pstate = EnsureState(state);
+
+	if (value < pstate->Min)
+		pstate->Min = value;
 }
 
-double MinAggregator::GetResult(void) const
+double MinAggregator::GetResult(const AggregatorState *state) const
 {
-	return m_Min;
+	if (!state)
+		return 0;
+
+	const MinAggregatorState *pstate = static_cast<const MinAggregatorState *>(state);
+
+	double result;
+
+	if (pstate->Min == DBL_MAX)
+		result = 0;
+	else
+		result = pstate->Min;
+
+	return result;
 }
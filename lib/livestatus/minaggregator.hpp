@@ -22,10 +22,23 @@
 
 #include "livestatus/table.hpp"
 #include "livestatus/aggregator.hpp"
+#include <float.h>
 
 namespace icinga
 {
 
+/**
+ * @ingroup livestatus
+ */
+struct I2_LIVESTATUS_API MinAggregatorState : public AggregatorState
+{
+	MinAggregatorState(void)
+	    : Min(DBL_MAX)
+	{ }
+
+	double Min;
+};
+
 /**
  * @ingroup livestatus
  */
@@ -36,12 +49,13 @@ public:
 
 	MinAggregator(const String& attr);
 
-	virtual void Apply(const Table::Ptr& table, const Value& row) override;
-	virtual double GetResult(void) const override;
+	virtual void Apply(const Table::Ptr& table, const Value& row, AggregatorState::Ptr& state) override;
+	virtual double GetResult(const AggregatorState *state) const override;
 
 private:
-	double m_Min;
 	String m_MinAttr;
+
+	static MinAggregatorState *EnsureState(AggregatorState::Ptr& state);
 };
 
 }
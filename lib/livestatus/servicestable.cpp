@@ -176,9 +176,9 @@ void ServicesTable::FetchRows(const AddRowFunction& addRowFn)
 		}
 	} else if (GetGroupByType() == LivestatusGroupByHostGroup) {
 		BOOST_FOREACH(const HostGroup::Ptr& hg, ConfigType::GetObjectsByType<HostGroup>()) {
-			ObjectLock ylock(hg);
+			/* GetMembers() and GetServices() return copies: rows are written to
+			 * the client while they are added, no object locks may be held */
 			BOOST_FOREACH(const Host::Ptr& host, hg->GetMembers()) {
-				ObjectLock ylock(host);
 				BOOST_FOREACH(const Service::Ptr& service, host->GetServices()) {
 					/* the caller must know which groupby type and value are set for this row */
 					if (!addRowFn(service, LivestatusGroupByHostGroup, hg))
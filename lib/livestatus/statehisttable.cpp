@@ -47,11 +47,14 @@
 
 using namespace icinga;
 
-StateHistTable::StateHistTable(const String& compat_log_path, time_t from, time_t until)
+StateHistTable::StateHistTable(const String& compat_log_path, time_t from, time_t until,
+    const String& host_name, const String& service_description)
 {
 	/* store attributes for FetchRows */
 	m_TimeFrom = from;
 	m_TimeUntil = until;
+	m_HostName = host_name;
+	m_ServiceDescription = service_description;
 	m_CompatLogPath = compat_log_path;
 
 	AddColumns(this);
@@ -260,11 +263,9 @@ void StateHistTable::FetchRows(const AddRowFunction& addRowFn)
 	Log(LogDebug, "StateHistTable")
 	    << "Pre-selecting log file from " << m_TimeFrom << " until " << m_TimeUntil;
 
-	/* create log file index */
-	LivestatusLogUtility::CreateLogIndex(m_CompatLogPath, m_LogFileIndex);
-
-	/* generate log cache */
-	LivestatusLogUtility::CreateLogCache(m_LogFileIndex, this, m_TimeFrom, m_TimeUntil, addRowFn);
+	/* generate log cache from the log index */
+	LivestatusLogUtility::CreateLogCache(m_CompatLogPath, this, m_TimeFrom, m_TimeUntil,
+	    m_HostName, m_ServiceDescription, addRowFn);
 
 	Checkable::Ptr checkable;
 
@@ -37,7 +37,8 @@ class I2_LIVESTATUS_API StateHistTable : public HistoryTable
 public:
 	DECLARE_PTR_TYPEDEFS(StateHistTable);
 
-	StateHistTable(const String& compat_log_path, time_t from, time_t until);
+	StateHistTable(const String& compat_log_path, time_t from, time_t until,
+	    const String& host_name = String(), const String& service_description = String());
 
 	static void AddColumns(Table *table, const String& prefix = String(),
 	    const Column::ObjectAccessor& objectAccessor = Column::ObjectAccessor());
@@ -81,10 +82,11 @@ protected:
 	static Value DurationPartUnmonitoredAccessor(const Value& row);
 
 private:
-	std::map<time_t, String> m_LogFileIndex;
 	std::map<Checkable::Ptr, Array::Ptr> m_CheckablesCache;
 	time_t m_TimeFrom;
 	time_t m_TimeUntil;
+	String m_HostName;
+	String m_ServiceDescription;
 	String m_CompatLogPath;
 };
 
@@ -23,21 +23,37 @@
 using namespace icinga;
 
 StdAggregator::StdAggregator(const String& attr)
-    : m_StdSum(0), m_StdQSum(0), m_StdCount(0), m_StdAttr(attr)
+    : m_StdAttr(attr)
 { }
 
-void StdAggregator::Apply(const Table::Ptr& table, const Value& row)
+StdAggregatorState *StdAggregator::EnsureState(AggregatorState::Ptr& state)
+{
+	if (!state)
+		state.reset(new StdAggregatorState());
+
+	return static_cast<StdAggregatorState *>(state.get());
+}
+
+void StdAggregator::Apply(const Table::Ptr& table, const Value& row, AggregatorState::Ptr& state)
 {
 	Column column = table->GetColumn(m_StdAttr);
 
 	Value value = column.ExtractValue(row);
 
-	m_StdSum += value;
-	m_StdQSum += pow(value, 2);
-	m_StdCount++;
+	StdAggregatorState *pstate = EnsureState(state);
+
+	pstate->StdSum += value;
+	pstate->StdQSum += pow(value, 2);
+	pstate->StdCount++;
 }
 
-double StdAggregator::GetResult(void) const
+double StdAggregator::GetResult(const AggregatorState *state) const
 {
-	return sqrt((m_StdQSum - (1 / m_StdCount) * pow(m_StdSum, 2)) / (m_StdCount - 1));
+	if (!state)
+		return 0;
+
+	const StdAggregatorState *pstate = static_cast<const StdAggregatorState *>(state);
+
+	return sqrt((pstate->StdQSum - (1 / pstate->StdCount) * pow(pstate->StdSum, 2)) /
+	    (pstate->StdCount - 1));
 }
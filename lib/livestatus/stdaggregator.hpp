@@ -26,6 +26,20 @@
 namespace icinga
 {
 
+/**
+ * @ingroup livestatus
+ */
+struct I2_LIVESTATUS_API StdAggregatorState : public AggregatorState
+{
+	StdAggregatorState(void)
+	    : StdSum(0), StdQSum(0), StdCount(0)
+	{ }
+
+	double StdSum;
+	double StdQSum;
+	double StdCount;
+};
+
 /**
  * @ingroup livestatus
  */
@@ -36,14 +50,13 @@ public:
 
 	StdAggregator(const String& attr);
 
-	virtual void Apply(const Table::Ptr& table, const Value& row) override;
-	virtual double GetResult(void) const override;
+	virtual void Apply(const Table::Ptr& table, const Value& row, AggregatorState::Ptr& state) override;
+	virtual double GetResult(const AggregatorState *state) const override;
 
 private:
-	double m_StdSum;
-	double m_StdQSum;
-	double m_StdCount;
 	String m_StdAttr;
+
+	static StdAggregatorState *EnsureState(AggregatorState::Ptr& state);
 };
 
 }
@@ -22,19 +22,34 @@
 using namespace icinga;
 
 SumAggregator::SumAggregator(const String& attr)
-    : m_Sum(0), m_SumAttr(attr)
+    : m_SumAttr(attr)
 { }
 
-void SumAggregator::Apply(const Table::Ptr& table, const Value& row)
+SumAggregatorState *SumAggregator::EnsureState(AggregatorState::Ptr& state)
+{
+	if (!state)
+		state.reset(new SumAggregatorState());
+
+	return static_cast<SumAggregatorState *>(state.get());
+}
+
+void SumAggregator::Apply(const Table::Ptr& table, const Value& row, AggregatorState::Ptr& state)
 {
 	Column column = table->GetColumn(m_SumAttr);
 
 	Value value = column.ExtractValue(row);
 
-	m_Sum += value;
+	SumAggregatorState *pstate = EnsureState(state);
+
+	pstate->Sum += value;
 }
 
-double SumAggregator::GetResult(void) const
+double SumAggregator::GetResult(const AggregatorState *state) const
 {
-	return m_Sum;
+	if (!state)
+		return 0;
+
+	const SumAggregatorState *pstate = static_cast<const SumAggregatorState *>(state);
+
+	return pstate->Sum;
 }
@@ -47,7 +47,8 @@ Table::Table(LivestatusGroupByType type)
     : m_GroupByType(type), m_GroupByObject(Empty)
 { }
 
-Table::Ptr Table::GetByName(const String& name, const String& compat_log_path, const unsigned long& from, const unsigned long& until)
+Table::Ptr Table::GetByName(const String& name, const String& compat_log_path, const unsigned long& from,
+    const unsigned long& until, const String& host_name, const String& service_description)
 {
 	if (name == "status")
 		return new StatusTable();
@@ -78,9 +79,9 @@ Table::Ptr Table::GetByName(const String& name, const String& compat_log_path, c
 	else if (name == "timeperiods")
 		return new TimePeriodsTable();
 	else if (name == "log")
-		return new LogTable(compat_log_path, from, until);
+		return new LogTable(compat_log_path, from, until, host_name, service_description);
 	else if (name == "statehist")
-		return new StateHistTable(compat_log_path, from, until);
+		return new StateHistTable(compat_log_path, from, until, host_name, service_description);
 	else if (name == "endpoints")
 		return new EndpointsTable();
 	else if (name == "zones")
@@ -136,6 +137,36 @@ std::vector<LivestatusRowValue> Table::FilterRows(const Filter::Ptr& filter, int
 	return rs;
 }
 
+/**
+ * Calls rowFn for each row which matches the filter without collecting the
+ * rows first. Stops when rowFn returns false or the limit has been reached.
+ */
+void Table::FilterRows(const Filter::Ptr& filter, int limit, const FilteredRowFunction& rowFn)
+{
+	int count = 0;
+
+	FetchRows(boost::bind(&Table::FilteredCallRow, this, boost::cref(rowFn), filter, limit, boost::ref(count), _1, _2, _3));
+}
+
+bool Table::FilteredCallRow(const FilteredRowFunction& rowFn, const Filter::Ptr& filter, int limit, int& count, const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject)
+{
+	if (limit != -1 && count == limit)
+		return false;
+
+	if (!filter || filter->Apply(this, row)) {
+		LivestatusRowValue rval;
+		rval.Row = row;
+		rval.GroupByType = groupByType;
+		rval.GroupByObject = groupByObject;
+
+		count++;
+
+		return rowFn(rval);
+	}
+
+	return true;
+}
+
 bool Table::FilteredAddRow(std::vector<LivestatusRowValue>& rs, const Filter::Ptr& filter, int limit, const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject)
 {
 	if (limit != -1 && rs.size() == limit)
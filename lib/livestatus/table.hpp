@@ -37,6 +37,7 @@ struct LivestatusRowValue {
 
 
 typedef boost::function<bool (const Value&, LivestatusGroupByType, const Object::Ptr&)> AddRowFunction;
+typedef boost::function<bool (const LivestatusRowValue&)> FilteredRowFunction;
 
 class Filter;
 
@@ -48,12 +49,14 @@ class I2_LIVESTATUS_API Table : public Object
 public:
 	DECLARE_PTR_TYPEDEFS(Table);
 
-	static Table::Ptr GetByName(const String& name, const String& compat_log_path = "", const unsigned long& from = 0, const unsigned long& until = 0);
+	static Table::Ptr GetByName(const String& name, const String& compat_log_path = "", const unsigned long& from = 0,
+	    const unsigned long& until = 0, const String& host_name = String(), const String& service_description = String());
 
 	virtual String GetName(void) const = 0;
 	virtual String GetPrefix(void) const = 0;
 
 	std::vector<LivestatusRowValue> FilterRows(const intrusive_ptr<Filter>& filter, int limit = -1);
+	void FilterRows(const intrusive_ptr<Filter>& filter, int limit, const FilteredRowFunction& rowFn);
 
 	void AddColumn(const String& name, const Column& column);
 	Column GetColumn(const String& name) const;
@@ -79,6 +82,7 @@ private:
 	std::map<String, Column> m_Columns;
 
 	bool FilteredAddRow(std::vector<LivestatusRowValue>& rs, const intrusive_ptr<Filter>& filter, int limit, const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject);
+	bool FilteredCallRow(const FilteredRowFunction& rowFn, const intrusive_ptr<Filter>& filter, int limit, int& count, const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject);
 };
 
 }
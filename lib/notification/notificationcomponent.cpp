@@ -21,6 +21,7 @@
 #include "notification/notificationcomponent.tcpp"
 #include "icinga/service.hpp"
 #include "icinga/icingaapplication.hpp"
+#include "icinga/perfdatavalue.hpp"
 #include "base/configtype.hpp"
 #include "base/objectlock.hpp"
 #include "base/logger.hpp"
@@ -35,17 +36,47 @@ REGISTER_TYPE(NotificationComponent);
 
 REGISTER_STATSFUNCTION(NotificationComponent, &NotificationComponent::StatsFunc);
 
-void NotificationComponent::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
+void NotificationComponent::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	Dictionary::Ptr nodes = new Dictionary();
 
 	BOOST_FOREACH(const NotificationComponent::Ptr& notification_component, ConfigType::GetObjectsByType<NotificationComponent>()) {
 		nodes->Set(notification_component->GetName(), 1); //add more stats
+
+		unsigned long idle, due;
+
+		{
+			boost::mutex::scoped_lock lock(notification_component->m_NotificationMutex);
+			idle = notification_component->m_IdleNotifications.GetLength();
+			due = notification_component->m_LastDueNotifications;
+		}
+
+		String perfdata_prefix = "notificationcomponent_" + notification_component->GetName() + "_";
+		perfdata->Add(new PerfdataValue(perfdata_prefix + "idle", Convert::ToDouble(idle)));
+		perfdata->Add(new PerfdataValue(perfdata_prefix + "due", Convert::ToDouble(due)));
 	}
 
 	status->Set("notificationcomponent", nodes);
 }
 
+void NotificationComponent::OnConfigLoaded(void)
+{
+	ObjectImpl<NotificationComponent>::OnConfigLoaded();
+
+	m_LastDueNotifications = 0;
+
+	ConfigObject::OnActiveChanged.connect(boost::bind(&NotificationComponent::ObjectHandler, this, _1));
+	ConfigObject::OnPausedChanged.connect(boost::bind(&NotificationComponent::ObjectHandler, this, _1));
+
+	ObjectImpl<Notification>::OnNextNotificationChanged.connect(boost::bind(&NotificationComponent::ScheduleNotification, this, _1));
+	Notification::OnIntervalChanged.connect(boost::bind(&NotificationComponent::ScheduleNotification, this, _1));
+
+	Checkable::OnEnableNotificationsChanged.connect(boost::bind(&NotificationComponent::CheckableChangedHandler, this, _1));
+	Checkable::OnStateChange.connect(boost::bind(&NotificationComponent::CheckableChangedHandler, this, _1));
+
+	IcingaApplication::OnEnableNotificationsChanged.connect(boost::bind(&NotificationComponent::GlobalNotificationsChangedHandler, this));
+}
+
 /**
  * Starts the component.
  */
@@ -56,6 +87,9 @@ void NotificationComponent::Start(void)
 	Checkable::OnNotificationsRequested.connect(boost::bind(&NotificationComponent::SendNotificationsHandler, this, _1,
 	    _2, _3, _4, _5));
 
+	/* pick up notifications which were activated before this component */
+	GlobalNotificationsChangedHandler();
+
 	m_NotificationTimer = new Timer();
 	m_NotificationTimer->SetInterval(5);
 	m_NotificationTimer->OnTimerExpired.connect(boost::bind(&NotificationComponent::NotificationTimerHandler, this));
@@ -63,7 +97,57 @@ void NotificationComponent::Start(void)
 }
 
 /**
- * Periodically sends notifications.
+ * Adds the notification to the reminder queue using its next notification
+ * time or removes it from the queue if it isn't active.
+ */
+void NotificationComponent::ScheduleNotification(const Notification::Ptr& notification)
+{
+	boost::mutex::scoped_lock lock(m_NotificationMutex);
+
+	if (notification->IsActive())
+		m_IdleNotifications.Insert(notification, notification->GetNextNotification());
+	else
+		m_IdleNotifications.Remove(notification);
+}
+
+void NotificationComponent::ObjectHandler(const ConfigObject::Ptr& object)
+{
+	Notification::Ptr notification = dynamic_pointer_cast<Notification>(object);
+
+	if (notification) {
+		ScheduleNotification(notification);
+		return;
+	}
+
+	Checkable::Ptr checkable = dynamic_pointer_cast<Checkable>(object);
+
+	if (checkable)
+		CheckableChangedHandler(checkable);
+}
+
+/**
+ * Re-evaluates the notifications for a checkable whose notifications
+ * may have been skipped by the timer handler.
+ */
+void NotificationComponent::CheckableChangedHandler(const Checkable::Ptr& checkable)
+{
+	BOOST_FOREACH(const Notification::Ptr& notification, checkable->GetNotifications()) {
+		ScheduleNotification(notification);
+	}
+}
+
+void NotificationComponent::GlobalNotificationsChangedHandler(void)
+{
+	BOOST_FOREACH(const Notification::Ptr& notification, ConfigType::GetObjectsByType<Notification>()) {
+		ScheduleNotification(notification);
+	}
+}
+
+/**
+ * Periodically sends reminder notifications. Only notifications whose next
+ * notification time has passed are processed. Notifications which are
+ * skipped without updating their next notification time are not
+ * re-queued until one of the conditions they depend on changes.
  *
  * @param - Event arguments for the timer.
  */
@@ -71,7 +155,20 @@ void NotificationComponent::NotificationTimerHandler(void)
 {
 	double now = Utility::GetTime();
 
-	BOOST_FOREACH(const Notification::Ptr& notification, ConfigType::GetObjectsByType<Notification>()) {
+	std::vector<Notification::Ptr> notifications;
+
+	{
+		boost::mutex::scoped_lock lock(m_NotificationMutex);
+
+		Notification::Ptr notification;
+
+		while (m_IdleNotifications.Pop(now, notification))
+			notifications.push_back(notification);
+
+		m_LastDueNotifications = notifications.size();
+	}
+
+	BOOST_FOREACH(const Notification::Ptr& notification, notifications) {
 		Checkable::Ptr checkable = notification->GetCheckable();
 
 		if (checkable->IsPaused() && GetEnableHA())
@@ -83,9 +180,6 @@ void NotificationComponent::NotificationTimerHandler(void)
 		if (notification->GetInterval() <= 0 && notification->GetLastProblemNotification() > checkable->GetLastHardStateChange())
 			continue;
 
-		if (notification->GetNextNotification() > now)
-			continue;
-
 		bool reachable = checkable->IsReachable(DependencyNotification);
 
 		{
@@ -93,6 +187,8 @@ void NotificationComponent::NotificationTimerHandler(void)
 			notification->SetNextNotification(Utility::GetTime() + notification->GetInterval());
 		}
 
+		bool problem;
+
 		{
 			Host::Ptr host;
 			Service::Ptr service;
@@ -100,14 +196,18 @@ void NotificationComponent::NotificationTimerHandler(void)
 
 			ObjectLock olock(checkable);
 
-			if (checkable->GetStateType() == StateTypeSoft)
-				continue;
+			problem = checkable->GetStateType() == StateTypeHard &&
+			    ((service && service->GetState() != ServiceOK) || (!service && host->GetState() != HostUp));
 
-			if ((service && service->GetState() == ServiceOK) || (!service && host->GetState() == HostUp))
-				continue;
+			if (!problem || !reachable || checkable->IsInDowntime() || checkable->IsAcknowledged()) {
+				/* Without reminders there is nothing to do until the state changes. */
+				if (!problem && notification->GetInterval() <= 0) {
+					boost::mutex::scoped_lock lock(m_NotificationMutex);
+					m_IdleNotifications.Remove(notification);
+				}
 
-			if (!reachable || checkable->IsInDowntime() || checkable->IsAcknowledged())
 				continue;
+			}
 		}
 
 		try {
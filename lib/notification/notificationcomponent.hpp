@@ -24,6 +24,8 @@
 #include "icinga/service.hpp"
 #include "base/configobject.hpp"
 #include "base/timer.hpp"
+#include "base/timingwheel.hpp"
+#include <boost/thread/mutex.hpp>
 
 namespace icinga
 {
@@ -39,12 +41,21 @@ public:
 
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
 
+	virtual void OnConfigLoaded(void) override;
 	virtual void Start(void) override;
 
 private:
 	Timer::Ptr m_NotificationTimer;
 
+	boost::mutex m_NotificationMutex;
+	TimingWheel<Notification::Ptr> m_IdleNotifications;
+	unsigned long m_LastDueNotifications;
+
 	void NotificationTimerHandler(void);
+	void ScheduleNotification(const Notification::Ptr& notification);
+	void ObjectHandler(const ConfigObject::Ptr& object);
+	void CheckableChangedHandler(const Checkable::Ptr& checkable);
+	void GlobalNotificationsChangedHandler(void);
 	void SendNotificationsHandler(const Checkable::Ptr& checkable, NotificationType type,
 	    const CheckResult::Ptr& cr, const String& author, const String& text);
 };
@@ -33,15 +33,38 @@
 #include "base/networkstream.hpp"
 #include "base/json.hpp"
 #include "base/context.hpp"
+#include "base/statsfunction.hpp"
+#include <boost/foreach.hpp>
 
 using namespace icinga;
 
 REGISTER_TYPE(GelfWriter);
 
+REGISTER_STATSFUNCTION(GelfWriter, &GelfWriter::StatsFunc);
+
+void GelfWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
+{
+	Dictionary::Ptr nodes = new Dictionary();
+
+	BOOST_FOREACH(const GelfWriter::Ptr& gelfwriter, ConfigType::GetObjectsByType<GelfWriter>()) {
+		MetricQueue::Ptr queue = gelfwriter->m_Queue;
+
+		if (!queue)
+			continue;
+
+		nodes->Set(gelfwriter->GetName(), queue->GetStats("gelfwriter_" + gelfwriter->GetName() + "_", perfdata));
+	}
+
+	status->Set("gelfwriter", nodes);
+}
+
 void GelfWriter::Start(void)
 {
 	ObjectImpl<GelfWriter>::Start();
 
+	m_Queue = new MetricQueue("GelfWriter", GetSpoolDir() + "/" + GetName() + ".spool");
+	m_Queue->Start(std::max(GetBufferSize(), 0), std::max(GetFlushThreshold(), 0), GetFlushInterval(), std::max(GetSpoolSize(), 0));
+
 	m_ReconnectTimer = new Timer();
 	m_ReconnectTimer->SetInterval(10);
 	m_ReconnectTimer->OnTimerExpired.connect(boost::bind(&GelfWriter::ReconnectTimerHandler, this));
@@ -56,9 +79,17 @@ void GelfWriter::Start(void)
 	Service::OnStateChange.connect(boost::bind(&GelfWriter::StateChangeHandler, this, _1, _2, _3));
 }
 
+void GelfWriter::Stop(void)
+{
+	m_ReconnectTimer->Stop();
+	m_Queue->Stop();
+
+	ObjectImpl<GelfWriter>::Stop();
+}
+
 void GelfWriter::ReconnectTimerHandler(void)
 {
-	if (m_Stream)
+	if (m_Queue->IsConnected())
 		return;
 
 	TcpSocket::Ptr socket = new TcpSocket();
@@ -74,7 +105,7 @@ void GelfWriter::ReconnectTimerHandler(void)
 		return;
 	}
 
-	m_Stream = new NetworkStream(socket);
+	m_Queue->SetStream(new NetworkStream(socket));
 }
 
 void GelfWriter::CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
@@ -212,26 +243,11 @@ String GelfWriter::ComposeGelfMessage(const Dictionary::Ptr& fields, const Strin
 
 void GelfWriter::SendLogMessage(const String& gelf)
 {
-	std::ostringstream msgbuf;
-	msgbuf << gelf;
-	msgbuf << '\0';
-
-	String log = msgbuf.str();
-
-	ObjectLock olock(this);
-
-	if (!m_Stream)
-		return;
+	Log(LogDebug, "GelfWriter")
+	    << "Sending '" << gelf << "'.";
 
-	try {
-		//TODO remove
-		Log(LogDebug, "GelfWriter")
-		    << "Sending '" << log << "'.";
-		m_Stream->Write(log.CStr(), log.GetLength());
-	} catch (const std::exception& ex) {
-		Log(LogCritical, "GelfWriter")
-		    << "Cannot write to TCP socket on host '" << GetHost() << "' port '" << GetPort() << "'.";
+	String log = gelf;
+	log += '\0';
 
-		m_Stream.reset();
-	}
+	m_Queue->Enqueue(log);
 }
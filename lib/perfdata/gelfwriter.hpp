@@ -21,6 +21,7 @@
 #define GELFWRITER_H
 
 #include "perfdata/gelfwriter.thpp"
+#include "perfdata/metricqueue.hpp"
 #include "icinga/service.hpp"
 #include "base/configobject.hpp"
 #include "base/tcpsocket.hpp"
@@ -41,11 +42,14 @@ public:
 	DECLARE_OBJECT(GelfWriter);
 	DECLARE_OBJECTNAME(GelfWriter);
 
+	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
+
 protected:
 	virtual void Start(void) override;
+	virtual void Stop(void) override;
 
 private:
-	Stream::Ptr m_Stream;
+	MetricQueue::Ptr m_Queue;
 
 	Timer::Ptr m_ReconnectTimer;
 
@@ -47,12 +47,17 @@ REGISTER_TYPE(GraphiteWriter);
 
 REGISTER_STATSFUNCTION(GraphiteWriter, &GraphiteWriter::StatsFunc);
 
-void GraphiteWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
+void GraphiteWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	Dictionary::Ptr nodes = new Dictionary();
 
 	BOOST_FOREACH(const GraphiteWriter::Ptr& graphitewriter, ConfigType::GetObjectsByType<GraphiteWriter>()) {
-		nodes->Set(graphitewriter->GetName(), 1); //add more stats
+		MetricQueue::Ptr queue = graphitewriter->m_Queue;
+
+		if (!queue)
+			continue;
+
+		nodes->Set(graphitewriter->GetName(), queue->GetStats("graphitewriter_" + graphitewriter->GetName() + "_", perfdata));
 	}
 
 	status->Set("graphitewriter", nodes);
@@ -62,6 +67,9 @@ void GraphiteWriter::Start(void)
 {
 	ObjectImpl<GraphiteWriter>::Start();
 
+	m_Queue = new MetricQueue("GraphiteWriter", GetSpoolDir() + "/" + GetName() + ".spool");
+	m_Queue->Start(std::max(GetBufferSize(), 0), std::max(GetFlushThreshold(), 0), GetFlushInterval(), std::max(GetSpoolSize(), 0));
+
 	m_ReconnectTimer = new Timer();
 	m_ReconnectTimer->SetInterval(10);
 	m_ReconnectTimer->OnTimerExpired.connect(boost::bind(&GraphiteWriter::ReconnectTimerHandler, this));
@@ -71,9 +79,17 @@ void GraphiteWriter::Start(void)
 	Service::OnNewCheckResult.connect(boost::bind(&GraphiteWriter::CheckResultHandler, this, _1, _2));
 }
 
+void GraphiteWriter::Stop(void)
+{
+	m_ReconnectTimer->Stop();
+	m_Queue->Stop();
+
+	ObjectImpl<GraphiteWriter>::Stop();
+}
+
 void GraphiteWriter::ReconnectTimerHandler(void)
 {
-	if (m_Stream)
+	if (m_Queue->IsConnected())
 		return;
 
 	TcpSocket::Ptr socket = new TcpSocket();
@@ -89,7 +105,7 @@ void GraphiteWriter::ReconnectTimerHandler(void)
 		return;
 	}
 
-	m_Stream = new NetworkStream(socket);
+	m_Queue->SetStream(new NetworkStream(socket));
 }
 
 void GraphiteWriter::CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
@@ -168,27 +184,10 @@ void GraphiteWriter::CheckResultHandler(const Checkable::Ptr& checkable, const C
 
 void GraphiteWriter::SendPerfdata(const String& prefix, const CheckResult::Ptr& cr, double ts)
 {
-	Array::Ptr perfdata = cr->GetPerformanceData();
-
-	if (!perfdata)
-		return;
+	Array::Ptr perfdata = cr->GetPerfdataValues();
 
 	ObjectLock olock(perfdata);
-	BOOST_FOREACH(const Value& val, perfdata) {
-		PerfdataValue::Ptr pdv;
-
-		if (val.IsObjectType<PerfdataValue>())
-			pdv = val;
-		else {
-			try {
-				pdv = PerfdataValue::Parse(val);
-			} catch (const std::exception&) {
-				Log(LogWarning, "GraphiteWriter")
-				    << "Ignoring invalid perfdata value: " << val;
-				continue;
-			}
-		}
-
+	BOOST_FOREACH(const PerfdataValue::Ptr& pdv, perfdata) {
 		/* new mode below. old mode in else tree with 2.4, deprecate it in 2.6 */
 		if (!GetEnableLegacyMode()) {
 			String escaped_key = EscapeMetricLabel(pdv->GetLabel());
@@ -224,29 +223,15 @@ void GraphiteWriter::SendPerfdata(const String& prefix, const CheckResult::Ptr&
 
 void GraphiteWriter::SendMetric(const String& prefix, const String& name, double value, double ts)
 {
-	std::ostringstream msgbuf;
-	msgbuf << prefix << "." << name << " " << Convert::ToString(value) << " " << static_cast<long>(ts);
+	String metric = prefix + "." + name + " " + Convert::ToString(value) + " " + Convert::ToString(static_cast<long>(ts));
 
 	Log(LogDebug, "GraphiteWriter")
-	    << "Add to metric list:'" << msgbuf.str() << "'.";
+	    << "Add to metric list:'" << metric << "'.";
 
 	// do not send \n to debug log
-	msgbuf << "\n";
-	String metric = msgbuf.str();
-
-	ObjectLock olock(this);
-
-	if (!m_Stream)
-		return;
+	metric += '\n';
 
-	try {
-		m_Stream->Write(metric.CStr(), metric.GetLength());
-	} catch (const std::exception& ex) {
-		Log(LogCritical, "GraphiteWriter")
-		    << "Cannot write to TCP socket on host '" << GetHost() << "' port '" << GetPort() << "'.";
-
-		m_Stream.reset();
-	}
+	m_Queue->Enqueue(metric);
 }
 
 String GraphiteWriter::EscapeMetric(const String& str, bool legacyMode)
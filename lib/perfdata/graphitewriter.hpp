@@ -21,6 +21,7 @@
 #define GRAPHITEWRITER_H
 
 #include "perfdata/graphitewriter.thpp"
+#include "perfdata/metricqueue.hpp"
 #include "icinga/service.hpp"
 #include "base/configobject.hpp"
 #include "base/tcpsocket.hpp"
@@ -48,9 +49,10 @@ public:
 
 protected:
 	virtual void Start(void) override;
+	virtual void Stop(void) override;
 
 private:
-	Stream::Ptr m_Stream;
+	MetricQueue::Ptr m_Queue;
 
 	Timer::Ptr m_ReconnectTimer;
 
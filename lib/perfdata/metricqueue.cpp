@@ -0,0 +1,319 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+
+#include "perfdata/metricqueue.hpp"
+#include "icinga/perfdatavalue.hpp"
+#include "base/logger.hpp"
+#include "base/utility.hpp"
+#include "base/exception.hpp"
+#include <boost/foreach.hpp>
+#include <fstream>
+#include <cstdio>
+
+using namespace icinga;
+
+MetricQueue::MetricQueue(const String& facility, const String& spoolPath)
+	: m_Facility(facility), m_SpoolPath(spoolPath), m_MaxRecords(1), m_FlushThreshold(1),
+	  m_FlushInterval(1), m_MaxSpoolSize(0), m_Stopped(true), m_SpoolSize(0), m_Dropped(0), m_BytesSent(0),
+	  m_FlushRequests(0), m_FlushesDone(0)
+{ }
+
+MetricQueue::~MetricQueue(void)
+{
+	Stop();
+}
+
+/**
+ * Starts the thread which writes the queued records.
+ *
+ * @param maxRecords The maximum number of queued records. New records are
+ *		     dropped when the queue is full.
+ * @param flushThreshold The number of queued records which triggers a write.
+ * @param flushInterval The maximum time (in seconds) records are queued.
+ * @param maxSpoolSize The maximum size of the spool file in bytes. A value
+ *		       of 0 disables the spool file.
+ */
+void MetricQueue::Start(size_t maxRecords, size_t flushThreshold, double flushInterval, size_t maxSpoolSize)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	if (!m_Stopped)
+		return;
+
+	m_MaxRecords = std::max(maxRecords, static_cast<size_t>(1));
+	m_FlushThreshold = std::max(std::min(flushThreshold, m_MaxRecords), static_cast<size_t>(1));
+	m_FlushInterval = std::max(flushInterval, 0.01);
+	m_MaxSpoolSize = maxSpoolSize;
+
+	/* records which were spooled before a restart are replayed as well */
+	m_SpoolSize = 0;
+
+	if (m_MaxSpoolSize > 0) {
+		Utility::MkDirP(Utility::DirName(m_SpoolPath), 0750);
+
+		std::ifstream fp(m_SpoolPath.CStr(), std::ios_base::in | std::ios_base::binary | std::ios_base::ate);
+
+		if (fp)
+			m_SpoolSize = fp.tellg();
+	}
+
+	m_Stopped = false;
+	m_Thread = boost::thread(boost::bind(&MetricQueue::FlushThreadProc, this));
+}
+
+/**
+ * Writes (or spools) all queued records and stops the flush thread.
+ */
+void MetricQueue::Stop(void)
+{
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		if (m_Stopped)
+			return;
+
+		m_Stopped = true;
+		m_CV.notify_all();
+		m_FlushCV.notify_all();
+	}
+
+	m_Thread.join();
+}
+
+/**
+ * Adds a record to the queue. The record must include its delimiter.
+ *
+ * @param record The record.
+ */
+void MetricQueue::Enqueue(const String& record)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	if (m_Stopped)
+		return;
+
+	if (m_Records.size() >= m_MaxRecords) {
+		m_Dropped++;
+		return;
+	}
+
+	m_Records.push_back(record);
+
+	if (m_Records.size() == m_FlushThreshold)
+		m_CV.notify_all();
+}
+
+/**
+ * Writes (or spools) all records which are currently queued and waits
+ * until the flush thread is done with them.
+ */
+void MetricQueue::Flush(void)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	unsigned long request = ++m_FlushRequests;
+	m_CV.notify_all();
+
+	while (!m_Stopped && m_FlushesDone < request)
+		m_FlushCV.wait(lock);
+}
+
+void MetricQueue::SetStream(const Stream::Ptr& stream)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+	m_Stream = stream;
+	m_CV.notify_all();
+}
+
+bool MetricQueue::IsConnected(void) const
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+	return static_cast<bool>(m_Stream);
+}
+
+/**
+ * Returns the statistics for this queue and adds them to the perfdata.
+ *
+ * @param perfdataPrefix The prefix for the perfdata labels.
+ * @param perfdata The perfdata array.
+ * @returns The statistics.
+ */
+Dictionary::Ptr MetricQueue::GetStats(const String& perfdataPrefix, const Array::Ptr& perfdata) const
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	Dictionary::Ptr stats = new Dictionary();
+	stats->Set("connected", static_cast<bool>(m_Stream));
+	stats->Set("queue_size", m_Records.size());
+	stats->Set("queue_max_size", m_MaxRecords);
+	stats->Set("dropped", m_Dropped);
+	stats->Set("bytes_sent", m_BytesSent);
+	stats->Set("spool_size", m_SpoolSize);
+
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "queue_size", m_Records.size()));
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "dropped", m_Dropped, true));
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "bytes_sent", m_BytesSent, true, "B"));
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "spool_size", m_SpoolSize, false, "B"));
+
+	return stats;
+}
+
+void MetricQueue::FlushThreadProc(void)
+{
+	Utility::SetThreadName(m_Facility);
+
+	std::deque<String> records;
+
+	for (;;) {
+		Stream::Ptr stream;
+		bool stopped, replay;
+		unsigned long flushRequests;
+
+		{
+			boost::mutex::scoped_lock lock(m_Mutex);
+
+			if (!m_Stopped && m_Records.size() < m_FlushThreshold && m_FlushesDone == m_FlushRequests)
+				m_CV.timed_wait(lock, boost::posix_time::milliseconds(static_cast<long>(m_FlushInterval * 1000)));
+
+			records.swap(m_Records);
+			stream = m_Stream;
+			stopped = m_Stopped;
+			replay = (m_SpoolSize > 0);
+			flushRequests = m_FlushRequests;
+		}
+
+		if (stream && replay && !ReplaySpool(stream))
+			stream.reset();
+
+		if (!records.empty()) {
+			size_t length = 0;
+
+			BOOST_FOREACH(const String& record, records) {
+				length += record.GetLength();
+			}
+
+			String data;
+			data.GetData().reserve(length);
+
+			BOOST_FOREACH(const String& record, records) {
+				data += record;
+			}
+
+			size_t count = records.size();
+			records.clear();
+
+			if (!stream || !WriteData(stream, data))
+				SpoolData(data, count);
+		}
+
+		{
+			boost::mutex::scoped_lock lock(m_Mutex);
+			m_FlushesDone = flushRequests;
+			m_FlushCV.notify_all();
+		}
+
+		if (stopped)
+			break;
+	}
+}
+
+bool MetricQueue::WriteData(const Stream::Ptr& stream, const String& data)
+{
+	try {
+		stream->Write(data.CStr(), data.GetLength());
+	} catch (const std::exception& ex) {
+		Log(LogCritical, m_Facility)
+		    << "Cannot write to connection: " << DiagnosticInformation(ex, false);
+
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		/* the writer reconnects when its stream is gone */
+		if (m_Stream == stream)
+			m_Stream.reset();
+
+		return false;
+	}
+
+	boost::mutex::scoped_lock lock(m_Mutex);
+	m_BytesSent += data.GetLength();
+
+	return true;
+}
+
+/**
+ * Writes the contents of the spool file to the stream and removes the file.
+ * The file is kept if the stream fails, so records may be sent more than
+ * once when the connection breaks during the replay.
+ */
+bool MetricQueue::ReplaySpool(const Stream::Ptr& stream)
+{
+	std::ifstream fp(m_SpoolPath.CStr(), std::ios_base::in | std::ios_base::binary);
+
+	if (fp) {
+		Log(LogInformation, m_Facility)
+		    << "Replaying spooled records from '" << m_SpoolPath << "'.";
+
+		char buffer[64 * 1024];
+
+		while (fp) {
+			fp.read(buffer, sizeof(buffer));
+
+			if (fp.gcount() > 0 && !WriteData(stream, String(buffer, buffer + fp.gcount())))
+				return false;
+		}
+
+		fp.close();
+	}
+
+	(void) remove(m_SpoolPath.CStr());
+
+	boost::mutex::scoped_lock lock(m_Mutex);
+	m_SpoolSize = 0;
+
+	return true;
+}
+
+void MetricQueue::SpoolData(const String& data, size_t count)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	if (m_SpoolSize + data.GetLength() > m_MaxSpoolSize) {
+		m_Dropped += count;
+		return;
+	}
+
+	lock.unlock();
+
+	std::ofstream fp(m_SpoolPath.CStr(), std::ios_base::out | std::ios_base::binary | std::ios_base::app);
+	fp.write(data.CStr(), data.GetLength());
+	fp.close();
+
+	if (fp.fail()) {
+		Log(LogWarning, m_Facility)
+		    << "Could not write to spool file '" << m_SpoolPath << "'.";
+
+		lock.lock();
+		m_Dropped += count;
+		return;
+	}
+
+	lock.lock();
+	m_SpoolSize += data.GetLength();
+}
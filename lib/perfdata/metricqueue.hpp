@@ -0,0 +1,94 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+
+#ifndef METRICQUEUE_H
+#define METRICQUEUE_H
+
+#include "base/object.hpp"
+#include "base/stream.hpp"
+#include "base/dictionary.hpp"
+#include "base/array.hpp"
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <deque>
+
+namespace icinga
+{
+
+/**
+ * A bounded queue for the records of a perfdata writer. Records are written
+ * to the writer's stream in batches by a background thread. While the
+ * writer is not connected they are appended to a spool file which is
+ * replayed once the connection has been re-established.
+ *
+ * @ingroup perfdata
+ */
+class MetricQueue : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(MetricQueue);
+
+	MetricQueue(const String& facility, const String& spoolPath);
+	~MetricQueue(void);
+
+	void Start(size_t maxRecords, size_t flushThreshold, double flushInterval, size_t maxSpoolSize);
+	void Stop(void);
+
+	void Enqueue(const String& record);
+	void Flush(void);
+
+	void SetStream(const Stream::Ptr& stream);
+	bool IsConnected(void) const;
+
+	Dictionary::Ptr GetStats(const String& perfdataPrefix, const Array::Ptr& perfdata) const;
+
+private:
+	String m_Facility;
+	String m_SpoolPath;
+
+	size_t m_MaxRecords;
+	size_t m_FlushThreshold;
+	double m_FlushInterval;
+	size_t m_MaxSpoolSize;
+
+	mutable boost::mutex m_Mutex;
+	boost::condition_variable m_CV;
+	boost::condition_variable m_FlushCV;
+	std::deque<String> m_Records;
+	Stream::Ptr m_Stream;
+	bool m_Stopped;
+	boost::thread m_Thread;
+
+	size_t m_SpoolSize;
+	unsigned long m_Dropped;
+	unsigned long m_BytesSent;
+	unsigned long m_FlushRequests;
+	unsigned long m_FlushesDone;
+
+	void FlushThreadProc(void);
+	bool WriteData(const Stream::Ptr& stream, const String& data);
+	bool ReplaySpool(const Stream::Ptr& stream);
+	void SpoolData(const String& data, size_t count);
+};
+
+}
+
+#endif /* METRICQUEUE_H */
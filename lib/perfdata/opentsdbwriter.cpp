@@ -47,12 +47,17 @@ REGISTER_TYPE(OpenTsdbWriter);
 
 REGISTER_STATSFUNCTION(OpenTsdbWriter, &OpenTsdbWriter::StatsFunc);
 
-void OpenTsdbWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
+void OpenTsdbWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	Dictionary::Ptr nodes = new Dictionary();
 
 	BOOST_FOREACH(const OpenTsdbWriter::Ptr& opentsdbwriter, ConfigType::GetObjectsByType<OpenTsdbWriter>()) {
-		nodes->Set(opentsdbwriter->GetName(), 1); //add more stats
+		MetricQueue::Ptr queue = opentsdbwriter->m_Queue;
+
+		if (!queue)
+			continue;
+
+		nodes->Set(opentsdbwriter->GetName(), queue->GetStats("opentsdbwriter_" + opentsdbwriter->GetName() + "_", perfdata));
 	}
 
 	status->Set("opentsdbwriter", nodes);
@@ -62,6 +67,9 @@ void OpenTsdbWriter::Start(void)
 {
 	ObjectImpl<OpenTsdbWriter>::Start();
 
+	m_Queue = new MetricQueue("OpenTsdbWriter", GetSpoolDir() + "/" + GetName() + ".spool");
+	m_Queue->Start(std::max(GetBufferSize(), 0), std::max(GetFlushThreshold(), 0), GetFlushInterval(), std::max(GetSpoolSize(), 0));
+
 	m_ReconnectTimer = new Timer();
 	m_ReconnectTimer->SetInterval(10);
 	m_ReconnectTimer->OnTimerExpired.connect(boost::bind(&OpenTsdbWriter::ReconnectTimerHandler, this));
@@ -71,9 +79,17 @@ void OpenTsdbWriter::Start(void)
 	Service::OnNewCheckResult.connect(boost::bind(&OpenTsdbWriter::CheckResultHandler, this, _1, _2));
 }
 
+void OpenTsdbWriter::Stop(void)
+{
+	m_ReconnectTimer->Stop();
+	m_Queue->Stop();
+
+	ObjectImpl<OpenTsdbWriter>::Stop();
+}
+
 void OpenTsdbWriter::ReconnectTimerHandler(void)
 {
-	if (m_Stream)
+	if (m_Queue->IsConnected())
 		return;
 
 	TcpSocket::Ptr socket = new TcpSocket();
@@ -89,7 +105,7 @@ void OpenTsdbWriter::ReconnectTimerHandler(void)
 		return;
 	}
 
-	m_Stream = new NetworkStream(socket);
+	m_Queue->SetStream(new NetworkStream(socket));
 }
 
 void OpenTsdbWriter::CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
@@ -151,27 +167,10 @@ void OpenTsdbWriter::CheckResultHandler(const Checkable::Ptr& checkable, const C
 
 void OpenTsdbWriter::SendPerfdata(const String& metric, const std::map<String, String>& tags, const CheckResult::Ptr& cr, double ts)
 {
-	Array::Ptr perfdata = cr->GetPerformanceData();
-
-	if (!perfdata)
-		return;
+	Array::Ptr perfdata = cr->GetPerfdataValues();
 
 	ObjectLock olock(perfdata);
-	BOOST_FOREACH(const Value& val, perfdata) {
-		PerfdataValue::Ptr pdv;
-
-		if (val.IsObjectType<PerfdataValue>())
-			pdv = val;
-		else {
-			try {
-				pdv = PerfdataValue::Parse(val);
-			} catch (const std::exception&) {
-				Log(LogWarning, "OpenTsdbWriter")
-					<< "Ignoring invalid perfdata value: " << val;
-				continue;
-			}
-		}
-
+	BOOST_FOREACH(const PerfdataValue::Ptr& pdv, perfdata) {
 		String escaped_key = EscapeMetric(pdv->GetLabel());
 		boost::algorithm::replace_all(escaped_key, "::", ".");
 
@@ -208,21 +207,8 @@ void OpenTsdbWriter::SendMetric(const String& metric, const std::map<String, Str
 
 	/* do not send \n to debug log */
 	msgbuf << "\n";
-	String put = msgbuf.str();
-
-	ObjectLock olock(this);
-
-	if (!m_Stream)
-		return;
 
-	try {
-		m_Stream->Write(put.CStr(), put.GetLength());
-	} catch (const std::exception& ex) {
-		Log(LogCritical, "OpenTsdbWriter")
-			<< "Cannot write to OpenTSDB TSD on host '" << GetHost() << "' port '" << GetPort() + "'.";
-
-		m_Stream.reset();
-	}
+	m_Queue->Enqueue(msgbuf.str());
 }
 
 /* for metric and tag name rules, see
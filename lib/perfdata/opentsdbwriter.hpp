@@ -21,6 +21,7 @@
 #define OPENTSDBWRITER_H
 
 #include "perfdata/opentsdbwriter.thpp"
+#include "perfdata/metricqueue.hpp"
 #include "icinga/service.hpp"
 #include "base/configobject.hpp"
 #include "base/tcpsocket.hpp"
@@ -45,9 +46,10 @@ public:
 
 protected:
 	virtual void Start(void) override;
+	virtual void Stop(void) override;
 
 private:
-	Stream::Ptr m_Stream;
+	MetricQueue::Ptr m_Queue;
 
 	Timer::Ptr m_ReconnectTimer;
 
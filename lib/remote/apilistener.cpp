@@ -20,6 +20,7 @@
 #include "remote/apilistener.hpp"
 #include "remote/apilistener.tcpp"
 #include "remote/jsonrpcconnection.hpp"
+#include "remote/eventqueue.hpp"
 #include "remote/endpoint.hpp"
 #include "remote/jsonrpc.hpp"
 #include "remote/apifunction.hpp"
@@ -34,6 +35,7 @@
 #include "base/context.hpp"
 #include "base/statsfunction.hpp"
 #include "base/exception.hpp"
+#include <boost/assign/list_of.hpp>
 #include <fstream>
 
 using namespace icinga;
@@ -47,7 +49,7 @@ REGISTER_STATSFUNCTION(ApiListener, &ApiListener::StatsFunc);
 REGISTER_APIFUNCTION(Hello, icinga, &ApiListener::HelloAPIHandler);
 
 ApiListener::ApiListener(void)
-	: m_LogMessageCount(0)
+	: m_LogMessageCount(0), m_ReplayedMessages(15 * 60), m_ReplayedBytes(15 * 60)
 { }
 
 void ApiListener::OnConfigLoaded(void)
@@ -434,6 +436,7 @@ void ApiListener::ApiTimerHandler(void)
 			Log(LogNotice, "ApiListener")
 			    << "Removing old log file: " << path;
 			(void)unlink(path.CStr());
+			(void)unlink((path + ".idx").CStr());
 		}
 	}
 
@@ -535,24 +538,19 @@ void ApiListener::RelayMessage(const MessageOrigin::Ptr& origin,
 	m_RelayQueue.Enqueue(boost::bind(&ApiListener::SyncRelayMessage, this, origin, secobj, message, log), true);
 }
 
-void ApiListener::PersistMessage(const Dictionary::Ptr& message, const ConfigObject::Ptr& secobj)
+void ApiListener::PersistMessage(const String& json, double ts, const ConfigObject::Ptr& secobj)
 {
-	double ts = message->Get("ts");
-
 	ASSERT(ts != 0);
 
-	Dictionary::Ptr pmessage = new Dictionary();
-	pmessage->Set("timestamp", ts);
-
-	pmessage->Set("message", JsonEncode(message));
-	Dictionary::Ptr secname = new Dictionary();
-	secname->Set("type", secobj->GetType()->GetName());
-	secname->Set("name", secobj->GetName());
-	pmessage->Set("secobj", secname);
+	ApiLogRecord record;
+	record.Timestamp = ts;
+	record.SecobjType = secobj->GetType()->GetName();
+	record.SecobjName = secobj->GetName();
+	record.Message = json;
 
 	boost::mutex::scoped_lock lock(m_LogLock);
 	if (m_LogFile) {
-		NetString::WriteStringToStream(m_LogFile, JsonEncode(pmessage));
+		m_LogFile->Write(record);
 		m_LogMessageCount++;
 		SetLogMessageTimestamp(ts);
 
@@ -565,6 +563,11 @@ void ApiListener::PersistMessage(const Dictionary::Ptr& message, const ConfigObj
 }
 
 void ApiListener::SyncSendMessage(const Endpoint::Ptr& endpoint, const Dictionary::Ptr& message)
+{
+	SyncSendRawMessage(endpoint, JsonRpc::EncodeMessage(message));
+}
+
+void ApiListener::SyncSendRawMessage(const Endpoint::Ptr& endpoint, const String& encodedMessage)
 {
 	ObjectLock olock(endpoint);
 
@@ -573,7 +576,7 @@ void ApiListener::SyncSendMessage(const Endpoint::Ptr& endpoint, const Dictionar
 		    << "Sending message to '" << endpoint->GetName() << "'";
 
 		BOOST_FOREACH(const JsonRpcConnection::Ptr& client, endpoint->GetClients())
-			client->SendMessage(message);
+			client->SendRawMessage(encodedMessage);
 	}
 }
 
@@ -590,6 +593,10 @@ void ApiListener::SyncRelayMessage(const MessageOrigin::Ptr& origin,
 	if (origin && origin->FromZone)
 		message->Set("originZone", origin->FromZone->GetName());
 
+	/* the message is encoded once and the same buffer is sent to all endpoints */
+	String json = JsonEncode(message);
+	String encodedMessage = NetString::Encode(json);
+
 	bool is_master = IsMaster();
 	Endpoint::Ptr master = GetMaster();
 	Zone::Ptr my_zone = Zone::GetLocalZone();
@@ -657,11 +664,11 @@ void ApiListener::SyncRelayMessage(const MessageOrigin::Ptr& origin,
 
 		finishedZones.insert(target_zone);
 
-		SyncSendMessage(endpoint, message);
+		SyncSendRawMessage(endpoint, encodedMessage);
 	}
 
 	if (log && allZones.size() != finishedLogZones.size())
-		PersistMessage(message, secobj);
+		PersistMessage(json, ts, secobj);
 
 	BOOST_FOREACH(const Endpoint::Ptr& endpoint, skippedEndpoints)
 		endpoint->SetLocalLogPosition(ts);
@@ -677,15 +684,15 @@ void ApiListener::OpenLogFile(void)
 {
 	String path = GetApiDir() + "log/current";
 
-	std::fstream *fp = new std::fstream(path.CStr(), std::fstream::out | std::ofstream::app);
+	ApiLogWriter::Ptr logFile = new ApiLogWriter(path);
 
-	if (!fp->good()) {
+	if (!logFile->IsOpen()) {
 		Log(LogWarning, "ApiListener")
 		    << "Could not open spool file: " << path;
 		return;
 	}
 
-	m_LogFile = new StdioStream(fp, true);
+	m_LogFile = logFile;
 	m_LogMessageCount = 0;
 	SetLogMessageTimestamp(Utility::GetTime());
 }
@@ -711,6 +718,7 @@ void ApiListener::RotateLogFile(void)
 	String oldpath = GetApiDir() + "log/current";
 	String newpath = GetApiDir() + "log/" + Convert::ToString(static_cast<int>(ts)+1);
 	(void) rename(oldpath.CStr(), newpath.CStr());
+	(void) rename((oldpath + ".idx").CStr(), (newpath + ".idx").CStr());
 }
 
 void ApiListener::LogGlobHandler(std::vector<int>& files, const String& file)
@@ -756,7 +764,9 @@ void ApiListener::ReplayLog(const JsonRpcConnection::Ptr& client)
 		CloseLogFile();
 		RotateLogFile();
 
-		if (count == -1 || count > 50000) {
+		/* Only the final pass holds the log lock, all other passes read
+		 * rotated files while new messages are written to a new file. */
+		if (count == -1 || count > 1000) {
 			OpenLogFile();
 			lock.unlock();
 		} else {
@@ -778,44 +788,25 @@ void ApiListener::ReplayLog(const JsonRpcConnection::Ptr& client)
 			Log(LogNotice, "ApiListener")
 			    << "Replaying log: " << path;
 
-			std::fstream *fp = new std::fstream(path.CStr(), std::fstream::in | std::fstream::binary);
-			StdioStream::Ptr logStream = new StdioStream(fp, true);
-
-			String message;
-			StreamReadContext src;
-			while (true) {
-				Dictionary::Ptr pmessage;
-
-				try {
-					StreamReadStatus srs = NetString::ReadStringFromStream(logStream, &message, src);
+			ApiLogReader::Ptr reader = new ApiLogReader(path);
 
-					if (srs == StatusEof)
-						break;
-
-					if (srs != StatusNewItem)
-						continue;
-
-					pmessage = JsonDecode(message);
-				} catch (const std::exception&) {
-					Log(LogWarning, "ApiListener")
-					    << "Unexpected end-of-file for cluster log: " << path;
-
-					/* Log files may be incomplete or corrupted. This is perfectly OK. */
-					break;
-				}
+			if (!reader->IsOpen())
+				continue;
 
-				if (pmessage->Get("timestamp") <= peer_ts)
-					continue;
+			/* skip the part of the file which the peer already has */
+			reader->Seek(peer_ts);
 
-				Dictionary::Ptr secname = pmessage->Get("secobj");
+			int file_count = 0;
+			ApiLogRecord record;
 
-				if (secname) {
-					ConfigType::Ptr dtype = ConfigType::GetByName(secname->Get("type"));
+			while (reader->ReadRecord(&record, peer_ts)) {
+				if (!record.SecobjType.IsEmpty()) {
+					ConfigType::Ptr dtype = ConfigType::GetByName(record.SecobjType);
 
 					if (!dtype)
 						continue;
 
-					ConfigObject::Ptr secobj = dtype->GetObject(secname->Get("name"));
+					ConfigObject::Ptr secobj = dtype->GetObject(record.SecobjName);
 
 					if (!secobj)
 						continue;
@@ -824,10 +815,11 @@ void ApiListener::ReplayLog(const JsonRpcConnection::Ptr& client)
 						continue;
 				}
 
-				NetString::WriteStringToStream(client->GetStream(), pmessage->Get("message"));
+				NetString::WriteStringToStream(client->GetStream(), record.Message);
 				count++;
+				file_count++;
 
-				peer_ts = pmessage->Get("timestamp");
+				peer_ts = record.Timestamp;
 
 				if (ts > logpos_ts + 10) {
 					logpos_ts = ts;
@@ -844,7 +836,11 @@ void ApiListener::ReplayLog(const JsonRpcConnection::Ptr& client)
 				}
 			}
 
-			logStream->Close();
+			double now = Utility::GetTime();
+
+			boost::mutex::scoped_lock slock(m_ReplayStatsMutex);
+			m_ReplayedMessages.InsertValue(now, file_count);
+			m_ReplayedBytes.InsertValue(now, reader->GetBytesRead());
 		}
 
 		if (count > 0) {
@@ -886,6 +882,22 @@ void ApiListener::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& per
 	status->Set("api", stats.first);
 }
 
+void ApiListener::ValidateEventsMaxPending(int value, const ValidationUtils& utils)
+{
+	ObjectImpl<ApiListener>::ValidateEventsMaxPending(value, utils);
+
+	if (value <= 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, boost::assign::list_of("events_max_pending"), "Value must be greater than 0."));
+}
+
+void ApiListener::ValidateEventsOverflowPolicy(const String& value, const ValidationUtils& utils)
+{
+	ObjectImpl<ApiListener>::ValidateEventsOverflowPolicy(value, utils);
+
+	if (value != "drop" && value != "disconnect")
+		BOOST_THROW_EXCEPTION(ValidationError(this, boost::assign::list_of("events_overflow_policy"), "Value must be 'drop' or 'disconnect'."));
+}
+
 std::pair<Dictionary::Ptr, Dictionary::Ptr> ApiListener::GetStatus(void)
 {
 	Dictionary::Ptr status = new Dictionary();
@@ -965,9 +977,33 @@ std::pair<Dictionary::Ptr, Dictionary::Ptr> ApiListener::GetStatus(void)
 
 	status->Set("zones", connectedZones);
 
+	int replayedMessages, replayedBytes;
+
+	{
+		boost::mutex::scoped_lock lock(m_ReplayStatsMutex);
+		replayedMessages = m_ReplayedMessages.GetValues(60);
+		replayedBytes = m_ReplayedBytes.GetValues(60);
+	}
+
+	status->Set("log_replay_messages_rate", replayedMessages / 60.0);
+	status->Set("log_replay_bytes_rate", replayedBytes / 60.0);
+
+	size_t eventClients, eventsPending;
+	unsigned long eventsDropped;
+	EventQueue::GetStats(eventClients, eventsPending, eventsDropped);
+
+	status->Set("num_event_clients", eventClients);
+	status->Set("events_pending", eventsPending);
+	status->Set("events_dropped", eventsDropped);
+
 	perfdata->Set("num_endpoints", allEndpoints);
 	perfdata->Set("num_conn_endpoints", Convert::ToDouble(allConnectedEndpoints->GetLength()));
 	perfdata->Set("num_not_conn_endpoints", Convert::ToDouble(allNotConnectedEndpoints->GetLength()));
+	perfdata->Set("log_replay_messages_rate", replayedMessages / 60.0);
+	perfdata->Set("log_replay_bytes_rate", replayedBytes / 60.0);
+	perfdata->Set("num_event_clients", eventClients);
+	perfdata->Set("events_pending", eventsPending);
+	perfdata->Set("events_dropped", eventsDropped);
 
 	return std::make_pair(status, perfdata);
 }
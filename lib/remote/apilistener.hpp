@@ -25,11 +25,13 @@
 #include "remote/httpserverconnection.hpp"
 #include "remote/endpoint.hpp"
 #include "remote/messageorigin.hpp"
+#include "remote/apilog.hpp"
 #include "base/configobject.hpp"
 #include "base/timer.hpp"
 #include "base/workqueue.hpp"
 #include "base/tcpsocket.hpp"
 #include "base/tlsstream.hpp"
+#include "base/ringbuffer.hpp"
 #include <set>
 
 namespace icinga
@@ -62,6 +64,7 @@ public:
 	static String GetApiDir(void);
 
 	void SyncSendMessage(const Endpoint::Ptr& endpoint, const Dictionary::Ptr& message);
+	void SyncSendRawMessage(const Endpoint::Ptr& endpoint, const String& encodedMessage);
 	void RelayMessage(const MessageOrigin::Ptr& origin, const ConfigObject::Ptr& secobj, const Dictionary::Ptr& message, bool log);
 
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
@@ -91,6 +94,9 @@ protected:
 	virtual void OnAllConfigLoaded(void) override;
 	virtual void Start(void) override;
 
+	virtual void ValidateEventsMaxPending(int value, const ValidationUtils& utils) override;
+	virtual void ValidateEventsOverflowPolicy(const String& value, const ValidationUtils& utils) override;
+
 private:
 	boost::shared_ptr<SSL_CTX> m_SSLContext;
 	std::set<TcpSocket::Ptr> m_Servers;
@@ -110,11 +116,15 @@ private:
 	WorkQueue m_RelayQueue;
 
 	boost::mutex m_LogLock;
-	Stream::Ptr m_LogFile;
+	ApiLogWriter::Ptr m_LogFile;
 	size_t m_LogMessageCount;
 
+	mutable boost::mutex m_ReplayStatsMutex;
+	RingBuffer m_ReplayedMessages;
+	RingBuffer m_ReplayedBytes;
+
 	void SyncRelayMessage(const MessageOrigin::Ptr& origin, const ConfigObject::Ptr& secobj, const Dictionary::Ptr& message, bool log);
-	void PersistMessage(const Dictionary::Ptr& message, const ConfigObject::Ptr& secobj);
+	void PersistMessage(const String& json, double ts, const ConfigObject::Ptr& secobj);
 
 	void OpenLogFile(void);
 	void RotateLogFile(void);
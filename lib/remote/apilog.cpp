@@ -0,0 +1,435 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+
+#include "remote/apilog.hpp"
+#include "base/netstring.hpp"
+#include "base/json.hpp"
+#include "base/logger.hpp"
+#include <algorithm>
+#include <vector>
+#include <cstring>
+
+using namespace icinga;
+
+static const char l_ApiLogMagic[] = "ICINGA2LOG1\n";
+static const size_t l_ApiLogMagicLength = sizeof(l_ApiLogMagic) - 1;
+static const size_t l_ApiLogHeaderLength = 12;
+static const size_t l_ApiLogIndexEntryLength = 16;
+
+/* Payloads which are larger than this are checked against the file size
+ * before allocating a buffer for them. */
+static const boost::uint32_t l_ApiLogMaxUncheckedLength = 64 * 1024;
+
+const size_t ApiLogWriter::IndexInterval = 64 * 1024;
+
+static void EncodeUInt32(char *buf, boost::uint32_t value)
+{
+	for (int i = 3; i >= 0; i--) {
+		buf[i] = value & 0xff;
+		value >>= 8;
+	}
+}
+
+static boost::uint32_t DecodeUInt32(const char *buf)
+{
+	boost::uint32_t value = 0;
+
+	for (int i = 0; i < 4; i++)
+		value = (value << 8) | static_cast<unsigned char>(buf[i]);
+
+	return value;
+}
+
+static void EncodeUInt64(char *buf, boost::uint64_t value)
+{
+	for (int i = 7; i >= 0; i--) {
+		buf[i] = value & 0xff;
+		value >>= 8;
+	}
+}
+
+static boost::uint64_t DecodeUInt64(const char *buf)
+{
+	boost::uint64_t value = 0;
+
+	for (int i = 0; i < 8; i++)
+		value = (value << 8) | static_cast<unsigned char>(buf[i]);
+
+	return value;
+}
+
+/* Timestamps are stored bit-for-bit so that they compare equal to the "ts"
+ * attribute of the message. */
+static void EncodeDouble(char *buf, double value)
+{
+	boost::uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	EncodeUInt64(buf, bits);
+}
+
+static double DecodeDouble(const char *buf)
+{
+	boost::uint64_t bits = DecodeUInt64(buf);
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+ApiLogWriter::ApiLogWriter(const String& path)
+	: m_File(path.CStr(), std::ofstream::out | std::ofstream::app | std::ofstream::binary),
+	  m_Index((path + ".idx").CStr(), std::ofstream::out | std::ofstream::app | std::ofstream::binary),
+	  m_Offset(0), m_NextIndexOffset(0)
+{
+	if (!m_File.good())
+		return;
+
+	m_File.seekp(0, std::ofstream::end);
+	m_Offset = m_File.tellp();
+
+	if (m_Offset == 0) {
+		m_File.write(l_ApiLogMagic, l_ApiLogMagicLength);
+		m_Offset = l_ApiLogMagicLength;
+	}
+
+	m_NextIndexOffset = m_Offset;
+}
+
+bool ApiLogWriter::IsOpen(void) const
+{
+	return m_File.is_open() && m_File.good();
+}
+
+/**
+ * Appends a record to the log file.
+ *
+ * @param record The record.
+ */
+void ApiLogWriter::Write(const ApiLogRecord& record)
+{
+	std::string payload;
+	payload.reserve(record.SecobjType.GetLength() + record.SecobjName.GetLength() + record.Message.GetLength() + 2);
+	payload.append(record.SecobjType.GetData());
+	payload.push_back('\0');
+	payload.append(record.SecobjName.GetData());
+	payload.push_back('\0');
+	payload.append(record.Message.GetData());
+
+	if (m_Offset >= m_NextIndexOffset && m_Index.good()) {
+		char entry[l_ApiLogIndexEntryLength];
+		EncodeDouble(entry, record.Timestamp);
+		EncodeUInt64(entry + 8, m_Offset);
+		m_Index.write(entry, sizeof(entry));
+
+		m_NextIndexOffset = m_Offset + IndexInterval;
+	}
+
+	char header[l_ApiLogHeaderLength];
+	EncodeUInt32(header, payload.size());
+	EncodeDouble(header + 4, record.Timestamp);
+
+	m_File.write(header, sizeof(header));
+	m_File.write(payload.c_str(), payload.size());
+
+	m_Offset += sizeof(header) + payload.size();
+}
+
+void ApiLogWriter::Close(void)
+{
+	m_File.close();
+	m_Index.close();
+}
+
+ApiLogReader::ApiLogReader(const String& path)
+	: m_Path(path), m_File(path.CStr(), std::ifstream::in | std::ifstream::binary),
+	  m_Legacy(false), m_BytesRead(0)
+{
+	if (!m_File.good())
+		return;
+
+	char magic[l_ApiLogMagicLength];
+
+	if (m_File.read(magic, sizeof(magic)) && memcmp(magic, l_ApiLogMagic, sizeof(magic)) == 0)
+		return;
+
+	/* log files written by older versions consist of JSON-encoded netstrings */
+	m_File.close();
+	m_Legacy = true;
+
+	std::fstream *fp = new std::fstream(path.CStr(), std::fstream::in | std::fstream::binary);
+	m_LegacyStream = new StdioStream(fp, true);
+}
+
+bool ApiLogReader::IsOpen(void) const
+{
+	return m_Legacy || m_File.is_open();
+}
+
+/**
+ * Uses the index to skip to the last indexed record which is not newer than
+ * the specified timestamp.
+ *
+ * @param ts The timestamp.
+ */
+void ApiLogReader::Seek(double ts)
+{
+	if (m_Legacy)
+		return;
+
+	std::ifstream index((m_Path + ".idx").CStr(), std::ifstream::in | std::ifstream::binary);
+	char entry[l_ApiLogIndexEntryLength];
+	boost::uint64_t offset = 0;
+
+	while (index.read(entry, sizeof(entry))) {
+		if (DecodeDouble(entry) > ts)
+			break;
+
+		offset = DecodeUInt64(entry + 8);
+	}
+
+	if (offset != 0)
+		m_File.seekg(offset);
+}
+
+/**
+ * Returns the number of bytes between the current position and the end of the file.
+ */
+static boost::uint64_t GetRemainingLength(std::ifstream& fp)
+{
+	std::streamoff pos = fp.tellg();
+	fp.seekg(0, std::ifstream::end);
+	std::streamoff size = fp.tellg();
+	fp.seekg(pos);
+
+	if (pos < 0 || size < pos)
+		return 0;
+
+	return size - pos;
+}
+
+/**
+ * Reads the next record.
+ *
+ * @param record Receives the record.
+ * @param after Records with a timestamp which is not newer than this are skipped
+ *              without reading their payload.
+ * @returns true if a record was read, false if the end of the file was reached.
+ */
+bool ApiLogReader::ReadRecord(ApiLogRecord *record, double after)
+{
+	if (m_Legacy)
+		return ReadLegacyRecord(record, after);
+
+	for (;;) {
+		char header[l_ApiLogHeaderLength];
+
+		if (!m_File.read(header, sizeof(header)))
+			return false;
+
+		boost::uint32_t length = DecodeUInt32(header);
+		double ts = DecodeDouble(header + 4);
+
+		if (ts <= after) {
+			m_File.seekg(length, std::ifstream::cur);
+			continue;
+		}
+
+		/* The length of a torn record may be garbage. */
+		if (length > l_ApiLogMaxUncheckedLength && length > GetRemainingLength(m_File)) {
+			Log(LogWarning, "ApiLogReader")
+			    << "Unexpected end-of-file for cluster log: " << m_Path;
+
+			return false;
+		}
+
+		std::vector<char> payload(length);
+
+		if (length > 0 && !m_File.read(&payload[0], length)) {
+			Log(LogWarning, "ApiLogReader")
+			    << "Unexpected end-of-file for cluster log: " << m_Path;
+
+			/* Log files may be incomplete or corrupted. This is perfectly OK. */
+			return false;
+		}
+
+		const char *begin = payload.empty() ? NULL : &payload[0];
+		const char *end = begin + length;
+		const char *type_end = std::find(begin, end, '\0');
+		const char *name_end = (type_end != end) ? std::find(type_end + 1, end, '\0') : end;
+
+		if (name_end == end) {
+			Log(LogWarning, "ApiLogReader")
+			    << "Invalid record in cluster log: " << m_Path;
+
+			return false;
+		}
+
+		record->Timestamp = ts;
+		record->SecobjType = String(begin, type_end);
+		record->SecobjName = String(type_end + 1, name_end);
+		record->Message = String(name_end + 1, end);
+
+		m_BytesRead += sizeof(header) + length;
+
+		return true;
+	}
+}
+
+/**
+ * Extracts the attributes of a legacy cluster log entry which are needed for
+ * replaying it without building a dictionary for the entry.
+ */
+class LegacyRecordHandler : public JsonSaxHandler
+{
+public:
+	double Timestamp;
+	String SecobjType;
+	String SecobjName;
+	String Message;
+
+	LegacyRecordHandler(void)
+		: Timestamp(0), m_Depth(0), m_Key(KeyOther), m_InSecobj(false)
+	{ }
+
+	virtual void HandleKey(const char *str, size_t len)
+	{
+		if (m_Depth == 1) {
+			if (KeyEquals(str, len, "timestamp"))
+				m_Key = KeyTimestamp;
+			else if (KeyEquals(str, len, "message"))
+				m_Key = KeyMessage;
+			else if (KeyEquals(str, len, "secobj"))
+				m_Key = KeySecobj;
+			else
+				m_Key = KeyOther;
+		} else if (m_Depth == 2 && m_InSecobj) {
+			if (KeyEquals(str, len, "type"))
+				m_Key = KeyType;
+			else if (KeyEquals(str, len, "name"))
+				m_Key = KeyName;
+			else
+				m_Key = KeyOther;
+		}
+	}
+
+	virtual void HandleNumber(double value)
+	{
+		if (m_Depth == 1 && m_Key == KeyTimestamp)
+			Timestamp = value;
+	}
+
+	virtual void HandleString(const char *str, size_t len)
+	{
+		if (m_Depth == 1 && m_Key == KeyMessage)
+			Message = String(str, str + len);
+		else if (m_Depth == 2 && m_InSecobj && m_Key == KeyType)
+			SecobjType = String(str, str + len);
+		else if (m_Depth == 2 && m_InSecobj && m_Key == KeyName)
+			SecobjName = String(str, str + len);
+	}
+
+	virtual void HandleStartMap(void)
+	{
+		m_Depth++;
+
+		if (m_Depth == 2 && m_Key == KeySecobj)
+			m_InSecobj = true;
+	}
+
+	virtual void HandleEndMap(void)
+	{
+		if (m_Depth == 2)
+			m_InSecobj = false;
+
+		m_Depth--;
+	}
+
+	virtual void HandleStartArray(void)
+	{
+		m_Depth++;
+	}
+
+	virtual void HandleEndArray(void)
+	{
+		m_Depth--;
+	}
+
+private:
+	enum LegacyRecordKey
+	{
+		KeyOther,
+		KeyTimestamp,
+		KeyMessage,
+		KeySecobj,
+		KeyType,
+		KeyName
+	};
+
+	int m_Depth;
+	LegacyRecordKey m_Key;
+	bool m_InSecobj;
+
+	static bool KeyEquals(const char *str, size_t len, const char *key)
+	{
+		return strlen(key) == len && memcmp(str, key, len) == 0;
+	}
+};
+
+bool ApiLogReader::ReadLegacyRecord(ApiLogRecord *record, double after)
+{
+	for (;;) {
+		String message;
+		LegacyRecordHandler handler;
+
+		try {
+			StreamReadStatus srs = NetString::ReadStringFromStream(m_LegacyStream, &message, m_LegacyContext);
+
+			if (srs == StatusEof)
+				return false;
+
+			if (srs != StatusNewItem)
+				continue;
+
+			JsonParse(message, handler);
+		} catch (const std::exception&) {
+			Log(LogWarning, "ApiLogReader")
+			    << "Unexpected end-of-file for cluster log: " << m_Path;
+
+			/* Log files may be incomplete or corrupted. This is perfectly OK. */
+			return false;
+		}
+
+		if (handler.Timestamp <= after)
+			continue;
+
+		record->Timestamp = handler.Timestamp;
+		record->SecobjType = handler.SecobjType;
+		record->SecobjName = handler.SecobjName;
+		record->Message = handler.Message;
+
+		m_BytesRead += message.GetLength();
+
+		return true;
+	}
+}
+
+boost::uint64_t ApiLogReader::GetBytesRead(void) const
+{
+	return m_BytesRead;
+}
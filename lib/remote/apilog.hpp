@@ -0,0 +1,116 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+
+#ifndef APILOG_H
+#define APILOG_H
+
+#include "remote/i2-remote.hpp"
+#include "base/stdiostream.hpp"
+#include <boost/cstdint.hpp>
+#include <fstream>
+
+namespace icinga
+{
+
+/**
+ * A message in the cluster replay log.
+ *
+ * @ingroup remote
+ */
+struct ApiLogRecord
+{
+	double Timestamp;
+	String SecobjType;
+	String SecobjName;
+	String Message;
+
+	ApiLogRecord(void)
+		: Timestamp(0)
+	{ }
+};
+
+/**
+ * Appends messages to a cluster replay log file.
+ *
+ * The file starts with a magic string. Each record consists of a header with
+ * the length of the payload and the message timestamp, followed by the
+ * payload (the type and name of the security object and the JSON-encoded
+ * message). Every IndexInterval bytes the timestamp and the offset of a
+ * record are appended to a sparse index ("<path>.idx") so that readers can
+ * skip records they are not interested in.
+ *
+ * @ingroup remote
+ */
+class I2_REMOTE_API ApiLogWriter : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(ApiLogWriter);
+
+	static const size_t IndexInterval;
+
+	ApiLogWriter(const String& path);
+
+	bool IsOpen(void) const;
+
+	void Write(const ApiLogRecord& record);
+	void Close(void);
+
+private:
+	std::ofstream m_File;
+	std::ofstream m_Index;
+	boost::uint64_t m_Offset;
+	boost::uint64_t m_NextIndexOffset;
+};
+
+/**
+ * Reads the messages from a cluster replay log file. Files which were
+ * written in the old netstring format are supported as well, however they
+ * do not have an index.
+ *
+ * @ingroup remote
+ */
+class I2_REMOTE_API ApiLogReader : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(ApiLogReader);
+
+	ApiLogReader(const String& path);
+
+	bool IsOpen(void) const;
+
+	void Seek(double ts);
+	bool ReadRecord(ApiLogRecord *record, double after = 0);
+
+	boost::uint64_t GetBytesRead(void) const;
+
+private:
+	String m_Path;
+	std::ifstream m_File;
+	bool m_Legacy;
+	StdioStream::Ptr m_LegacyStream;
+	StreamReadContext m_LegacyContext;
+	boost::uint64_t m_BytesRead;
+
+	bool ReadLegacyRecord(ApiLogRecord *record, double after);
+};
+
+}
+
+#endif /* APILOG_H */
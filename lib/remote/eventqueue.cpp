@@ -19,12 +19,142 @@
 
 #include "remote/eventqueue.hpp"
 #include "remote/filterutility.hpp"
+#include "remote/httpchunkedencoding.hpp"
 #include "base/singleton.hpp"
+#include "base/json.hpp"
+#include "base/logger.hpp"
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/algorithm/string/replace.hpp>
 
 using namespace icinga;
 
-EventQueue::EventQueue(void)
-    : m_Filter(NULL)
+/* events are only written to the stream while its send queue is shorter than this */
+#define EVENTQUEUE_MAX_SENDQ (64 * 1024)
+
+static boost::mutex l_DroppedEventsMutex;
+static unsigned long l_DroppedEvents = 0;
+
+EventQueueClient::EventQueueClient(const String& queueName, const TlsStream::Ptr& stream, size_t maxPending, EventQueueOverflowPolicy policy)
+	: m_QueueName(queueName), m_Stream(stream), m_MaxPending(maxPending), m_Policy(policy), m_Disconnected(false)
+{ }
+
+void EventQueueClient::Start(void)
+{
+	/* the handler keeps the client alive until Disconnect() removes it */
+	m_WritableConnection = m_Stream->RegisterWritableHandler(boost::bind(&EventQueueClient::Flush, EventQueueClient::Ptr(this)));
+
+	/* the peer might have closed the connection before the handler was registered */
+	if (m_Stream->IsEof())
+		Disconnect();
+}
+
+/**
+ * Closes the client's stream and removes the client from its queue.
+ */
+void EventQueueClient::Disconnect(void)
+{
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		m_Disconnected = true;
+		m_Pending.clear();
+	}
+
+	m_WritableConnection.disconnect();
+	m_Stream->Close();
+
+	EventQueue::Ptr queue = EventQueue::GetByName(m_QueueName);
+
+	if (queue) {
+		queue->RemoveClient(this);
+		EventQueue::UnregisterIfUnused(m_QueueName, queue);
+	}
+}
+
+/**
+ * Queues an encoded event for the client. The event is shared with the
+ * other clients and must not be modified.
+ */
+void EventQueueClient::SendEvent(const boost::shared_ptr<String>& event)
+{
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		if (m_Disconnected)
+			return;
+
+		if (m_Pending.size() >= m_MaxPending) {
+			if (m_Policy == EventQueueDrop) {
+				boost::mutex::scoped_lock dlock(l_DroppedEventsMutex);
+				l_DroppedEvents++;
+				return;
+			}
+
+			Log(LogWarning, "EventQueue", "Event queue for API client is full. Disconnecting client.");
+		} else {
+			m_Pending.push_back(event);
+			lock.unlock();
+
+			Flush();
+			return;
+		}
+	}
+
+	Disconnect();
+}
+
+/**
+ * Writes pending events to the stream until its send queue is full.
+ * Disconnects the client once the stream has been closed.
+ */
+void EventQueueClient::Flush(void)
+{
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		if (m_Disconnected)
+			return;
+
+		if (!m_Stream->IsEof()) {
+			if (m_Pending.empty())
+				return;
+
+			size_t sendq = m_Stream->GetSendQueueSize();
+
+			if (sendq >= EVENTQUEUE_MAX_SENDQ)
+				return;
+
+			/* send all events which fit into a single chunk */
+			String chunk;
+
+			while (!m_Pending.empty() && sendq + chunk.GetLength() < EVENTQUEUE_MAX_SENDQ) {
+				chunk += *m_Pending.front();
+				m_Pending.pop_front();
+			}
+
+			try {
+				HttpChunkedEncoding::WriteChunkToStream(m_Stream, chunk.CStr(), chunk.GetLength());
+				return;
+			} catch (const std::exception&) {
+				/* the stream was closed */
+			}
+		}
+	}
+
+	Disconnect();
+}
+
+size_t EventQueueClient::GetPending(void) const
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	return m_Pending.size();
+}
+
+
+EventQueue::EventQueue(const String& name)
+    : m_Name(name), m_Filter(NULL)
 { }
 
 EventQueue::~EventQueue(void)
@@ -39,45 +169,59 @@ bool EventQueue::CanProcessEvent(const String& type) const
 	return m_Types.find(type) != m_Types.end();
 }
 
+/**
+ * Filters the event and sends it to all clients. The event is encoded
+ * once for all clients.
+ */
 void EventQueue::ProcessEvent(const Dictionary::Ptr& event)
 {
-	ScriptFrame frame;
-	frame.Sandboxed = true;
+	std::set<EventQueueClient::Ptr> clients;
 
-	if (!FilterUtility::EvaluateFilter(frame, m_Filter, event, "event"))
-		return;
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
 
-	boost::mutex::scoped_lock lock(m_Mutex);
+		ScriptFrame frame;
+		frame.Sandboxed = true;
 
-	typedef std::pair<void *const, std::deque<Dictionary::Ptr> > kv_pair;
-	BOOST_FOREACH(kv_pair& kv, m_Events) {
-		kv.second.push_back(event);
+		if (!FilterUtility::EvaluateFilter(frame, m_Filter, event, "event"))
+			return;
+
+		clients = m_Clients;
 	}
 
-	m_CV.notify_all();
+	if (clients.empty())
+		return;
+
+	boost::shared_ptr<String> body = boost::make_shared<String>(JsonEncode(event));
+	boost::algorithm::replace_all(*body, "\n", "");
+	*body += "\n";
+
+	/* clients whose stream was closed remove themselves from the queue */
+	BOOST_FOREACH(const EventQueueClient::Ptr& client, clients) {
+		client->SendEvent(body);
+	}
 }
 
-void EventQueue::AddClient(void *client)
+void EventQueue::AddClient(const EventQueueClient::Ptr& client)
 {
 	boost::mutex::scoped_lock lock(m_Mutex);
 
-	typedef std::map<void *, std::deque<Dictionary::Ptr> >::iterator it_type;
-	std::pair<it_type, bool> result = m_Events.insert(std::make_pair(client, std::deque<Dictionary::Ptr>()));
+	std::pair<std::set<EventQueueClient::Ptr>::iterator, bool> result = m_Clients.insert(client);
 	ASSERT(result.second);
 }
 
-void EventQueue::RemoveClient(void *client)
+void EventQueue::RemoveClient(const EventQueueClient::Ptr& client)
 {
 	boost::mutex::scoped_lock lock(m_Mutex);
 
-	m_Events.erase(client);
+	m_Clients.erase(client);
 }
 
 void EventQueue::UnregisterIfUnused(const String& name, const EventQueue::Ptr& queue)
 {
 	boost::mutex::scoped_lock lock(queue->m_Mutex);
 
-	if (queue->m_Events.empty())
+	if (queue->m_Clients.empty())
 		Unregister(name);
 }
 
@@ -94,25 +238,30 @@ void EventQueue::SetFilter(Expression *filter)
 	m_Filter = filter;
 }
 
-Dictionary::Ptr EventQueue::WaitForEvent(void *client, double timeout)
+void EventQueue::GetStats(size_t& clients, size_t& pending, unsigned long& dropped)
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
+	clients = 0;
+	pending = 0;
 
-	for (;;) {
-		std::map<void *, std::deque<Dictionary::Ptr> >::iterator it = m_Events.find(client);
-		ASSERT(it != m_Events.end());
+	typedef std::pair<String, EventQueue::Ptr> kv_pair;
+	BOOST_FOREACH(const kv_pair& kv, EventQueueRegistry::GetInstance()->GetItems()) {
+		std::set<EventQueueClient::Ptr> queueClients;
 
-		if (!it->second.empty()) {
-			Dictionary::Ptr result = *it->second.begin();
-			it->second.pop_front();
-			return result;
+		{
+			boost::mutex::scoped_lock lock(kv.second->m_Mutex);
+			queueClients = kv.second->m_Clients;
 		}
 
-		if (!m_CV.timed_wait(lock, boost::posix_time::milliseconds(timeout * 1000)))
-			return Dictionary::Ptr();
+		clients += queueClients.size();
+
+		BOOST_FOREACH(const EventQueueClient::Ptr& client, queueClients) {
+			pending += client->GetPending();
+		}
 	}
-}
 
+	boost::mutex::scoped_lock lock(l_DroppedEventsMutex);
+	dropped = l_DroppedEvents;
+}
 
 std::vector<EventQueue::Ptr> EventQueue::GetQueuesForType(const String& type)
 {
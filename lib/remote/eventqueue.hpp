@@ -22,51 +22,96 @@
 
 #include "remote/httphandler.hpp"
 #include "base/object.hpp"
+#include "base/tlsstream.hpp"
 #include "config/expression.hpp"
-#include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
-#include <boost/thread/condition_variable.hpp>
+#include <boost/smart_ptr/shared_ptr.hpp>
 #include <set>
-#include <map>
 #include <deque>
 
 namespace icinga
 {
 
+/**
+ * What to do when a client's event queue is full.
+ *
+ * @ingroup remote
+ */
+enum EventQueueOverflowPolicy
+{
+	EventQueueDrop, /**< Discard new events until the client catches up. */
+	EventQueueDisconnect /**< Disconnect the client. */
+};
+
+/**
+ * A subscriber of an event queue. Events are written to the client's
+ * stream while the stream's send queue is short and kept in a bounded
+ * queue otherwise; they are sent once the stream becomes writable. The
+ * client removes itself from the queue when the stream is closed.
+ *
+ * @ingroup remote
+ */
+class I2_REMOTE_API EventQueueClient : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(EventQueueClient);
+
+	EventQueueClient(const String& queueName, const TlsStream::Ptr& stream, size_t maxPending, EventQueueOverflowPolicy policy);
+
+	void Start(void);
+	void Disconnect(void);
+
+	void SendEvent(const boost::shared_ptr<String>& event);
+
+	size_t GetPending(void) const;
+
+private:
+	mutable boost::mutex m_Mutex;
+	String m_QueueName;
+	TlsStream::Ptr m_Stream;
+	boost::signals2::connection m_WritableConnection;
+	size_t m_MaxPending;
+	EventQueueOverflowPolicy m_Policy;
+	bool m_Disconnected;
+
+	std::deque<boost::shared_ptr<String> > m_Pending;
+
+	void Flush(void);
+};
+
 class I2_REMOTE_API EventQueue : public Object
 {
 public:
 	DECLARE_PTR_TYPEDEFS(EventQueue);
 
-	EventQueue(void);
+	EventQueue(const String& name);
 	~EventQueue(void);
 
 	bool CanProcessEvent(const String& type) const;
 	void ProcessEvent(const Dictionary::Ptr& event);
-	void AddClient(void *client);
-	void RemoveClient(void *client);
+	void AddClient(const EventQueueClient::Ptr& client);
+	void RemoveClient(const EventQueueClient::Ptr& client);
 
 	void SetTypes(const std::set<String>& types);
 	void SetFilter(Expression *filter);
 
-	Dictionary::Ptr WaitForEvent(void *client, double timeout = 5);
-
 	static std::vector<EventQueue::Ptr> GetQueuesForType(const String& type);
 	static void UnregisterIfUnused(const String& name, const EventQueue::Ptr& queue);
 
+	static void GetStats(size_t& clients, size_t& pending, unsigned long& dropped);
+
 	static EventQueue::Ptr GetByName(const String& name);
 	static void Register(const String& name, const EventQueue::Ptr& function);
 	static void Unregister(const String& name);
 
 private:
 	mutable boost::mutex m_Mutex;
-	boost::condition_variable m_CV;
 
+	String m_Name;
 	std::set<String> m_Types;
 	Expression *m_Filter;
-	double m_Ttl;
 
-	std::map<void *, std::deque<Dictionary::Ptr> > m_Events;
+	std::set<EventQueueClient::Ptr> m_Clients;
 };
 
 /**
@@ -20,12 +20,11 @@
 #include "remote/eventshandler.hpp"
 #include "remote/httputility.hpp"
 #include "remote/filterutility.hpp"
+#include "remote/apilistener.hpp"
 #include "config/configcompiler.hpp"
 #include "config/expression.hpp"
 #include "base/objectlock.hpp"
-#include "base/json.hpp"
 #include <boost/foreach.hpp>
-#include <boost/algorithm/string/replace.hpp>
 
 using namespace icinga;
 
@@ -78,42 +77,37 @@ bool EventsHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& request
 	EventQueue::Ptr queue = EventQueue::GetByName(queueName);
 
 	if (!queue) {
-		queue = new EventQueue();
+		queue = new EventQueue(queueName);
 		EventQueue::Register(queueName, queue);
 	}
 
 	queue->SetTypes(types->ToSet<String>());
 	queue->SetFilter(ufilter);
 
-	queue->AddClient(&request);
-
 	response.SetStatus(200, "OK");
 	response.AddHeader("Content-Type", "application/json");
 
-	for (;;) {
-		Dictionary::Ptr result = queue->WaitForEvent(&request);
+	ApiListener::Ptr listener = ApiListener::GetInstance();
 
-		if (!response.IsPeerConnected()) {
-			queue->RemoveClient(&request);
-			EventQueue::UnregisterIfUnused(queueName, queue);
-			return true;
-		}
+	size_t maxPending = 10000;
+	EventQueueOverflowPolicy policy = EventQueueDrop;
 
-		if (!result)
-			continue;
+	if (listener) {
+		maxPending = listener->GetEventsMaxPending();
 
-		String body = JsonEncode(result);
+		if (listener->GetEventsOverflowPolicy() == "disconnect")
+			policy = EventQueueDisconnect;
+	}
 
-		boost::algorithm::replace_all(body, "\n", "");
+	/* The connection is handed over to the queue: events are written
+	 * whenever the stream becomes writable, so this thread is released
+	 * as soon as the headers have been sent. */
+	TlsStream::Ptr stream = static_pointer_cast<TlsStream>(response.Detach());
 
-		try {
-			response.WriteBody(body.CStr(), body.GetLength());
-			response.WriteBody("\n", 1);
-		} catch (const std::exception&) {
-			queue->RemoveClient(&request);
-			EventQueue::UnregisterIfUnused(queueName, queue);
-			throw;
-		}
-	}
-}
+	EventQueueClient::Ptr client = new EventQueueClient(queueName, stream, maxPending, policy);
+	queue->AddClient(client);
 
+	client->Start();
+
+	return true;
+}
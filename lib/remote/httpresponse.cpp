@@ -99,6 +99,9 @@ void HttpResponse::Finish(void)
 {
 	ASSERT(m_State != HttpResponseEnd);
 
+	if (m_State == HttpResponseDetached)
+		return;
+
 	if (m_Request.ProtocolVersion == HttpVersion10) {
 		if (m_Body)
 			AddHeader("Content-Length", Convert::ToString(m_Body->GetAvailableBytes()));
@@ -241,6 +244,29 @@ size_t HttpResponse::ReadBody(char *data, size_t count)
 		return m_Body->Read(data, count, true);
 }
 
+/**
+ * Sends the response headers and hands the stream over to the caller,
+ * which writes the chunked response body once data becomes available.
+ * The request handler may return before the response is complete.
+ *
+ * @returns The stream.
+ */
+Stream::Ptr HttpResponse::Detach(void)
+{
+	ASSERT(m_Request.ProtocolVersion == HttpVersion11);
+
+	FinishHeaders();
+
+	m_State = HttpResponseDetached;
+
+	return m_Stream;
+}
+
+bool HttpResponse::IsDetached(void) const
+{
+	return m_State == HttpResponseDetached;
+}
+
 bool HttpResponse::IsPeerConnected(void) const
 {
 	return !m_Stream->IsEof();
@@ -32,7 +32,8 @@ enum HttpResponseState
 	HttpResponseStart,
 	HttpResponseHeaders,
 	HttpResponseBody,
-	HttpResponseEnd
+	HttpResponseEnd,
+	HttpResponseDetached
 };
 
 /**
@@ -61,6 +62,9 @@ public:
 	void WriteBody(const char *data, size_t count);
 	void Finish(void);
 
+	Stream::Ptr Detach(void);
+	bool IsDetached(void) const;
+
 	bool IsPeerConnected(void) const;
 
 private:
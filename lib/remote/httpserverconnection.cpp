@@ -174,7 +174,9 @@ void HttpServerConnection::ProcessMessageAsync(HttpRequest& request)
 
 	response.Finish();
 
-	m_PendingRequests--;
+	/* detached responses remain pending until the peer disconnects */
+	if (!response.IsDetached())
+		m_PendingRequests--;
 }
 
 void HttpServerConnection::DataAvailableHandler(void)
@@ -194,6 +196,11 @@ void HttpServerConnection::DataAvailableHandler(void)
 
 void HttpServerConnection::CheckLiveness(void)
 {
+	if (m_Stream->IsEof()) {
+		Disconnect();
+		return;
+	}
+
 	if (m_Seen < Utility::GetTime() - 10 && m_PendingRequests == 0) {
 		Log(LogInformation, "HttpServerConnection")
 		    <<  "No messages for Http connection have been received in the last 10 seconds.";
@@ -30,8 +30,29 @@ using namespace icinga;
  */
 void JsonRpc::SendMessage(const Stream::Ptr& stream, const Dictionary::Ptr& message)
 {
-	String json = JsonEncode(message);
-	NetString::WriteStringToStream(stream, json);
+	SendRawMessage(stream, EncodeMessage(message));
+}
+
+/**
+ * Encodes a message so that it can be sent to multiple peers
+ * with SendRawMessage().
+ *
+ * @param message The message.
+ * @returns The message in the netstring format.
+ */
+String JsonRpc::EncodeMessage(const Dictionary::Ptr& message)
+{
+	return NetString::Encode(JsonEncode(message));
+}
+
+/**
+ * Sends a message which was previously encoded with EncodeMessage().
+ *
+ * @param encodedMessage The encoded message.
+ */
+void JsonRpc::SendRawMessage(const Stream::Ptr& stream, const String& encodedMessage)
+{
+	stream->Write(encodedMessage.CStr(), encodedMessage.GetLength());
 }
 
 StreamReadStatus JsonRpc::ReadMessage(const Stream::Ptr& stream, Dictionary::Ptr *message, StreamReadContext& src, bool may_wait)
@@ -36,6 +36,8 @@ class I2_REMOTE_API JsonRpc
 {
 public:
 	static void SendMessage(const Stream::Ptr& stream, const Dictionary::Ptr& message);
+	static String EncodeMessage(const Dictionary::Ptr& message);
+	static void SendRawMessage(const Stream::Ptr& stream, const String& encodedMessage);
 	static StreamReadStatus ReadMessage(const Stream::Ptr& stream, Dictionary::Ptr *message, StreamReadContext& src, bool may_wait = false);
 
 private:
@@ -91,12 +91,17 @@ ConnectionRole JsonRpcConnection::GetRole(void) const
 }
 
 void JsonRpcConnection::SendMessage(const Dictionary::Ptr& message)
+{
+	SendRawMessage(JsonRpc::EncodeMessage(message));
+}
+
+void JsonRpcConnection::SendRawMessage(const String& encodedMessage)
 {
 	try {
 		ObjectLock olock(m_Stream);
 		if (m_Stream->IsEof())
 			return;
-		JsonRpc::SendMessage(m_Stream, message);
+		JsonRpc::SendRawMessage(m_Stream, encodedMessage);
 	} catch (const std::exception& ex) {
 		std::ostringstream info;
 		info << "Error while sending JSON-RPC message for identity '" << m_Identity << "'";
@@ -66,6 +66,7 @@ public:
 	void Disconnect(void);
 
 	void SendMessage(const Dictionary::Ptr& request);
+	void SendRawMessage(const String& encodedMessage);
 
 	static void HeartbeatTimerHandler(void);
 	static Value HeartbeatAPIHandler(const intrusive_ptr<MessageOrigin>& origin, const Dictionary::Ptr& params);
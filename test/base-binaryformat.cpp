@@ -0,0 +1,81 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+
+#include "base/binaryformat.hpp"
+#include "base/dictionary.hpp"
+#include "base/array.hpp"
+#include "base/objectlock.hpp"
+#include <boost/test/unit_test.hpp>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_binaryformat)
+
+BOOST_AUTO_TEST_CASE(roundtrip)
+{
+	Array::Ptr array = new Array();
+	array->Add(7);
+	array->Add(-3);
+	array->Add(2.5);
+	array->Add(1e15);
+	array->Add(Empty);
+	array->Add(String(std::string("a\0b", 3)));
+
+	Dictionary::Ptr dict = new Dictionary();
+	dict->Set("bool", true);
+	dict->Set("string", "hello world");
+	dict->Set("empty", String());
+	dict->Set("array", array);
+
+	Dictionary::Ptr nested = new Dictionary();
+	nested->Set("value", -1.75);
+	dict->Set("nested", nested);
+
+	Dictionary::Ptr result = BinaryDecode(BinaryEncode(dict));
+
+	BOOST_CHECK(result->GetLength() == 5);
+	BOOST_CHECK(result->Get("bool") == true);
+	BOOST_CHECK(result->Get("string") == "hello world");
+	BOOST_CHECK(result->Get("empty") == "");
+
+	Array::Ptr resultArray = result->Get("array");
+	BOOST_CHECK(resultArray->GetLength() == 6);
+	BOOST_CHECK(resultArray->Get(0) == 7);
+	BOOST_CHECK(resultArray->Get(1) == -3);
+	BOOST_CHECK(resultArray->Get(2) == 2.5);
+	BOOST_CHECK(resultArray->Get(3) == 1e15);
+	BOOST_CHECK(resultArray->Get(4).IsEmpty());
+	BOOST_CHECK(resultArray->Get(5) == String(std::string("a\0b", 3)));
+
+	Dictionary::Ptr resultNested = result->Get("nested");
+	BOOST_CHECK(resultNested->Get("value") == -1.75);
+}
+
+BOOST_AUTO_TEST_CASE(invalid)
+{
+	String data = BinaryEncode("hello world");
+
+	BOOST_CHECK_THROW(BinaryDecode(""), std::exception);
+	BOOST_CHECK_THROW(BinaryDecode(data.SubStr(0, data.GetLength() - 1)), std::exception);
+	BOOST_CHECK_THROW(BinaryDecode(data + "x"), std::exception);
+	BOOST_CHECK_THROW(BinaryDecode("\x42"), std::exception);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
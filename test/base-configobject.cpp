@@ -0,0 +1,182 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/configobject.hpp"
+#include "base/utility.hpp"
+#include "base/convert.hpp"
+#include "icinga/host.hpp"
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+#include <fstream>
+#include <unistd.h>
+
+using namespace icinga;
+
+struct StateFileFixture
+{
+	StateFileFixture(void)
+	{
+		for (int i = 0; i < 2; i++) {
+			Host::Ptr host = new Host();
+			host->SetTypeNameV("Host");
+			host->SetName("state-host-" + Convert::ToString(i));
+			host->SetCheckAttempt(1);
+			host->Register();
+			Hosts.push_back(host);
+		}
+	}
+
+	~StateFileFixture(void)
+	{
+		BOOST_FOREACH(const Host::Ptr& host, Hosts) {
+			host->Unregister();
+		}
+
+		BOOST_FOREACH(const String& file, Files) {
+			(void) unlink(file.CStr());
+		}
+	}
+
+	String GetStateFile(const String& name)
+	{
+		String file = Convert::ToString(Utility::GetPid()) + "-" + name + ".state";
+		Files.push_back(file);
+		Files.push_back(file + ".tmp");
+		return file;
+	}
+
+	void Restore(const String& file)
+	{
+		BOOST_FOREACH(const Host::Ptr& host, Hosts) {
+			host->SetCheckAttempt(0);
+		}
+
+		ConfigObject::RestoreObjects(file);
+	}
+
+	std::vector<Host::Ptr> Hosts;
+	std::vector<String> Files;
+};
+
+static std::streamoff GetFileSize(const String& file)
+{
+	std::ifstream fp(file.CStr(), std::ios_base::in | std::ios_base::binary);
+	fp.seekg(0, std::ios_base::end);
+	return fp.tellg();
+}
+
+BOOST_FIXTURE_TEST_SUITE(base_configobject, StateFileFixture)
+
+BOOST_AUTO_TEST_CASE(state_delta)
+{
+	String file = GetStateFile("delta");
+
+	ConfigObject::DumpObjects(file);
+	std::streamoff size = GetFileSize(file);
+	BOOST_CHECK(size > 0);
+
+	/* unchanged objects are not written again */
+	ConfigObject::DumpObjects(file);
+	BOOST_CHECK(GetFileSize(file) == size);
+
+	Hosts[0]->SetCheckAttempt(2);
+	ConfigObject::DumpObjects(file);
+
+	std::streamoff deltaSize = GetFileSize(file);
+	BOOST_CHECK(deltaSize > size);
+
+	Hosts[0]->SetCheckAttempt(3);
+	ConfigObject::DumpObjects(file);
+	BOOST_CHECK(GetFileSize(file) - deltaSize == deltaSize - size);
+
+	Restore(file);
+
+	BOOST_CHECK(Hosts[0]->GetCheckAttempt() == 3);
+	BOOST_CHECK(Hosts[1]->GetCheckAttempt() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(state_compaction)
+{
+	String file = GetStateFile("compaction");
+
+	ConfigObject::DumpObjects(file);
+	std::streamoff size = GetFileSize(file);
+
+	/* the file is rewritten once it has twice as many records as there are objects */
+	for (int i = 2; i <= 4; i++) {
+		Hosts[0]->SetCheckAttempt(i);
+		ConfigObject::DumpObjects(file);
+		BOOST_CHECK(GetFileSize(file) > size);
+	}
+
+	Hosts[0]->SetCheckAttempt(5);
+	ConfigObject::DumpObjects(file);
+	BOOST_CHECK(GetFileSize(file) == size);
+	BOOST_CHECK(!Utility::PathExists(file + ".tmp"));
+
+	Restore(file);
+
+	BOOST_CHECK(Hosts[0]->GetCheckAttempt() == 5);
+	BOOST_CHECK(Hosts[1]->GetCheckAttempt() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(state_torn)
+{
+	String file = GetStateFile("torn");
+
+	ConfigObject::DumpObjects(file);
+	std::streamoff size = GetFileSize(file);
+
+	Hosts[0]->SetCheckAttempt(2);
+	ConfigObject::DumpObjects(file);
+
+	/* cut the last record in half */
+	std::streamoff tornSize = (size + GetFileSize(file)) / 2;
+	BOOST_REQUIRE(truncate(file.CStr(), tornSize) == 0);
+
+	Restore(file);
+
+	BOOST_CHECK(Hosts[0]->GetCheckAttempt() == 1);
+	BOOST_CHECK(Hosts[1]->GetCheckAttempt() == 1);
+
+	/* the next dump does not append to the torn record */
+	Hosts[0]->SetCheckAttempt(3);
+	ConfigObject::DumpObjects(file);
+	BOOST_CHECK(GetFileSize(file) == size);
+
+	Restore(file);
+
+	BOOST_CHECK(Hosts[0]->GetCheckAttempt() == 3);
+	BOOST_CHECK(Hosts[1]->GetCheckAttempt() == 1);
+
+	/* a length field pointing past the end of the file */
+	{
+		std::ofstream fp(file.CStr(), std::ios_base::out | std::ios_base::binary | std::ios_base::app);
+		fp.write("\x7f\xff\xff\xff", 4);
+	}
+
+	Restore(file);
+
+	BOOST_CHECK(Hosts[0]->GetCheckAttempt() == 3);
+
+	ConfigObject::DumpObjects(file);
+	BOOST_CHECK(GetFileSize(file) == size);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -20,9 +20,14 @@
 #include "base/dictionary.hpp"
 #include "base/objectlock.hpp"
 #include "base/json.hpp"
+#include "base/utility.hpp"
+#include "base/convert.hpp"
 #include <boost/test/unit_test.hpp>
 #include <boost/foreach.hpp>
 #include <boost/tuple/tuple.hpp>
+#ifdef __GLIBC__
+#	include <malloc.h>
+#endif /* __GLIBC__ */
 
 using namespace icinga;
 
@@ -180,4 +185,206 @@ BOOST_AUTO_TEST_CASE(json)
 	BOOST_CHECK(deserialized->Get("test2") == "hello world");
 }
 
+BOOST_AUTO_TEST_CASE(order)
+{
+	Dictionary::Ptr dictionary = new Dictionary();
+
+	dictionary->Set("c", 3);
+	dictionary->Set("a", 1);
+	dictionary->Set("d", 4);
+	dictionary->Set("b", 2);
+	dictionary->Set("a", 5);
+
+	BOOST_CHECK(dictionary->GetLength() == 4);
+
+	std::vector<String> keys = dictionary->GetKeys();
+	BOOST_CHECK(keys.size() == 4);
+	BOOST_CHECK(keys[0] == "a");
+	BOOST_CHECK(keys[1] == "b");
+	BOOST_CHECK(keys[2] == "c");
+	BOOST_CHECK(keys[3] == "d");
+
+	BOOST_CHECK(dictionary->Get("a") == 5);
+	BOOST_CHECK(!dictionary->Contains("e"));
+
+	dictionary->Remove("b");
+	BOOST_CHECK(!dictionary->Contains("b"));
+	BOOST_CHECK(dictionary->Get("c") == 3);
+
+	Dictionary::Ptr clone = static_pointer_cast<Dictionary>(dictionary->Clone());
+	keys = clone->GetKeys();
+	BOOST_CHECK(keys.size() == 3);
+	BOOST_CHECK(keys[0] == "a");
+	BOOST_CHECK(keys[1] == "c");
+	BOOST_CHECK(keys[2] == "d");
+	BOOST_CHECK(clone->Get("a") == 5);
+}
+
+BOOST_AUTO_TEST_CASE(large)
+{
+	Dictionary::Ptr dictionary = new Dictionary();
+
+	/* insert the keys out of order so that the dictionary uses a tree */
+	for (int i = 0; i < 1000; i++)
+		dictionary->Set(Convert::ToString((i * 7) % 1000 + 1000), i);
+
+	BOOST_CHECK(dictionary->GetLength() == 1000);
+	BOOST_CHECK(dictionary->Get("1007") == 1);
+
+	dictionary->Set("1007", "hello world");
+	BOOST_CHECK(dictionary->Get("1007") == "hello world");
+	BOOST_CHECK(dictionary->GetLength() == 1000);
+
+	dictionary->Remove("1000");
+	BOOST_CHECK(!dictionary->Contains("1000"));
+	BOOST_CHECK(dictionary->GetLength() == 999);
+
+	std::vector<String> keys = dictionary->GetKeys();
+	BOOST_CHECK(keys.size() == 999);
+	BOOST_CHECK(keys[0] == "1001");
+	BOOST_CHECK(keys[998] == "1999");
+
+	{
+		ObjectLock olock(dictionary);
+
+		String last;
+		int count = 0;
+
+		BOOST_FOREACH(const Dictionary::Pair& kv, dictionary) {
+			BOOST_CHECK(last < kv.first);
+			last = kv.first;
+			count++;
+		}
+
+		BOOST_CHECK(count == 999);
+
+		dictionary->Remove(dictionary->Begin());
+	}
+
+	BOOST_CHECK(!dictionary->Contains("1001"));
+
+	Dictionary::Ptr clone = dictionary->ShallowClone();
+	clone->Set("0", 0);
+	BOOST_CHECK(clone->GetLength() == 999);
+	BOOST_CHECK(dictionary->GetLength() == 998);
+	BOOST_CHECK(clone->GetKeys()[0] == "0");
+
+	clone = static_pointer_cast<Dictionary>(dictionary->Clone());
+	BOOST_CHECK(clone->GetKeys() == dictionary->GetKeys());
+	BOOST_CHECK(clone->Get("1007") == "hello world");
+
+	dictionary->Clear();
+	BOOST_CHECK(dictionary->GetLength() == 0);
+
+	dictionary->Set("b", 2);
+	dictionary->Set("a", 1);
+	keys = dictionary->GetKeys();
+	BOOST_CHECK(keys.size() == 2);
+	BOOST_CHECK(keys[0] == "a");
+}
+
+static const char * const l_BenchmarkKeys[] = {
+	"state", "state_type", "last_state", "last_state_type", "host_name",
+	"display_name", "check_command", "max_check_attempts", "check_interval",
+	"retry_interval", "enable_notifications", "vars", "address", "os",
+	"notes", "groups"
+};
+
+static const int l_BenchmarkKeyCount = sizeof(l_BenchmarkKeys) / sizeof(l_BenchmarkKeys[0]);
+
+static size_t GetAllocatedBytes(void)
+{
+#ifdef __GLIBC__
+	return mallinfo().uordblks;
+#else /* __GLIBC__ */
+	return 0;
+#endif /* __GLIBC__ */
+}
+
+/* fills and queries dictionaries resembling the attributes of host objects */
+BOOST_AUTO_TEST_CASE(benchmark)
+{
+	const int objects = 20000;
+
+	std::vector<String> keys;
+
+	/* Insert keys in a scrambled order, like attributes set by the config compiler. */
+	for (int i = 0; i < l_BenchmarkKeyCount; i++)
+		keys.push_back(l_BenchmarkKeys[(i * 7) % l_BenchmarkKeyCount]);
+
+	size_t mem = GetAllocatedBytes();
+	double start = Utility::GetTime();
+
+	std::vector<Dictionary::Ptr> dicts;
+	dicts.reserve(objects);
+
+	for (int i = 0; i < objects; i++) {
+		Dictionary::Ptr dict = new Dictionary();
+
+		BOOST_FOREACH(const String& key, keys) {
+			dict->Set(key, i);
+		}
+
+		dicts.push_back(dict);
+	}
+
+	double duration = Utility::GetTime() - start;
+	BOOST_TEST_MESSAGE("Set: " << objects / duration << " objects/s, "
+	    << (GetAllocatedBytes() - mem) / objects << " bytes/object");
+
+	start = Utility::GetTime();
+
+	double sum = 0;
+
+	BOOST_FOREACH(const Dictionary::Ptr& dict, dicts) {
+		BOOST_FOREACH(const String& key, keys) {
+			sum += dict->Get(key);
+		}
+	}
+
+	duration = Utility::GetTime() - start;
+	BOOST_TEST_MESSAGE("Get: " << objects / duration << " objects/s");
+
+	BOOST_CHECK(sum == static_cast<double>(objects - 1) * objects / 2 * keys.size());
+
+	start = Utility::GetTime();
+
+	BOOST_FOREACH(const Dictionary::Ptr& dict, dicts) {
+		(void) JsonDecode(JsonEncode(dict));
+	}
+
+	duration = Utility::GetTime() - start;
+	BOOST_TEST_MESSAGE("JSON round-trip: " << objects / duration << " objects/s");
+}
+
+/* fills a single dictionary with thousands of keys which aren't added in order */
+BOOST_AUTO_TEST_CASE(benchmark_large)
+{
+	const int count = 20000;
+
+	double start = Utility::GetTime();
+
+	Dictionary::Ptr dict = new Dictionary();
+
+	for (int i = 0; i < count; i++)
+		dict->Set("key" + Convert::ToString((i * 7919) % count), i);
+
+	double duration = Utility::GetTime() - start;
+	BOOST_TEST_MESSAGE("Set (out of order): " << count / duration << " keys/s");
+
+	BOOST_CHECK(dict->GetLength() == count);
+
+	start = Utility::GetTime();
+
+	double sum = 0;
+
+	for (int i = 0; i < count; i++)
+		sum += dict->Get("key" + Convert::ToString((i * 7919) % count));
+
+	duration = Utility::GetTime() - start;
+	BOOST_TEST_MESSAGE("Get: " << count / duration << " keys/s");
+
+	BOOST_CHECK(sum == static_cast<double>(count - 1) * count / 2);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -21,6 +21,9 @@
 #include "base/dictionary.hpp"
 #include "base/objectlock.hpp"
 #include "base/json.hpp"
+#include "base/serializer.hpp"
+#include "base/utility.hpp"
+#include "base/convert.hpp"
 #include <boost/test/unit_test.hpp>
 #include <boost/foreach.hpp>
 #include <boost/tuple/tuple.hpp>
@@ -36,4 +39,191 @@ BOOST_AUTO_TEST_CASE(invalid1)
 	BOOST_CHECK_THROW(JsonDecode("{\"test\": \"test\""), std::exception);
 }
 
+BOOST_AUTO_TEST_CASE(decode)
+{
+	Dictionary::Ptr dict = JsonDecode("{ \"a\": [ 1, 2.5, true, null ], \"b\": { \"c\": \"test\" }, \"d\": [] }");
+
+	BOOST_CHECK(dict->GetLength() == 3);
+
+	Array::Ptr arr = dict->Get("a");
+	BOOST_CHECK(arr->GetLength() == 4);
+	BOOST_CHECK(arr->Get(0) == 1);
+	BOOST_CHECK(arr->Get(1) == 2.5);
+	BOOST_CHECK(arr->Get(2) == true);
+	BOOST_CHECK(arr->Get(3).IsEmpty());
+
+	Dictionary::Ptr sub = dict->Get("b");
+	BOOST_CHECK(sub->Get("c") == "test");
+
+	Array::Ptr empty = dict->Get("d");
+	BOOST_CHECK(empty->GetLength() == 0);
+
+	BOOST_CHECK(JsonDecode("\"test\"") == "test");
+	BOOST_CHECK(JsonEncode(JsonDecode(JsonEncode(dict))) == JsonEncode(dict));
+}
+
+class CountingSaxHandler : public JsonSaxHandler
+{
+public:
+	int Maps;
+	int Arrays;
+	int Keys;
+	int Scalars;
+	int Depth;
+
+	CountingSaxHandler(void)
+		: Maps(0), Arrays(0), Keys(0), Scalars(0), Depth(0)
+	{ }
+
+	virtual void HandleNumber(double)
+	{
+		Scalars++;
+	}
+
+	virtual void HandleString(const char *, size_t)
+	{
+		Scalars++;
+	}
+
+	virtual void HandleKey(const char *str, size_t len)
+	{
+		if (String(str, str + len) == "abort")
+			BOOST_THROW_EXCEPTION(std::runtime_error("Aborted."));
+
+		Keys++;
+	}
+
+	virtual void HandleStartMap(void)
+	{
+		Maps++;
+		Depth++;
+	}
+
+	virtual void HandleEndMap(void)
+	{
+		Depth--;
+	}
+
+	virtual void HandleStartArray(void)
+	{
+		Arrays++;
+		Depth++;
+	}
+
+	virtual void HandleEndArray(void)
+	{
+		Depth--;
+	}
+};
+
+BOOST_AUTO_TEST_CASE(sax)
+{
+	CountingSaxHandler handler;
+	JsonParse("{ \"a\": [ 1, \"x\", true ], \"b\": { \"c\": null } }", handler);
+
+	BOOST_CHECK(handler.Maps == 2);
+	BOOST_CHECK(handler.Arrays == 1);
+	BOOST_CHECK(handler.Keys == 3);
+	BOOST_CHECK(handler.Scalars == 2);
+	BOOST_CHECK(handler.Depth == 0);
+
+	CountingSaxHandler aborted;
+	BOOST_CHECK_THROW(JsonParse("{ \"abort\": 1 }", aborted), std::runtime_error);
+	BOOST_CHECK_THROW(JsonParse("[ 1, ", aborted), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(serialize)
+{
+	PerfdataValue::Ptr pdv = new PerfdataValue("time", 5, true, "s", 10, 20, 0, 100);
+
+	Dictionary::Ptr dict = new Dictionary();
+	dict->Set("value", pdv);
+	dict->Set("values", new Array());
+	dict->Set("name", "test");
+
+	Array::Ptr arr = dict->Get("values");
+	arr->Add(pdv);
+
+	/* Reflected objects are encoded as null unless their attributes are serialized. */
+	Dictionary::Ptr result = JsonDecode(JsonEncode(dict));
+	BOOST_CHECK(result->Get("value").IsEmpty());
+
+	String expected = JsonEncode(Serialize(dict, FAState));
+	result = JsonDecode(JsonSerialize(dict, FAState));
+	BOOST_CHECK(JsonEncode(result) == expected);
+
+	Dictionary::Ptr spdv = result->Get("value");
+	BOOST_CHECK(spdv->Get("type") == "PerfdataValue");
+	BOOST_CHECK(spdv->Get("label") == "time");
+	BOOST_CHECK(spdv->Get("value") == 5);
+	BOOST_CHECK(spdv->Get("unit") == "s");
+
+	BOOST_CHECK(JsonEncode(JsonDecode(JsonSerialize(pdv, FAState, true))) == JsonEncode(JsonDecode(JsonSerialize(pdv, FAState))));
+}
+
+/* compares the streaming encoder and the SAX parser with building intermediate trees */
+BOOST_AUTO_TEST_CASE(benchmark)
+{
+	Array::Ptr pd = new Array();
+
+	for (int i = 0; i < 10; i++) {
+		pd->Add(new PerfdataValue("value" + Convert::ToString(i), i, false, "B", 100, 200, 0, 1000));
+	}
+
+	Dictionary::Ptr cr = new Dictionary();
+	cr->Set("output", "OK - everything is fine");
+	cr->Set("performance_data", pd);
+	cr->Set("execution_start", Utility::GetTime());
+	cr->Set("execution_end", Utility::GetTime());
+	cr->Set("exit_status", 0);
+
+	Dictionary::Ptr params = new Dictionary();
+	params->Set("host", "localhost");
+	params->Set("service", "ping4");
+	params->Set("cr", cr);
+
+	Dictionary::Ptr message = new Dictionary();
+	message->Set("jsonrpc", "2.0");
+	message->Set("method", "event::CheckResult");
+	message->Set("params", params);
+
+	const int rounds = 20000;
+
+	double start = Utility::GetTime();
+
+	for (int i = 0; i < rounds; i++)
+		(void) JsonEncode(Serialize(message, FAState));
+
+	double duration = Utility::GetTime() - start;
+	BOOST_TEST_MESSAGE("JsonEncode(Serialize()): " << rounds / duration << " messages/s");
+
+	start = Utility::GetTime();
+
+	for (int i = 0; i < rounds; i++)
+		(void) JsonSerialize(message, FAState);
+
+	duration = Utility::GetTime() - start;
+	BOOST_TEST_MESSAGE("JsonSerialize(): " << rounds / duration << " messages/s");
+
+	String json = JsonSerialize(message, FAState);
+
+	start = Utility::GetTime();
+
+	for (int i = 0; i < rounds; i++)
+		(void) JsonDecode(json);
+
+	duration = Utility::GetTime() - start;
+	BOOST_TEST_MESSAGE("JsonDecode(): " << rounds / duration << " messages/s");
+
+	start = Utility::GetTime();
+
+	for (int i = 0; i < rounds; i++) {
+		JsonSaxHandler handler;
+		JsonParse(json, handler);
+	}
+
+	duration = Utility::GetTime() - start;
+	BOOST_TEST_MESSAGE("JsonParse(): " << rounds / duration << " messages/s");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,148 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+
+#include "base/logger.hpp"
+#include "base/dictionary.hpp"
+#include "base/array.hpp"
+#include "base/convert.hpp"
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <sstream>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_logger)
+
+static unsigned long GetDroppedLogEntries(void)
+{
+	Dictionary::Ptr status = new Dictionary();
+	Array::Ptr perfdata = new Array();
+	Logger::GetAsyncLogStats(status, perfdata);
+	return status->Get("dropped");
+}
+
+static size_t CountLines(const String& output, const String& text)
+{
+	size_t count = 0;
+
+	for (size_t pos = output.Find(text); pos != String::NPos; pos = output.Find(text, pos + 1))
+		count++;
+
+	return count;
+}
+
+/* Writes log messages with the log entries going to the console, which is
+ * redirected to a string stream. */
+static String LogToConsole(int count)
+{
+	std::ostringstream buf;
+
+	bool console = Logger::IsConsoleLogEnabled();
+	LogSeverity severity = Logger::GetConsoleLogSeverity();
+
+	Logger::EnableConsoleLog();
+	Logger::SetConsoleLogSeverity(LogInformation);
+
+	std::streambuf *old = std::cout.rdbuf(buf.rdbuf());
+
+	for (int i = 0; i < count; i++)
+		Log(LogInformation, "test") << "message " << i << ".";
+
+	/* writes all pending log entries */
+	Logger::DisableAsyncLog();
+
+	std::cout.rdbuf(old);
+
+	Logger::SetConsoleLogSeverity(severity);
+
+	if (!console)
+		Logger::DisableConsoleLog();
+
+	return buf.str();
+}
+
+BOOST_AUTO_TEST_CASE(async)
+{
+	Logger::EnableAsyncLog(16, LogOverflowBlock);
+	BOOST_CHECK(Logger::IsAsyncLogEnabled());
+
+	String output = LogToConsole(100);
+
+	BOOST_CHECK(!Logger::IsAsyncLogEnabled());
+
+	for (int i = 0; i < 100; i++)
+		BOOST_CHECK(output.Find("message " + Convert::ToString(i) + ".") != String::NPos);
+
+	BOOST_CHECK(output.Find("message 0.") < output.Find("message 99."));
+}
+
+BOOST_AUTO_TEST_CASE(overflow)
+{
+	unsigned long dropped = GetDroppedLogEntries();
+
+	Logger::EnableAsyncLog(1, LogOverflowDrop);
+
+	String output = LogToConsole(1000);
+
+	dropped = GetDroppedLogEntries() - dropped;
+
+	/* every message is either written or counted as dropped */
+	BOOST_CHECK(CountLines(output, "message ") + dropped == 1000);
+
+	if (dropped > 0)
+		BOOST_CHECK(output.Find("Log queue is full: Dropped ") != String::NPos);
+}
+
+BOOST_AUTO_TEST_CASE(critical)
+{
+	std::ostringstream buf;
+
+	bool console = Logger::IsConsoleLogEnabled();
+	LogSeverity severity = Logger::GetConsoleLogSeverity();
+
+	Logger::EnableConsoleLog();
+	Logger::SetConsoleLogSeverity(LogInformation);
+
+	std::streambuf *old = std::cout.rdbuf(buf.rdbuf());
+
+	Logger::EnableAsyncLog(1000, LogOverflowBlock);
+
+	for (int i = 0; i < 100; i++)
+		Log(LogInformation, "test") << "message " << i << ".";
+
+	Log(LogCritical, "test", "critical message");
+
+	/* the critical message is written right away, after all earlier messages */
+	String output = buf.str();
+
+	Logger::DisableAsyncLog();
+
+	std::cout.rdbuf(old);
+
+	Logger::SetConsoleLogSeverity(severity);
+
+	if (!console)
+		Logger::DisableConsoleLog();
+
+	BOOST_CHECK(CountLines(output, "message ") == 100);
+	BOOST_CHECK(output.Find("message 99.") < output.Find("critical message"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
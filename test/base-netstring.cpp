@@ -39,4 +39,21 @@ BOOST_AUTO_TEST_CASE(netstring)
 	fifo->Close();
 }
 
+BOOST_AUTO_TEST_CASE(encode)
+{
+	BOOST_CHECK(NetString::Encode("hello") == "5:hello,");
+
+	FIFO::Ptr fifo = new FIFO();
+
+	String msg = NetString::Encode("world");
+	fifo->Write(msg.CStr(), msg.GetLength());
+
+	String s;
+	StreamReadContext src;
+	BOOST_CHECK(NetString::ReadStringFromStream(fifo, &s, src) == StatusNewItem);
+	BOOST_CHECK(s == "world");
+
+	fifo->Close();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,230 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/process.hpp"
+#include "base/application.hpp"
+#include "base/scriptglobal.hpp"
+#include "base/convert.hpp"
+#include "base/utility.hpp"
+#include "base/array.hpp"
+#include <boost/test/unit_test.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <signal.h>
+
+using namespace icinga;
+
+#ifndef _WIN32
+struct ProcessWaiter
+{
+	boost::mutex Mutex;
+	boost::condition_variable CV;
+	bool Done;
+	ProcessResult Result;
+
+	ProcessWaiter(void)
+		: Done(false)
+	{ }
+
+	void ProcessFinishedHandler(const ProcessResult& result)
+	{
+		boost::mutex::scoped_lock lock(Mutex);
+		Result = result;
+		Done = true;
+		CV.notify_all();
+	}
+};
+
+static ProcessResult RunShellCommand(const String& command, double timeout = 600)
+{
+	Array::Ptr arguments = new Array();
+	arguments->Add("/bin/sh");
+	arguments->Add("-c");
+	arguments->Add(command);
+
+	/* icinga2's main() usually takes care of this */
+	if (!ScriptGlobal::Exists("UseVfork"))
+		ScriptGlobal::Set("UseVfork", false);
+
+	ProcessWaiter waiter;
+
+	Process::Ptr process = new Process(Process::PrepareCommand(arguments));
+	process->SetTimeout(timeout);
+	process->Run(boost::bind(&ProcessWaiter::ProcessFinishedHandler, &waiter, _1));
+
+	boost::mutex::scoped_lock lock(waiter.Mutex);
+
+	while (!waiter.Done)
+		BOOST_REQUIRE(waiter.CV.timed_wait(lock, boost::posix_time::seconds(60)));
+
+	return waiter.Result;
+}
+
+/* Returns the PID of the process which started the shell: either the test
+ * itself or the spawn helper. */
+static pid_t GetShellParent(const ProcessResult& result)
+{
+	return Convert::ToLong(String(result.Output).Trim());
+}
+
+struct SpawnHelperFixture
+{
+	SpawnHelperFixture(void)
+	{
+		/* the spawn helper is the icinga2 binary which is built next to the tests */
+		String exe = Utility::DirName(Application::GetExePath(boost::unit_test::framework::master_test_suite().argv[0])) + "/icinga2";
+
+		BOOST_REQUIRE(Utility::PathExists(exe));
+
+		Argv[0] = strdup(exe.CStr());
+		Argv[1] = NULL;
+
+		OldArgv = Application::GetArgV();
+		Application::SetArgV(Argv);
+
+		ScriptGlobal::Set("UseSpawnHelper", true);
+	}
+
+	~SpawnHelperFixture(void)
+	{
+		ScriptGlobal::Set("UseSpawnHelper", false);
+		Application::SetArgV(OldArgv);
+		free(Argv[0]);
+	}
+
+	char *Argv[2];
+	char **OldArgv;
+};
+#endif /* _WIN32 */
+
+BOOST_AUTO_TEST_SUITE(base_process)
+
+#ifndef _WIN32
+BOOST_AUTO_TEST_CASE(spawn)
+{
+	ProcessResult result = RunShellCommand("echo foo; exit 3");
+
+	BOOST_CHECK(result.Output == "foo\n");
+	BOOST_CHECK(result.ExitStatus == 3);
+	BOOST_CHECK(result.PID > 0);
+}
+
+BOOST_AUTO_TEST_CASE(timeout)
+{
+	ProcessResult result = RunShellCommand("sleep 30", 1);
+
+	BOOST_CHECK(String(result.Output).Contains("<Timeout exceeded.>"));
+	BOOST_CHECK(result.ExitStatus == 128);
+	BOOST_CHECK(result.ExecutionEnd - result.ExecutionStart < 20);
+}
+
+BOOST_FIXTURE_TEST_CASE(spawn_helper, SpawnHelperFixture)
+{
+	ProcessResult result = RunShellCommand("echo $PPID; exit 3");
+
+	pid_t helper = GetShellParent(result);
+
+	BOOST_CHECK(helper > 0 && helper != getpid());
+	BOOST_CHECK(result.ExitStatus == 3);
+
+	/* plugins are killed by the spawn helper on timeout */
+	result = RunShellCommand("sleep 30", 1);
+
+	BOOST_CHECK(String(result.Output).Contains("<Timeout exceeded.>"));
+	BOOST_CHECK(result.ExitStatus == 128);
+	BOOST_CHECK(result.ExecutionEnd - result.ExecutionStart < 20);
+
+	result = RunShellCommand("echo $PPID");
+	BOOST_CHECK(GetShellParent(result) == helper);
+}
+
+BOOST_FIXTURE_TEST_CASE(spawn_helper_stdin, SpawnHelperFixture)
+{
+	/* plugins must not be able to read from the spawn helper's socket */
+	ProcessResult result = RunShellCommand("cat; echo done", 10);
+
+	BOOST_CHECK(result.Output == "done\n");
+	BOOST_CHECK(result.ExitStatus == 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(spawn_helper_hung, SpawnHelperFixture)
+{
+	pid_t helper = GetShellParent(RunShellCommand("echo $PPID"));
+
+	BOOST_REQUIRE(helper > 0 && helper != getpid());
+	BOOST_REQUIRE(kill(helper, SIGSTOP) == 0);
+
+	/* the process is started with fork() once the spawn helper has failed to
+	 * respond, the process timeout starts after that */
+	ProcessResult result = RunShellCommand("echo $PPID; exit 2", 2);
+
+	BOOST_CHECK(GetShellParent(result) == getpid());
+	BOOST_CHECK(result.ExitStatus == 2);
+	BOOST_CHECK(!String(result.Output).Contains("<Timeout exceeded.>"));
+
+	/* the spawn helper was killed, following processes are started with fork() right away */
+	double start = Utility::GetTime();
+	result = RunShellCommand("echo $PPID");
+
+	BOOST_CHECK(GetShellParent(result) == getpid());
+	BOOST_CHECK(Utility::GetTime() - start < 2);
+
+	/* a new spawn helper is started once the restart interval has passed */
+	pid_t parent = getpid();
+
+	for (int i = 0; i < 150; i++) {
+		parent = GetShellParent(RunShellCommand("echo $PPID"));
+
+		if (parent != getpid())
+			break;
+
+		Utility::Sleep(0.1);
+	}
+
+	BOOST_CHECK(parent != helper && parent != getpid());
+}
+
+BOOST_FIXTURE_TEST_CASE(spawn_helper_restart, SpawnHelperFixture)
+{
+	pid_t helper = GetShellParent(RunShellCommand("echo $PPID"));
+
+	BOOST_REQUIRE(helper > 0 && helper != getpid());
+	BOOST_REQUIRE(kill(helper, SIGKILL) == 0);
+
+	/* processes are started with fork() until the spawn helper has been restarted */
+	pid_t parent = helper;
+
+	for (int i = 0; i < 150; i++) {
+		ProcessResult result = RunShellCommand("echo $PPID; exit 2");
+
+		BOOST_CHECK(result.ExitStatus == 2);
+
+		parent = GetShellParent(result);
+
+		if (parent != helper && parent != getpid())
+			break;
+
+		Utility::Sleep(0.1);
+	}
+
+	BOOST_CHECK(parent != helper && parent != getpid());
+}
+#endif /* _WIN32 */
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,115 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/socketevents.hpp"
+#include <boost/test/unit_test.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#ifndef _WIN32
+#	include <poll.h>
+#endif /* _WIN32 */
+
+using namespace icinga;
+
+class TestSocketEvents : public Object, public SocketEvents
+{
+public:
+	DECLARE_PTR_TYPEDEFS(TestSocketEvents);
+
+	TestSocketEvents(const Socket::Ptr& socket)
+		: SocketEvents(socket, this)
+	{ }
+
+	virtual void OnEvent(int revents) override
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		m_Events.push_back(revents);
+		m_CV.notify_all();
+	}
+
+	/* Waits until the handler was called count times and returns the events of the last call, or 0 on timeout. */
+	int WaitForEvents(size_t count, double timeout)
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(static_cast<long>(timeout * 1000));
+
+		while (m_Events.size() < count) {
+			if (!m_CV.timed_wait(lock, deadline))
+				return 0;
+		}
+
+		return m_Events[count - 1];
+	}
+
+	size_t GetEventCount(void)
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		return m_Events.size();
+	}
+
+private:
+	boost::mutex m_Mutex;
+	boost::condition_variable m_CV;
+	std::vector<int> m_Events;
+};
+
+BOOST_AUTO_TEST_SUITE(base_socketevents)
+
+BOOST_AUTO_TEST_CASE(register_change_unregister)
+{
+	SOCKET fds[2];
+	Socket::SocketPair(fds);
+
+	Socket::Ptr sock = new Socket(fds[0]);
+	Socket::Ptr peer = new Socket(fds[1]);
+
+	TestSocketEvents::Ptr se = new TestSocketEvents(sock);
+	BOOST_CHECK(se->IsHandlingEvents());
+
+	se->ChangeEvents(POLLIN);
+	peer->Write("a", 1);
+
+	BOOST_CHECK(se->WaitForEvents(1, 10) & POLLIN);
+
+	se->ChangeEvents(POLLOUT);
+
+	BOOST_CHECK(se->WaitForEvents(2, 10) & POLLOUT);
+
+	/* changing the events re-arms the socket, the unread data is reported again */
+	se->ChangeEvents(POLLIN);
+
+	BOOST_CHECK(se->WaitForEvents(3, 10) & POLLIN);
+
+	se->Unregister();
+	BOOST_CHECK(!se->IsHandlingEvents());
+
+	size_t count = se->GetEventCount();
+
+	peer->Write("b", 1);
+
+	BOOST_CHECK(se->WaitForEvents(count + 1, 0.5) == 0);
+	BOOST_CHECK(se->GetEventCount() == count);
+
+	sock->Close();
+	peer->Close();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
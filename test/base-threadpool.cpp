@@ -0,0 +1,158 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+
+#include "base/threadpool.hpp"
+#include "base/utility.hpp"
+#include "base/objectlock.hpp"
+#include <boost/test/unit_test.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/foreach.hpp>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_threadpool)
+
+static void Callback(boost::mutex *mutex, int *counter)
+{
+	Utility::Sleep(0.01);
+
+	boost::mutex::scoped_lock lock(*mutex);
+	(*counter)++;
+}
+
+static int GetCounter(boost::mutex *mutex, int *counter)
+{
+	boost::mutex::scoped_lock lock(*mutex);
+	return *counter;
+}
+
+BOOST_AUTO_TEST_CASE(post)
+{
+	boost::mutex mutex;
+	int counter = 0;
+
+	ThreadPool tp(8);
+
+	for (int i = 0; i < 100; i++)
+		BOOST_CHECK(tp.Post(boost::bind(&Callback, &mutex, &counter)));
+
+	for (int i = 0; i < 100 && GetCounter(&mutex, &counter) < 100; i++)
+		Utility::Sleep(0.1);
+
+	BOOST_CHECK(GetCounter(&mutex, &counter) == 100);
+}
+
+BOOST_AUTO_TEST_CASE(backpressure)
+{
+	boost::mutex mutex;
+	int counter = 0;
+
+	ThreadPool tp(4);
+	tp.SetMaxPending(4);
+
+	BOOST_CHECK(tp.GetMaxPending() == 4);
+
+	/* Post() blocks while the queues are full, so all items must have been accepted. */
+	for (int i = 0; i < 50; i++)
+		BOOST_CHECK(tp.Post(boost::bind(&Callback, &mutex, &counter), ThrottledScheduler));
+
+	for (int i = 0; i < 100 && GetCounter(&mutex, &counter) < 50; i++)
+		Utility::Sleep(0.1);
+
+	BOOST_CHECK(GetCounter(&mutex, &counter) == 50);
+
+	Dictionary::Ptr status = new Dictionary();
+	Array::Ptr perfdata = new Array();
+	tp.GetStats(status, perfdata);
+
+	BOOST_CHECK(status->Get("throttled") > 0);
+
+	Dictionary::Ptr histogram = status->Get("latency_histogram");
+	int tasks = 0;
+
+	ObjectLock olock(histogram);
+	BOOST_FOREACH(const Dictionary::Pair& kv, histogram) {
+		tasks += kv.second;
+	}
+
+	BOOST_CHECK(tasks == 50);
+}
+
+BOOST_AUTO_TEST_CASE(unthrottled)
+{
+	boost::mutex mutex;
+	int counter = 0;
+
+	ThreadPool tp(4);
+	tp.SetMaxPending(4);
+
+	/* only ThrottledScheduler items wait for the queues to drain */
+	for (int i = 0; i < 50; i++)
+		BOOST_CHECK(tp.Post(boost::bind(&Callback, &mutex, &counter)));
+
+	Dictionary::Ptr status = new Dictionary();
+	Array::Ptr perfdata = new Array();
+	tp.GetStats(status, perfdata);
+
+	BOOST_CHECK(status->Get("throttled") == 0);
+
+	for (int i = 0; i < 100 && GetCounter(&mutex, &counter) < 50; i++)
+		Utility::Sleep(0.1);
+
+	BOOST_CHECK(GetCounter(&mutex, &counter) == 50);
+}
+
+static void WaitForOthers(boost::mutex *mutex, boost::condition_variable *cv, int *running, int count)
+{
+	boost::mutex::scoped_lock lock(*mutex);
+
+	(*running)++;
+	cv->notify_all();
+
+	boost::system_time deadline = boost::get_system_time() + boost::posix_time::seconds(10);
+
+	while (*running < count && cv->timed_wait(lock, deadline))
+		; /* empty loop */
+}
+
+BOOST_AUTO_TEST_CASE(steal)
+{
+	boost::mutex mutex;
+	boost::condition_variable cv;
+	int running = 0;
+
+	/* one worker per queue: work items which end up in the same queue can
+	 * only run concurrently if idle workers steal them */
+	ThreadPool tp(4);
+
+	for (int i = 0; i < 4; i++)
+		BOOST_CHECK(tp.Post(boost::bind(&WaitForOthers, &mutex, &cv, &running, 4)));
+
+	boost::mutex::scoped_lock lock(mutex);
+	boost::system_time deadline = boost::get_system_time() + boost::posix_time::seconds(10);
+
+	while (running < 4 && cv.timed_wait(lock, deadline))
+		; /* empty loop */
+
+	BOOST_CHECK(running == 4);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,222 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/timingwheel.hpp"
+#include "base/utility.hpp"
+#include <boost/test/unit_test.hpp>
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/key_extractors.hpp>
+#include <cstdlib>
+
+using namespace icinga;
+
+struct TimingWheelEntry
+{
+	double When;
+};
+
+BOOST_AUTO_TEST_SUITE(base_timingwheel)
+
+BOOST_AUTO_TEST_CASE(order)
+{
+	TimingWheel<TimingWheelEntry *> wheel;
+	TimingWheelEntry entries[3];
+
+	double now = Utility::GetTime();
+
+	wheel.Insert(&entries[0], now + 30);
+	wheel.Insert(&entries[1], now - 5);
+	wheel.Insert(&entries[2], now + 3600);
+
+	BOOST_CHECK(wheel.GetLength() == 3);
+
+	TimingWheelEntry *entry;
+	BOOST_CHECK(wheel.Pop(now, entry));
+	BOOST_CHECK(entry == &entries[1]);
+	BOOST_CHECK(!wheel.Pop(now, entry));
+
+	BOOST_CHECK(wheel.GetNextDeadline() > now);
+	BOOST_CHECK(wheel.GetNextDeadline() <= now + 30);
+
+	BOOST_CHECK(wheel.Pop(now + 31, entry));
+	BOOST_CHECK(entry == &entries[0]);
+	BOOST_CHECK(!wheel.Pop(now + 31, entry));
+
+	BOOST_CHECK(wheel.Pop(now + 3600, entry));
+	BOOST_CHECK(entry == &entries[2]);
+	BOOST_CHECK(wheel.IsEmpty());
+}
+
+BOOST_AUTO_TEST_CASE(fifo)
+{
+	TimingWheel<TimingWheelEntry *> wheel;
+	TimingWheelEntry entries[6];
+
+	double now = Utility::GetTime();
+
+	/* overdue items with the same deadline are returned in insertion order */
+	wheel.Insert(&entries[0], now - 10);
+	wheel.Insert(&entries[1], now - 10);
+	wheel.Insert(&entries[2], now - 10);
+
+	/* earlier deadlines come first */
+	wheel.Insert(&entries[3], now + 2);
+	wheel.Insert(&entries[4], now + 1);
+	wheel.Insert(&entries[5], now - 20);
+
+	TimingWheelEntry *entry;
+
+	BOOST_CHECK(wheel.Pop(now, entry));
+	BOOST_CHECK(entry == &entries[5]);
+	BOOST_CHECK(wheel.Pop(now, entry));
+	BOOST_CHECK(entry == &entries[0]);
+
+	/* items which have expired while the wheel advances are merged */
+	BOOST_CHECK(wheel.Pop(now + 3, entry));
+	BOOST_CHECK(entry == &entries[1]);
+	BOOST_CHECK(wheel.Pop(now + 3, entry));
+	BOOST_CHECK(entry == &entries[2]);
+	BOOST_CHECK(wheel.Pop(now + 3, entry));
+	BOOST_CHECK(entry == &entries[4]);
+	BOOST_CHECK(wheel.Pop(now + 3, entry));
+	BOOST_CHECK(entry == &entries[3]);
+	BOOST_CHECK(wheel.IsEmpty());
+}
+
+BOOST_AUTO_TEST_CASE(reschedule)
+{
+	TimingWheel<TimingWheelEntry *> wheel;
+	TimingWheelEntry entries[2];
+
+	double now = Utility::GetTime();
+
+	wheel.Insert(&entries[0], now + 10);
+	wheel.Insert(&entries[1], now + 20);
+	wheel.Insert(&entries[0], now + 30);
+
+	BOOST_CHECK(wheel.GetLength() == 2);
+
+	TimingWheelEntry *entry;
+	BOOST_CHECK(wheel.Pop(now + 25, entry));
+	BOOST_CHECK(entry == &entries[1]);
+	BOOST_CHECK(!wheel.Pop(now + 25, entry));
+
+	BOOST_CHECK(wheel.Remove(&entries[0]));
+	BOOST_CHECK(!wheel.Remove(&entries[0]));
+	BOOST_CHECK(!wheel.Contains(&entries[0]));
+	BOOST_CHECK(wheel.IsEmpty());
+}
+
+BOOST_AUTO_TEST_CASE(cascade)
+{
+	TimingWheel<TimingWheelEntry *> wheel;
+	std::vector<TimingWheelEntry> entries(1000);
+
+	double now = Utility::GetTime();
+
+	for (std::vector<TimingWheelEntry>::size_type i = 0; i < entries.size(); i++) {
+		entries[i].When = now + (rand() % 100000) / 10.0;
+		wheel.Insert(&entries[i], entries[i].When);
+	}
+
+	TimingWheelEntry *entry;
+
+	for (double ts = now; ts < now + 10001; ts += 7.3) {
+		while (wheel.Pop(ts, entry)) {
+			BOOST_CHECK(entry->When <= ts);
+			BOOST_CHECK(entry->When > ts - 7.3);
+		}
+
+		BOOST_CHECK(wheel.IsEmpty() || wheel.GetNextDeadline() > ts);
+	}
+
+	BOOST_CHECK(wheel.IsEmpty());
+}
+
+typedef boost::multi_index_container<
+	TimingWheelEntry *,
+	boost::multi_index::indexed_by<
+		boost::multi_index::ordered_unique<boost::multi_index::identity<TimingWheelEntry *> >,
+		boost::multi_index::ordered_non_unique<boost::multi_index::member<TimingWheelEntry, double, &TimingWheelEntry::When> >
+	>
+> TimingWheelEntrySet;
+
+static double BenchmarkWheel(std::vector<TimingWheelEntry>& entries, const std::vector<size_t>& order, double now)
+{
+	TimingWheel<TimingWheelEntry *> wheel;
+
+	for (std::vector<TimingWheelEntry>::size_type i = 0; i < entries.size(); i++)
+		wheel.Insert(&entries[i], entries[i].When);
+
+	double start = Utility::GetTime();
+
+	for (std::vector<size_t>::size_type i = 0; i < order.size(); i++) {
+		TimingWheelEntry& entry = entries[order[i]];
+		entry.When = now + (i % 300);
+		wheel.Insert(&entry, entry.When);
+	}
+
+	return Utility::GetTime() - start;
+}
+
+static double BenchmarkOrderedIndex(std::vector<TimingWheelEntry>& entries, const std::vector<size_t>& order, double now)
+{
+	TimingWheelEntrySet set;
+
+	for (std::vector<TimingWheelEntry>::size_type i = 0; i < entries.size(); i++)
+		set.insert(&entries[i]);
+
+	double start = Utility::GetTime();
+
+	for (std::vector<size_t>::size_type i = 0; i < order.size(); i++) {
+		TimingWheelEntry *entry = &entries[order[i]];
+		set.erase(entry);
+		entry->When = now + (i % 300);
+		set.insert(entry);
+	}
+
+	return Utility::GetTime() - start;
+}
+
+/* compares the reschedule throughput with the ordered index the timing wheel replaced */
+BOOST_AUTO_TEST_CASE(benchmark)
+{
+	double now = Utility::GetTime();
+
+	for (size_t count = 100000; count <= 1000000; count *= 10) {
+		std::vector<TimingWheelEntry> entries(count);
+
+		for (size_t i = 0; i < count; i++)
+			entries[i].When = now + rand() % 300;
+
+		std::vector<size_t> order(count);
+
+		for (size_t i = 0; i < count; i++)
+			order[i] = rand() % count;
+
+		double wheel = BenchmarkWheel(entries, order, now);
+		double ordered = BenchmarkOrderedIndex(entries, order, now);
+
+		BOOST_TEST_MESSAGE(count << " entries: timing wheel " << count / wheel << " reschedules/s, ordered index "
+		    << count / ordered << " reschedules/s");
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
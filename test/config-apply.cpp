@@ -0,0 +1,94 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "config/configcompiler.hpp"
+#include "config/applyrule.hpp"
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+
+using namespace icinga;
+
+static String GetCandidateNames(const Dictionary::Ptr& host)
+{
+	Dictionary::Ptr variables = new Dictionary();
+	variables->Set("host", host);
+
+	String names;
+
+	BOOST_FOREACH(ApplyRule *rule, ApplyRule::GetCandidateRules("Service", variables)) {
+		if (!names.IsEmpty())
+			names += ",";
+
+		names += rule->GetName();
+	}
+
+	return names;
+}
+
+BOOST_AUTO_TEST_SUITE(config_apply)
+
+BOOST_AUTO_TEST_CASE(index)
+{
+	ScriptFrame frame;
+	Expression *expr = ConfigCompiler::CompileText("<test>",
+	    "apply Service \"linux\" { assign where host.vars.os == \"Linux\" }\n"
+	    "apply Service \"web\" { assign where \"web\" in host.groups && !host.vars.disabled }\n"
+	    "apply Service \"either\" {\n"
+	    "  assign where host.vars.os == \"BSD\"\n"
+	    "  assign where \"h1\" == host.name\n"
+	    "}\n"
+	    "apply Service \"dynamic\" { assign where host.vars.count > 3 }\n"
+	    "apply Service \"loop\" for (host in [ \"a\" ]) { assign where host.name == \"a\" }\n");
+	expr->Evaluate(frame);
+	delete expr;
+
+	Dictionary::Ptr host, vars;
+	Array::Ptr groups;
+
+	host = new Dictionary();
+	host->Set("name", "h0");
+	vars = new Dictionary();
+	vars->Set("os", "Linux");
+	host->Set("vars", vars);
+	groups = new Array();
+	groups->Add("web");
+	host->Set("groups", groups);
+	BOOST_CHECK(GetCandidateNames(host) == "linux,web,dynamic,loop");
+
+	host = new Dictionary();
+	host->Set("name", "h1");
+	vars = new Dictionary();
+	vars->Set("os", "BSD");
+	host->Set("vars", vars);
+	BOOST_CHECK(GetCandidateNames(host) == "either,dynamic,loop");
+
+	/* 'in' with a string raises an error which must not be skipped. */
+	host = new Dictionary();
+	host->Set("groups", "web");
+	BOOST_CHECK(GetCandidateNames(host) == "web,dynamic,loop");
+
+	unsigned long evaluations, skipped;
+	ApplyRule::GetIndexStats(evaluations, skipped);
+	BOOST_CHECK(evaluations == 15);
+	BOOST_CHECK(skipped == 5);
+
+	ApplyRule::DiscardRules();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
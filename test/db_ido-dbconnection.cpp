@@ -0,0 +1,169 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "db_ido/dbconnection.hpp"
+#include "icinga/host.hpp"
+#include <boost/test/unit_test.hpp>
+
+using namespace icinga;
+
+class TestDbConnection : public DbConnection
+{
+public:
+	DECLARE_PTR_TYPEDEFS(TestDbConnection);
+
+	virtual int GetPendingQueryCount(void) const override
+	{
+		return 0;
+	}
+
+	using DbConnection::CanCoalesceQuery;
+	using DbConnection::AddCoalescedQuery;
+	using DbConnection::CloseCoalescedQueries;
+	using DbConnection::TakeCoalescedQuery;
+
+protected:
+	virtual void ExecuteQuery(const DbQuery&) override { }
+	virtual void ActivateObject(const DbObject::Ptr&) override { }
+	virtual void DeactivateObject(const DbObject::Ptr&) override { }
+	virtual void FillIDCache(const DbType::Ptr&) override { }
+	virtual void NewTransaction(void) override { }
+
+private:
+	virtual void ClearConfigTable(const String&) override { }
+};
+
+static DbObject::Ptr GetTestDbObject(const String& name)
+{
+	Host::Ptr host = new Host();
+	host->SetTypeNameV("Host");
+	host->SetName(name);
+	return DbObject::GetOrCreateByObject(host);
+}
+
+static DbQuery MakeStatusQuery(const DbObject::Ptr& dbobj, const String& field, int value, bool instanceCriteria = false)
+{
+	DbQuery query;
+	query.Table = "hoststatus";
+	query.Type = DbQueryInsert | DbQueryUpdate;
+	query.Category = DbCatState;
+	query.Object = dbobj;
+	query.StatusUpdate = true;
+
+	query.Fields = new Dictionary();
+	query.Fields->Set(field, value);
+
+	query.WhereCriteria = new Dictionary();
+	query.WhereCriteria->Set("host_object_id", dbobj->GetObject());
+
+	if (instanceCriteria)
+		query.WhereCriteria->Set("instance_id", 0);
+
+	return query;
+}
+
+BOOST_AUTO_TEST_SUITE(db_ido_dbconnection)
+
+BOOST_AUTO_TEST_CASE(coalesce)
+{
+	TestDbConnection::Ptr conn = new TestDbConnection();
+	DbObject::Ptr dbobj = GetTestDbObject("coalesce-host-01");
+
+	DbQuery q1 = MakeStatusQuery(dbobj, "current_state", 1);
+	DbQuery q2 = MakeStatusQuery(dbobj, "output", 2, true);
+
+	BOOST_CHECK(TestDbConnection::CanCoalesceQuery(q1));
+	BOOST_CHECK(TestDbConnection::CanCoalesceQuery(q2));
+
+	DbQuery vars = q1;
+	vars.Table = "customvariablestatus";
+	vars.StatusUpdate = false;
+	BOOST_CHECK(!TestDbConnection::CanCoalesceQuery(vars));
+
+	/* the instance ID in the where criteria does not prevent coalescing */
+	unsigned long id1, id2;
+	BOOST_CHECK(conn->AddCoalescedQuery(q1, &id1));
+	BOOST_CHECK(!conn->AddCoalescedQuery(q2, &id2));
+
+	DbQuery query;
+	BOOST_CHECK(conn->TakeCoalescedQuery(id1, &query));
+	BOOST_CHECK(query.Fields->Get("current_state") == 1);
+	BOOST_CHECK(query.Fields->Get("output") == 2);
+	BOOST_CHECK(!conn->TakeCoalescedQuery(id1, &query));
+
+	/* once the pending update was taken newer updates are scheduled again */
+	BOOST_CHECK(conn->AddCoalescedQuery(q1, &id2));
+	BOOST_CHECK(id2 != id1);
+	BOOST_CHECK(conn->TakeCoalescedQuery(id2, &query));
+}
+
+BOOST_AUTO_TEST_CASE(coalesce_order)
+{
+	TestDbConnection::Ptr conn = new TestDbConnection();
+	DbObject::Ptr dbobj1 = GetTestDbObject("coalesce-host-02");
+	DbObject::Ptr dbobj2 = GetTestDbObject("coalesce-host-03");
+
+	unsigned long id1, id2, id3;
+	BOOST_CHECK(conn->AddCoalescedQuery(MakeStatusQuery(dbobj1, "current_state", 1), &id1));
+	BOOST_CHECK(conn->AddCoalescedQuery(MakeStatusQuery(dbobj2, "current_state", 1), &id2));
+
+	/* queries for other objects do not depend on the pending update */
+	DbQuery other;
+	other.Table = "hoststatus";
+	other.Type = DbQueryUpdate;
+	other.Category = DbCatAcknowledgement;
+	other.Object = dbobj2;
+	conn->CloseCoalescedQueries(other);
+
+	BOOST_CHECK(!conn->AddCoalescedQuery(MakeStatusQuery(dbobj1, "current_state", 2), &id3));
+
+	/* later updates must not be moved ahead of queries for the same object */
+	DbQuery history;
+	history.Table = "statehistory";
+	history.Type = DbQueryInsert;
+	history.Category = DbCatStateHistory;
+	history.Object = dbobj1;
+	conn->CloseCoalescedQueries(history);
+
+	BOOST_CHECK(conn->AddCoalescedQuery(MakeStatusQuery(dbobj1, "current_state", 3), &id3));
+	BOOST_CHECK(id3 != id1);
+
+	DbQuery query;
+	BOOST_CHECK(conn->TakeCoalescedQuery(id1, &query));
+	BOOST_CHECK(query.Fields->Get("current_state") == 2);
+	BOOST_CHECK(conn->TakeCoalescedQuery(id3, &query));
+	BOOST_CHECK(query.Fields->Get("current_state") == 3);
+
+	/* ... nor ahead of queries for the same table which are not restricted to an object */
+	DbQuery cleanup;
+	cleanup.Table = "hoststatus";
+	cleanup.Type = DbQueryDelete;
+	cleanup.Category = DbCatConfig;
+	conn->CloseCoalescedQueries(cleanup);
+
+	BOOST_CHECK(conn->AddCoalescedQuery(MakeStatusQuery(dbobj2, "current_state", 2), &id3));
+	BOOST_CHECK(id3 != id2);
+
+	BOOST_CHECK(conn->TakeCoalescedQuery(id2, &query));
+	BOOST_CHECK(query.Fields->Get("current_state") == 1);
+	BOOST_CHECK(conn->TakeCoalescedQuery(id3, &query));
+	BOOST_CHECK(query.Fields->Get("current_state") == 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,301 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "db_ido_pgsql/idopgsqlconnection.hpp"
+#include "db_ido/dbobject.hpp"
+#include "icinga/host.hpp"
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <deque>
+#include <map>
+#include <set>
+
+using namespace icinga;
+
+/*
+ * TestIdoPgsqlConnection replaces the libpq calls which talk to the server
+ * with an in-memory server. It only understands the statements the tests
+ * send, enforces the unique key on icinga_hoststatus.host_object_id and
+ * aborts a batch on the first failing statement, like PostgreSQL does.
+ */
+class TestIdoPgsqlConnection : public IdoPgsqlConnection
+{
+public:
+	DECLARE_PTR_TYPEDEFS(TestIdoPgsqlConnection);
+
+	TestIdoPgsqlConnection(void)
+		: m_Errors(0)
+	{ }
+
+	~TestIdoPgsqlConnection(void)
+	{
+		BOOST_FOREACH(PGresult *result, m_Results) {
+			PQclear(result);
+		}
+	}
+
+	using IdoPgsqlConnection::ExecuteQuery;
+	using IdoPgsqlConnection::NewTransaction;
+
+	int GetStatementCount(const std::string& prefix)
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		int count = 0;
+
+		BOOST_FOREACH(const std::string& statement, m_Statements) {
+			if (statement.find(prefix) == 0)
+				count++;
+		}
+
+		return count;
+	}
+
+	bool WaitForStatements(const std::string& prefix, int count)
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		boost::system_time deadline = boost::get_system_time() + boost::posix_time::seconds(10);
+
+		for (;;) {
+			int current = 0;
+
+			BOOST_FOREACH(const std::string& statement, m_Statements) {
+				if (statement.find(prefix) == 0)
+					current++;
+			}
+
+			if (current >= count)
+				return true;
+
+			if (!m_CV.timed_wait(lock, deadline))
+				return false;
+		}
+	}
+
+	int GetErrors(void)
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		return m_Errors;
+	}
+
+protected:
+	virtual PGresult *ExecuteStatement(const String& query) override
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		return RunStatement(query);
+	}
+
+	virtual bool SendStatements(const String& query) override
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		std::vector<std::string> statements;
+		boost::algorithm::split(statements, query.GetData(), boost::is_any_of(";"));
+
+		BOOST_FOREACH(const std::string& statement, statements) {
+			PGresult *result = RunStatement(statement);
+			m_Results.push_back(result);
+
+			if (PQresultStatus(result) == PGRES_FATAL_ERROR)
+				break;
+		}
+
+		return true;
+	}
+
+	virtual PGresult *GetNextResult(void) override
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		if (m_Results.empty())
+			return NULL;
+
+		PGresult *result = m_Results.front();
+		m_Results.pop_front();
+		return result;
+	}
+
+	virtual int GetResultAffectedRows(PGresult *result) override
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		std::map<PGresult *, int>::iterator it = m_AffectedRows.find(result);
+
+		if (it == m_AffectedRows.end())
+			return 0;
+
+		int rows = it->second;
+		m_AffectedRows.erase(it);
+		return rows;
+	}
+
+	virtual String Escape(const String& s) override
+	{
+		return s;
+	}
+
+private:
+	boost::mutex m_Mutex;
+	boost::condition_variable m_CV;
+	std::set<std::string> m_HostStatusRows;
+	std::vector<std::string> m_Statements;
+	std::deque<PGresult *> m_Results;
+	std::map<PGresult *, int> m_AffectedRows;
+	int m_Errors;
+
+	static std::string GetStatementValue(const std::string& statement, const std::string& column)
+	{
+		std::string::size_type pos = statement.find(column + " = ");
+
+		if (pos == std::string::npos)
+			return std::string();
+
+		pos += column.size() + 3;
+
+		return statement.substr(pos, statement.find(' ', pos) - pos);
+	}
+
+	static std::string GetInsertValue(const std::string& statement, const std::string& column)
+	{
+		std::string::size_type colStart = statement.find('(') + 1;
+		std::string::size_type colEnd = statement.find(')', colStart);
+		std::string::size_type valStart = statement.find('(', colEnd) + 1;
+		std::string::size_type valEnd = statement.rfind(')');
+
+		std::vector<std::string> columns, values;
+		String cols = statement.substr(colStart, colEnd - colStart);
+		String vals = statement.substr(valStart, valEnd - valStart);
+		boost::algorithm::split(columns, cols.GetData(), boost::is_any_of(","));
+		boost::algorithm::split(values, vals.GetData(), boost::is_any_of(","));
+
+		for (std::vector<std::string>::size_type i = 0; i < columns.size() && i < values.size(); i++) {
+			if (String(columns[i]).Trim() == column)
+				return String(values[i]).Trim();
+		}
+
+		return std::string();
+	}
+
+	/* The caller must hold m_Mutex. */
+	PGresult *RunStatement(const std::string& statement)
+	{
+		ExecStatusType status = PGRES_COMMAND_OK;
+		int rows = 0;
+
+		m_Statements.push_back(statement);
+		m_CV.notify_all();
+
+		if (statement.find("UPDATE icinga_hoststatus ") == 0) {
+			if (m_HostStatusRows.find(GetStatementValue(statement, "host_object_id")) != m_HostStatusRows.end())
+				rows = 1;
+		} else if (statement.find("INSERT INTO icinga_hoststatus ") == 0) {
+			/* duplicate key value violates unique constraint */
+			if (!m_HostStatusRows.insert(GetInsertValue(statement, "host_object_id")).second) {
+				status = PGRES_FATAL_ERROR;
+				m_Errors++;
+			} else
+				rows = 1;
+		}
+
+		PGresult *result = PQmakeEmptyPGresult(NULL, status);
+		m_AffectedRows[result] = rows;
+		return result;
+	}
+};
+
+static DbQuery MakeHostStatusQuery(const DbObject::Ptr& dbobj, bool instanceCriteria)
+{
+	DbQuery query;
+	query.Table = "hoststatus";
+	query.Type = DbQueryInsert | DbQueryUpdate;
+	query.Category = DbCatState;
+	query.Object = dbobj;
+	query.StatusUpdate = true;
+
+	query.Fields = new Dictionary();
+	query.Fields->Set("host_object_id", 12);
+	query.Fields->Set("current_state", 1);
+
+	query.WhereCriteria = new Dictionary();
+	query.WhereCriteria->Set("host_object_id", 12);
+
+	if (instanceCriteria)
+		query.WhereCriteria->Set("instance_id", 0);
+
+	return query;
+}
+
+BOOST_AUTO_TEST_SUITE(db_ido_pgsql)
+
+BOOST_AUTO_TEST_CASE(upsert_batch)
+{
+	TestIdoPgsqlConnection::Ptr conn = new TestIdoPgsqlConnection();
+	conn->SetTypeNameV("IdoPgsqlConnection");
+	conn->SetName("ido-pgsql-test");
+	conn->SetConnected(true);
+
+	Host::Ptr host = new Host();
+	host->SetTypeNameV("Host");
+	host->SetName("ido-pgsql-test-host");
+	DbObject::Ptr dbobj = DbObject::GetOrCreateByObject(host);
+	BOOST_REQUIRE(dbobj);
+
+	/* Two updates for a status row which does not exist yet end up in the same batch. */
+	conn->ExecuteQuery(MakeHostStatusQuery(dbobj, false));
+
+	DbQuery history;
+	history.Table = "statehistory";
+	history.Type = DbQueryInsert;
+	history.Category = DbCatStateHistory;
+	history.Object = dbobj;
+	history.Fields = new Dictionary();
+	history.Fields->Set("object_id", 12);
+	conn->ExecuteQuery(history);
+
+	conn->ExecuteQuery(MakeHostStatusQuery(dbobj, true));
+
+	/* flush the batch like the transaction timer does */
+	conn->NewTransaction();
+
+	BOOST_REQUIRE(conn->WaitForStatements("COMMIT", 1));
+
+	BOOST_CHECK(conn->GetStatementCount("INSERT INTO icinga_statehistory ") == 1);
+	BOOST_CHECK(conn->GetStatementCount("INSERT INTO icinga_hoststatus ") == 1);
+	BOOST_CHECK(conn->GetStatementCount("UPDATE icinga_hoststatus ") == 2);
+	BOOST_CHECK(conn->GetErrors() == 0);
+
+	/* the row exists now, further updates are sent as part of a batch */
+	conn->ExecuteQuery(MakeHostStatusQuery(dbobj, false));
+	conn->NewTransaction();
+
+	BOOST_REQUIRE(conn->WaitForStatements("COMMIT", 2));
+
+	BOOST_CHECK(conn->GetStatementCount("UPDATE icinga_hoststatus ") == 3);
+	BOOST_CHECK(conn->GetStatementCount("INSERT INTO icinga_hoststatus ") == 1);
+
+	conn->SetConnected(false);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
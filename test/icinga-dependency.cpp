@@ -0,0 +1,222 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "icinga/host.hpp"
+#include "icinga/dependency.hpp"
+#include "icinga/checkresult.hpp"
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+#include <boost/bind.hpp>
+
+using namespace icinga;
+
+struct DependencyFixture
+{
+	DependencyFixture(void)
+	{
+		Parent = AddHost("dependency-parent");
+		Child = AddHost("dependency-child");
+		Grandchild = AddHost("dependency-grandchild");
+
+		ParentDependency = AddDependency(Parent, Child);
+		ChildDependency = AddDependency(Child, Grandchild);
+	}
+
+	~DependencyFixture(void)
+	{
+		BOOST_FOREACH(const ConfigObject::Ptr& object, Objects) {
+			object->Deactivate();
+			object->Unregister();
+		}
+	}
+
+	Host::Ptr AddHost(const String& name)
+	{
+		Host::Ptr host = new Host();
+		host->SetTypeNameV("Host");
+		host->SetName(name);
+		host->Register();
+		host->Activate();
+		Objects.push_back(host);
+
+		return host;
+	}
+
+	Dependency::Ptr AddDependency(const Host::Ptr& parent, const Host::Ptr& child)
+	{
+		Dependency::Ptr dep = new Dependency();
+		dep->SetTypeNameV("Dependency");
+		dep->SetName(child->GetName() + "!" + parent->GetName());
+		dep->SetParentHostName(parent->GetName());
+		dep->SetChildHostName(child->GetName());
+
+		ConfigObject::Ptr object = dep;
+		object->OnConfigLoaded();
+		object->Register();
+		object->OnAllConfigLoaded();
+		object->Activate();
+
+		/* dependencies have to be removed before the hosts they refer to */
+		Objects.insert(Objects.begin(), object);
+
+		return dep;
+	}
+
+	static void SetState(const Host::Ptr& host, ServiceState state, StateType type = StateTypeHard)
+	{
+		host->SetLastCheckResult(new CheckResult());
+		host->SetStateRaw(state);
+		host->SetStateType(type);
+	}
+
+	static void FailParentHandler(const Checkable::Ptr& checkable, const Host::Ptr& child, const Host::Ptr& parent)
+	{
+		if (checkable == child && parent->GetStateRaw() == ServiceOK)
+			SetState(parent, ServiceCritical);
+	}
+
+	static unsigned long GetCacheHits(const Checkable::Ptr& checkable)
+	{
+		unsigned long hits = 0, misses = 0;
+		checkable->GetReachabilityCacheStatistics(hits, misses);
+		return hits;
+	}
+
+	Host::Ptr Parent;
+	Host::Ptr Child;
+	Host::Ptr Grandchild;
+	Dependency::Ptr ParentDependency;
+	Dependency::Ptr ChildDependency;
+	std::vector<ConfigObject::Ptr> Objects;
+};
+
+BOOST_FIXTURE_TEST_SUITE(icinga_dependency, DependencyFixture)
+
+BOOST_AUTO_TEST_CASE(cache)
+{
+	/* pending parents don't fail dependencies */
+	BOOST_CHECK(Child->IsReachable());
+
+	unsigned long hits = GetCacheHits(Child);
+	BOOST_CHECK(Child->IsReachable());
+	BOOST_CHECK(GetCacheHits(Child) == hits + 1);
+
+	/* the cache is kept when the state doesn't change */
+	SetState(Parent, ServiceOK);
+	BOOST_CHECK(Child->IsReachable());
+
+	hits = GetCacheHits(Child);
+	SetState(Parent, ServiceOK);
+	BOOST_CHECK(Child->IsReachable());
+	BOOST_CHECK(GetCacheHits(Child) == hits + 1);
+}
+
+BOOST_AUTO_TEST_CASE(parent_state)
+{
+	SetState(Parent, ServiceOK);
+	BOOST_CHECK(Child->IsReachable());
+	BOOST_CHECK(Grandchild->IsReachable());
+
+	SetState(Parent, ServiceCritical);
+
+	Dependency::Ptr failed;
+	BOOST_CHECK(!Child->IsReachable(DependencyState, &failed));
+	BOOST_CHECK(failed == ParentDependency);
+
+	/* checkables which depend on the child are invalidated as well */
+	BOOST_CHECK(!Grandchild->IsReachable(DependencyState, &failed));
+	BOOST_CHECK(failed == ParentDependency);
+
+	/* cached results return the failed dependency too */
+	failed.reset();
+	BOOST_CHECK(!Grandchild->IsReachable(DependencyState, &failed));
+	BOOST_CHECK(failed == ParentDependency);
+
+	SetState(Parent, ServiceOK);
+	BOOST_CHECK(Child->IsReachable(DependencyState, &failed));
+	BOOST_CHECK(!failed);
+	BOOST_CHECK(Grandchild->IsReachable());
+}
+
+BOOST_AUTO_TEST_CASE(parent_state_type)
+{
+	SetState(Parent, ServiceCritical, StateTypeSoft);
+	BOOST_CHECK(Child->IsReachable());
+
+	SetState(Parent, ServiceCritical, StateTypeHard);
+	BOOST_CHECK(!Child->IsReachable());
+
+	SetState(Parent, ServiceCritical, StateTypeSoft);
+	BOOST_CHECK(Child->IsReachable());
+}
+
+BOOST_AUTO_TEST_CASE(dependency_change)
+{
+	SetState(Parent, ServiceCritical);
+	BOOST_CHECK(!Child->IsReachable());
+	BOOST_CHECK(!Grandchild->IsReachable());
+
+	ParentDependency->SetStateFilter(StateFilterUp | StateFilterDown);
+	BOOST_CHECK(Child->IsReachable());
+	BOOST_CHECK(Grandchild->IsReachable());
+
+	ParentDependency->SetStateFilter(StateFilterUp);
+	BOOST_CHECK(!Child->IsReachable());
+
+	SetState(Parent, ServiceCritical, StateTypeSoft);
+	BOOST_CHECK(Child->IsReachable());
+
+	ParentDependency->SetIgnoreSoftStates(false);
+	BOOST_CHECK(!Child->IsReachable());
+
+	/* checks are only suppressed when disable_checks is set */
+	BOOST_CHECK(Child->IsReachable(DependencyCheckExecution));
+
+	ParentDependency->SetDisableChecks(true);
+	BOOST_CHECK(!Child->IsReachable(DependencyCheckExecution));
+}
+
+BOOST_AUTO_TEST_CASE(dependency_removed)
+{
+	SetState(Parent, ServiceCritical);
+	BOOST_CHECK(!Child->IsReachable());
+	BOOST_CHECK(!Grandchild->IsReachable());
+
+	ParentDependency->Deactivate();
+	BOOST_CHECK(Child->IsReachable());
+	BOOST_CHECK(Grandchild->IsReachable());
+}
+
+BOOST_AUTO_TEST_CASE(invalidated_during_evaluation)
+{
+	SetState(Parent, ServiceOK);
+
+	/* the parent fails after the child's reachability was evaluated, but
+	 * before the result is cached */
+	boost::signals2::connection conn = Checkable::OnReachabilityEvaluated.connect(
+	    boost::bind(&DependencyFixture::FailParentHandler, _1, Child, Parent));
+
+	BOOST_CHECK(Child->IsReachable());
+
+	conn.disconnect();
+
+	BOOST_CHECK(!Child->IsReachable());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
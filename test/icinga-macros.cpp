@@ -64,4 +64,37 @@ BOOST_AUTO_TEST_CASE(simple)
 
 }
 
+BOOST_AUTO_TEST_CASE(cached)
+{
+	Dictionary::Ptr macros = new Dictionary();
+	macros->Set("name", "world");
+	macros->Set("count", 2);
+
+	Array::Ptr list = new Array();
+	list->Add("a");
+	list->Add("b");
+	macros->Set("list", list);
+
+	MacroProcessor::ResolverList resolvers;
+	resolvers.push_back(std::make_pair("macros", macros));
+
+	/* the compiled format string is reused on subsequent calls */
+	for (int i = 0; i < 2; i++) {
+		BOOST_CHECK(MacroProcessor::ResolveMacros("hello $macros.name$!", resolvers) == "hello world!");
+		BOOST_CHECK(MacroProcessor::ResolveMacros("$count$ $$ $name$", resolvers) == "2 $ world");
+		BOOST_CHECK(MacroProcessor::ResolveMacros("no macros", resolvers) == "no macros");
+		BOOST_CHECK(MacroProcessor::ResolveMacros("$count$", resolvers) == 2);
+	}
+
+	macros->Set("name", "icinga");
+	BOOST_CHECK(MacroProcessor::ResolveMacros("hello $macros.name$!", resolvers) == "hello icinga!");
+
+	String missingMacro;
+	BOOST_CHECK(MacroProcessor::ResolveMacros("x$unknown$y", resolvers, CheckResult::Ptr(), &missingMacro) == "xy");
+	BOOST_CHECK(missingMacro == "unknown");
+
+	BOOST_CHECK_THROW(MacroProcessor::ResolveMacros("items: $list$", resolvers), std::exception);
+	BOOST_CHECK_THROW(MacroProcessor::ResolveMacros("$name", resolvers), std::exception);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
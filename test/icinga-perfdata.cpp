@@ -19,7 +19,11 @@
 
 #include "icinga/perfdatavalue.hpp"
 #include "icinga/pluginutility.hpp"
+#include "icinga/checkresult.hpp"
+#include "base/utility.hpp"
+#include "base/objectlock.hpp"
 #include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
 
 using namespace icinga;
 
@@ -140,4 +144,117 @@ BOOST_AUTO_TEST_CASE(multi)
 	BOOST_CHECK(pd->Get(1) == "test::b=4");
 }
 
+BOOST_AUTO_TEST_CASE(checkresult)
+{
+	CheckResult::Ptr cr = new CheckResult();
+	BOOST_CHECK(cr->GetPerfdataValues()->GetLength() == 0);
+
+	cr->SetPerformanceData(PluginUtility::SplitPerfdata("time=0.5s;1;2;0 size=1,5KB offset=-0.25"));
+
+	Array::Ptr values = cr->GetPerfdataValues();
+	BOOST_CHECK(values->GetLength() == 2);
+	BOOST_CHECK(cr->GetPerfdataValues() == values);
+
+	PerfdataValue::Ptr pv = values->Get(0);
+	BOOST_CHECK(pv->GetLabel() == "time");
+	BOOST_CHECK(pv->GetValue() == 0.5);
+	BOOST_CHECK(pv->GetUnit() == "seconds");
+	BOOST_CHECK(pv->GetWarn() == 1);
+	BOOST_CHECK(pv->GetCrit() == 2);
+	BOOST_CHECK(pv->GetMin() == 0);
+	BOOST_CHECK(pv->GetMax() == Empty);
+
+	pv = values->Get(1);
+	BOOST_CHECK(pv->GetLabel() == "offset");
+	BOOST_CHECK(pv->GetValue() == -0.25);
+
+	cr->SetPerformanceData(PluginUtility::SplitPerfdata("rta=0.2ms"));
+	BOOST_CHECK(cr->GetPerfdataValues() != values);
+	BOOST_CHECK(cr->GetPerfdataValues()->GetLength() == 1);
+}
+
+/* performance data from the output of commonly used plugins */
+static const char *l_PerfdataCorpus[] = {
+	"rta=0.045000ms;3000.000000;5000.000000;0.000000 pl=0%;80;100;0",
+	"/=2643MB;5948;6691;0;7434 /boot=68MB;88;99;0;110 /home=69357MB;253404;285079;0;316755",
+	"load1=0.160;5.000;10.000;0; load5=0.240;4.000;6.000;0; load15=0.210;3.000;4.000;0;",
+	"time=0.018402s;;;0.000000 size=2344B;;;0",
+	"swap=2047MB;0;0;0;2047",
+	"users=3;20;50;0",
+	"procs=223;250;400;0;",
+	"Connections=12c;;; Open_files=40;;; Open_tables=31;;; Queries_per_second_avg=0.13;;; Slow_queries=0c;;; Uptime=6127s;;;",
+	"'C:\\ Used Space'=12.34Gb;40.51;45.57;0.00;50.63",
+	"'eth0 in'=1241512c;;; 'eth0 out'=99123c;;;",
+	"offset=-0.000412s;60.000000;120.000000;",
+	"temp=38.5;80;90 fan1=2100;500:;300: voltage=12.1;11.5:12.5;11:13",
+	"active=85;;; reading=0;;; writing=1;;; waiting=84;;; requests=10.5;;;",
+	"mem_used=73.42%;90;95;0;100 mem_free=2147483648B;;;0;8589934592"
+};
+
+BOOST_AUTO_TEST_CASE(corpus)
+{
+	size_t count = 0;
+
+	for (size_t i = 0; i < sizeof(l_PerfdataCorpus) / sizeof(l_PerfdataCorpus[0]); i++) {
+		Array::Ptr pd = PluginUtility::SplitPerfdata(l_PerfdataCorpus[i]);
+
+		ObjectLock olock(pd);
+		BOOST_FOREACH(const String& value, pd) {
+			PerfdataValue::Ptr pv = PerfdataValue::Parse(value);
+			BOOST_CHECK(pv);
+			count++;
+		}
+	}
+
+	BOOST_CHECK(count == 33);
+
+	PerfdataValue::Ptr pv = PerfdataValue::Parse("/boot=68MB;88;99;0;110");
+	BOOST_CHECK(pv->GetLabel() == "/boot");
+	BOOST_CHECK(pv->GetValue() == 68 * 1024 * 1024);
+	BOOST_CHECK(pv->GetUnit() == "bytes");
+	BOOST_CHECK(pv->GetMax() == 110 * 1024 * 1024);
+
+	pv = PerfdataValue::Parse("'C:\\ Used Space'=12.34Gb;40.51;45.57;0.00;50.63");
+	BOOST_CHECK(pv->GetLabel() == "C:\\ Used Space");
+	BOOST_CHECK(pv->GetUnit() == "bytes");
+
+	pv = PerfdataValue::Parse("fan1=2100;500:;300:");
+	BOOST_CHECK(pv->GetValue() == 2100);
+	BOOST_CHECK(pv->GetWarn() == Empty);
+	BOOST_CHECK(pv->GetCrit() == Empty);
+
+	pv = PerfdataValue::Parse("Slow_queries=0c;;;");
+	BOOST_CHECK(pv->GetCounter());
+	BOOST_CHECK(pv->GetUnit() == "");
+}
+
+/* measures how fast the performance data from the corpus is parsed */
+BOOST_AUTO_TEST_CASE(benchmark)
+{
+	std::vector<String> values;
+
+	for (size_t i = 0; i < sizeof(l_PerfdataCorpus) / sizeof(l_PerfdataCorpus[0]); i++) {
+		Array::Ptr pd = PluginUtility::SplitPerfdata(l_PerfdataCorpus[i]);
+
+		ObjectLock olock(pd);
+		BOOST_FOREACH(const String& value, pd) {
+			values.push_back(value);
+		}
+	}
+
+	const int rounds = 20000;
+
+	double start = Utility::GetTime();
+
+	for (int i = 0; i < rounds; i++) {
+		BOOST_FOREACH(const String& value, values) {
+			PerfdataValue::Parse(value);
+		}
+	}
+
+	double duration = Utility::GetTime() - start;
+
+	BOOST_TEST_MESSAGE(rounds * values.size() / duration << " values/s");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -18,14 +18,20 @@
  ******************************************************************************/
 
 #include "livestatus/livestatusquery.hpp"
+#include "livestatus/livestatuslogindex.hpp"
+#include "icinga/checkresult.hpp"
 #include "config/configcompiler.hpp"
 #include "config/configitem.hpp"
 #include "base/application.hpp"
 #include "base/stdiostream.hpp"
 #include "base/json.hpp"
+#include "base/convert.hpp"
+#include "base/objectlock.hpp"
 #include "base/loader.hpp"
+#include "base/utility.hpp"
 #include "cli/daemonutility.hpp"
 #include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
 #include <fstream>
 
 using namespace icinga;
@@ -202,6 +208,283 @@ BOOST_AUTO_TEST_CASE(services)
 
 	BOOST_TEST_MESSAGE("Done with testing livestatus services...");
 }
+
+BOOST_AUTO_TEST_CASE(filters)
+{
+	BOOST_TEST_MESSAGE( "Querying Livestatus...");
+
+	std::vector<String> lines;
+	lines.push_back("GET hosts");
+	lines.push_back("Columns: host_name");
+	lines.push_back("Filter: host_name ~~ ^TEST-0[12]$");
+	lines.push_back("Filter: address != 127.0.0.1");
+	lines.push_back("OutputFormat: json");
+	lines.push_back("\n");
+
+	Array::Ptr query_result = JsonDecode(LivestatusQueryHelper(lines));
+
+	BOOST_CHECK(query_result->GetLength() == 1);
+	BOOST_CHECK(Array::Ptr(query_result->Get(0))->Contains("test-02"));
+
+	/* invalid regular expressions don't match anything */
+	lines.clear();
+	lines.push_back("GET hosts");
+	lines.push_back("Columns: host_name");
+	lines.push_back("Filter: host_name ~ (test");
+	lines.push_back("OutputFormat: json");
+	lines.push_back("\n");
+
+	query_result = JsonDecode(LivestatusQueryHelper(lines));
+
+	BOOST_CHECK(query_result->GetLength() == 0);
+
+	BOOST_TEST_MESSAGE("Done with testing livestatus filters...");
+}
+
+BOOST_AUTO_TEST_CASE(stats)
+{
+	BOOST_TEST_MESSAGE( "Querying Livestatus...");
+
+	std::vector<String> lines;
+	lines.push_back("GET services");
+	lines.push_back("Columns: host_name");
+	lines.push_back("Stats: state >= 0");
+	lines.push_back("Stats: min state");
+	lines.push_back("OutputFormat: json");
+	lines.push_back("\n");
+
+	Array::Ptr query_result = JsonDecode(LivestatusQueryHelper(lines));
+
+	/* one row per host */
+	BOOST_CHECK(query_result->GetLength() == 2);
+
+	ObjectLock olock(query_result);
+	BOOST_FOREACH(const Array::Ptr& row, query_result) {
+		BOOST_CHECK(row->GetLength() == 3);
+		BOOST_CHECK(row->Get(0) == "test-01" || row->Get(0) == "test-02");
+		BOOST_CHECK(row->Get(1) == 1);
+		BOOST_CHECK(row->Get(2) == ServiceUnknown);
+	}
+
+	/* without group-by columns a single row is returned, even for empty result sets */
+	lines.clear();
+	lines.push_back("GET services");
+	lines.push_back("Filter: host_name = nonexistent");
+	lines.push_back("Stats: state >= 0");
+	lines.push_back("Stats: avg state");
+	lines.push_back("Stats: max state");
+	lines.push_back("OutputFormat: json");
+	lines.push_back("\n");
+
+	query_result = JsonDecode(LivestatusQueryHelper(lines));
+
+	BOOST_REQUIRE(query_result->GetLength() == 1);
+
+	Array::Ptr row = query_result->Get(0);
+	BOOST_REQUIRE(row->GetLength() == 3);
+	BOOST_CHECK(row->Get(0) == 0);
+	BOOST_CHECK(row->Get(1) == 0);
+	BOOST_CHECK(row->Get(2) == 0);
+
+	BOOST_TEST_MESSAGE("Done with testing livestatus stats...");
+}
+
+static void CollectLogLine(std::vector<String>& lines, const String& line)
+{
+	lines.push_back(line);
+}
+
+BOOST_AUTO_TEST_CASE(logindex)
+{
+	String path = "livestatus-logindex";
+
+	if (Utility::PathExists(path))
+		Utility::RemoveDirRecursive(path);
+
+	Utility::MkDirP(path + "/archives", 0750);
+
+	std::ofstream fp;
+	fp.open((path + "/archives/icinga-01-01-2015-00.log").CStr(), std::ofstream::out | std::ofstream::trunc);
+	fp << "[1420070400] LOG VERSION: 2.0\n";
+	fp << "[1420070401] SERVICE ALERT: test-01;livestatus;CRITICAL;HARD;1;foo\n";
+	fp << "[1420070402] HOST NOTIFICATION: admin;test-02;DOWN;DOWN;mail;bar\n";
+	fp.close();
+
+	fp.open((path + "/icinga.log").CStr(), std::ofstream::out | std::ofstream::trunc);
+	fp << "[1420156800] SERVICE ALERT: test-01;livestatus;OK;HARD;1;foo\n";
+	fp.close();
+
+	LivestatusLogIndex::Ptr index = LivestatusLogIndex::GetByPath(path);
+	index->Update();
+
+	std::vector<String> lines;
+	index->Query(0, 1420156800, String(), String(), boost::bind(&CollectLogLine, boost::ref(lines), _1));
+	BOOST_CHECK(lines.size() == 4);
+
+	/* time range and host name pre-selection, which works on blocks rather than single lines */
+	lines.clear();
+	index->Query(1420070402, 1420070402, "test-02", String(), boost::bind(&CollectLogLine, boost::ref(lines), _1));
+	BOOST_REQUIRE(lines.size() == 1);
+	BOOST_CHECK(lines[0].Contains("HOST NOTIFICATION"));
+
+	lines.clear();
+	index->Query(0, 1420156800, "test-03", String(), boost::bind(&CollectLogLine, boost::ref(lines), _1));
+	BOOST_CHECK(lines.empty());
+
+	/* service pre-selection */
+	lines.clear();
+	index->Query(0, 1420156800, "test-01", "livestatus", boost::bind(&CollectLogLine, boost::ref(lines), _1));
+	BOOST_REQUIRE(lines.size() == 4);
+	BOOST_CHECK(lines[3].Contains("test-01;livestatus;OK"));
+
+	lines.clear();
+	index->Query(0, 1420156800, "test-01", "ping", boost::bind(&CollectLogLine, boost::ref(lines), _1));
+	BOOST_CHECK(lines.empty());
+
+	/* host notifications don't reference a service */
+	lines.clear();
+	index->Query(0, 1420156800, "test-02", "DOWN", boost::bind(&CollectLogLine, boost::ref(lines), _1));
+	BOOST_CHECK(lines.empty());
+
+	/* appended lines are indexed incrementally */
+	fp.open((path + "/icinga.log").CStr(), std::ofstream::out | std::ofstream::app);
+	fp << "[1420156801] HOST ALERT: test-02;UP;HARD;1;up\n";
+	fp.close();
+
+	index->Update();
+
+	lines.clear();
+	index->Query(1420156801, 1420156900, "test-02", String(), boost::bind(&CollectLogLine, boost::ref(lines), _1));
+	BOOST_REQUIRE(lines.size() == 1);
+	BOOST_CHECK(lines[0].Contains("HOST ALERT"));
+
+	BOOST_CHECK(Utility::PathExists(LivestatusLogIndex::GetIndexPath(path)));
+
+	/* the file is truncated after the index was updated */
+	fp.open((path + "/icinga.log").CStr(), std::ofstream::out | std::ofstream::trunc);
+	fp << "[1420156800] SERVICE ALERT: test-01;livestatus;OK;HARD;1;foo\n";
+	fp.close();
+
+	lines.clear();
+	index->Query(1420156800, 1420156900, String(), String(), boost::bind(&CollectLogLine, boost::ref(lines), _1));
+	BOOST_CHECK(lines.size() <= 1);
+
+	/* files which shrank are indexed again */
+	fp.open((path + "/icinga.log").CStr(), std::ofstream::out | std::ofstream::app);
+	fp << "[1420156802] HOST ALERT: test-01;DOWN;HARD;1;down\n";
+	fp.close();
+
+	index->Update();
+
+	lines.clear();
+	index->Query(1420156800, 1420156900, String(), String(), boost::bind(&CollectLogLine, boost::ref(lines), _1));
+	BOOST_REQUIRE(lines.size() == 2);
+	BOOST_CHECK(lines[1].Contains("test-01;DOWN"));
+
+	Utility::RemoveDirRecursive(path);
+}
+
+BOOST_AUTO_TEST_CASE(fixed16)
+{
+	BOOST_TEST_MESSAGE( "Querying Livestatus...");
+
+	std::vector<String> lines;
+	lines.push_back("GET hosts");
+	lines.push_back("Columns: host_name address");
+	lines.push_back("ResponseHeader: fixed16");
+	lines.push_back("\n");
+
+	String output = LivestatusQueryHelper(lines);
+
+	/* the header contains the length of the streamed response */
+	String::SizeType pos = output.Find("\n");
+	BOOST_REQUIRE(pos != String::NPos);
+
+	String header = output.SubStr(0, pos);
+	String body = output.SubStr(pos + 1);
+
+	BOOST_CHECK(header.GetLength() == 15);
+	BOOST_CHECK(header.SubStr(0, 3) == "200");
+	BOOST_CHECK(Convert::ToLong(header.SubStr(3).Trim()) == static_cast<long>(body.GetLength()));
+	BOOST_CHECK(body.Find("test-01;127.0.0.1\n") != String::NPos);
+	BOOST_CHECK(body.Find("test-02;127.0.0.2\n") != String::NPos);
+
+	BOOST_TEST_MESSAGE("Done with testing livestatus fixed16...");
+}
+
+static bool ExecuteLogQuery(const String& path, const String& header, String& output)
+{
+	std::vector<String> lines;
+	lines.push_back("GET log");
+	lines.push_back("Columns: message");
+	/* current_host_parents is a list, '>' isn't a valid operator for lists */
+	lines.push_back("Filter: host_name = nonexistent");
+	lines.push_back("Filter: current_host_parents > foo");
+	lines.push_back("Or: 2");
+	lines.push_back("OutputFormat: json");
+	lines.push_back("KeepAlive: on");
+
+	if (!header.IsEmpty())
+		lines.push_back(header);
+
+	lines.push_back("\n");
+
+	LivestatusQuery::Ptr query = new LivestatusQuery(lines, path);
+
+	std::stringstream stream;
+	StdioStream::Ptr sstream = new StdioStream(&stream, false);
+
+	bool keepAlive = query->Execute(sstream);
+
+	output = stream.str();
+
+	return keepAlive;
+}
+
+BOOST_AUTO_TEST_CASE(error)
+{
+	String path = "livestatus-error";
+
+	if (Utility::PathExists(path))
+		Utility::RemoveDirRecursive(path);
+
+	Utility::MkDirP(path + "/archives", 0750);
+
+	std::ofstream fp;
+	fp.open((path + "/icinga.log").CStr(), std::ofstream::out | std::ofstream::trunc);
+
+	for (int i = 0; i < 10; i++)
+		fp << "[" << 1420070400 + i << "] SERVICE ALERT: nonexistent;livestatus;OK;HARD;1;foo\n";
+
+	fp << "[1420070500] HOST ALERT: test-01;DOWN;HARD;1;down\n";
+	fp.close();
+
+	/* errors which occur before any part of the response was sent result in an error response */
+	String output;
+	BOOST_CHECK(ExecuteLogQuery(path, "ResponseHeader: fixed16", output));
+	BOOST_CHECK(output.SubStr(0, 3) == "452");
+	BOOST_CHECK(output.Find("nonexistent;livestatus") == String::NPos);
+
+	/* once the first chunk of the response has been sent the connection is closed instead */
+	fp.open((path + "/icinga.log").CStr(), std::ofstream::out | std::ofstream::trunc);
+
+	for (int i = 0; i < 2000; i++)
+		fp << "[" << 1420070400 + i << "] SERVICE ALERT: nonexistent;livestatus;OK;HARD;1;" << String(64, 'x') << "\n";
+
+	fp << "[1420080000] HOST ALERT: test-01;DOWN;HARD;1;down\n";
+	fp.close();
+
+	BOOST_CHECK(!ExecuteLogQuery(path, String(), output));
+	BOOST_CHECK(output.GetLength() >= 64 * 1024);
+	BOOST_CHECK(output.SubStr(0, 2) == "[[");
+	BOOST_CHECK(output.Find("Invalid operator") == String::NPos);
+
+	/* the result set isn't terminated */
+	BOOST_CHECK(output.Find("]]") == String::NPos);
+
+	Utility::RemoveDirRecursive(path);
+}
+
 //____________________________________________________________________________//
 
 BOOST_AUTO_TEST_SUITE_END()
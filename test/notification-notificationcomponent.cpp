@@ -0,0 +1,168 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "notification/notificationcomponent.hpp"
+#include "icinga/host.hpp"
+#include "icinga/perfdatavalue.hpp"
+#include "base/convert.hpp"
+#include "base/utility.hpp"
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+
+using namespace icinga;
+
+/* The component connects to global signals, so there is only one instance
+ * for all tests. It isn't started, i.e. its timer doesn't run. */
+static NotificationComponent::Ptr GetNotificationComponent(void)
+{
+	static NotificationComponent::Ptr component;
+
+	if (!component) {
+		component = new NotificationComponent();
+		component->SetTypeNameV("NotificationComponent");
+		component->SetName("notification-test");
+		component->OnConfigLoaded();
+		component->Register();
+	}
+
+	return component;
+}
+
+struct NotificationComponentFixture
+{
+	NotificationComponentFixture(void)
+	{
+		Component = GetNotificationComponent();
+
+		HostObject = new Host();
+		HostObject->SetTypeNameV("Host");
+		HostObject->SetName("notification-host");
+		HostObject->Register();
+		HostObject->Activate();
+	}
+
+	~NotificationComponentFixture(void)
+	{
+		BOOST_FOREACH(const Notification::Ptr& notification, Notifications) {
+			notification->Deactivate();
+			notification->Unregister();
+		}
+
+		HostObject->Deactivate();
+		HostObject->Unregister();
+	}
+
+	Notification::Ptr AddNotification(double interval)
+	{
+		Notification::Ptr notification = new Notification();
+		notification->SetTypeNameV("Notification");
+		notification->SetName(HostObject->GetName() + "!notification-" + Convert::ToString(Notifications.size()));
+
+		/* host_name is protected, it's usually set by the config compiler */
+		Type::Ptr type = notification->GetReflectionType();
+		notification->SetField(type->GetFieldId("host_name"), HostObject->GetName());
+
+		notification->SetInterval(interval);
+
+		ConfigObject::Ptr object = notification;
+		object->OnConfigLoaded();
+		object->Register();
+		object->OnAllConfigLoaded();
+		object->Activate();
+
+		Notifications.push_back(notification);
+
+		return notification;
+	}
+
+	/* Returns the number of notifications in the reminder queue. */
+	double GetQueuedNotifications(void)
+	{
+		Dictionary::Ptr status = new Dictionary();
+		Array::Ptr perfdata = new Array();
+
+		NotificationComponent::StatsFunc(status, perfdata);
+
+		ObjectLock olock(perfdata);
+
+		BOOST_FOREACH(const PerfdataValue::Ptr& pdv, perfdata) {
+			if (pdv->GetLabel() == "notificationcomponent_" + Component->GetName() + "_idle")
+				return pdv->GetValue();
+		}
+
+		BOOST_FAIL("Missing notification component perfdata.");
+		return -1;
+	}
+
+	NotificationComponent::Ptr Component;
+	Host::Ptr HostObject;
+	std::vector<Notification::Ptr> Notifications;
+};
+
+BOOST_FIXTURE_TEST_SUITE(notification_notificationcomponent, NotificationComponentFixture)
+
+BOOST_AUTO_TEST_CASE(activate)
+{
+	BOOST_CHECK(GetQueuedNotifications() == 0);
+
+	AddNotification(1800);
+	BOOST_CHECK(GetQueuedNotifications() == 1);
+
+	AddNotification(0);
+	BOOST_CHECK(GetQueuedNotifications() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(interval)
+{
+	Notification::Ptr notification = AddNotification(0);
+	AddNotification(1800);
+	BOOST_CHECK(GetQueuedNotifications() == 2);
+
+	/* changing the interval reschedules the notification rather than adding it again */
+	notification->SetInterval(60);
+	BOOST_CHECK(GetQueuedNotifications() == 2);
+
+	notification->SetNextNotification(Utility::GetTime() + notification->GetInterval());
+	BOOST_CHECK(GetQueuedNotifications() == 2);
+
+	notification->SetInterval(0);
+	BOOST_CHECK(GetQueuedNotifications() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(deleted)
+{
+	Notification::Ptr notification = AddNotification(1800);
+	AddNotification(1800);
+	BOOST_CHECK(GetQueuedNotifications() == 2);
+
+	notification->Deactivate();
+	BOOST_CHECK(GetQueuedNotifications() == 1);
+
+	/* deleted notifications aren't queued again when they are changed */
+	notification->SetInterval(60);
+	notification->SetNextNotification(Utility::GetTime());
+	BOOST_CHECK(GetQueuedNotifications() == 1);
+
+	/* nor when their checkable changes state */
+	Checkable::OnStateChange(HostObject, CheckResult::Ptr(), StateTypeHard, MessageOrigin::Ptr());
+	BOOST_CHECK(GetQueuedNotifications() == 1);
+	BOOST_CHECK(HostObject->GetNotifications().size() == 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,271 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "perfdata/metricqueue.hpp"
+#include "base/stream.hpp"
+#include "base/convert.hpp"
+#include "base/utility.hpp"
+#include <boost/test/unit_test.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <fstream>
+#include <cstdio>
+
+using namespace icinga;
+
+/**
+ * A stream which keeps the written data in memory. Writes can be blocked
+ * or made to fail.
+ */
+class TestMetricStream : public Stream
+{
+public:
+	DECLARE_PTR_TYPEDEFS(TestMetricStream);
+
+	TestMetricStream(void)
+		: m_Writes(0), m_Blocked(false), m_Fail(false)
+	{ }
+
+	virtual size_t Read(void *buffer, size_t count, bool allow_partial) override
+	{
+		return 0;
+	}
+
+	virtual void Write(const void *buffer, size_t count) override
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		m_Writes++;
+		m_CV.notify_all();
+
+		while (m_Blocked)
+			m_CV.wait(lock);
+
+		if (m_Fail)
+			BOOST_THROW_EXCEPTION(std::runtime_error("Write failed."));
+
+		m_Data += String(static_cast<const char *>(buffer), static_cast<const char *>(buffer) + count);
+	}
+
+	virtual void Close(void) override
+	{ }
+
+	virtual bool IsEof(void) const override
+	{
+		return false;
+	}
+
+	void SetBlocked(bool blocked)
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		m_Blocked = blocked;
+		m_CV.notify_all();
+	}
+
+	void SetFail(bool fail)
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		m_Fail = fail;
+	}
+
+	/* Waits until Write() was called at least the specified number of times. */
+	bool WaitForWrites(int writes)
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		boost::system_time deadline = boost::get_system_time() + boost::posix_time::seconds(10);
+
+		while (m_Writes < writes) {
+			if (!m_CV.timed_wait(lock, deadline))
+				return false;
+		}
+
+		return true;
+	}
+
+	int GetWrites(void)
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		return m_Writes;
+	}
+
+	String GetData(void)
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		return m_Data;
+	}
+
+private:
+	boost::mutex m_Mutex;
+	boost::condition_variable m_CV;
+	int m_Writes;
+	bool m_Blocked;
+	bool m_Fail;
+	String m_Data;
+};
+
+struct MetricQueueFixture
+{
+	MetricQueueFixture(void)
+		: SpoolPath(Convert::ToString(Utility::GetPid()) + "-metricqueue.spool"),
+		  Queue(new MetricQueue("MetricQueueTest", SpoolPath)), Output(new TestMetricStream())
+	{
+		(void) remove(SpoolPath.CStr());
+	}
+
+	~MetricQueueFixture(void)
+	{
+		Output->SetBlocked(false);
+		Queue->Stop();
+		(void) remove(SpoolPath.CStr());
+	}
+
+	Value GetStat(const String& name)
+	{
+		return Queue->GetStats("test_", new Array())->Get(name);
+	}
+
+	String ReadSpool(void)
+	{
+		std::ifstream fp(SpoolPath.CStr(), std::ios_base::in | std::ios_base::binary);
+		return String(std::istreambuf_iterator<char>(fp), std::istreambuf_iterator<char>());
+	}
+
+	String SpoolPath;
+	MetricQueue::Ptr Queue;
+	TestMetricStream::Ptr Output;
+};
+
+BOOST_FIXTURE_TEST_SUITE(perfdata_metricqueue, MetricQueueFixture)
+
+BOOST_AUTO_TEST_CASE(drop)
+{
+	Queue->SetStream(Output);
+	Queue->Start(2, 1, 60, 0);
+
+	/* keep the flush thread busy with the first record */
+	Output->SetBlocked(true);
+	Queue->Enqueue("a\n");
+	BOOST_REQUIRE(Output->WaitForWrites(1));
+
+	Queue->Enqueue("b\n");
+	Queue->Enqueue("c\n");
+	Queue->Enqueue("d\n");
+	Queue->Enqueue("e\n");
+
+	BOOST_CHECK(GetStat("queue_size") == 2);
+	BOOST_CHECK(GetStat("dropped") == 2);
+
+	Output->SetBlocked(false);
+	BOOST_REQUIRE(Output->WaitForWrites(2));
+
+	Queue->Stop();
+
+	BOOST_CHECK(Output->GetData() == "a\nb\nc\n");
+	BOOST_CHECK(GetStat("dropped") == 2);
+}
+
+BOOST_AUTO_TEST_CASE(batch)
+{
+	Queue->SetStream(Output);
+	Queue->Start(100, 3, 60, 0);
+
+	Queue->Enqueue("a\n");
+	Queue->Enqueue("b\n");
+
+	Utility::Sleep(0.2);
+	BOOST_CHECK(Output->GetWrites() == 0);
+
+	/* the third record fills the batch */
+	Queue->Enqueue("c\n");
+
+	BOOST_REQUIRE(Output->WaitForWrites(1));
+	BOOST_CHECK(Output->GetData() == "a\nb\nc\n");
+	BOOST_CHECK(Output->GetWrites() == 1);
+	BOOST_CHECK(GetStat("bytes_sent") == 6);
+}
+
+BOOST_AUTO_TEST_CASE(spool)
+{
+	Queue->Start(100, 1, 60, 1024);
+
+	Queue->Enqueue("a\n");
+	Queue->Flush();
+	BOOST_CHECK(GetStat("spool_size") == 2);
+
+	Queue->Enqueue("b\n");
+	Queue->Flush();
+	BOOST_CHECK(GetStat("spool_size") == 4);
+
+	BOOST_CHECK(ReadSpool() == "a\nb\n");
+
+	Queue->SetStream(Output);
+	Queue->Enqueue("c\n");
+	Queue->Flush();
+
+	/* spooled records are replayed before new records are written */
+	BOOST_CHECK(Output->GetData() == "a\nb\nc\n");
+	BOOST_CHECK(GetStat("spool_size") == 0);
+	BOOST_CHECK(!Utility::PathExists(SpoolPath));
+}
+
+BOOST_AUTO_TEST_CASE(spool_size)
+{
+	Queue->Start(100, 1, 60, 4);
+
+	Queue->Enqueue("a\n");
+	Queue->Flush();
+
+	Queue->Enqueue("b\n");
+	Queue->Flush();
+	BOOST_CHECK(GetStat("spool_size") == 4);
+
+	/* the spool file is full */
+	Queue->Enqueue("c\n");
+	Queue->Flush();
+
+	BOOST_CHECK(GetStat("dropped") == 1);
+	BOOST_CHECK(GetStat("spool_size") == 4);
+	BOOST_CHECK(ReadSpool() == "a\nb\n");
+}
+
+BOOST_AUTO_TEST_CASE(replay_failure)
+{
+	Queue->Start(100, 1, 60, 1024);
+
+	Queue->Enqueue("a\n");
+	Queue->Flush();
+	BOOST_CHECK(GetStat("spool_size") == 2);
+
+	Output->SetFail(true);
+	Queue->SetStream(Output);
+	Queue->Flush();
+
+	/* the queue drops the broken stream and keeps the spool file */
+	BOOST_CHECK(Output->GetWrites() == 1);
+	BOOST_CHECK(!Queue->IsConnected());
+	BOOST_CHECK(GetStat("spool_size") == 2);
+	BOOST_CHECK(ReadSpool() == "a\n");
+
+	Queue->Enqueue("b\n");
+	Queue->Flush();
+	BOOST_CHECK(GetStat("spool_size") == 4);
+	BOOST_CHECK(ReadSpool() == "a\nb\n");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,204 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+
+#include "remote/apilog.hpp"
+#include "base/netstring.hpp"
+#include "base/json.hpp"
+#include "base/dictionary.hpp"
+#include "base/convert.hpp"
+#include "base/utility.hpp"
+#include <boost/test/unit_test.hpp>
+#include <fstream>
+#include <unistd.h>
+
+using namespace icinga;
+
+static String GetApiLogTestPath(const String& name)
+{
+	return "/tmp/icinga2-test-apilog-" + Convert::ToString(static_cast<long>(getpid())) + "-" + name;
+}
+
+static void RemoveApiLog(const String& path)
+{
+	(void)unlink(path.CStr());
+	(void)unlink((path + ".idx").CStr());
+}
+
+BOOST_AUTO_TEST_SUITE(remote_apilog)
+
+BOOST_AUTO_TEST_CASE(readwrite)
+{
+	String path = GetApiLogTestPath("readwrite");
+	RemoveApiLog(path);
+
+	ApiLogWriter::Ptr writer = new ApiLogWriter(path);
+	BOOST_CHECK(writer->IsOpen());
+
+	ApiLogRecord record;
+	record.Timestamp = 1000.25;
+	record.SecobjType = "Host";
+	record.SecobjName = "localhost";
+	record.Message = "{\"method\":\"event::CheckResult\"}";
+	writer->Write(record);
+
+	record.Timestamp = 1001.5;
+	record.SecobjType = "";
+	record.SecobjName = "";
+	record.Message = "{}";
+	writer->Write(record);
+
+	writer->Close();
+
+	ApiLogReader::Ptr reader = new ApiLogReader(path);
+	BOOST_CHECK(reader->IsOpen());
+
+	BOOST_CHECK(reader->ReadRecord(&record));
+	BOOST_CHECK(record.Timestamp == 1000.25);
+	BOOST_CHECK(record.SecobjType == "Host");
+	BOOST_CHECK(record.SecobjName == "localhost");
+	BOOST_CHECK(record.Message == "{\"method\":\"event::CheckResult\"}");
+
+	BOOST_CHECK(reader->ReadRecord(&record));
+	BOOST_CHECK(record.Timestamp == 1001.5);
+	BOOST_CHECK(record.SecobjType.IsEmpty());
+	BOOST_CHECK(record.Message == "{}");
+
+	BOOST_CHECK(!reader->ReadRecord(&record));
+
+	RemoveApiLog(path);
+}
+
+BOOST_AUTO_TEST_CASE(seek)
+{
+	String path = GetApiLogTestPath("seek");
+	RemoveApiLog(path);
+
+	ApiLogWriter::Ptr writer = new ApiLogWriter(path);
+
+	/* large enough to create a number of index entries */
+	ApiLogRecord record;
+	record.SecobjType = "Service";
+	record.SecobjName = "localhost!ping4";
+	record.Message = String(1000, 'x');
+
+	for (int i = 0; i < 1000; i++) {
+		record.Timestamp = 1000 + i;
+		writer->Write(record);
+	}
+
+	writer->Close();
+
+	ApiLogReader::Ptr reader = new ApiLogReader(path);
+	reader->Seek(1500);
+
+	/* the index has an entry for about every 64 records */
+	BOOST_CHECK(reader->ReadRecord(&record));
+	BOOST_CHECK(record.Timestamp <= 1500);
+	BOOST_CHECK(record.Timestamp > 1400);
+
+	BOOST_CHECK(reader->ReadRecord(&record, 1500));
+	BOOST_CHECK(record.Timestamp == 1501);
+
+	int count = 1;
+
+	while (reader->ReadRecord(&record, 1500))
+		count++;
+
+	BOOST_CHECK(count == 499);
+
+	RemoveApiLog(path);
+}
+
+BOOST_AUTO_TEST_CASE(torn)
+{
+	String path = GetApiLogTestPath("torn");
+	RemoveApiLog(path);
+
+	ApiLogWriter::Ptr writer = new ApiLogWriter(path);
+
+	ApiLogRecord record;
+	record.Timestamp = 1000;
+	record.SecobjType = "Host";
+	record.SecobjName = "localhost";
+	record.Message = String(100000, 'x');
+	writer->Write(record);
+	writer->Close();
+
+	/* a header with a length which is larger than the rest of the file */
+	std::ofstream fp(path.CStr(), std::ofstream::out | std::ofstream::binary | std::ofstream::app);
+	fp.write("\xff\xff\xff\xf0\x40\x9f\x40\x00\x00\x00\x00\x00", 12);
+	fp.write("garbage", 7);
+	fp.close();
+
+	ApiLogReader::Ptr reader = new ApiLogReader(path);
+
+	BOOST_CHECK(reader->ReadRecord(&record));
+	BOOST_CHECK(record.Message.GetLength() == 100000);
+	BOOST_CHECK(!reader->ReadRecord(&record));
+
+	/* a large record which was cut off */
+	BOOST_REQUIRE(truncate(path.CStr(), 1000) == 0);
+
+	reader = new ApiLogReader(path);
+	BOOST_CHECK(!reader->ReadRecord(&record));
+
+	RemoveApiLog(path);
+}
+
+BOOST_AUTO_TEST_CASE(legacy)
+{
+	String path = GetApiLogTestPath("legacy");
+	RemoveApiLog(path);
+
+	std::ofstream fp(path.CStr(), std::ofstream::out | std::ofstream::binary);
+
+	for (int i = 0; i < 3; i++) {
+		Dictionary::Ptr secname = new Dictionary();
+		secname->Set("type", "Host");
+		secname->Set("name", "localhost");
+
+		Dictionary::Ptr pmessage = new Dictionary();
+		pmessage->Set("timestamp", 1000 + i);
+		pmessage->Set("message", "{}");
+		pmessage->Set("secobj", secname);
+
+		String data = NetString::Encode(JsonEncode(pmessage));
+		fp.write(data.CStr(), data.GetLength());
+	}
+
+	fp.close();
+
+	ApiLogReader::Ptr reader = new ApiLogReader(path);
+	BOOST_CHECK(reader->IsOpen());
+
+	ApiLogRecord record;
+	BOOST_CHECK(reader->ReadRecord(&record, 1000));
+	BOOST_CHECK(record.Timestamp == 1001);
+	BOOST_CHECK(record.SecobjType == "Host");
+	BOOST_CHECK(record.SecobjName == "localhost");
+	BOOST_CHECK(record.Message == "{}");
+
+	BOOST_CHECK(reader->ReadRecord(&record, 1000));
+	BOOST_CHECK(!reader->ReadRecord(&record, 1000));
+
+	RemoveApiLog(path);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
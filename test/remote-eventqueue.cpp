@@ -0,0 +1,149 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "remote/eventqueue.hpp"
+#include "base/socket.hpp"
+#include "base/tlsstream.hpp"
+#include "base/dictionary.hpp"
+#include "base/utility.hpp"
+#include <boost/test/unit_test.hpp>
+#include <signal.h>
+
+using namespace icinga;
+
+/* The peer never answers the TLS handshake: everything written to the
+ * stream stays in its send queue. */
+static TlsStream::Ptr MakeStalledStream(Socket::Ptr& peer)
+{
+	SOCKET fds[2];
+	Socket::SocketPair(fds);
+
+	peer = new Socket(fds[1]);
+
+	return new TlsStream(new Socket(fds[0]), String(), RoleClient);
+}
+
+static EventQueueClient::Ptr AddClient(const String& name, const TlsStream::Ptr& stream,
+    size_t maxPending, EventQueueOverflowPolicy policy)
+{
+	EventQueue::Ptr queue = new EventQueue(name);
+	EventQueue::Register(name, queue);
+
+	EventQueueClient::Ptr client = new EventQueueClient(name, stream, maxPending, policy);
+	queue->AddClient(client);
+	client->Start();
+
+	return client;
+}
+
+static void SendEvents(const String& name, int count, size_t size)
+{
+	EventQueue::Ptr queue = EventQueue::GetByName(name);
+
+	for (int i = 0; i < count && queue; i++) {
+		Dictionary::Ptr event = new Dictionary();
+		event->Set("type", "CheckResult");
+		event->Set("data", String(size, 'x'));
+
+		queue->ProcessEvent(event);
+	}
+}
+
+static unsigned long GetDroppedEvents(void)
+{
+	size_t clients, pending;
+	unsigned long dropped;
+
+	EventQueue::GetStats(clients, pending, dropped);
+
+	return dropped;
+}
+
+BOOST_AUTO_TEST_SUITE(remote_eventqueue)
+
+BOOST_AUTO_TEST_CASE(drop)
+{
+	Socket::Ptr peer;
+	TlsStream::Ptr stream = MakeStalledStream(peer);
+
+	EventQueueClient::Ptr client = AddClient("test-drop", stream, 10, EventQueueDrop);
+
+	unsigned long dropped = GetDroppedEvents();
+
+	/* no more than five of these events fit into the stream's send queue */
+	SendEvents("test-drop", 30, 16 * 1024);
+
+	BOOST_CHECK(client->GetPending() == 10);
+	BOOST_CHECK(GetDroppedEvents() - dropped >= 15);
+
+	/* dropping events keeps the client connected */
+	BOOST_CHECK(!stream->IsEof());
+	BOOST_CHECK(EventQueue::GetByName("test-drop"));
+
+	client->Disconnect();
+
+	BOOST_CHECK(stream->IsEof());
+	BOOST_CHECK(!EventQueue::GetByName("test-drop"));
+}
+
+BOOST_AUTO_TEST_CASE(disconnect)
+{
+	Socket::Ptr peer;
+	TlsStream::Ptr stream = MakeStalledStream(peer);
+
+	EventQueueClient::Ptr client = AddClient("test-disconnect", stream, 10, EventQueueDisconnect);
+
+	unsigned long dropped = GetDroppedEvents();
+
+	SendEvents("test-disconnect", 30, 16 * 1024);
+
+	BOOST_CHECK(stream->IsEof());
+	BOOST_CHECK(client->GetPending() == 0);
+	BOOST_CHECK(!EventQueue::GetByName("test-disconnect"));
+
+	/* disconnected clients don't count as dropped events */
+	BOOST_CHECK(GetDroppedEvents() == dropped);
+}
+
+BOOST_AUTO_TEST_CASE(stream_closed)
+{
+	Socket::Ptr peer;
+	TlsStream::Ptr stream = MakeStalledStream(peer);
+
+	EventQueueClient::Ptr client = AddClient("test-close", stream, 10, EventQueueDrop);
+
+#ifndef _WIN32
+	/* icinga2's main() usually takes care of this */
+	signal(SIGPIPE, SIG_IGN);
+#endif /* _WIN32 */
+
+	/* starts the handshake so that the stream waits for the peer */
+	SendEvents("test-close", 1, 16);
+	BOOST_CHECK(EventQueue::GetByName("test-close"));
+
+	peer->Close();
+
+	for (int i = 0; i < 100 && EventQueue::GetByName("test-close"); i++)
+		Utility::Sleep(0.1);
+
+	BOOST_CHECK(stream->IsEof());
+	BOOST_CHECK(!EventQueue::GetByName("test-close"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()